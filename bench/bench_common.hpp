@@ -0,0 +1,63 @@
+#ifndef BENCH_COMMON_HPP
+#define BENCH_COMMON_HPP
+
+/*
+    helpers shared by the headless benchmarks
+    - options are "--name n" pairs with unsigned values
+    - results are one JSON object on stdout, made of named entries
+*/
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+#include "../src/algorithms/timer.hpp"
+
+// option of a benchmark, value is set when name is passed
+struct benchOption {
+    const char* name;
+    unsigned int* value;
+};
+
+// set the options passed as "--name n", false and a message on an unknown option or a missing value
+static bool parseOptions(int argc, char** argv, std::initializer_list<benchOption> options) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "missing value for %s\n", argv[i]);
+            return false;
+        }
+
+        const benchOption* option = nullptr;
+        for (const benchOption& candidate : options) {
+            if (!std::strcmp(argv[i], candidate.name)) {
+                option = &candidate;
+                break;
+            }
+        }
+        if (!option) {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return false;
+        }
+
+        *option->value = (unsigned int)std::strtoul(argv[i + 1], nullptr, 10);
+        i++;
+    }
+    return true;
+}
+
+// print an entry of the result object ("name": { fields }), fields are formatted like printf
+// - last leaves out the comma, so the entry can close the object
+static void reportEntry(const char* name, bool last, const char* format, ...) {
+    std::printf("  \"%s\": { ", name);
+
+    va_list args;
+    va_start(args, format);
+    std::vprintf(format, args);
+    va_end(args);
+
+    std::printf(" }%s\n", last ? "" : ",");
+}
+
+#endif
@@ -0,0 +1,130 @@
+/*
+    bounding region copy benchmark
+    - moves a grid of instances through both octrees every frame
+    - BoundingRegion counts its copies (BOUNDS_COUNT_COPIES), the broad phase should not copy any
+      once the trees are built
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../src/algorithms/octree.hpp"
+#include "../src/algorithms/linear_octree.hpp"
+
+#ifndef BOUNDS_COUNT_COPIES
+#error "bounds_bench needs BOUNDS_COUNT_COPIES defined"
+#endif
+
+// instances per axis
+#define GRID_SIZE 16
+// distance between instances (larger than their regions, so they never collide)
+#define GRID_SPACING 2.0f
+
+// frames timed after warming up
+#define NO_FRAMES 200
+
+struct benchResult {
+    unsigned long long buildCopies;
+    unsigned long long frameCopies;
+    double msPerFrame;
+};
+
+// move every other instance along x, back and forth so they stay inside the root
+static void moveInstances(std::vector<std::unique_ptr<RigidBody>>& instances, int frame) {
+    float step = (frame / 32) % 2 ? -0.05f : 0.05f;
+    for (unsigned int i = 0; i < instances.size(); i++) {
+        if (i % 2) {
+            States::deactivate(&instances[i]->state, INSTANCE_MOVED);
+            continue;
+        }
+
+        instances[i]->pos.x += step;
+        States::activate(&instances[i]->state, INSTANCE_MOVED);
+    }
+}
+
+template <typename Tree>
+static benchResult run(std::vector<std::unique_ptr<RigidBody>>& instances, const std::vector<BoundingRegion>& regions) {
+    benchResult ret;
+    std::vector<glm::vec3> positions, sizes;
+
+    float halfExtent = GRID_SIZE * GRID_SPACING;
+    Tree tree(BoundingRegion(glm::vec3(-halfExtent), glm::vec3(halfExtent)));
+
+    // build (copies from the model's regions are expected here)
+    CopyCounter::noCopies = 0;
+    for (std::unique_ptr<RigidBody>& rb : instances) {
+        tree.addToPending(rb.get(), regions);
+    }
+    tree.update(positions, sizes);
+    ret.buildCopies = CopyCounter::noCopies;
+
+    // warm up so the pools and scratch lists reach their final size
+    for (int frame = 0; frame < 16; frame++) {
+        moveInstances(instances, frame);
+        positions.clear();
+        sizes.clear();
+        tree.update(positions, sizes);
+    }
+
+    CopyCounter::noCopies = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < NO_FRAMES; frame++) {
+        moveInstances(instances, frame);
+        positions.clear();
+        sizes.clear();
+        tree.update(positions, sizes);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    ret.frameCopies = CopyCounter::noCopies;
+    ret.msPerFrame = std::chrono::duration<double, std::milli>(end - start).count() / NO_FRAMES;
+
+    tree.destroy();
+    return ret;
+}
+
+static void report(const char* name, benchResult res) {
+    std::printf("%-12s build copies: %8llu  copies/frame: %8.2f  ms/frame: %8.3f\n",
+        name, res.buildCopies, (double)res.frameCopies / NO_FRAMES, res.msPerFrame);
+}
+
+// instances of a model with one sphere region, placed on a grid around the origin
+static std::vector<std::unique_ptr<RigidBody>> makeInstances() {
+    std::vector<std::unique_ptr<RigidBody>> ret;
+    for (int x = 0; x < GRID_SIZE; x++) {
+        for (int y = 0; y < GRID_SIZE; y++) {
+            for (int z = 0; z < GRID_SIZE; z++) {
+                std::unique_ptr<RigidBody> rb = std::make_unique<RigidBody>();
+                rb->pos = (glm::vec3(x, y, z) - 0.5f * GRID_SIZE + 0.5f) * GRID_SPACING;
+                rb->instanceId = ret.size();
+                rb->state = 0;
+                ret.push_back(std::move(rb));
+            }
+        }
+    }
+    return ret;
+}
+
+int main() {
+    std::vector<BoundingRegion> regions = { BoundingRegion(glm::vec3(0.0f), 0.5f) };
+    regions[0].collisionMesh = nullptr;
+    regions[0].instance = nullptr;
+
+    std::vector<std::unique_ptr<RigidBody>> instances = makeInstances();
+    benchResult nodeRes = run<Octree::node>(instances, regions);
+
+    instances = makeInstances();
+    benchResult linearRes = run<Octree::LinearTree>(instances, regions);
+
+    std::printf("%u instances, %u frames\n", (unsigned int)instances.size(), NO_FRAMES);
+    report("node", nodeRes);
+    report("linear", linearRes);
+
+    // non-zero exit if the hot path copies regions
+    return (nodeRes.frameCopies || linearRes.frameCopies) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
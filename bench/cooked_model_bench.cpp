@@ -0,0 +1,323 @@
+/*
+    headless cooked model benchmark (no Assimp or GPU)
+    - generates meshes the way an importer hands them over: a vertex per face corner, so most
+      vertices appear several times, plus a source file standing in for the model
+    - measures the import (deduplicating the vertices with a hash map, as Model::importMesh does),
+      cooking the result and loading it back from the mapped file
+    - checks the loaded meshes match the import (small meshes get 16 bit indices, the last one
+      needs 32 bit), and that touching or editing the source file, changing the vertex size or an
+      index past the vertices of its mesh rejects the cooked file, prints timings as JSON
+
+    usage: cooked_model_bench [--meshes n] [--grid n] [--runs n]
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bench_common.hpp"
+#include "../src/graphics/cooked_model.hpp"
+
+// same size and layout as the engine's Vertex (position, color, normal, texCoord, tangent)
+struct benchVertex {
+    float position[3];
+    float color[3];
+    float normal[3];
+    float texCoord[2];
+    float tangent[3];
+
+    bool operator==(const benchVertex& other) const {
+        return std::memcmp(this, &other, sizeof(benchVertex)) == 0;
+    }
+};
+
+struct benchVertexHash {
+    size_t operator()(const benchVertex& vertex) const {
+        // FNV-1a over the bytes
+        size_t h = 1469598103934665603ULL;
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&vertex);
+        for (size_t i = 0; i < sizeof(benchVertex); i++) {
+            h = (h ^ bytes[i]) * 1099511628211ULL;
+        }
+        return h;
+    }
+};
+
+struct benchConfig {
+    unsigned int noMeshes = 16;
+    // quads per side of each small mesh
+    unsigned int grid = 96;
+    unsigned int runs = 5;
+};
+
+// what the importer produces for a mesh
+struct rawMesh {
+    // 6 per quad, shared corners repeated
+    std::vector<benchVertex> corners;
+};
+
+struct importedMesh {
+    std::vector<benchVertex> vertices;
+    std::vector<uint32_t> indices;
+    CookedModel::Bounds bounds;
+};
+
+static bool parseArgs(int argc, char** argv, benchConfig& config) {
+    if (!parseOptions(argc, argv, {
+            { "--meshes", &config.noMeshes },
+            { "--grid", &config.grid },
+            { "--runs", &config.runs } })) {
+        return false;
+    }
+    return config.noMeshes > 0 && config.grid > 0 && config.runs > 0;
+}
+
+static void writeFile(const std::filesystem::path& path, const std::string& contents) {
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << contents;
+}
+
+// a wavy grid of grid x grid quads
+static rawMesh generateMesh(unsigned int grid, float offset) {
+    rawMesh ret;
+    ret.corners.reserve(6ULL * grid * grid);
+
+    auto corner = [&](unsigned int x, unsigned int y) {
+        benchVertex v{};
+        float u = (float)x / grid;
+        float w = (float)y / grid;
+        v.position[0] = u * 10.0f + offset;
+        v.position[1] = std::sin(u * 6.0f) * std::cos(w * 6.0f);
+        v.position[2] = w * 10.0f;
+        v.normal[1] = 1.0f;
+        v.texCoord[0] = u;
+        v.texCoord[1] = w;
+        v.tangent[0] = 1.0f;
+        ret.corners.push_back(v);
+    };
+
+    for (unsigned int y = 0; y < grid; y++) {
+        for (unsigned int x = 0; x < grid; x++) {
+            corner(x, y);
+            corner(x + 1, y);
+            corner(x + 1, y + 1);
+            corner(x, y);
+            corner(x + 1, y + 1);
+            corner(x, y + 1);
+        }
+    }
+    return ret;
+}
+
+// deduplicate the corners and compute the bounds (what Model::importMesh does per mesh)
+static void importMesh(const rawMesh& raw, importedMesh& imported) {
+    imported.vertices.clear();
+    imported.indices.clear();
+    imported.vertices.reserve(raw.corners.size());
+    imported.indices.reserve(raw.corners.size());
+
+    float min[3] = { INFINITY, INFINITY, INFINITY };
+    float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+
+    std::unordered_map<benchVertex, uint32_t, benchVertexHash> uniqueVertices;
+    for (const benchVertex& vertex : raw.corners) {
+        auto [it, inserted] = uniqueVertices.try_emplace(vertex, (uint32_t)imported.vertices.size());
+        if (inserted) {
+            imported.vertices.push_back(vertex);
+            for (int i = 0; i < 3; i++) {
+                min[i] = std::fmin(min[i], vertex.position[i]);
+                max[i] = std::fmax(max[i], vertex.position[i]);
+            }
+        }
+        imported.indices.push_back(it->second);
+    }
+
+    float radius = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        imported.bounds.sphere[i] = (min[i] + max[i]) / 2.0f;
+        imported.bounds.min[i] = min[i];
+        imported.bounds.max[i] = max[i];
+    }
+    for (const benchVertex& vertex : imported.vertices) {
+        float dx = vertex.position[0] - imported.bounds.sphere[0];
+        float dy = vertex.position[1] - imported.bounds.sphere[1];
+        float dz = vertex.position[2] - imported.bounds.sphere[2];
+        radius = std::fmax(radius, std::sqrt(dx * dx + dy * dy + dz * dz));
+    }
+    imported.bounds.sphere[3] = radius;
+}
+
+static bool cook(const std::string& path, const std::string& source, const std::vector<importedMesh>& imported,
+    const std::vector<CookedModel::Material>& materials) {
+    std::vector<CookedModel::MeshSource> sources(imported.size());
+    for (unsigned int i = 0; i < imported.size(); i++) {
+        sources[i].vertices = imported[i].vertices.data();
+        sources[i].vertexCount = imported[i].vertices.size();
+        sources[i].indices = imported[i].indices.data();
+        sources[i].indexCount = imported[i].indices.size();
+        sources[i].materialIndex = i % materials.size();
+        sources[i].bounds = imported[i].bounds;
+    }
+
+    std::string error;
+    if (!CookedModel::write(path, sizeof(benchVertex), { source }, sources, materials, error)) {
+        std::fprintf(stderr, "failed to cook %s: %s\n", path.c_str(), error.c_str());
+        return false;
+    }
+    return true;
+}
+
+// open and copy every mesh out of the mapping (what Model::readCooked does)
+static bool loadCooked(const std::string& path, std::vector<importedMesh>& loaded, unsigned int& noShortIndices) {
+    CookedModel cooked;
+    if (!cooked.open(path, sizeof(benchVertex))) {
+        std::fprintf(stderr, "failed to open %s: %s\n", path.c_str(), cooked.getLoadError().c_str());
+        return false;
+    }
+
+    noShortIndices = 0;
+    loaded.resize(cooked.noMeshes());
+    for (unsigned int i = 0; i < cooked.noMeshes(); i++) {
+        CookedModel::MeshView view = cooked.getMesh(i);
+        loaded[i].vertices.resize(view.vertexCount);
+        std::memcpy(loaded[i].vertices.data(), view.vertices, view.vertexCount * sizeof(benchVertex));
+        loaded[i].indices.resize(view.indexCount);
+        cooked.readIndices(i, loaded[i].indices.data());
+        loaded[i].bounds = view.bounds;
+        noShortIndices += view.indexSize == sizeof(uint16_t);
+    }
+    return true;
+}
+
+static bool sameMeshes(const std::vector<importedMesh>& a, const std::vector<importedMesh>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (unsigned int i = 0; i < a.size(); i++) {
+        if (a[i].vertices != b[i].vertices || a[i].indices != b[i].indices
+            || std::memcmp(&a[i].bounds, &b[i].bounds, sizeof(CookedModel::Bounds))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// false and a message if open accepts the cooked file
+static bool expectStale(const char* name, const std::string& path, uint32_t vertexStride) {
+    CookedModel cooked;
+    if (cooked.open(path, vertexStride)) {
+        std::fprintf(stderr, "%s: stale cooked file was accepted\n", name);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    benchConfig config;
+    if (!parseArgs(argc, argv, config)) {
+        return EXIT_FAILURE;
+    }
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "cooked_model_bench";
+    std::filesystem::remove_all(dir);
+    std::string source = (dir / "model.gltf").string();
+    std::string path = source + COOKED_MODEL_EXTENSION;
+    writeFile(source, "{ \"asset\": { \"version\": \"2.0\" } }\n");
+
+    // small meshes and one with more than 65536 vertices
+    std::vector<rawMesh> raw;
+    for (unsigned int i = 0; i + 1 < config.noMeshes; i++) {
+        raw.push_back(generateMesh(config.grid, 12.0f * i));
+    }
+    raw.push_back(generateMesh(300, -12.0f));
+
+    std::vector<CookedModel::Material> materials(2);
+    materials[0].textures = { { 1, "albedo.png" }, { 2, "specular.png" } };
+    materials[1].diffuse[0] = 0.5f;
+
+    size_t noCorners = 0;
+    size_t noVertices = 0;
+    std::vector<importedMesh> imported(raw.size());
+    std::vector<importedMesh> loaded;
+    double importMs = 0.0, cookMs = 0.0, loadMs = 0.0;
+    unsigned int noShortIndices = 0;
+    bool ok = true;
+
+    for (unsigned int run = 0; run < config.runs && ok; run++) {
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < raw.size(); i++) {
+            importMesh(raw[i], imported[i]);
+        }
+        importMs += msSince(start);
+
+        start = std::chrono::steady_clock::now();
+        ok &= cook(path, source, imported, materials);
+        cookMs += msSince(start);
+
+        start = std::chrono::steady_clock::now();
+        ok &= loadCooked(path, loaded, noShortIndices);
+        loadMs += msSince(start);
+    }
+
+    for (unsigned int i = 0; i < raw.size(); i++) {
+        noCorners += raw[i].corners.size();
+        noVertices += imported[i].vertices.size();
+    }
+
+    if (ok && !sameMeshes(imported, loaded)) {
+        std::fprintf(stderr, "loaded meshes differ from the import\n");
+        ok = false;
+    }
+    if (ok && noShortIndices != raw.size() - 1) {
+        std::fprintf(stderr, "%u meshes with 16 bit indices, expected %u\n", noShortIndices, (unsigned int)raw.size() - 1);
+        ok = false;
+    }
+
+    CookedModel cooked;
+    size_t cookedSize = 0;
+    if (ok && cooked.open(path, sizeof(benchVertex))) {
+        cookedSize = cooked.getSize();
+        CookedModel::Material material = cooked.getMaterial(0);
+        if (cooked.noMaterials() != materials.size() || material.textures.size() != 2 || material.textures[1].path != "specular.png") {
+            std::fprintf(stderr, "materials differ\n");
+            ok = false;
+        }
+        cooked.close();
+    }
+
+    // another vertex layout, a newer modification time and different contents are all stale
+    ok &= expectStale("vertex_size", path, sizeof(benchVertex) + 4);
+    std::filesystem::last_write_time(source, std::filesystem::last_write_time(source) + std::chrono::seconds(2));
+    ok &= expectStale("touched", path, sizeof(benchVertex));
+
+    // an index past the vertices of its mesh is rejected instead of read out of bounds later
+    std::vector<importedMesh> corrupt = imported;
+    corrupt[0].indices[0] = corrupt[0].vertices.size();
+    ok &= cook(path, source, corrupt, materials);
+    ok &= expectStale("index_range", path, sizeof(benchVertex));
+
+    ok &= cook(path, source, imported, materials);
+    writeFile(source, "{ \"asset\": { \"version\": \"2.0\", \"generator\": \"bench\" } }\n");
+    ok &= expectStale("edited", path, sizeof(benchVertex));
+
+    std::filesystem::remove_all(dir);
+
+    std::printf("{\n");
+    reportEntry("config", false, "\"meshes\": %u, \"grid\": %u, \"runs\": %u",
+        (unsigned int)raw.size(), config.grid, config.runs);
+    reportEntry("model", false, "\"corners\": %zu, \"vertices\": %zu, \"cooked_bytes\": %zu, \"short_index_meshes\": %u",
+        noCorners, noVertices, cookedSize, noShortIndices);
+    reportEntry("per_run", true, "\"import_ms\": %.3f, \"cook_ms\": %.3f, \"load_ms\": %.3f, \"speedup\": %.1f",
+        importMs / config.runs, cookMs / config.runs, loadMs / config.runs, loadMs > 0.0 ? importMs / loadMs : 0.0);
+    std::printf("}\n");
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
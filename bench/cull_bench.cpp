@@ -0,0 +1,163 @@
+/*
+    headless culling benchmark (CPU reference of the GPU cull pass)
+    - spreads instance spheres in a cube and orbits the camera around it
+    - culls them against the frustum alone, then with a Hi-Z pyramid of a wall in front of the camera
+    - checks the pyramid only removes instances the frustum kept, prints timings and counts as JSON
+
+    usage: cull_bench [--instances n] [--groups n] [--frames n] [--width n] [--height n] [--seed n]
+*/
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "bench_common.hpp"
+#include "../src/algorithms/culling.hpp"
+
+// half extent of the cube the instances are in
+#define WORLD_HALF_EXTENT 128.0f
+// distance of the camera from the center
+#define CAMERA_DISTANCE 192.0f
+// meshes per group (draws = groups * meshes)
+#define MESHES_PER_GROUP 2
+
+struct benchConfig {
+    unsigned int noInstances = 100000;
+    unsigned int noGroups = 64;
+    unsigned int noFrames = 100;
+    unsigned int width = 1920;
+    unsigned int height = 1080;
+    unsigned int seed = 1;
+};
+
+static bool parseArgs(int argc, char** argv, benchConfig& config) {
+    if (!parseOptions(argc, argv, {
+            { "--instances", &config.noInstances },
+            { "--groups", &config.noGroups },
+            { "--frames", &config.noFrames },
+            { "--width", &config.width },
+            { "--height", &config.height },
+            { "--seed", &config.seed } })) {
+        return false;
+    }
+
+    config.noGroups = std::max(config.noGroups, 1u);
+    config.width = std::max(config.width, 1u);
+    config.height = std::max(config.height, 1u);
+    return true;
+}
+
+// reset the visible counts and give each group an equal range of the instances
+static void resetGroups(std::vector<CullGroup>& groups, unsigned int noInstances) {
+    unsigned int perGroup = (noInstances + groups.size() - 1) / groups.size();
+    for (unsigned int i = 0; i < groups.size(); i++) {
+        groups[i] = { std::min(i * perGroup, noInstances), 0 };
+    }
+}
+
+int main(int argc, char** argv) {
+    benchConfig config;
+    if (!parseArgs(argc, argv, config)) {
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 rng(config.seed);
+    std::uniform_real_distribution<float> posDist(-WORLD_HALF_EXTENT, WORLD_HALF_EXTENT);
+    std::uniform_real_distribution<float> radiusDist(0.25f, 2.0f);
+
+    // instances of a group are next to each other, like the instances of an entity
+    std::vector<CullInstance> instances(config.noInstances);
+    unsigned int perGroup = (config.noInstances + config.noGroups - 1) / config.noGroups;
+    for (unsigned int i = 0; i < config.noInstances; i++) {
+        instances[i].sphere = glm::vec4(posDist(rng), posDist(rng), posDist(rng), radiusDist(rng));
+        instances[i].group = i / perGroup;
+    }
+
+    std::vector<CullDraw> draws(config.noGroups * MESHES_PER_GROUP);
+    for (unsigned int i = 0; i < draws.size(); i++) {
+        draws[i].command = { 36, 0, 0, 0, 0 };
+        draws[i].group = i / MESHES_PER_GROUP;
+    }
+
+    std::vector<CullGroup> groups(config.noGroups);
+    std::vector<CullGroup> hizGroups(config.noGroups);
+    std::vector<uint32_t> visible(config.noInstances), hizVisible(config.noInstances);
+    std::vector<IndirectCommand> commands(draws.size());
+    std::vector<unsigned char> keptByFrustum(config.noInstances);
+    std::vector<float> depth(config.width * config.height);
+
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), (float)config.width / (float)config.height, 0.1f, 1000.0f);
+
+    double frustumMs = 0.0, hizMs = 0.0, pyramidMs = 0.0, commandMs = 0.0;
+    unsigned long long noFrustumVisible = 0, noHizVisible = 0, noMismatches = 0;
+    DepthPyramid pyramid;
+
+    for (unsigned int frame = 0; frame < config.noFrames; frame++) {
+        // orbit around the cube
+        float angle = glm::radians(360.0f * frame / std::max(config.noFrames, 1u));
+        glm::vec3 eye(CAMERA_DISTANCE * std::sin(angle), 0.0f, CAMERA_DISTANCE * std::cos(angle));
+        glm::mat4 viewProj = projection * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        Frustum frustum(viewProj);
+
+        // wall halfway to the center covering the middle of the screen
+        glm::vec4 wall = viewProj * glm::vec4(0.5f * eye, 1.0f);
+        float wallDepth = wall.z / wall.w;
+        for (unsigned int y = 0; y < config.height; y++) {
+            for (unsigned int x = 0; x < config.width; x++) {
+                bool covered = x > config.width / 4 && x < 3 * config.width / 4 && y > config.height / 4 && y < 3 * config.height / 4;
+                depth[y * config.width + x] = covered ? wallDepth : 1.0f;
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        pyramid.build(depth.data(), config.width, config.height);
+        pyramidMs += msSince(start);
+
+        resetGroups(groups, config.noInstances);
+        start = std::chrono::steady_clock::now();
+        noFrustumVisible += cullInstances(frustum, nullptr, viewProj, instances.data(), config.noInstances, groups.data(), visible.data());
+        frustumMs += msSince(start);
+
+        resetGroups(hizGroups, config.noInstances);
+        start = std::chrono::steady_clock::now();
+        noHizVisible += cullInstances(frustum, &pyramid, viewProj, instances.data(), config.noInstances, hizGroups.data(), hizVisible.data());
+        hizMs += msSince(start);
+
+        start = std::chrono::steady_clock::now();
+        writeCulledCommands(draws.data(), draws.size(), hizGroups.data(), commands.data());
+        commandMs += msSince(start);
+
+        // the pyramid may only remove instances
+        std::fill(keptByFrustum.begin(), keptByFrustum.end(), 0);
+        for (const CullGroup& group : groups) {
+            for (unsigned int i = 0; i < group.visibleCount; i++) {
+                keptByFrustum[visible[group.firstInstance + i]] = 1;
+            }
+        }
+        for (const CullGroup& group : hizGroups) {
+            for (unsigned int i = 0; i < group.visibleCount; i++) {
+                noMismatches += !keptByFrustum[hizVisible[group.firstInstance + i]];
+            }
+        }
+    }
+
+    double noFrames = std::max(config.noFrames, 1u);
+    std::printf("{\n");
+    reportEntry("config", false, "\"instances\": %u, \"groups\": %u, \"frames\": %u, \"width\": %u, \"height\": %u",
+        config.noInstances, config.noGroups, config.noFrames, config.width, config.height);
+    reportEntry("results", true, "\"frustum_ms\": %.4f, \"hiz_ms\": %.4f, \"pyramid_ms\": %.4f, \"commands_ms\": %.4f, "
+        "\"frustum_visible\": %.1f, \"hiz_visible\": %.1f, \"mismatches\": %llu",
+        frustumMs / noFrames, hizMs / noFrames, pyramidMs / noFrames, commandMs / noFrames,
+        noFrustumVisible / noFrames, noHizVisible / noFrames, noMismatches);
+    std::printf("}\n");
+
+    return noMismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,269 @@
+/*
+    headless physics/collision benchmark
+    - spawns spheres and boxes with random positions and velocities inside a closed world
+    - steps the physics world (integration + linear octree) for a number of frames and casts rays after each
+    - prints the time spent in each phase as JSON (one object on stdout)
+    - then frees a quarter of the bodies in a frame too short for a step (as the scene does at the end of
+      a frame) and checks the tree drops them before the next steps
+
+    usage: engine_bench [--spheres n] [--boxes n] [--frames n] [--rays n] [--threads n] [--seed n]
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_common.hpp"
+#include "../src/algorithms/linear_octree.hpp"
+#include "../src/algorithms/jobsystem.hpp"
+#include "../src/algorithms/ray.hpp"
+#include "../src/physics/collisionmesh.hpp"
+#include "../src/physics/physicsworld.hpp"
+
+// half extent of the world (bodies bounce off its walls)
+#define WORLD_HALF_EXTENT 64.0f
+// fastest initial speed along an axis in m/s
+#define MAX_SPEED 8.0f
+// frames run before timing so the pools and scratch lists reach their final size
+#define WARMUP_FRAMES 16
+
+struct benchConfig {
+    unsigned int noSpheres = 2048;
+    unsigned int noBoxes = 2048;
+    unsigned int noFrames = 300;
+    unsigned int noRays = 256;
+    // 0 = one per hardware thread
+    unsigned int noThreads = 0;
+    unsigned int seed = 1;
+};
+
+// totals over the timed frames (ms)
+struct benchTotals {
+    double stepMs = 0.0;
+    double updateMs = 0.0;
+    double broadPhaseMs = 0.0;
+    double narrowPhaseMs = 0.0;
+    double responseMs = 0.0;
+    double rayMs = 0.0;
+
+    unsigned long long noMoved = 0;
+    unsigned long long noCandidates = 0;
+    unsigned long long noCollisions = 0;
+    unsigned long long noRayHits = 0;
+};
+
+static bool parseArgs(int argc, char** argv, benchConfig& config) {
+    return parseOptions(argc, argv, {
+        { "--spheres", &config.noSpheres },
+        { "--boxes", &config.noBoxes },
+        { "--frames", &config.noFrames },
+        { "--rays", &config.noRays },
+        { "--threads", &config.noThreads },
+        { "--seed", &config.seed }
+    });
+}
+
+// unit cube around the origin (12 triangles), faces point back at the mesh so it is not moved
+static std::unique_ptr<CollisionMesh> makeCubeMesh() {
+    float coordinates[] = {
+        -0.5f, -0.5f, -0.5f,
+         0.5f, -0.5f, -0.5f,
+         0.5f,  0.5f, -0.5f,
+        -0.5f,  0.5f, -0.5f,
+        -0.5f, -0.5f,  0.5f,
+         0.5f, -0.5f,  0.5f,
+         0.5f,  0.5f,  0.5f,
+        -0.5f,  0.5f,  0.5f
+    };
+    unsigned int indices[] = {
+        0, 2, 1,  0, 3, 2,  // back
+        4, 5, 6,  4, 6, 7,  // front
+        0, 1, 5,  0, 5, 4,  // bottom
+        3, 7, 6,  3, 6, 2,  // top
+        0, 4, 7,  0, 7, 3,  // left
+        1, 2, 6,  1, 6, 5   // right
+    };
+
+    std::unique_ptr<CollisionMesh> ret = std::make_unique<CollisionMesh>(8, coordinates, 12, indices);
+    ret->model = nullptr;
+    return ret;
+}
+
+// turn bodies around at the walls of the world
+static void bounceOffWalls(std::vector<std::unique_ptr<RigidBody>>& bodies) {
+    float limit = WORLD_HALF_EXTENT - 1.0f;
+    for (std::unique_ptr<RigidBody>& rb : bodies) {
+        bool edited = false;
+        for (int j = 0; j < 3; j++) {
+            if ((rb->pos[j] > limit && rb->velocity[j] > 0.0f) ||
+                (rb->pos[j] < -limit && rb->velocity[j] < 0.0f)) {
+                rb->velocity[j] = -rb->velocity[j];
+                edited = true;
+            }
+        }
+
+        if (edited) {
+            States::activate(&rb->state, INSTANCE_EDITED);
+        }
+    }
+}
+
+// free every fourth body in a frame that runs no step (like Scene::clearDeadInstances), then run steps
+// - the tree must not keep regions of the freed bodies (it is only updated in steps)
+static bool checkRemoval(PhysicsWorld& world, Octree::LinearTree& tree, std::vector<std::unique_ptr<RigidBody>>& bodies,
+    std::vector<glm::vec3>& positions, std::vector<glm::vec3>& sizes) {
+    std::vector<RigidBody*> dead;
+    for (unsigned int i = 0; i < bodies.size(); i += 4) {
+        States::activate(&bodies[i]->state, INSTANCE_DEAD);
+        dead.push_back(bodies[i].get());
+    }
+
+    if (world.update(0.25f * world.fixedDt, positions, sizes) != 0) {
+        std::fprintf(stderr, "removal: a step ran in a frame shorter than a step\n");
+        return false;
+    }
+
+    world.removeDead(dead);
+    bodies.erase(std::remove_if(bodies.begin(), bodies.end(), [](const std::unique_ptr<RigidBody>& rb) {
+        return States::isActive(&rb->state, INSTANCE_DEAD);
+    }), bodies.end());
+
+    for (unsigned int frame = 0; frame < 4; frame++) {
+        bounceOffWalls(bodies);
+        world.update(world.fixedDt, positions, sizes);
+    }
+
+    // one region per body
+    if (world.noBodies() != bodies.size() || tree.noObjects() + tree.noPending() != bodies.size()) {
+        std::fprintf(stderr, "removal: %u bodies and %u regions left, expected %u\n",
+            world.noBodies(), tree.noObjects() + tree.noPending(), (unsigned int)bodies.size());
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    benchConfig config;
+    if (!parseArgs(argc, argv, config)) {
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 rng(config.seed);
+    std::uniform_real_distribution<float> posDist(-WORLD_HALF_EXTENT + 1.0f, WORLD_HALF_EXTENT - 1.0f);
+    std::uniform_real_distribution<float> velDist(-MAX_SPEED, MAX_SPEED);
+    std::uniform_real_distribution<float> sizeDist(0.25f, 0.75f);
+
+    // regions of the two models
+    std::unique_ptr<CollisionMesh> cube = makeCubeMesh();
+    std::vector<BoundingRegion> sphereRegions = { BoundingRegion(glm::vec3(0.0f), 0.5f) };
+    sphereRegions[0].collisionMesh = nullptr;
+    sphereRegions[0].instance = nullptr;
+    std::vector<BoundingRegion> boxRegions = { BoundingRegion(glm::vec3(-0.5f), glm::vec3(0.5f)) };
+    boxRegions[0].collisionMesh = cube.get();
+    boxRegions[0].instance = nullptr;
+
+    JobSystem jobs(config.noThreads);
+    Octree::LinearTree tree(BoundingRegion(glm::vec3(-WORLD_HALF_EXTENT), glm::vec3(WORLD_HALF_EXTENT)));
+    tree.jobs = &jobs;
+    PhysicsWorld world;
+    world.octree = &tree;
+
+    std::vector<glm::vec3> positions, sizes;
+    std::vector<Ray> rays;
+    std::vector<RayHit> hits(config.noRays);
+
+    // build
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::unique_ptr<RigidBody>> bodies;
+    for (unsigned int i = 0; i < config.noSpheres + config.noBoxes; i++) {
+        bool sphere = i < config.noSpheres;
+        std::unique_ptr<RigidBody> rb = std::make_unique<RigidBody>(glm::vec3(sizeDist(rng)), 1.0f,
+            glm::vec3(posDist(rng), posDist(rng), posDist(rng)));
+        rb->instanceId = i;
+        rb->velocity = glm::vec3(velDist(rng), velDist(rng), velDist(rng));
+        States::activate(&rb->state, INSTANCE_EDITED);
+
+        tree.addToPending(rb.get(), sphere ? sphereRegions : boxRegions);
+        world.addBody(rb.get());
+        bodies.push_back(std::move(rb));
+    }
+    tree.update(positions, sizes);
+    double buildMs = msSince(start);
+
+    // frames
+    benchTotals totals;
+    for (unsigned int frame = 0; frame < WARMUP_FRAMES + config.noFrames; frame++) {
+        bool timed = frame >= WARMUP_FRAMES;
+
+        bounceOffWalls(bodies);
+
+        start = std::chrono::steady_clock::now();
+        world.step(positions, sizes);
+        double stepMs = msSince(start);
+
+        rays.clear();
+        for (unsigned int i = 0; i < config.noRays; i++) {
+            glm::vec3 origin(posDist(rng), posDist(rng), posDist(rng));
+            glm::vec3 dir(velDist(rng), velDist(rng), velDist(rng));
+            if (dir == glm::vec3(0.0f)) {
+                dir.x = 1.0f;
+            }
+            rays.push_back(Ray(origin, glm::normalize(dir)));
+        }
+
+        start = std::chrono::steady_clock::now();
+        tree.castRays(rays, hits);
+        double rayMs = msSince(start);
+
+        unsigned int noHits = 0;
+        for (RayHit& hit : hits) {
+            if (hit.instance) {
+                noHits++;
+            }
+        }
+
+        if (timed) {
+            totals.stepMs += stepMs;
+            totals.updateMs += tree.stats.updateMs;
+            totals.broadPhaseMs += tree.stats.broadPhaseMs;
+            totals.narrowPhaseMs += tree.stats.narrowPhaseMs;
+            totals.responseMs += tree.stats.responseMs;
+            totals.rayMs += rayMs;
+
+            totals.noMoved += tree.stats.noMoved;
+            totals.noCandidates += tree.stats.noCandidates;
+            totals.noCollisions += tree.stats.noCollisions;
+            totals.noRayHits += noHits;
+        }
+    }
+
+    bool ok = checkRemoval(world, tree, bodies, positions, sizes);
+
+    // integration is what is left of the step after the tree
+    double treeMs = totals.updateMs + totals.broadPhaseMs + totals.narrowPhaseMs + totals.responseMs;
+    double n = config.noFrames ? (double)config.noFrames : 1.0;
+
+    std::printf("{\n");
+    reportEntry("config", false, "\"spheres\": %u, \"boxes\": %u, \"frames\": %u, \"rays\": %u, \"threads\": %u, \"seed\": %u",
+        config.noSpheres, config.noBoxes, config.noFrames, config.noRays, jobs.noThreads(), config.seed);
+    std::printf("  \"build_ms\": %.4f,\n", buildMs);
+    std::printf("  \"per_frame_ms\": {\n");
+    std::printf("    \"step\": %.4f,\n", totals.stepMs / n);
+    std::printf("    \"integrate\": %.4f,\n", (totals.stepMs - treeMs) / n);
+    std::printf("    \"update\": %.4f,\n", totals.updateMs / n);
+    std::printf("    \"broad_phase\": %.4f,\n", totals.broadPhaseMs / n);
+    std::printf("    \"narrow_phase\": %.4f,\n", totals.narrowPhaseMs / n);
+    std::printf("    \"response\": %.4f,\n", totals.responseMs / n);
+    std::printf("    \"ray_casts\": %.4f\n", totals.rayMs / n);
+    std::printf("  },\n");
+    reportEntry("per_frame", true, "\"moved\": %.1f, \"candidate_pairs\": %.1f, \"collisions\": %.1f, \"ray_hits\": %.1f",
+        totals.noMoved / n, totals.noCandidates / n, totals.noCollisions / n, totals.noRayHits / n);
+    std::printf("}\n");
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
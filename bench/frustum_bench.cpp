@@ -0,0 +1,204 @@
+/*
+    headless frustum culling benchmark (CPU traversal of the octrees)
+    - spreads spheres and boxes in a cube and orbits the camera around its center
+    - culls the octree against the frustum each frame (cullFrustum, 8 boxes per plane test)
+    - checks the result against testing every object on its own, prints counts per frame and timings as JSON
+
+    usage: frustum_bench [--instances n] [--frames n] [--seed n]
+*/
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "bench_common.hpp"
+#include "../src/algorithms/octree.hpp"
+#include "../src/algorithms/linear_octree.hpp"
+#include "../src/algorithms/culling.hpp"
+
+// half extent of the cube the instances are in (and of the root)
+#define WORLD_HALF_EXTENT 128.0f
+// distance of the camera from the center (inside the cube, so part of the tree is behind it)
+#define CAMERA_DISTANCE 64.0f
+
+struct benchConfig {
+    unsigned int noInstances = 100000;
+    unsigned int noFrames = 100;
+    unsigned int seed = 1;
+};
+
+// totals over the frames
+struct benchResult {
+    double cullMs = 0.0;
+    double bruteMs = 0.0;
+
+    unsigned long long noNodesVisited = 0;
+    unsigned long long noNodesInside = 0;
+    unsigned long long noObjectsTested = 0;
+    unsigned long long noObjectsAccepted = 0;
+    unsigned long long noVisible = 0;
+    unsigned long long noCulled = 0;
+
+    // visible by the brute force test but not found by the traversal, and the other way around
+    unsigned long long noMissed = 0;
+    unsigned long long noExtra = 0;
+};
+
+static bool parseArgs(int argc, char** argv, benchConfig& config) {
+    return parseOptions(argc, argv, {
+        { "--instances", &config.noInstances },
+        { "--frames", &config.noFrames },
+        { "--seed", &config.seed }
+    });
+}
+
+// box test of one object, written out without packets (brute force reference)
+static bool boxVisible(const Frustum& frustum, glm::vec3 boxMin, glm::vec3 boxMax) {
+    for (const glm::vec4& plane : frustum.planes) {
+        glm::vec3 p(plane.x >= 0.0f ? boxMax.x : boxMin.x,
+            plane.y >= 0.0f ? boxMax.y : boxMin.y,
+            plane.z >= 0.0f ? boxMax.z : boxMin.z);
+        if (plane.x * p.x + plane.y * p.y + (plane.z * p.z + plane.w) < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Tree>
+static benchResult run(const benchConfig& config, std::vector<std::unique_ptr<RigidBody>>& instances,
+    const std::vector<BoundingRegion>& sphereRegions, const std::vector<BoundingRegion>& boxRegions) {
+    benchResult ret;
+    std::vector<glm::vec3> positions, sizes;
+
+    Tree tree(BoundingRegion(glm::vec3(-WORLD_HALF_EXTENT), glm::vec3(WORLD_HALF_EXTENT)));
+    for (unsigned int i = 0; i < instances.size(); i++) {
+        tree.addToPending(instances[i].get(), i % 2 ? boxRegions : sphereRegions);
+    }
+    tree.update(positions, sizes);
+
+    // world space boxes of the instances for the brute force test
+    std::vector<glm::vec3> boxMin(instances.size()), boxMax(instances.size());
+    for (unsigned int i = 0; i < instances.size(); i++) {
+        BoundingRegion br = i % 2 ? boxRegions[0] : sphereRegions[0];
+        br.instance = instances[i].get();
+        br.transform();
+        HotRegion hot(br, i);
+        boxMin[i] = hot.boxMin();
+        boxMax[i] = hot.boxMax();
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    VisibleInstances visible, bruteVisible;
+    std::vector<unsigned char> found(instances.size());
+
+    for (unsigned int frame = 0; frame < config.noFrames; frame++) {
+        // orbit around the center, looking at it
+        float angle = glm::radians(360.0f * frame / std::max(config.noFrames, 1u));
+        glm::vec3 eye(CAMERA_DISTANCE * std::sin(angle), 0.25f * CAMERA_DISTANCE, CAMERA_DISTANCE * std::cos(angle));
+        Frustum frustum(projection * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+        FrustumCullStats stats;
+        auto start = std::chrono::steady_clock::now();
+        visible.clear();
+        tree.cullFrustum(frustum, visible, &stats);
+        ret.cullMs += msSince(start);
+
+        unsigned int noVisible = visible.noVisible();
+        ret.noNodesVisited += stats.noNodesVisited;
+        ret.noNodesInside += stats.noNodesInside;
+        ret.noObjectsTested += stats.noObjectsTested;
+        ret.noObjectsAccepted += stats.noObjectsAccepted;
+        ret.noVisible += noVisible;
+        ret.noCulled += instances.size() - noVisible;
+
+        std::fill(found.begin(), found.end(), 0);
+        if (const std::vector<uint32_t>* list = visible.get(0)) {
+            for (uint32_t idx : *list) {
+                found[idx] = 1;
+            }
+        }
+
+        // every object on its own, with the same output
+        start = std::chrono::steady_clock::now();
+        bruteVisible.clear();
+        for (unsigned int i = 0; i < instances.size(); i++) {
+            if (boxVisible(frustum, boxMin[i], boxMax[i])) {
+                bruteVisible.add(instances[i].get());
+            }
+        }
+        ret.bruteMs += msSince(start);
+
+        unsigned int noMissed = 0;
+        if (const std::vector<uint32_t>* list = bruteVisible.get(0)) {
+            for (uint32_t idx : *list) {
+                noMissed += !found[idx];
+            }
+        }
+        ret.noMissed += noMissed;
+        ret.noExtra += noVisible + noMissed - bruteVisible.noVisible();
+    }
+
+    tree.destroy();
+    return ret;
+}
+
+static void report(const char* name, const benchResult& res, double noFrames, bool last) {
+    reportEntry(name, last, "\"cull_ms\": %.4f, \"brute_force_ms\": %.4f, "
+        "\"nodes_visited\": %.1f, \"nodes_inside\": %.1f, \"objects_tested\": %.1f, \"objects_accepted\": %.1f, "
+        "\"visible\": %.1f, \"culled\": %.1f, \"missed\": %llu, \"extra\": %llu",
+        res.cullMs / noFrames, res.bruteMs / noFrames,
+        res.noNodesVisited / noFrames, res.noNodesInside / noFrames, res.noObjectsTested / noFrames, res.noObjectsAccepted / noFrames,
+        res.noVisible / noFrames, res.noCulled / noFrames, res.noMissed, res.noExtra);
+}
+
+int main(int argc, char** argv) {
+    benchConfig config;
+    if (!parseArgs(argc, argv, config)) {
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 rng(config.seed);
+    std::uniform_real_distribution<float> posDist(-WORLD_HALF_EXTENT + 2.0f, WORLD_HALF_EXTENT - 2.0f);
+    std::uniform_real_distribution<float> sizeDist(0.25f, 2.0f);
+
+    // every instance is in model 0, so its index is its place in the visible list
+    std::vector<std::unique_ptr<RigidBody>> instances;
+    for (unsigned int i = 0; i < config.noInstances; i++) {
+        std::unique_ptr<RigidBody> rb = std::make_unique<RigidBody>(glm::vec3(sizeDist(rng)), 1.0f,
+            glm::vec3(posDist(rng), posDist(rng), posDist(rng)));
+        rb->instanceId = i;
+        rb->instanceIdx = i;
+        rb->state = 0;
+        instances.push_back(std::move(rb));
+    }
+
+    std::vector<BoundingRegion> sphereRegions = { BoundingRegion(glm::vec3(0.0f), 0.5f) };
+    sphereRegions[0].collisionMesh = nullptr;
+    sphereRegions[0].instance = nullptr;
+    std::vector<BoundingRegion> boxRegions = { BoundingRegion(glm::vec3(-0.5f), glm::vec3(0.5f)) };
+    boxRegions[0].collisionMesh = nullptr;
+    boxRegions[0].instance = nullptr;
+
+    benchResult linearRes = run<Octree::LinearTree>(config, instances, sphereRegions, boxRegions);
+    benchResult nodeRes = run<Octree::node>(config, instances, sphereRegions, boxRegions);
+
+    double noFrames = std::max(config.noFrames, 1u);
+    std::printf("{\n");
+    reportEntry("config", false, "\"instances\": %u, \"frames\": %u, \"seed\": %u, \"simd_width\": %d",
+        config.noInstances, config.noFrames, config.seed, FRUSTUM_SIMD_WIDTH);
+    report("linear", linearRes, noFrames, false);
+    report("node", nodeRes, noFrames, true);
+    std::printf("}\n");
+
+    return linearRes.noMissed || nodeRes.noMissed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
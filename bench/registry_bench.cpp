@@ -0,0 +1,154 @@
+/*
+    instance/model registry benchmark
+    - registers, looks up and removes instances the way the scene does, with the old containers
+      (trie::Trie of instance ids, avl of model ids) and the new ones (SlotMap of instances, StringMap of models)
+    - each instance insert also looks up its model by id
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/algorithms/avl.hpp"
+#include "../src/algorithms/trie.hpp"
+#include "../src/algorithms/slotmap.hpp"
+#include "../src/algorithms/stringmap.hpp"
+
+// number of distinct models the instances are spread over
+#define NO_MODELS 16
+
+struct registryResult {
+    // ns per operation
+    double insertNs;
+    double lookupNs;
+    double eraseNs;
+};
+
+static double nsPerOp(std::chrono::steady_clock::time_point start, unsigned int noOps) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / noOps;
+}
+
+// same sequence as the 8 letter string ids the scene used to generate
+static std::string nextId(std::string& currentId) {
+    for (int i = currentId.length() - 1; i >= 0; i--) {
+        if (currentId[i] != 'z') {
+            currentId[i]++;
+            break;
+        }
+        else {
+            currentId[i] = 'a';
+        }
+    }
+    return currentId;
+}
+
+static registryResult runOld(const std::vector<std::string>& modelIds, std::vector<int>& instances, const std::vector<unsigned int>& order) {
+    registryResult ret;
+    unsigned int n = instances.size();
+
+    avl* models = avl_createEmptyRoot(strkeycmp);
+    for (const std::string& id : modelIds) {
+        models = avl_insert(models, (void*)id.c_str(), (void*)&id);
+    }
+    trie::Trie<int*> registry(trie::ascii_lowercase);
+    std::vector<std::string> ids(n);
+    std::string currentId = "aaaaaaaa";
+
+    unsigned int found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < n; i++) {
+        found += avl_get(models, (void*)modelIds[i % NO_MODELS].c_str()) != nullptr;
+        ids[i] = nextId(currentId);
+        registry.insert(ids[i], &instances[i]);
+    }
+    ret.insertNs = nsPerOp(start, n);
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i : order) {
+        found += registry[ids[i]] == &instances[i];
+    }
+    ret.lookupNs = nsPerOp(start, n);
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i : order) {
+        found += registry.erase(ids[i]);
+    }
+    ret.eraseNs = nsPerOp(start, n);
+
+    if (found != 3 * n) {
+        std::fprintf(stderr, "old registry lost instances\n");
+    }
+
+    registry.cleanup();
+    avl_free(models);
+    return ret;
+}
+
+static registryResult runNew(const std::vector<std::string>& modelIds, std::vector<int>& instances, const std::vector<unsigned int>& order) {
+    registryResult ret;
+    unsigned int n = instances.size();
+
+    StringMap<const std::string*> models;
+    for (const std::string& id : modelIds) {
+        models.insert(id, &id);
+    }
+    SlotMap<int*> registry;
+    std::vector<uint64_t> handles(n);
+
+    unsigned int found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < n; i++) {
+        found += models.get(modelIds[i % NO_MODELS]) != nullptr;
+        handles[i] = registry.insert(&instances[i]);
+    }
+    ret.insertNs = nsPerOp(start, n);
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i : order) {
+        found += *registry.get(handles[i]) == &instances[i];
+    }
+    ret.lookupNs = nsPerOp(start, n);
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i : order) {
+        found += registry.erase(handles[i]);
+    }
+    ret.eraseNs = nsPerOp(start, n);
+
+    if (found != 3 * n) {
+        std::fprintf(stderr, "new registry lost instances\n");
+    }
+
+    return ret;
+}
+
+int main() {
+    std::vector<std::string> modelIds;
+    for (int i = 0; i < NO_MODELS; i++) {
+        modelIds.push_back("model_" + std::to_string(i));
+    }
+
+    std::printf("%-10s %-6s %12s %12s %12s\n", "instances", "", "insert ns", "lookup ns", "erase ns");
+    for (unsigned int n : { 10000u, 100000u, 1000000u }) {
+        std::vector<int> instances(n);
+
+        // visit instances in random order for lookups and removals
+        std::vector<unsigned int> order(n);
+        for (unsigned int i = 0; i < n; i++) {
+            order[i] = i;
+        }
+        std::shuffle(order.begin(), order.end(), std::mt19937(n));
+
+        registryResult oldRes = runOld(modelIds, instances, order);
+        registryResult newRes = runNew(modelIds, instances, order);
+
+        std::printf("%-10u %-6s %12.1f %12.1f %12.1f\n", n, "old", oldRes.insertNs, oldRes.lookupNs, oldRes.eraseNs);
+        std::printf("%-10u %-6s %12.1f %12.1f %12.1f\n", n, "new", newRes.insertNs, newRes.lookupNs, newRes.eraseNs);
+    }
+
+    return EXIT_SUCCESS;
+}
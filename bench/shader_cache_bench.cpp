@@ -0,0 +1,193 @@
+/*
+    headless shader cache benchmark (no glslang or GPU)
+    - writes generated shaders to a temporary directory, a quarter of them include a shared file
+      (which includes another one next to it)
+    - compiles them with a stand-in compiler that spends CPU time hashing the source
+    - measures startup cold (no archive) on one thread and on the job system, warm (archive loaded),
+      after editing the shared include (only the shaders including it compile) and after changing
+      the default header (everything compiles)
+    - checks the hit and miss counts and that warm output matches cold output, prints timings as JSON
+
+    usage: shader_cache_bench [--shaders n] [--work n] [--threads n]
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "bench_common.hpp"
+#include "../src/graphics/shader_cache.hpp"
+#include "../src/algorithms/jobsystem.hpp"
+
+// every fourth shader includes lib/common.glsl
+#define INCLUDE_EVERY 4
+
+struct benchConfig {
+    unsigned int noShaders = 64;
+    // hashing passes over the source per compile (~ms per shader)
+    unsigned int work = 4000;
+    // 0 = hardware threads
+    unsigned int noThreads = 0;
+};
+
+struct benchResult {
+    double totalMs = 0.0;
+    ShaderCache::Stats stats;
+    unsigned int noEntries = 0;
+};
+
+static bool parseArgs(int argc, char** argv, benchConfig& config) {
+    return parseOptions(argc, argv, {
+        { "--shaders", &config.noShaders },
+        { "--work", &config.work },
+        { "--threads", &config.noThreads }
+    });
+}
+
+static void writeFile(const std::filesystem::path& path, const std::string& contents) {
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << contents;
+}
+
+static void writeShaders(const std::filesystem::path& dir, const benchConfig& config) {
+    writeFile(dir / "lib/noise.glsl", "float noise(vec2 p) { return fract(sin(dot(p, vec2(12.9898, 78.233))) * 43758.5453); }\n");
+    writeFile(dir / "lib/common.glsl", "#include \"noise.glsl\"\nvec3 shade(vec3 n, vec3 l) { return vec3(max(dot(n, l), 0.0)); }\n");
+
+    for (unsigned int i = 0; i < config.noShaders; i++) {
+        std::string source;
+        if (i % INCLUDE_EVERY == 0) {
+            source += "#include \"lib/common.glsl\"\n";
+        }
+        source += "layout(location = 0) in vec3 inPos;\nlayout(location = 0) out vec4 outColor;\n";
+        source += "void main() {\n    outColor = vec4(inPos * " + std::to_string(i) + ".0, 1.0);\n}\n";
+        writeFile(dir / ("shader" + std::to_string(i) + ".glsl"), source);
+    }
+}
+
+// hashes the source work times and turns it into SPIR-V sized words (deterministic per source)
+static ShaderCache::Compiler standInCompiler(unsigned int work) {
+    return [work](const ShaderSource& source, std::vector<uint32_t>& spirv, std::string&) {
+        uint64_t h = 0;
+        for (unsigned int i = 0; i < work; i++) {
+            h = ShaderCache::hash(source.text.data(), source.text.size(), h + i);
+        }
+
+        spirv.resize(source.text.size() / 4 + 5);
+        spirv[0] = 0x07230203;
+        for (unsigned int i = 1; i < spirv.size(); i++) {
+            h = ShaderCache::hash(&h, sizeof(h), h);
+            spirv[i] = (uint32_t)h;
+        }
+        return true;
+    };
+}
+
+// starts the engine's shaders the way VulkanPipeline does: load, get every shader, save
+static benchResult startup(const std::filesystem::path& dir, const benchConfig& config,
+    const std::string& defaultHeader, JobSystem* jobs, std::vector<std::vector<uint32_t>>& spirv) {
+    benchResult ret;
+
+    std::vector<ShaderRequest> requests(config.noShaders);
+    for (unsigned int i = 0; i < config.noShaders; i++) {
+        requests[i].path = "shader" + std::to_string(i) + ".glsl";
+        requests[i].stage = i % 2 ? 4 : 0;
+        requests[i].includeDefaultHeader = true;
+        if (i % 3 == 0) {
+            requests[i].defines = { "SHADOWS", "NO_LIGHTS 4" };
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ShaderCache cache(dir.string(), (dir / "shaders.cache").string(), "stand-in 1", standInCompiler(config.work));
+    cache.jobs = jobs;
+    cache.setDefaultHeader(defaultHeader);
+    cache.load();
+    cache.getOrCompile(requests, spirv);
+    if (!cache.save()) {
+        std::fprintf(stderr, "failed to save %s\n", (dir / "shaders.cache").string().c_str());
+    }
+    ret.totalMs = msSince(start);
+
+    ret.stats = cache.getStats();
+    ret.noEntries = cache.noEntries();
+    return ret;
+}
+
+static bool check(const char* name, const benchResult& res, unsigned int noHits, unsigned int noMisses) {
+    if (res.stats.noHits == noHits && res.stats.noMisses == noMisses) {
+        return true;
+    }
+    std::fprintf(stderr, "%s: %u hits and %u misses, expected %u and %u\n",
+        name, res.stats.noHits, res.stats.noMisses, noHits, noMisses);
+    return false;
+}
+
+static void report(const char* name, const benchResult& res, bool last) {
+    reportEntry(name, last, "\"total_ms\": %.3f, \"load_ms\": %.3f, \"preprocess_ms\": %.3f, \"compile_ms\": %.3f, "
+        "\"save_ms\": %.3f, \"hits\": %u, \"misses\": %u, \"entries\": %u",
+        res.totalMs, res.stats.loadMs, res.stats.preprocessMs, res.stats.compileMs,
+        res.stats.saveMs, res.stats.noHits, res.stats.noMisses, res.noEntries);
+}
+
+int main(int argc, char** argv) {
+    benchConfig config;
+    if (!parseArgs(argc, argv, config)) {
+        return EXIT_FAILURE;
+    }
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "shader_cache_bench";
+    std::filesystem::remove_all(dir);
+    writeShaders(dir, config);
+
+    JobSystem jobs(config.noThreads);
+    std::string header = "#version 460 core\n";
+    std::vector<std::vector<uint32_t>> coldSpirv, spirv;
+    bool ok = true;
+    unsigned int noIncluding = (config.noShaders + INCLUDE_EVERY - 1) / INCLUDE_EVERY;
+
+    benchResult coldSerial = startup(dir, config, header, nullptr, coldSpirv);
+    ok &= check("cold_serial", coldSerial, 0, config.noShaders);
+
+    std::filesystem::remove(dir / "shaders.cache");
+    benchResult coldParallel = startup(dir, config, header, &jobs, spirv);
+    ok &= check("cold_parallel", coldParallel, 0, config.noShaders);
+
+    benchResult warm = startup(dir, config, header, &jobs, spirv);
+    ok &= check("warm", warm, config.noShaders, 0);
+    if (spirv != coldSpirv) {
+        std::fprintf(stderr, "warm: SPIR-V differs from the cold compile\n");
+        ok = false;
+    }
+
+    // the nested include changes, so every shader including lib/common.glsl compiles again
+    writeFile(dir / "lib/noise.glsl", "float noise(vec2 p) { return fract(sin(p.x * 91.3 + p.y * 47.1) * 43758.5453); }\n");
+    benchResult editInclude = startup(dir, config, header, &jobs, spirv);
+    ok &= check("edit_include", editInclude, config.noShaders - noIncluding, noIncluding);
+    // replaced entries are dropped from the archive
+    if (editInclude.noEntries != config.noShaders) {
+        std::fprintf(stderr, "edit_include: %u entries, expected %u\n", editInclude.noEntries, config.noShaders);
+        ok = false;
+    }
+
+    benchResult editHeader = startup(dir, config, header + "#define GAMMA 2.2\n", &jobs, spirv);
+    ok &= check("edit_header", editHeader, 0, config.noShaders);
+
+    std::filesystem::remove_all(dir);
+
+    std::printf("{\n");
+    reportEntry("config", false, "\"shaders\": %u, \"work\": %u, \"threads\": %u",
+        config.noShaders, config.work, jobs.noThreads());
+    report("cold_serial", coldSerial, false);
+    report("cold_parallel", coldParallel, false);
+    report("warm", warm, false);
+    report("edit_include", editInclude, false);
+    report("edit_header", editHeader, true);
+    std::printf("}\n");
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
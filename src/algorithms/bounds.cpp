@@ -45,21 +45,42 @@ void BoundingRegion::transform() {
 }
 
 // center
-glm::vec3 BoundingRegion::calculateCenter() {
+glm::vec3 BoundingRegion::calculateCenter() const {
     return (type == BoundTypes::AABB) ? (min + max) / 2.0f : center;
 }
 
 // calculate dimensions
-glm::vec3 BoundingRegion::calculateDimensions() {
+glm::vec3 BoundingRegion::calculateDimensions() const {
     return (type == BoundTypes::AABB) ? (max - min) : glm::vec3(2.0f * radius);
 }
 
+// motion over the last update if the instance is swept (zero otherwise)
+glm::vec3 BoundingRegion::sweep() const {
+    return (instance && instance->isSwept()) ? instance->pos - instance->prevPos : glm::vec3(0.0f);
+}
+
+// smallest box around the region at the start and end of its sweep
+void BoundingRegion::sweptBounds(glm::vec3 &lo, glm::vec3 &hi) const {
+    if (type == BoundTypes::AABB) {
+        lo = min;
+        hi = max;
+    }
+    else {
+        lo = center - radius;
+        hi = center + radius;
+    }
+
+    glm::vec3 motion = sweep();
+    lo = glm::min(lo, lo - motion);
+    hi = glm::max(hi, hi - motion);
+}
+
 /*
     testing methods
 */
 
 // determine if point inside
-bool BoundingRegion::containsPoint(glm::vec3 pt) {
+bool BoundingRegion::containsPoint(glm::vec3 pt) const {
     if (type == BoundTypes::AABB) {
         // box - point must be larger than man and smaller than max
         return (pt.x >= min.x) && (pt.x <= max.x) &&
@@ -78,7 +99,7 @@ bool BoundingRegion::containsPoint(glm::vec3 pt) {
 }
 
 // determine if region completely inside
-bool BoundingRegion::containsRegion(BoundingRegion br) {
+bool BoundingRegion::containsRegion(const BoundingRegion& br) const {
     if (br.type == BoundTypes::AABB) {
         // if br is a box, just has to contain min and max
         return containsPoint(br.min) && containsPoint(br.max);
@@ -112,7 +133,7 @@ bool BoundingRegion::containsRegion(BoundingRegion br) {
 }
 
 // determine if region intersects (partial containment)
-bool BoundingRegion::intersectsWith(BoundingRegion br) {
+bool BoundingRegion::intersectsWith(const BoundingRegion& br) const {
     // overlap on all axes
 
     if (type == BoundTypes::AABB && br.type == BoundTypes::AABB) {
@@ -170,7 +191,7 @@ bool BoundingRegion::intersectsWith(BoundingRegion br) {
 }
 
 // operator overload
-bool BoundingRegion::operator==(BoundingRegion br) {
+bool BoundingRegion::operator==(const BoundingRegion& br) const {
     if (type != br.type) {
         return false;
     }
@@ -182,3 +203,52 @@ bool BoundingRegion::operator==(BoundingRegion br) {
         return center == br.center && radius == br.radius;
     }
 }
+
+/*
+    hot region
+*/
+
+// initialize from a (transformed) region, covering its sweep
+HotRegion::HotRegion(const BoundingRegion& br, unsigned int handle)
+    : handle(handle), type(br.type) {
+    if (type == BoundTypes::AABB) {
+        a = br.min;
+        b = br.max;
+    }
+    else {
+        a = br.center;
+        b = glm::vec3(br.radius);
+    }
+
+    if (br.sweep() != glm::vec3(0.0f)) {
+        // box around the region at the start and end of the motion
+        type = BoundTypes::AABB;
+        br.sweptBounds(a, b);
+    }
+}
+
+// determine if region intersects (same as BoundingRegion::intersectsWith)
+bool HotRegion::intersectsWith(const HotRegion& br) const {
+    if (type == BoundTypes::AABB && br.type == BoundTypes::AABB) {
+        // both boxes - overlap on all axes
+        return !(glm::any(glm::lessThan(b, br.a)) || glm::any(glm::greaterThan(a, br.b)));
+    }
+    else if (type == BoundTypes::SPHERE && br.type == BoundTypes::SPHERE) {
+        // both spheres - distance between centers must be less than combined radius
+        glm::vec3 centerDiff = a - br.a;
+        float maxMag = b.x + br.b.x;
+
+        return glm::dot(centerDiff, centerDiff) <= maxMag * maxMag;
+    }
+    else if (type == BoundTypes::SPHERE) {
+        // this is a sphere, br is a box - distance to closest point in box
+        glm::vec3 closestPt = glm::clamp(a, br.a, br.b);
+        glm::vec3 diff = closestPt - a;
+
+        return glm::dot(diff, diff) < b.x * b.x;
+    }
+    else {
+        // this is a box, br is a sphere
+        return br.intersectsWith(*this);
+    }
+}
@@ -1,6 +1,13 @@
+#ifndef BOUNDS_HPP
+#define BOUNDS_HPP
+
 #include <glm/glm.hpp>
 #include <memory>
 
+#ifdef BOUNDS_COUNT_COPIES
+#include <atomic>
+#endif
+
 #include "../physics/rigidbody.hpp"
 
 // forward declaration
@@ -18,8 +25,26 @@ enum class BoundTypes : unsigned char {
     SPHERE  = 0x01	// 0x01 = 1
 };
 
+#ifdef BOUNDS_COUNT_COPIES
+/*
+    member that counts copies of the class holding it (moves are not counted)
+*/
+
+struct CopyCounter {
+    static inline std::atomic<unsigned long long> noCopies = 0;
+
+    CopyCounter() = default;
+    CopyCounter(const CopyCounter&) { noCopies++; }
+    CopyCounter(CopyCounter&&) noexcept {}
+    CopyCounter& operator=(const CopyCounter&) { noCopies++; return *this; }
+    CopyCounter& operator=(CopyCounter&&) noexcept { return *this; }
+};
+#endif
+
 /*
     class to represent bounding region
+    - the full (cold) region, with original values and pointers to the instance and collision mesh
+    - the linear octree keeps a HotRegion next to each of its regions for the broad phase
 */
 
 class BoundingRegion {
@@ -49,6 +74,10 @@ public:
     glm::vec3 ogMin;
     glm::vec3 ogMax;
 
+#ifdef BOUNDS_COUNT_COPIES
+    CopyCounter copyCounter;
+#endif
+
     /*
         Constructors
     */
@@ -70,24 +99,70 @@ public:
     void transform();
 
     // center
-    glm::vec3 calculateCenter();
+    glm::vec3 calculateCenter() const;
 
     // calculate dimensions
-    glm::vec3 calculateDimensions();
+    glm::vec3 calculateDimensions() const;
+
+    // motion over the last update if the instance is swept (zero otherwise)
+    glm::vec3 sweep() const;
+
+    // smallest box around the region at the start and end of its sweep
+    void sweptBounds(glm::vec3 &lo, glm::vec3 &hi) const;
 
     /*
         testing methods
     */
 
     // determine if point inside
-    bool containsPoint(glm::vec3 pt);
+    bool containsPoint(glm::vec3 pt) const;
 
     // determine if region completely inside
-    bool containsRegion(BoundingRegion br);
+    bool containsRegion(const BoundingRegion& br) const;
 
     // determine if region intersects (partial containment)
-    bool intersectsWith(BoundingRegion br);
+    bool intersectsWith(const BoundingRegion& br) const;
 
     // operator overload
-    bool operator==(BoundingRegion br);
-};
\ No newline at end of file
+    bool operator==(const BoundingRegion& br) const;
+};
+
+/*
+    compact copy of a region for the broad phase (32 bytes)
+    - only what the intersection tests read, so a cache line holds two regions
+    - regions of swept instances become the box around the whole motion
+*/
+
+class HotRegion {
+public:
+    // AABB: min, sphere: center
+    glm::vec3 a;
+    // index of the region in the structure that owns it
+    unsigned int handle;
+    // AABB: max, sphere: radius on every axis
+    glm::vec3 b;
+    // type of region
+    BoundTypes type;
+
+    /*
+        constructors
+    */
+
+    HotRegion() = default;
+
+    // initialize from a (transformed) region, covering its sweep
+    HotRegion(const BoundingRegion& br, unsigned int handle);
+
+    /*
+        testing methods
+    */
+
+    // smallest box around the region
+    glm::vec3 boxMin() const { return type == BoundTypes::AABB ? a : a - b; }
+    glm::vec3 boxMax() const { return type == BoundTypes::AABB ? b : a + b; }
+
+    // determine if region intersects (same as BoundingRegion::intersectsWith)
+    bool intersectsWith(const HotRegion& br) const;
+};
+
+#endif
\ No newline at end of file
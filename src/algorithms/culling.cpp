@@ -0,0 +1,382 @@
+#include "culling.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#if FRUSTUM_SIMD_WIDTH > 1
+#include <immintrin.h>
+#endif
+
+/*
+    Frustum
+*/
+
+// planes of a view-projection matrix (normalized)
+Frustum::Frustum(const glm::mat4& viewProj) {
+    // rows of the matrix (glm is column major)
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+    }
+
+    planes[0] = rows[3] + rows[0];  // left:   -w <= x
+    planes[1] = rows[3] - rows[0];  // right:   x <= w
+    planes[2] = rows[3] + rows[1];  // bottom: -w <= y
+    planes[3] = rows[3] - rows[1];  // top:     y <= w
+    planes[4] = rows[2];            // near:    0 <= z
+    planes[5] = rows[3] - rows[2];  // far:     z <= w
+
+    for (glm::vec4& plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+}
+
+// determine if sphere is at least partially inside
+bool Frustum::intersectsSphere(glm::vec3 center, float radius) const {
+    for (const glm::vec4& plane : planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+            // completely behind a plane
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// mask of the boxes at least partially inside, insideMask is set to the boxes completely inside
+unsigned int Frustum::testBoxes(const BoxPacket& boxes, unsigned int& insideMask) const {
+    // lanes with a box behind a plane (outside) or reaching behind one (not completely inside)
+    unsigned int outside = 0;
+    unsigned int notInside = 0;
+
+    for (const glm::vec4& plane : planes) {
+        // corner farthest along the normal (p) and farthest against it (n), picked per axis for the whole packet
+        const float* p[3];
+        const float* n[3];
+        for (int i = 0; i < 3; i++) {
+            p[i] = plane[i] >= 0.0f ? boxes.max[i] : boxes.min[i];
+            n[i] = plane[i] >= 0.0f ? boxes.min[i] : boxes.max[i];
+        }
+
+#if FRUSTUM_SIMD_WIDTH == 8
+        __m256 nx = _mm256_set1_ps(plane.x), ny = _mm256_set1_ps(plane.y), nz = _mm256_set1_ps(plane.z);
+        __m256 d = _mm256_set1_ps(plane.w);
+        __m256 zero = _mm256_setzero_ps();
+
+        __m256 pDist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, _mm256_loadu_ps(p[0])), _mm256_mul_ps(ny, _mm256_loadu_ps(p[1]))),
+            _mm256_add_ps(_mm256_mul_ps(nz, _mm256_loadu_ps(p[2])), d));
+        __m256 nDist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, _mm256_loadu_ps(n[0])), _mm256_mul_ps(ny, _mm256_loadu_ps(n[1]))),
+            _mm256_add_ps(_mm256_mul_ps(nz, _mm256_loadu_ps(n[2])), d));
+
+        outside |= _mm256_movemask_ps(_mm256_cmp_ps(pDist, zero, _CMP_LT_OQ));
+        notInside |= _mm256_movemask_ps(_mm256_cmp_ps(nDist, zero, _CMP_LT_OQ));
+#elif FRUSTUM_SIMD_WIDTH == 4
+        __m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z);
+        __m128 d = _mm_set1_ps(plane.w);
+        __m128 zero = _mm_setzero_ps();
+
+        for (int half = 0; half < BOX_PACKET_WIDTH; half += 4) {
+            __m128 pDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_loadu_ps(p[0] + half)), _mm_mul_ps(ny, _mm_loadu_ps(p[1] + half))),
+                _mm_add_ps(_mm_mul_ps(nz, _mm_loadu_ps(p[2] + half)), d));
+            __m128 nDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_loadu_ps(n[0] + half)), _mm_mul_ps(ny, _mm_loadu_ps(n[1] + half))),
+                _mm_add_ps(_mm_mul_ps(nz, _mm_loadu_ps(n[2] + half)), d));
+
+            outside |= _mm_movemask_ps(_mm_cmplt_ps(pDist, zero)) << half;
+            notInside |= _mm_movemask_ps(_mm_cmplt_ps(nDist, zero)) << half;
+        }
+#else
+        for (unsigned int i = 0; i < boxes.noBoxes; i++) {
+            float pDist = plane.x * p[0][i] + plane.y * p[1][i] + (plane.z * p[2][i] + plane.w);
+            float nDist = plane.x * n[0][i] + plane.y * n[1][i] + (plane.z * n[2][i] + plane.w);
+            outside |= (pDist < 0.0f) << i;
+            notInside |= (nDist < 0.0f) << i;
+        }
+#endif
+    }
+
+    unsigned int ret = ~outside & ((1u << boxes.noBoxes) - 1);
+    insideMask = ret & ~notInside;
+    return ret;
+}
+
+/*
+    VisibleInstances
+*/
+
+// start a new frame
+void VisibleInstances::clear() {
+    for (std::vector<uint32_t>& list : lists) {
+        list.clear();
+    }
+
+    // stamps of older frames no longer match
+    frame++;
+    if (!frame) {
+        for (std::vector<uint32_t>& modelStamps : stamps) {
+            std::fill(modelStamps.begin(), modelStamps.end(), 0);
+        }
+        frame = 1;
+    }
+}
+
+// add an instance (false if it was added this frame, is dead or is not in a scene)
+bool VisibleInstances::add(const RigidBody* instance) {
+    if (!instance || instance->instanceId == NULL_INSTANCE_ID || instance->instanceIdx == 0xffffffff) {
+        return false;
+    }
+    if (instance->state & INSTANCE_DEAD) {
+        // removed at the end of the frame
+        return false;
+    }
+
+    unsigned int modelIdx = INSTANCE_ID_MODEL(instance->instanceId);
+    if (modelIdx >= lists.size()) {
+        lists.resize(modelIdx + 1);
+        stamps.resize(modelIdx + 1);
+    }
+
+    std::vector<uint32_t>& modelStamps = stamps[modelIdx];
+    if (instance->instanceIdx >= modelStamps.size()) {
+        modelStamps.resize(instance->instanceIdx + 1, 0);
+    }
+    if (modelStamps[instance->instanceIdx] == frame) {
+        // another region of the instance was visible
+        return false;
+    }
+
+    modelStamps[instance->instanceIdx] = frame;
+    lists[modelIdx].push_back(instance->instanceIdx);
+    return true;
+}
+
+// add the instances in found and empty it
+void VisibleInstances::addFound() {
+    for (const RigidBody* instance : found) {
+        add(instance);
+    }
+    found.clear();
+}
+
+// visible instances of all models
+unsigned int VisibleInstances::noVisible() const {
+    unsigned int ret = 0;
+    for (const std::vector<uint32_t>& list : lists) {
+        ret += list.size();
+    }
+    return ret;
+}
+
+// test a packet of object boxes, append the instances of the visible ones to visible.found and empty the packet
+void cullPacket(const Frustum& frustum, BoxPacket& packet, RigidBody* const* instances,
+    VisibleInstances& visible, FrustumCullStats& stats) {
+    unsigned int insideMask;
+    unsigned int mask = frustum.testBoxes(packet, insideMask);
+
+    stats.noObjectsTested += packet.noBoxes;
+    for (unsigned int i = 0; i < packet.noBoxes; i++) {
+        if (mask & (1u << i)) {
+            visible.found.push_back(instances[i]);
+        }
+        else {
+            stats.noObjectsCulled++;
+        }
+    }
+
+    packet.noBoxes = 0;
+}
+
+/*
+    DepthPyramid
+*/
+
+// number of levels down to 1x1
+unsigned int DepthPyramid::noLevels(unsigned int width, unsigned int height) {
+    unsigned int ret = 1;
+    while (width > 1 || height > 1) {
+        width = levelSize(width, 1);
+        height = levelSize(height, 1);
+        ret++;
+    }
+    return ret;
+}
+
+// number of floats of all levels
+unsigned int DepthPyramid::noTexels(unsigned int width, unsigned int height) {
+    unsigned int ret = 0;
+    for (unsigned int level = 0, levels = noLevels(width, height); level < levels; level++) {
+        ret += levelSize(width, level) * levelSize(height, level);
+    }
+    return ret;
+}
+
+// rebuild from a depth buffer
+void DepthPyramid::build(const float* depth, unsigned int width, unsigned int height) {
+    this->width = width;
+    this->height = height;
+
+    unsigned int levels = noLevels(width, height);
+    levelOffsets.resize(levels);
+    for (unsigned int level = 0, offset = 0; level < levels; level++) {
+        levelOffsets[level] = offset;
+        offset += levelSize(width, level) * levelSize(height, level);
+    }
+    texels.resize(noTexels(width, height));
+
+    std::copy(depth, depth + width * height, texels.begin());
+
+    for (unsigned int level = 1; level < levels; level++) {
+        unsigned int srcWidth = getLevelWidth(level - 1), srcHeight = getLevelHeight(level - 1);
+        unsigned int dstWidth = getLevelWidth(level), dstHeight = getLevelHeight(level);
+        float* dst = texels.data() + levelOffsets[level];
+
+        for (unsigned int y = 0; y < dstHeight; y++) {
+            for (unsigned int x = 0; x < dstWidth; x++) {
+                // last row/column also covers the odd texel left over below it
+                unsigned int x1 = x == dstWidth - 1 ? srcWidth - 1 : 2 * x + 1;
+                unsigned int y1 = y == dstHeight - 1 ? srcHeight - 1 : 2 * y + 1;
+                dst[y * dstWidth + x] = maxDepth(level - 1, std::min(2 * x, srcWidth - 1), std::min(2 * y, srcHeight - 1), x1, y1);
+            }
+        }
+    }
+}
+
+// determine if the sphere is behind the depth of everything drawn where it would be
+bool DepthPyramid::isOccluded(const glm::mat4& viewProj, glm::vec3 center, float radius) const {
+    if (!width || !height) {
+        return false;
+    }
+
+    // screen rectangle and closest depth of the corners of the box around the sphere
+    glm::vec2 ndcMin(1.0f), ndcMax(-1.0f);
+    float minDepth = 1.0f;
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner = center + radius * glm::vec3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f);
+        glm::vec4 clip = viewProj * glm::vec4(corner, 1.0f);
+        if (clip.w <= 0.0f) {
+            // reaches behind the camera, projection is not bounded
+            return false;
+        }
+
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        ndcMin = glm::min(ndcMin, glm::vec2(ndc));
+        ndcMax = glm::max(ndcMax, glm::vec2(ndc));
+        minDepth = std::min(minDepth, ndc.z);
+    }
+
+    if (minDepth < 0.0f || ndcMax.x < -1.0f || ndcMax.y < -1.0f || ndcMin.x > 1.0f || ndcMin.y > 1.0f) {
+        // crosses the near plane or off screen (left to the frustum test)
+        return false;
+    }
+
+    // texels of level 0
+    glm::vec2 size((float)width, (float)height);
+    glm::vec2 lo = glm::clamp((ndcMin * 0.5f + 0.5f) * size, glm::vec2(0.0f), size - 1.0f);
+    glm::vec2 hi = glm::clamp((ndcMax * 0.5f + 0.5f) * size, glm::vec2(0.0f), size - 1.0f);
+    unsigned int x0 = (unsigned int)lo.x, y0 = (unsigned int)lo.y;
+    unsigned int x1 = (unsigned int)hi.x, y1 = (unsigned int)hi.y;
+
+    // lowest level where the rectangle covers at most 2x2 texels
+    unsigned int span = std::max(x1 - x0, y1 - y0);
+    unsigned int level = 0;
+    while (level + 1 < getNoLevels() && (1u << level) <= span) {
+        level++;
+    }
+
+    // texels of that level (the right and bottom texels also cover the odd ones cut off by the halving)
+    unsigned int maxX = getLevelWidth(level) - 1, maxY = getLevelHeight(level) - 1;
+    float occluderDepth = maxDepth(level,
+        std::min(x0 >> level, maxX), std::min(y0 >> level, maxY),
+        std::min(x1 >> level, maxX), std::min(y1 >> level, maxY));
+
+    return minDepth > occluderDepth;
+}
+
+// farthest depth of the texels of level in [x0, x1] x [y0, y1]
+float DepthPyramid::maxDepth(unsigned int level, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1) const {
+    const float* src = texels.data() + levelOffsets[level];
+    unsigned int levelWidth = getLevelWidth(level);
+
+    float ret = 0.0f;
+    for (unsigned int y = y0; y <= y1; y++) {
+        for (unsigned int x = x0; x <= x1; x++) {
+            ret = std::max(ret, src[y * levelWidth + x]);
+        }
+    }
+    return ret;
+}
+
+/*
+    instance culling
+*/
+
+// sphere around regions in model space
+glm::vec4 enclosingSphere(const std::vector<BoundingRegion>& regions) {
+    if (regions.empty()) {
+        return glm::vec4(0.0f);
+    }
+
+    // center of the box around all regions
+    glm::vec3 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+    for (const BoundingRegion& br : regions) {
+        glm::vec3 extent = br.type == BoundTypes::AABB ? br.ogMax - br.ogMin : glm::vec3(2.0f * br.ogRadius);
+        glm::vec3 brCenter = br.type == BoundTypes::AABB ? 0.5f * (br.ogMin + br.ogMax) : br.ogCenter;
+        min = glm::min(min, brCenter - 0.5f * extent);
+        max = glm::max(max, brCenter + 0.5f * extent);
+    }
+    glm::vec3 center = 0.5f * (min + max);
+
+    // reach the far side of each region
+    float radius = 0.0f;
+    for (const BoundingRegion& br : regions) {
+        if (br.type == BoundTypes::AABB) {
+            glm::vec3 brCenter = 0.5f * (br.ogMin + br.ogMax);
+            radius = std::max(radius, glm::length(brCenter - center) + 0.5f * glm::length(br.ogMax - br.ogMin));
+        }
+        else {
+            radius = std::max(radius, glm::length(br.ogCenter - center) + br.ogRadius);
+        }
+    }
+
+    return glm::vec4(center, radius);
+}
+
+// sphere in model space moved into world space by model
+glm::vec4 transformSphere(const glm::mat4& model, glm::vec4 sphere) {
+    glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(sphere), 1.0f));
+
+    // largest scale of the axes keeps the whole model inside
+    float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    return glm::vec4(center, sphere.w * scale);
+}
+
+// cull instances and compact the visible ones of each group to its front
+unsigned int cullInstances(const Frustum& frustum, const DepthPyramid* pyramid, const glm::mat4& viewProj,
+    const CullInstance* instances, unsigned int noInstances, CullGroup* groups, uint32_t* visible) {
+    unsigned int ret = 0;
+
+    for (unsigned int i = 0; i < noInstances; i++) {
+        glm::vec3 center = glm::vec3(instances[i].sphere);
+        float radius = instances[i].sphere.w;
+
+        if (!frustum.intersectsSphere(center, radius) ||
+            (pyramid && pyramid->isOccluded(viewProj, center, radius))) {
+            continue;
+        }
+
+        CullGroup& group = groups[instances[i].group];
+        visible[group.firstInstance + group.visibleCount++] = i;
+        ret++;
+    }
+
+    return ret;
+}
+
+// write the commands of the draws with the visible instances of their groups
+void writeCulledCommands(const CullDraw* draws, unsigned int noDraws, const CullGroup* groups, IndirectCommand* commands) {
+    for (unsigned int i = 0; i < noDraws; i++) {
+        const CullGroup& group = groups[draws[i].group];
+        commands[i] = draws[i].command;
+        commands[i].instanceCount = group.visibleCount;
+        commands[i].firstInstance = group.firstInstance;
+    }
+}
@@ -0,0 +1,246 @@
+#ifndef CULLING_HPP
+#define CULLING_HPP
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+#include "bounds.hpp"
+#include "../graphics/memory/drawbatcher.hpp"
+
+/*
+    visibility tests on the CPU
+    - frustum tests of octree nodes and objects, 8 boxes at a time (used by cullFrustum of the octrees)
+    - reference of the GPU culling pass (assets/shaders/cull/cull.comp): same tests and data layout as the
+      shader, so results can be checked and timed without a GPU
+    - clip space depth is [0, 1] (GLM_FORCE_DEPTH_ZERO_TO_ONE), smaller depth is closer
+*/
+
+// instances tested per workgroup of the shader
+#define CULL_GROUP_SIZE 64
+
+/*
+    boxes tested against the frustum at a time (BoxPacket)
+    - AVX: all 8 in one pass, SSE: two passes of 4, scalar otherwise (or with COLLISION_SCALAR defined)
+*/
+#define BOX_PACKET_WIDTH 8
+#if defined(__AVX__) && !defined(COLLISION_SCALAR)
+#define FRUSTUM_SIMD_WIDTH 8
+#elif (defined(__SSE__) || defined(_M_X64)) && !defined(COLLISION_SCALAR)
+#define FRUSTUM_SIMD_WIDTH 4
+#else
+#define FRUSTUM_SIMD_WIDTH 1
+#endif
+
+/*
+    up to BOX_PACKET_WIDTH AABBs in SoA (structure of arrays) form
+*/
+
+class BoxPacket {
+public:
+    // number of boxes in packet (rest of the lanes are padding)
+    unsigned int noBoxes = 0;
+
+    float min[3][BOX_PACKET_WIDTH] = {};
+    float max[3][BOX_PACKET_WIDTH] = {};
+
+    // add a box (the packet must not be full)
+    void add(glm::vec3 boxMin, glm::vec3 boxMax) {
+        for (int i = 0; i < 3; i++) {
+            min[i][noBoxes] = boxMin[i];
+            max[i][noBoxes] = boxMax[i];
+        }
+        noBoxes++;
+    }
+
+    bool isFull() const { return noBoxes == BOX_PACKET_WIDTH; }
+};
+
+/*
+    view frustum as 6 planes
+    - xyz: normal pointing into the frustum, w: distance, a point p is inside if dot(xyz, p) + w >= 0
+*/
+
+class Frustum {
+public:
+    // left, right, bottom, top, near, far
+    glm::vec4 planes[6];
+
+    Frustum() = default;
+
+    // planes of a view-projection matrix (normalized)
+    Frustum(const glm::mat4& viewProj);
+
+    // determine if sphere is at least partially inside
+    bool intersectsSphere(glm::vec3 center, float radius) const;
+
+    // mask of the boxes at least partially inside, insideMask is set to the boxes completely inside
+    unsigned int testBoxes(const BoxPacket& boxes, unsigned int& insideMask) const;
+};
+
+/*
+    counts of a frustum traversal of an octree
+*/
+typedef struct FrustumCullStats {
+    // nodes whose region was tested or accepted with their parent
+    unsigned int noNodesVisited;
+    // nodes completely inside (their subtree was accepted without tests)
+    unsigned int noNodesInside;
+    // objects tested on their own
+    unsigned int noObjectsTested;
+    // objects accepted with their node
+    unsigned int noObjectsAccepted;
+    // tested objects outside the frustum (objects of rejected nodes are not counted)
+    unsigned int noObjectsCulled;
+} FrustumCullStats;
+
+/*
+    visible instances of a frame, per model
+    - filled by the frustum traversal of the octree (Octree::node/LinearTree::cullFrustum)
+    - an instance with several visible regions (one per mesh) is added once, dead instances are not added
+*/
+
+class VisibleInstances {
+public:
+    // indices of the visible instances in their model (RigidBody::instanceIdx), by model index
+    std::vector<std::vector<uint32_t>> lists;
+
+    // start a new frame
+    void clear();
+
+    // add an instance (false if it was added this frame, is dead or is not in a scene)
+    bool add(const RigidBody* instance);
+
+    // instances found by a traversal, added together by addFound once it is done
+    // - the traversal then only reads the tree, the instances are read in one pass instead of between node visits
+    std::vector<const RigidBody*> found;
+
+    // add the instances in found and empty it
+    void addFound();
+
+    // visible instances of a model (nullptr if none were added)
+    const std::vector<uint32_t>* get(unsigned int modelIdx) const {
+        return modelIdx < lists.size() ? &lists[modelIdx] : nullptr;
+    }
+
+    // visible instances of all models
+    unsigned int noVisible() const;
+
+private:
+    // frame each instance was last added in, by model index and instance index
+    std::vector<std::vector<uint32_t>> stamps;
+    uint32_t frame = 1;
+};
+
+/*
+    test a packet of object boxes, append the instances of the visible ones to visible.found and empty the packet
+    - instances[i] is the instance of box i
+*/
+void cullPacket(const Frustum& frustum, BoxPacket& packet, RigidBody* const* instances,
+    VisibleInstances& visible, FrustumCullStats& stats);
+
+/*
+    hierarchical depth (Hi-Z) pyramid
+    - level 0 is the depth buffer, each texel of the next level holds the farthest depth of the texels it covers
+    - levels are packed in one array, the same layout the shader reads from its storage buffer
+*/
+
+class DepthPyramid {
+public:
+    DepthPyramid() : width(0), height(0) {}
+
+    // rebuild from a depth buffer (width * height floats, row 0 at the top like the framebuffer)
+    void build(const float* depth, unsigned int width, unsigned int height);
+
+    // determine if the sphere is behind the depth of everything drawn where it would be
+    bool isOccluded(const glm::mat4& viewProj, glm::vec3 center, float radius) const;
+
+    /*
+        accessors
+    */
+
+    unsigned int getWidth() const { return width; }
+    unsigned int getHeight() const { return height; }
+    unsigned int getNoLevels() const { return levelOffsets.size(); }
+    unsigned int getLevelWidth(unsigned int level) const { return levelSize(width, level); }
+    unsigned int getLevelHeight(unsigned int level) const { return levelSize(height, level); }
+    // index of the first texel of level in getTexels()
+    unsigned int getLevelOffset(unsigned int level) const { return levelOffsets[level]; }
+    const std::vector<float>& getTexels() const { return texels; }
+
+    /*
+        static
+    */
+
+    // side of a level (halved each level, at least 1)
+    static unsigned int levelSize(unsigned int size, unsigned int level) {
+        size >>= level;
+        return size ? size : 1;
+    }
+
+    // number of levels down to 1x1
+    static unsigned int noLevels(unsigned int width, unsigned int height);
+
+    // number of floats of all levels
+    static unsigned int noTexels(unsigned int width, unsigned int height);
+
+private:
+    unsigned int width;
+    unsigned int height;
+
+    std::vector<unsigned int> levelOffsets;
+    std::vector<float> texels;
+
+    // farthest depth of the texels of level in [x0, x1] x [y0, y1]
+    float maxDepth(unsigned int level, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1) const;
+};
+
+/*
+    instance as the cull pass reads it (32 bytes, std430)
+*/
+typedef struct CullInstance {
+    // world space bounding sphere (xyz: center, w: radius)
+    glm::vec4 sphere;
+    // group the instance is drawn with
+    uint32_t group;
+    uint32_t pad[3];
+} CullInstance;
+
+/*
+    instances drawn by the same commands (the instances of an entity)
+*/
+typedef struct CullGroup {
+    // first instance of the group in the instance arrays
+    uint32_t firstInstance;
+    // visible instances (0 before the pass, set by it)
+    uint32_t visibleCount;
+} CullGroup;
+
+/*
+    draw whose instance range is filled in by the cull pass (24 bytes, std430)
+*/
+typedef struct CullDraw {
+    IndirectCommand command;
+    uint32_t group;
+} CullDraw;
+
+// sphere around regions in model space (xyz: center, w: radius)
+glm::vec4 enclosingSphere(const std::vector<BoundingRegion>& regions);
+
+// sphere in model space moved into world space by model
+glm::vec4 transformSphere(const glm::mat4& model, glm::vec4 sphere);
+
+/*
+    cull instances and compact the visible ones of each group to its front
+    - visible[group.firstInstance + n] is the index of the n-th visible instance of the group
+      (in order here, the shader writes them in any order)
+    - pyramid is optional, visibleCount of the groups must be 0
+    - returns the number of visible instances
+*/
+unsigned int cullInstances(const Frustum& frustum, const DepthPyramid* pyramid, const glm::mat4& viewProj,
+    const CullInstance* instances, unsigned int noInstances, CullGroup* groups, uint32_t* visible);
+
+// write the commands of the draws with the visible instances of their groups (second dispatch of the shader)
+void writeCulledCommands(const CullDraw* draws, unsigned int noDraws, const CullGroup* groups, IndirectCommand* commands);
+
+#endif
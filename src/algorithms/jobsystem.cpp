@@ -0,0 +1,146 @@
+#include "jobsystem.hpp"
+
+#include <algorithm>
+
+// pool and index of the worker running on this thread (nullptr outside any pool)
+static thread_local JobSystem* currentPool = nullptr;
+static thread_local unsigned int currentThread = 0;
+
+/*
+    constructors
+*/
+
+// initialize with number of threads (0 = one per hardware thread)
+JobSystem::JobSystem(unsigned int noThreads) {
+    if (noThreads == 0) {
+        noThreads = std::thread::hardware_concurrency();
+    }
+
+    // caller is thread 0
+    for (unsigned int i = 1; i < noThreads; i++) {
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    batchStarted.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+/*
+    functionality
+*/
+
+// run job over [0, count) in chunks of grain items, returns once all chunks are done
+void JobSystem::parallelFor(unsigned int count, unsigned int grain, const RangeJob& job) {
+    if (count == 0) {
+        return;
+    }
+    if (grain == 0) {
+        grain = 1;
+    }
+
+    // a worker calling from inside a job keeps its index, so per thread scratch lists are not shared
+    unsigned int thread = callerThread();
+
+    if (singleThreaded || workers.empty() || count <= grain) {
+        // not worth waking the workers
+        job(0, count, thread);
+        return;
+    }
+
+    Batch batch;
+    batch.job = &job;
+    batch.count = count;
+    batch.grain = grain;
+    batch.noChunks = (count + grain - 1) / grain;
+    batch.nextChunk = 0;
+    batch.noWorkers = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batches.push_back(&batch);
+    }
+    batchStarted.notify_all();
+
+    // take part in the batch (only this one, chunks of other batches could need this thread's scratch lists)
+    runChunks(batch, thread);
+
+    // every chunk is taken, wait for the workers still running one before batch goes out of scope
+    std::unique_lock<std::mutex> lock(mutex);
+    closeBatch(&batch);
+    workerDone.wait(lock, [&batch] { return batch.noWorkers == 0; });
+}
+
+// parallelFor on jobs, or job(0, count, 0) on the calling thread if jobs is nullptr
+void JobSystem::run(JobSystem* jobs, unsigned int count, unsigned int grain, const RangeJob& job) {
+    if (jobs) {
+        jobs->parallelFor(count, grain, job);
+    }
+    else if (count) {
+        job(0, count, 0);
+    }
+}
+
+// loop run by each worker
+void JobSystem::workerLoop(unsigned int thread) {
+    currentPool = this;
+    currentThread = thread;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        batchStarted.wait(lock, [this] { return stop || !batches.empty(); });
+        if (stop) {
+            return;
+        }
+
+        Batch* batch = batches.front();
+        if (batch->nextChunk >= batch->noChunks) {
+            // all chunks are taken
+            closeBatch(batch);
+            continue;
+        }
+
+        // the caller waits for noWorkers before the batch goes out of scope
+        batch->noWorkers++;
+        lock.unlock();
+
+        runChunks(*batch, thread);
+
+        lock.lock();
+        closeBatch(batch);
+        batch->noWorkers--;
+        if (batch->noWorkers == 0) {
+            workerDone.notify_all();
+        }
+    }
+}
+
+// take chunks of a batch until none are left
+void JobSystem::runChunks(Batch& batch, unsigned int thread) {
+    for (unsigned int chunk = batch.nextChunk++; chunk < batch.noChunks; chunk = batch.nextChunk++) {
+        unsigned int begin = chunk * batch.grain;
+        unsigned int end = begin + batch.grain < batch.count ? begin + batch.grain : batch.count;
+        (*batch.job)(begin, end, thread);
+    }
+}
+
+// stop handing out a batch (called with mutex locked)
+void JobSystem::closeBatch(Batch* batch) {
+    std::vector<Batch*>::iterator it = std::find(batches.begin(), batches.end(), batch);
+    if (it != batches.end()) {
+        batches.erase(it);
+    }
+}
+
+// index of the calling thread (0 outside the pool)
+unsigned int JobSystem::callerThread() {
+    return currentPool == this ? currentThread : 0;
+}
@@ -0,0 +1,96 @@
+#ifndef JOBSYSTEM_HPP
+#define JOBSYSTEM_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+/*
+    job system
+    - fixed pool of worker threads that split ranges of work between them
+    - the calling thread takes part in every batch, so a pool of n threads has n - 1 workers
+    - each call is a batch of its own, so parallelFor may be called from several threads at once
+        and from inside a job (the caller only runs chunks of its own batch while it waits)
+*/
+
+class JobSystem {
+public:
+    // job over the range [begin, end), thread is in [0, noThreads())
+    // - thread is the index of the worker running the chunk, 0 for threads outside the pool
+    //   (so callers on different outside threads must not share scratch lists indexed by it)
+    typedef std::function<void(unsigned int begin, unsigned int end, unsigned int thread)> RangeJob;
+
+    // run every batch on the calling thread (to compare results with the threaded path)
+    bool singleThreaded = false;
+
+    /*
+        constructors
+    */
+
+    // initialize with number of threads (0 = one per hardware thread)
+    JobSystem(unsigned int noThreads = 0);
+
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    /*
+        functionality
+    */
+
+    // run job over [0, count) in chunks of grain items, returns once all chunks are done
+    void parallelFor(unsigned int count, unsigned int grain, const RangeJob& job);
+
+    // parallelFor on jobs, or job(0, count, 0) on the calling thread if jobs is nullptr
+    static void run(JobSystem* jobs, unsigned int count, unsigned int grain, const RangeJob& job);
+
+    /*
+        accessors
+    */
+
+    // number of threads that can run a batch (including the caller)
+    unsigned int noThreads() { return workers.size() + 1; }
+
+private:
+    // chunks of one parallelFor call (lives on the caller's stack)
+    struct Batch {
+        const RangeJob* job;
+        unsigned int count;
+        unsigned int grain;
+        unsigned int noChunks;
+        std::atomic<unsigned int> nextChunk;
+        // workers running chunks of the batch (guarded by mutex)
+        unsigned int noWorkers;
+    };
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    // signals workers that a batch started (or the pool stopped)
+    std::condition_variable batchStarted;
+    // signals callers that a worker left a batch
+    std::condition_variable workerDone;
+
+    // batches that may have chunks left, oldest first (guarded by mutex)
+    std::vector<Batch*> batches;
+    // if the pool is shutting down
+    bool stop = false;
+
+    // loop run by each worker
+    void workerLoop(unsigned int thread);
+
+    // take chunks of a batch until none are left
+    void runChunks(Batch& batch, unsigned int thread);
+
+    // stop handing out a batch (called with mutex locked)
+    void closeBatch(Batch* batch);
+
+    // index of the calling thread (0 outside the pool)
+    unsigned int callerThread();
+};
+
+#endif
@@ -0,0 +1,969 @@
+#include "linear_octree.hpp"
+#include "timer.hpp"
+#include <bit>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+/*
+    Morton (location) code utilities
+*/
+
+// spread the lower 21 bits of v so there are 2 zero bits between each
+uint64_t Octree::mortonSpread(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | (v << 32)) & 0x001f00000000ffff;
+    v = (v | (v << 16)) & 0x001f0000ff0000ff;
+    v = (v | (v << 8))  & 0x100f00f00f00f00f;
+    v = (v | (v << 4))  & 0x10c30c30c30c30c3;
+    v = (v | (v << 2))  & 0x1249249249249249;
+    return v;
+}
+
+// interleave 3 quantized coordinates into a Morton code
+uint64_t Octree::mortonEncode(uint32_t x, uint32_t y, uint32_t z) {
+    return mortonSpread(x) | (mortonSpread(y) << 1) | (mortonSpread(z) << 2);
+}
+
+// depth of a location code (root = 0)
+unsigned int Octree::codeDepth(uint64_t code) {
+    // position of sentinel bit / 3
+    return (63 - std::countl_zero(code)) / 3;
+}
+
+// octant of the child on the path to the location code, taken from the node at depth
+static inline unsigned char octantOnPath(uint64_t code, unsigned int depth) {
+    return (code >> (3 * (Octree::codeDepth(code) - depth - 1))) & 0b111;
+}
+
+/*
+    constructors
+*/
+
+// initialize with bounds (no objects yet)
+Octree::LinearTree::LinearTree(const BoundingRegion &bounds) : region(bounds) {
+    glm::vec3 dimensions = region.calculateDimensions();
+
+    // same termination as Octree::node, a cell is only divided if all its dimensions are at least MIN_BOUNDS
+    float minDimension = glm::min(dimensions.x, glm::min(dimensions.y, dimensions.z));
+    maxDepth = 0;
+    while (maxDepth < MAX_LINEAR_DEPTH && minDimension >= MIN_BOUNDS) {
+        minDimension *= 0.5f;
+        maxDepth++;
+    }
+
+    cellsPerUnit = glm::vec3((float)(1u << maxDepth)) / dimensions;
+
+    // root
+    allocateNode(1, NULL_INDEX, region.min, region.max);
+}
+
+/*
+    functionality
+*/
+
+// add instance to pending queue
+void Octree::LinearTree::addToPending(RigidBody* instance, const std::vector<BoundingRegion> &regions) {
+    // put a copy of each bounding region in queue
+    for (const BoundingRegion &br : regions) {
+        queue.push_back(br);
+        queue.back().instance = instance;
+        queue.back().transform();
+    }
+}
+
+// build tree (called during initialization)
+void Octree::LinearTree::build() {
+    // objects are pushed to their cells on insertion, so building is inserting the initial queue
+    for (BoundingRegion& br : queue) {
+        insert(std::move(br));
+    }
+    queue.clear();
+    compact();
+
+    // set state variables
+    treeBuilt = true;
+    treeReady = true;
+}
+
+// update objects in tree (called during each iteration of main loop)
+void Octree::LinearTree::update(std::vector<glm::vec3> &positions, std::vector<glm::vec3> &sizes) {
+    if (treeBuilt && treeReady) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        unsigned int noThreads = jobs ? jobs->noThreads() : 1;
+        if (contexts.size() < noThreads) {
+            contexts.resize(noThreads);
+        }
+        for (linearUpdateContext& ctx : contexts) {
+            ctx.movedObjects.clear();
+            ctx.deadObjects.clear();
+            ctx.positions.clear();
+            ctx.sizes.clear();
+            ctx.candidates.clear();
+            ctx.collisions.clear();
+        }
+
+        // lifespans, dead and moved objects (each node only touches itself and its objects)
+        JobSystem::run(jobs, nodes.size(), 256, [this](unsigned int begin, unsigned int end, unsigned int thread) {
+            updateNodes(contexts[thread], begin, end);
+        });
+
+        // gather results, sorted by object index so the tree changes the same way regardless of threading
+        movedObjects.clear();
+        deadObjects.clear();
+        for (linearUpdateContext& ctx : contexts) {
+            movedObjects.insert(movedObjects.end(), ctx.movedObjects.begin(), ctx.movedObjects.end());
+            deadObjects.insert(deadObjects.end(), ctx.deadObjects.begin(), ctx.deadObjects.end());
+            positions.insert(positions.end(), ctx.positions.begin(), ctx.positions.end());
+            sizes.insert(sizes.end(), ctx.sizes.begin(), ctx.sizes.end());
+        }
+        std::sort(movedObjects.begin(), movedObjects.end());
+        std::sort(deadObjects.begin(), deadObjects.end());
+
+        // remove objects that don't exist anymore
+        for (unsigned int obj : deadObjects) {
+            unlink(obj);
+            releaseObject(obj);
+        }
+
+        // remove dead branches (root is never removed)
+        for (unsigned int n = 1, noNodes = nodes.size(); n < noNodes; n++) {
+            if (nodes[n].code && nodes[n].currentLifespan == 0) {
+                if (nodes[n].noObjects || nodes[n].activeOctants) {
+                    // branch is dead but has objects or children, so reset
+                    nodes[n].currentLifespan = -1;
+                }
+                else {
+                    // branch is dead
+                    releaseNode(n);
+                }
+            }
+        }
+
+        // move moved objects into new nodes
+        unsigned int noMoved = 0;
+        for (unsigned int obj : movedObjects) {
+            uint64_t target = locate(hot[obj]);
+            if (!target) {
+                // left the root region, wait in the queue until it comes back
+                queue.push_back(std::move(objects[obj]));
+                unlink(obj);
+                releaseObject(obj);
+                continue;
+            }
+
+            if (target != links[obj].code) {
+                unlink(obj);
+                links[obj].code = target;
+                place(obj, target);
+            }
+
+            movedObjects[noMoved++] = obj;
+        }
+        movedObjects.resize(noMoved);
+        stats.updateMs = msSince(start);
+        stats.noMoved = noMoved;
+
+        // broad phase (tree is read only from here until the responses)
+        start = std::chrono::steady_clock::now();
+        JobSystem::run(jobs, movedObjects.size(), 16, [this](unsigned int begin, unsigned int end, unsigned int thread) {
+            findCandidates(contexts[thread], begin, end);
+        });
+        stats.broadPhaseMs = msSince(start);
+
+        // merge pairs in order of moved objects, then in the order each was found
+        // (all pairs of a moved object are found by the same thread)
+        candidates.clear();
+        for (linearUpdateContext& ctx : contexts) {
+            candidates.insert(candidates.end(), ctx.candidates.begin(), ctx.candidates.end());
+        }
+        std::stable_sort(candidates.begin(), candidates.end(), [](const linearCandidate& a, const linearCandidate& b) {
+            return a.order < b.order;
+        });
+
+        // narrow phase, split by pairs so one crowded region does not end up on one thread
+        start = std::chrono::steady_clock::now();
+        JobSystem::run(jobs, candidates.size(), 64, [this](unsigned int begin, unsigned int end, unsigned int thread) {
+            findCollisions(contexts[thread], begin, end);
+        });
+        stats.narrowPhaseMs = msSince(start);
+
+        // merge collisions in the order of the pairs
+        collisions.clear();
+        for (linearUpdateContext& ctx : contexts) {
+            collisions.insert(collisions.end(), ctx.collisions.begin(), ctx.collisions.end());
+        }
+        std::sort(collisions.begin(), collisions.end(), [](const linearCollision& a, const linearCollision& b) {
+            return a.candidate < b.candidate;
+        });
+
+        // respond on the calling thread
+        start = std::chrono::steady_clock::now();
+        for (linearCollision& c : collisions) {
+            respondToCollision(objects[c.br], objects[c.obj], c.norm, c.toi);
+        }
+        stats.responseMs = msSince(start);
+
+        stats.noCandidates = candidates.size();
+        stats.noCollisions = collisions.size();
+    }
+
+    processPending();
+
+    // objects that changed nodes were linked at the front of their new node, so reorder the pools once enough did
+    if (noRelinked * LINEAR_COMPACT_DIVISOR > noObjects()) {
+        compact();
+    }
+}
+
+// process pending queue
+void Octree::LinearTree::processPending() {
+    if (!treeBuilt) {
+        // add objects to be sorted into branches when built
+        build();
+    }
+    else {
+        unsigned int kept = 0;
+        for (unsigned int i = 0, len = queue.size(); i < len; i++) {
+            if (locate(HotRegion(queue[i], NULL_INDEX))) {
+                // insert object immediately (for swept instances, once the whole motion is inside)
+                insert(std::move(queue[i]));
+            }
+            else {
+                // return to queue
+                queue[i].transform();
+                if (kept != i) {
+                    queue[kept] = std::move(queue[i]);
+                }
+                kept++;
+            }
+        }
+        queue.erase(queue.begin() + kept, queue.end());
+    }
+}
+
+// remove the objects (and queued objects) of instances marked INSTANCE_DEAD
+void Octree::LinearTree::removeDead() {
+    for (unsigned int i = 0, noSlots = objects.size(); i < noSlots; i++) {
+        // free slots may point to instances that were already freed
+        if (links[i].cell != NULL_INDEX && States::isActive(&objects[i].instance->state, INSTANCE_DEAD)) {
+            unlink(i);
+            releaseObject(i);
+        }
+    }
+
+    queue.erase(std::remove_if(queue.begin(), queue.end(), [](const BoundingRegion& br) {
+        return States::isActive(&br.instance->state, INSTANCE_DEAD);
+    }), queue.end());
+}
+
+// dynamically insert object into tree
+bool Octree::LinearTree::insert(BoundingRegion obj) {
+    // safeguard if object doesn't fit
+    uint64_t target = locate(HotRegion(obj, NULL_INDEX));
+    if (!target) {
+        return false;
+    }
+
+    // objects in the linear tree are referenced by index, not by node pointer
+    obj.cell = nullptr;
+
+    unsigned int idx = allocateObject(std::move(obj));
+    links[idx].code = target;
+    place(idx, target);
+
+    return true;
+}
+
+// check collisions with a ray
+BoundingRegion* Octree::LinearTree::checkCollisionsRay(Ray r, float& tmin) {
+    float tmin_tmp, tmax_tmp;
+    glm::vec3 norm;
+    BoundingRegion* ret = nullptr;
+
+    stack.clear();
+    stack.push_back(0);
+    while (!stack.empty()) {
+        linearNode& current = nodes[stack.back()];
+        stack.pop_back();
+
+        tmin_tmp = std::numeric_limits<float>::max();
+        tmax_tmp = std::numeric_limits<float>::lowest();
+
+        // check current region
+        if (!r.intersectsBoundingRegion(current.region, tmin_tmp, tmax_tmp) || tmin_tmp >= tmin) {
+            // missed or found nearer collision
+            continue;
+        }
+
+        // check objects in the node
+        for (unsigned int i = current.firstObject; i != NULL_INDEX; i = links[i].next) {
+            if (r.intersectsObject(objects[i], tmin, norm)) {
+                ret = &objects[i];
+            }
+        }
+
+        // check children
+        for (unsigned char flags = current.activeOctants, i = 0; flags; flags >>= 1, i++) {
+            if (States::isIndexActive(&flags, 0)) {
+                stack.push_back(current.children[i]);
+            }
+        }
+    }
+
+    return ret;
+}
+
+// closest hit of each ray (hits[i] for rays[i])
+void Octree::LinearTree::castRays(std::span<const Ray> rays, std::span<RayHit> hits) {
+    unsigned int noPackets = (rays.size() + RAY_PACKET_WIDTH - 1) / RAY_PACKET_WIDTH;
+
+    // tree is only read, so packets need no scratch lists
+    JobSystem::run(jobs, noPackets, 8, [this, rays, hits](unsigned int begin, unsigned int end, unsigned int) {
+        for (unsigned int p = begin; p < end; p++) {
+            unsigned int first = p * RAY_PACKET_WIDTH;
+            unsigned int noRays = std::min((unsigned int)rays.size() - first, (unsigned int)RAY_PACKET_WIDTH);
+            castPacket(rays.data() + first, noRays, hits.data() + first);
+        }
+    });
+}
+
+// add the instances of the objects inside the frustum to visible
+void Octree::LinearTree::cullFrustum(const Frustum& frustum, VisibleInstances& visible, FrustumCullStats* stats) {
+    FrustumCullStats counts = {};
+    BoxPacket packet;
+    RigidBody* instances[BOX_PACKET_WIDTH];
+    unsigned int insideMask;
+
+    // root is tested alone, other nodes are tested together with their siblings
+    cullStack.clear();
+    packet.add(nodes[0].region.min, nodes[0].region.max);
+    if (frustum.testBoxes(packet, insideMask)) {
+        cullStack.push_back({ 0, insideMask != 0 });
+    }
+    packet.noBoxes = 0;
+
+    while (!cullStack.empty()) {
+        auto [idx, inside] = cullStack.back();
+        cullStack.pop_back();
+        const linearNode& current = nodes[idx];
+        counts.noNodesVisited++;
+
+        if (inside) {
+            // whole subtree is visible, accept objects without testing them
+            counts.noNodesInside++;
+            for (unsigned int i = current.firstObject; i != NULL_INDEX; i = links[i].next) {
+                visible.found.push_back(links[i].instance);
+            }
+            counts.noObjectsAccepted += current.noObjects;
+
+            for (unsigned char flags = current.activeOctants, i = 0; flags; flags >>= 1, i++) {
+                if (States::isIndexActive(&flags, 0)) {
+                    cullStack.push_back({ current.children[i], true });
+                }
+            }
+            continue;
+        }
+
+        // test objects in packets
+        for (unsigned int i = current.firstObject; i != NULL_INDEX; i = links[i].next) {
+            instances[packet.noBoxes] = links[i].instance;
+            packet.add(hot[i].boxMin(), hot[i].boxMax());
+
+            if (packet.isFull()) {
+                cullPacket(frustum, packet, instances, visible, counts);
+            }
+        }
+        if (packet.noBoxes) {
+            cullPacket(frustum, packet, instances, visible, counts);
+        }
+
+        // test children together (at most 8, one packet)
+        unsigned int active[NUM_CHILDREN];
+        for (unsigned char flags = current.activeOctants, i = 0; flags; flags >>= 1, i++) {
+            if (States::isIndexActive(&flags, 0)) {
+                active[packet.noBoxes] = current.children[i];
+                packet.add(nodes[current.children[i]].region.min, nodes[current.children[i]].region.max);
+            }
+        }
+        if (!packet.noBoxes) {
+            continue;
+        }
+
+        unsigned int mask = frustum.testBoxes(packet, insideMask);
+        for (unsigned int i = 0; i < packet.noBoxes; i++) {
+            if (mask & (1u << i)) {
+                cullStack.push_back({ active[i], ((insideMask >> i) & 1) != 0 });
+            }
+        }
+        packet.noBoxes = 0;
+    }
+
+    // objects waiting in the queue are not in the tree yet (or are outside the root), test them on their own
+    for (const BoundingRegion& obj : queue) {
+        HotRegion br(obj, NULL_INDEX);
+        instances[packet.noBoxes] = obj.instance;
+        packet.add(br.boxMin(), br.boxMax());
+        if (packet.isFull()) {
+            cullPacket(frustum, packet, instances, visible, counts);
+        }
+    }
+    if (packet.noBoxes) {
+        cullPacket(frustum, packet, instances, visible, counts);
+    }
+
+    // instances are only read once the tree was walked
+    visible.addFound();
+
+    if (stats) {
+        *stats = counts;
+    }
+}
+
+// destroy object (free memory)
+void Octree::LinearTree::destroy() {
+    nodes.clear();
+    freeNodes.clear();
+    objects.clear();
+    links.clear();
+    hot.clear();
+    worldMeshes.clear();
+    freeObjects.clear();
+    queue.clear();
+    movedObjects.clear();
+    deadObjects.clear();
+    stack.clear();
+    newNodes.clear();
+    newObjects.clear();
+    cullStack.clear();
+    candidates.clear();
+    collisions.clear();
+    contexts.clear();
+    noRelinked = 0;
+
+    // keep an empty root so the tree stays usable
+    allocateNode(1, NULL_INDEX, region.min, region.max);
+}
+
+/*
+    accessors
+*/
+
+// find the pool index of the node with a location code (NULL_INDEX if it does not exist)
+unsigned int Octree::LinearTree::findNode(uint64_t code) {
+    unsigned int depth = codeDepth(code);
+    unsigned int idx = 0;
+    for (unsigned int d = 0; d < depth && idx != NULL_INDEX; d++) {
+        idx = nodes[idx].children[octantOnPath(code, d)];
+    }
+    return idx;
+}
+
+/*
+    pool management
+*/
+
+// take a node from the pool
+unsigned int Octree::LinearTree::allocateNode(uint64_t code, unsigned int parent, glm::vec3 min, glm::vec3 max) {
+    unsigned int idx;
+    if (freeNodes.size()) {
+        idx = freeNodes.back();
+        freeNodes.pop_back();
+    }
+    else {
+        idx = nodes.size();
+        nodes.emplace_back();
+    }
+
+    linearNode& n = nodes[idx];
+    n.code = code;
+    n.depth = codeDepth(code);
+    n.parent = parent;
+    for (int i = 0; i < NUM_CHILDREN; i++) {
+        n.children[i] = NULL_INDEX;
+    }
+    n.activeOctants = 0;
+    n.maxLifespan = 8;
+    n.currentLifespan = -1;
+    n.firstObject = NULL_INDEX;
+    n.noObjects = 0;
+    n.region = BoundingRegion(min, max);
+
+    return idx;
+}
+
+// return a leaf to the pool
+void Octree::LinearTree::releaseNode(unsigned int idx) {
+    linearNode& n = nodes[idx];
+    unsigned char octant = n.code & 0b111;
+
+    nodes[n.parent].children[octant] = NULL_INDEX;
+    States::deactivateIndex(&nodes[n.parent].activeOctants, octant);
+
+    n.code = 0;
+    freeNodes.push_back(idx);
+}
+
+// get child in octant, create if not active
+unsigned int Octree::LinearTree::getOrCreateChild(unsigned int idx, unsigned char octant) {
+    if (nodes[idx].children[octant] != NULL_INDEX) {
+        return nodes[idx].children[octant];
+    }
+
+    // bounds of octant
+    glm::vec3 min = nodes[idx].region.min;
+    glm::vec3 max = nodes[idx].region.max;
+    glm::vec3 center = 0.5f * (min + max);
+    for (int i = 0; i < 3; i++) {
+        if (octant & (1 << i)) {
+            min[i] = center[i];
+        }
+        else {
+            max[i] = center[i];
+        }
+    }
+
+    // allocating may grow the pool, so only index into it afterwards
+    unsigned int child = allocateNode((nodes[idx].code << 3) | octant, idx, min, max);
+    nodes[idx].children[octant] = child;
+    States::activateIndex(&nodes[idx].activeOctants, octant);
+
+    return child;
+}
+
+// take an object slot
+unsigned int Octree::LinearTree::allocateObject(BoundingRegion&& obj) {
+    unsigned int idx;
+    if (freeObjects.size()) {
+        idx = freeObjects.back();
+        freeObjects.pop_back();
+        objects[idx] = std::move(obj);
+    }
+    else {
+        idx = objects.size();
+        objects.push_back(std::move(obj));
+        links.emplace_back();
+        hot.emplace_back();
+        worldMeshes.emplace_back();
+    }
+
+    hot[idx] = HotRegion(objects[idx], idx);
+
+    worldMeshes[idx].valid = false;
+
+    links[idx] = { 0, NULL_INDEX, NULL_INDEX, NULL_INDEX, objects[idx].instance };
+
+    return idx;
+}
+
+// return an object slot
+void Octree::LinearTree::releaseObject(unsigned int idx) {
+    links[idx].cell = NULL_INDEX;
+    freeObjects.push_back(idx);
+}
+
+// link object into node
+void Octree::LinearTree::link(unsigned int obj, unsigned int cell) {
+    linearNode& n = nodes[cell];
+
+    links[obj].cell = cell;
+    links[obj].prev = NULL_INDEX;
+    links[obj].next = n.firstObject;
+    if (n.firstObject != NULL_INDEX) {
+        links[n.firstObject].prev = obj;
+    }
+    n.firstObject = obj;
+    n.noObjects++;
+    noRelinked++;
+}
+
+// unlink object from its node
+void Octree::LinearTree::unlink(unsigned int obj) {
+    linearLink& l = links[obj];
+    linearNode& n = nodes[l.cell];
+
+    if (l.prev != NULL_INDEX) {
+        links[l.prev].next = l.next;
+    }
+    else {
+        n.firstObject = l.next;
+    }
+    if (l.next != NULL_INDEX) {
+        links[l.next].prev = l.prev;
+    }
+    n.noObjects--;
+
+    l.prev = l.next = NULL_INDEX;
+}
+
+// put nodes and objects in depth first order, the objects of a node next to each other
+void Octree::LinearTree::compact() {
+    // new pool indices in visiting order (the root stays at 0), free slots are moved behind the used ones
+    newNodes.assign(nodes.size(), NULL_INDEX);
+    newObjects.assign(objects.size(), NULL_INDEX);
+    unsigned int noSortedNodes = 0;
+    unsigned int noSortedObjects = 0;
+
+    stack.clear();
+    stack.push_back(0);
+    while (!stack.empty()) {
+        unsigned int n = stack.back();
+        stack.pop_back();
+        newNodes[n] = noSortedNodes++;
+
+        // objects in list order, relinked to their neighbours in the new order
+        for (unsigned int i = nodes[n].firstObject, next; i != NULL_INDEX; i = next) {
+            next = links[i].next;
+            newObjects[i] = noSortedObjects++;
+            links[i].prev = i == nodes[n].firstObject ? NULL_INDEX : newObjects[i] - 1;
+            links[i].next = next == NULL_INDEX ? NULL_INDEX : newObjects[i] + 1;
+            hot[i].handle = newObjects[i];
+        }
+        if (nodes[n].firstObject != NULL_INDEX) {
+            nodes[n].firstObject = newObjects[nodes[n].firstObject];
+        }
+
+        // reverse, so the lowest octant is visited first
+        for (int i = NUM_CHILDREN - 1; i >= 0; i--) {
+            if (nodes[n].children[i] != NULL_INDEX) {
+                stack.push_back(nodes[n].children[i]);
+            }
+        }
+    }
+    unsigned int noUsedNodes = noSortedNodes;
+    unsigned int noUsedObjects = noSortedObjects;
+    for (unsigned int& idx : newNodes) {
+        if (idx == NULL_INDEX) {
+            idx = noSortedNodes++;
+        }
+    }
+    for (unsigned int& idx : newObjects) {
+        if (idx == NULL_INDEX) {
+            idx = noSortedObjects++;
+        }
+    }
+
+    // node and object indices held by the pools
+    for (unsigned int n = 0, noSlots = nodes.size(); n < noSlots; n++) {
+        if (!nodes[n].code) {
+            continue;
+        }
+        if (nodes[n].parent != NULL_INDEX) {
+            nodes[n].parent = newNodes[nodes[n].parent];
+        }
+        for (int i = 0; i < NUM_CHILDREN; i++) {
+            if (nodes[n].children[i] != NULL_INDEX) {
+                nodes[n].children[i] = newNodes[nodes[n].children[i]];
+            }
+        }
+    }
+    for (linearLink& l : links) {
+        if (l.cell != NULL_INDEX) {
+            l.cell = newNodes[l.cell];
+        }
+    }
+
+    // move each slot to its new index in place (every swap puts one slot where it belongs)
+    for (unsigned int n = 0, noSlots = nodes.size(); n < noSlots; n++) {
+        while (newNodes[n] != n) {
+            unsigned int target = newNodes[n];
+            std::swap(nodes[n], nodes[target]);
+            std::swap(newNodes[n], newNodes[target]);
+        }
+    }
+    for (unsigned int i = 0, noSlots = objects.size(); i < noSlots; i++) {
+        while (newObjects[i] != i) {
+            unsigned int target = newObjects[i];
+            std::swap(objects[i], objects[target]);
+            std::swap(links[i], links[target]);
+            std::swap(hot[i], hot[target]);
+            std::swap(worldMeshes[i], worldMeshes[target]);
+            std::swap(newObjects[i], newObjects[target]);
+        }
+    }
+
+    // drop the free slots
+    nodes.resize(noUsedNodes);
+    objects.resize(noUsedObjects);
+    links.resize(noUsedObjects);
+    hot.resize(noUsedObjects);
+    worldMeshes.resize(noUsedObjects);
+    freeNodes.clear();
+    freeObjects.clear();
+    noRelinked = 0;
+}
+
+/*
+    placement
+*/
+
+// location code of the deepest cell that can contain the object (0 if not inside root)
+uint64_t Octree::LinearTree::locate(const HotRegion& obj) {
+    // extents of object
+    glm::vec3 lo = obj.boxMin();
+    glm::vec3 hi = obj.boxMax();
+
+    // same as region.containsRegion for either type of object
+    if (glm::any(glm::lessThan(lo, region.min)) || glm::any(glm::greaterThan(hi, region.max))) {
+        return 0;
+    }
+
+    // quantize to the finest grid
+    glm::vec3 cellMax = glm::vec3((float)((1u << maxDepth) - 1));
+    glm::uvec3 qlo = glm::uvec3(glm::clamp((lo - region.min) * cellsPerUnit, glm::vec3(0.0f), cellMax));
+    glm::uvec3 qhi = glm::uvec3(glm::clamp((hi - region.min) * cellsPerUnit, glm::vec3(0.0f), cellMax));
+
+    uint64_t a = mortonEncode(qlo.x, qlo.y, qlo.z);
+    uint64_t b = mortonEncode(qhi.x, qhi.y, qhi.z);
+
+    // the cell containing both corners is the common 3 bit prefix of their codes
+    unsigned int level = maxDepth;
+    uint64_t diff = a ^ b;
+    if (diff) {
+        unsigned int highestBit = 63 - std::countl_zero(diff);
+        level = maxDepth - 1 - highestBit / 3;
+    }
+
+    return ((uint64_t)1 << (3 * level)) | (a >> (3 * (maxDepth - level)));
+}
+
+// push object down to the cell at the location code, dividing leaves on the way
+void Octree::LinearTree::place(unsigned int obj, uint64_t target) {
+    unsigned int targetDepth = codeDepth(target);
+    unsigned int current = 0;
+
+    /*
+        termination conditions
+        - reached the target cell
+        - an empty leaf node (same as Octree::node, nodes are only divided once they hold an object)
+    */
+    while (nodes[current].depth < targetDepth &&
+        (nodes[current].noObjects || nodes[current].activeOctants)) {
+        if (nodes[current].noObjects) {
+            divide(current);
+        }
+
+        current = getOrCreateChild(current, octantOnPath(target, nodes[current].depth));
+    }
+
+    link(obj, current);
+}
+
+// move objects of a leaf one level down where they fit
+void Octree::LinearTree::divide(unsigned int idx) {
+    unsigned int depth = nodes[idx].depth;
+
+    for (unsigned int i = nodes[idx].firstObject, next; i != NULL_INDEX; i = next) {
+        next = links[i].next;
+
+        if (codeDepth(links[i].code) > depth) {
+            // object fits in a child octant
+            unsigned int child = getOrCreateChild(idx, octantOnPath(links[i].code, depth));
+            unlink(i);
+            link(i, child);
+        }
+    }
+}
+
+/*
+    collisions
+*/
+
+// find objects in node that overlap the moved object
+void Octree::LinearTree::checkCollisionsSelf(linearUpdateContext& ctx, unsigned int cell, unsigned int order) {
+    unsigned int obj = movedObjects[order];
+    const HotRegion& objHot = hot[obj];
+
+    for (unsigned int i = nodes[cell].firstObject; i != NULL_INDEX; i = links[i].next) {
+        // coarse check on the compact regions only
+        if (hot[i].intersectsWith(objHot)) {
+            ctx.candidates.push_back({ order, i, obj });
+        }
+    }
+}
+
+// test moved object against all objects in descendant nodes
+void Octree::LinearTree::checkCollisionsChildren(linearUpdateContext& ctx, unsigned int cell, unsigned int order) {
+    ctx.stack.clear();
+    ctx.stack.push_back(cell);
+    while (!ctx.stack.empty()) {
+        unsigned int current = ctx.stack.back();
+        ctx.stack.pop_back();
+
+        if (current != cell) {
+            checkCollisionsSelf(ctx, current, order);
+        }
+
+        for (unsigned char flags = nodes[current].activeOctants, i = 0; flags; flags >>= 1, i++) {
+            if (States::isIndexActive(&flags, 0)) {
+                ctx.stack.push_back(nodes[current].children[i]);
+            }
+        }
+    }
+}
+
+/*
+    update stages
+*/
+
+// lifespans, dead and moved objects of nodes in [begin, end)
+void Octree::LinearTree::updateNodes(linearUpdateContext& ctx, unsigned int begin, unsigned int end) {
+    for (unsigned int n = begin; n < end; n++) {
+        if (!nodes[n].code) {
+            // free slot
+            continue;
+        }
+
+        linearNode& current = nodes[n];
+
+        ctx.positions.push_back(current.region.calculateCenter());
+        ctx.sizes.push_back(current.region.calculateDimensions());
+
+        // countdown timer
+        if (current.noObjects == 0) {
+            if (!current.activeOctants) {
+                // ensure no child leaves
+                if (current.currentLifespan == -1) {
+                    // initial check
+                    current.currentLifespan = current.maxLifespan;
+                }
+                else if (current.currentLifespan > 0) {
+                    // decrement
+                    current.currentLifespan--;
+                }
+            }
+        }
+        else {
+            if (current.currentLifespan != -1) {
+                if (current.maxLifespan <= 64) {
+                    // extend lifespan because "hotspot"
+                    current.maxLifespan <<= 2;
+                }
+            }
+        }
+
+        for (unsigned int i = current.firstObject; i != NULL_INDEX; i = links[i].next) {
+            if (States::isActive(&objects[i].instance->state, INSTANCE_DEAD)) {
+                // removed once all threads are done
+                ctx.deadObjects.push_back(i);
+                continue;
+            }
+
+            if (States::isActive(&objects[i].instance->state, INSTANCE_MOVED)) {
+                // if moved switch active, transform region and push to list
+                objects[i].transform();
+                hot[i] = HotRegion(objects[i], i);
+                worldMeshes[i].valid = false;
+                ctx.movedObjects.push_back(i);
+            }
+
+            if (objects[i].collisionMesh && !worldMeshes[i].valid) {
+                // transform collision mesh once for all the pairs it is tested in
+                worldMeshes[i].update(objects[i].collisionMesh, objects[i].instance);
+            }
+
+            ctx.positions.push_back(objects[i].calculateCenter());
+            ctx.sizes.push_back(objects[i].calculateDimensions());
+        }
+    }
+}
+
+// broad phase for moved objects in [begin, end)
+void Octree::LinearTree::findCandidates(linearUpdateContext& ctx, unsigned int begin, unsigned int end) {
+    for (unsigned int order = begin; order < end; order++) {
+        // itself
+        unsigned int cell = links[movedObjects[order]].cell;
+        checkCollisionsSelf(ctx, cell, order);
+
+        // children
+        checkCollisionsChildren(ctx, cell, order);
+
+        // parents
+        for (cell = nodes[cell].parent; cell != NULL_INDEX; cell = nodes[cell].parent) {
+            checkCollisionsSelf(ctx, cell, order);
+        }
+    }
+}
+
+// narrow phase for the pairs in [begin, end)
+void Octree::LinearTree::findCollisions(linearUpdateContext& ctx, unsigned int begin, unsigned int end) {
+    glm::vec3 norm;
+    float toi;
+
+    for (unsigned int i = begin; i < end; i++) {
+        const linearCandidate& c = candidates[i];
+        const BoundingRegion& br = objects[c.br];
+        const BoundingRegion& obj = objects[c.obj];
+
+        if (br.instance->instanceId == obj.instance->instanceId) {
+            // do not test collisions with the same instance
+            continue;
+        }
+
+        toi = 1.0f;
+        unsigned char collisionCase = obj.instance->isSwept() ?
+            testCollisionSwept(br, obj, norm, toi, &worldMeshes[c.br]) :
+            testCollisionPairFine(br, obj, norm, &worldMeshes[c.br], &worldMeshes[c.obj]);
+        if (collisionCase) {
+            ctx.collisions.push_back({ i, c.br, c.obj, norm, toi });
+        }
+    }
+}
+
+// cast up to RAY_PACKET_WIDTH rays together (walks the tree through parent links, without a stack)
+void Octree::LinearTree::castPacket(const Ray* rays, unsigned int noRays, RayHit* hits) {
+    RayPacket packet(rays, noRays);
+
+    // closest hit so far of each lane (padding lanes never hit)
+    float tmin[RAY_PACKET_WIDTH];
+    for (unsigned int i = 0; i < RAY_PACKET_WIDTH; i++) {
+        tmin[i] = std::numeric_limits<float>::max();
+    }
+    for (unsigned int i = 0; i < noRays; i++) {
+        hits[i].instance = nullptr;
+        hits[i].t = tmin[i];
+    }
+
+    unsigned int idx = 0;
+    while (true) {
+        linearNode& current = nodes[idx];
+
+        if (packet.intersectsAABB(current.region.min, current.region.max, tmin)) {
+            // check objects in the node, each ray that enters the object's box is tested on its own
+            for (unsigned int obj = current.firstObject; obj != NULL_INDEX; obj = links[obj].next) {
+                unsigned int mask = packet.intersectsAABB(hot[obj].boxMin(), hot[obj].boxMax(), tmin);
+                for (; mask; mask &= mask - 1) {
+                    unsigned int i = std::countr_zero(mask);
+                    if (rays[i].intersectsObject(objects[obj], tmin[i], hits[i].norm)) {
+                        hits[i].instance = objects[obj].instance;
+                        hits[i].t = tmin[i];
+                    }
+                }
+            }
+
+            // go down to the first active child
+            if (current.activeOctants) {
+                idx = current.children[std::countr_zero(current.activeOctants)];
+                continue;
+            }
+        }
+
+        // go to the next active sibling, or up until a parent has one
+        while (idx != 0) {
+            linearNode& parent = nodes[nodes[idx].parent];
+            unsigned char octant = nodes[idx].code & 0b111;
+            unsigned char later = parent.activeOctants & (unsigned char)(0xff << (octant + 1));
+            if (later) {
+                idx = parent.children[std::countr_zero(later)];
+                break;
+            }
+            idx = nodes[idx].parent;
+        }
+
+        if (idx == 0) {
+            // back at the root
+            break;
+        }
+    }
+}
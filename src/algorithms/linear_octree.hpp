@@ -0,0 +1,351 @@
+#ifndef LINEAR_OCTREE_HPP
+#define LINEAR_OCTREE_HPP
+
+#include <vector>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+#include "octree.hpp"
+#include "jobsystem.hpp"
+#include "../physics/worldmesh.hpp"
+
+// a 64 bit location code holds 3 bits per level plus the depth sentinel bit
+#define MAX_LINEAR_DEPTH 21
+// marks an empty link in the node/object pools
+#define NULL_INDEX 0xffffffff
+// the pools are put back in depth first order once more than 1 / LINEAR_COMPACT_DIVISOR of the objects were relinked
+#define LINEAR_COMPACT_DIVISOR 4
+
+// forward declaration
+class Model;
+class BoundingRegion;
+class Box;
+
+/*
+    linear octree
+    - nodes are kept in one contiguous pool and addressed by their Morton location code
+    - objects are kept in one flat array, each node links to its objects by index
+    - nothing is heap allocated per subdivision once the pools have grown to the scene size
+    - both pools are kept close to depth first order, so walking a subtree reads them front to back
+*/
+
+namespace Octree {
+    /*
+        Morton (location) code utilities
+
+        a location code is the path from the root, 3 bits per level, behind a leading 1 (sentinel)
+            root            = 1
+            child of root   = 1xyz
+            grandchild      = 1xyz xyz
+
+        octant index bits (different order than the Octant enum, so that octants line up with Morton order)
+            0b001 = upper half of x
+            0b010 = upper half of y
+            0b100 = upper half of z
+    */
+
+    // spread the lower 21 bits of v so there are 2 zero bits between each
+    uint64_t mortonSpread(uint64_t v);
+
+    // interleave 3 quantized coordinates into a Morton code
+    uint64_t mortonEncode(uint32_t x, uint32_t y, uint32_t z);
+
+    // depth of a location code (root = 0)
+    unsigned int codeDepth(uint64_t code);
+
+    /*
+        node in the node pool
+    */
+    struct linearNode {
+        // location code (0 if this pool slot is free)
+        uint64_t code;
+        // depth in tree (root = 0)
+        unsigned char depth;
+
+        // pool index of parent (NULL_INDEX for root)
+        unsigned int parent;
+        // pool indices of children (NULL_INDEX if octant not active)
+        unsigned int children[NUM_CHILDREN];
+        // switch for active octants
+        unsigned char activeOctants;
+
+        // maximum possible lifespan
+        short maxLifespan;
+        // current lifespan
+        short currentLifespan;
+
+        // head of list of objects in node (index into object array)
+        unsigned int firstObject;
+        // number of objects in node
+        unsigned int noObjects;
+
+        // region of bounds of cell (AABB)
+        BoundingRegion region;
+    };
+
+    /*
+        links of an object in the flat object array
+    */
+    struct linearLink {
+        // location code of the deepest cell that can contain the object
+        uint64_t code;
+        // pool index of node containing object (NULL_INDEX if slot is free)
+        unsigned int cell;
+        // neighbouring objects in the same node
+        unsigned int prev;
+        unsigned int next;
+        // instance of the object (copied from the region, so culling a node only walks the links)
+        RigidBody* instance;
+    };
+
+    /*
+        collision found during the narrow phase, responded to once all threads are done
+    */
+    struct linearCollision {
+        // position of the pair in the merged list of pairs (merge key)
+        unsigned int candidate;
+        // object that was hit and the moved object (indices into object array)
+        unsigned int br;
+        unsigned int obj;
+        glm::vec3 norm;
+        // fraction of a swept motion before the contact (1 if not swept)
+        float toi;
+    };
+
+    /*
+        pair of objects whose regions overlap (found by the broad phase)
+    */
+    struct linearCandidate {
+        // position of the moved object in the list of moved objects
+        unsigned int order;
+        // object in the tree and the moved object (indices into object array)
+        unsigned int br;
+        unsigned int obj;
+    };
+
+    /*
+        scratch lists for one thread during update
+    */
+    struct linearUpdateContext {
+        std::vector<unsigned int> movedObjects;
+        std::vector<unsigned int> deadObjects;
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> sizes;
+        std::vector<unsigned int> stack;
+        std::vector<linearCandidate> candidates;
+        std::vector<linearCollision> collisions;
+    };
+
+    /*
+        timings (ms) and counts of the last update
+    */
+    struct linearUpdateStats {
+        // lifespans, dead and moved objects, placement of moved objects
+        double updateMs;
+        // pairs of overlapping regions
+        double broadPhaseMs;
+        // exact tests of the pairs
+        double narrowPhaseMs;
+        // responses on the calling thread
+        double responseMs;
+
+        unsigned int noMoved;
+        unsigned int noCandidates;
+        unsigned int noCollisions;
+    };
+
+    /*
+        class to represent the linear octree
+        - mirrors the interface of Octree::node so it can be used as the scene octree
+    */
+    class LinearTree {
+    public:
+        // if tree is ready
+        bool treeReady = false;
+        // if tree is built
+        bool treeBuilt = false;
+
+        // region of bounds of the root (AABB)
+        BoundingRegion region;
+
+        // splits update between threads (nullptr = update on calling thread)
+        JobSystem* jobs = nullptr;
+
+        // timings and counts of the last update
+        linearUpdateStats stats = {};
+
+        /*
+            constructors
+        */
+
+        // initialize with bounds (no objects yet)
+        LinearTree(const BoundingRegion &bounds);
+
+        /*
+            functionality
+        */
+
+        // add instance to pending queue
+        void addToPending(RigidBody* instance, Model *model);
+        void addToPending(RigidBody* instance, const std::vector<BoundingRegion> &regions);
+
+        // build tree (called during initialization)
+        void build();
+
+        // update objects in tree (called during each iteration of main loop)
+        void update(Box &box);
+        // positions and sizes of cells and objects are appended for debug drawing
+        void update(std::vector<glm::vec3> &positions, std::vector<glm::vec3> &sizes);
+
+        // process pending queue
+        void processPending();
+
+        // remove the objects (and queued objects) of instances marked INSTANCE_DEAD
+        // - update does this too, call it before the instances are freed when no update runs in between
+        void removeDead();
+
+        // dynamically insert object into tree (pass an rvalue to avoid a copy)
+        bool insert(BoundingRegion obj);
+
+        // check collisions with a ray
+        BoundingRegion* checkCollisionsRay(Ray r, float& tmin);
+
+        // closest hit of each ray (hits[i] for rays[i])
+        // - rays are cast in packets of RAY_PACKET_WIDTH, packets are split between threads
+        void castRays(std::span<const Ray> rays, std::span<RayHit> hits);
+
+        // add the instances of the objects inside the frustum to visible
+        // - nodes completely inside are accepted with their subtree, the rest are tested with their siblings
+        // - objects in the pending queue (outside the root) are tested on their own
+        // - instances marked INSTANCE_DEAD are not added
+        void cullFrustum(const Frustum& frustum, VisibleInstances& visible, FrustumCullStats* stats = nullptr);
+
+        // destroy object (free memory)
+        void destroy();
+
+        /*
+            accessors
+        */
+
+        // find the pool index of the node with a location code (NULL_INDEX if it does not exist)
+        unsigned int findNode(uint64_t code);
+
+        // number of active nodes
+        unsigned int noNodes() { return nodes.size() - freeNodes.size(); }
+
+        // number of objects in tree
+        unsigned int noObjects() { return objects.size() - freeObjects.size(); }
+
+        // number of objects waiting in the pending queue
+        unsigned int noPending() { return queue.size(); }
+
+    private:
+        // deepest allowed level (nodes are not divided below MIN_BOUNDS)
+        unsigned int maxDepth;
+        // number of finest-level cells per unit along each axis
+        glm::vec3 cellsPerUnit;
+
+        // node pool (index 0 is the root)
+        std::vector<linearNode> nodes;
+        // free slots in node pool
+        std::vector<unsigned int> freeNodes;
+
+        // flat array of objects and their links
+        std::vector<BoundingRegion> objects;
+        std::vector<linearLink> links;
+        // broad phase copy of each object's region (refreshed when it is transformed)
+        std::vector<HotRegion> hot;
+        // world space collision meshes of objects (only for objects with a collision mesh)
+        std::vector<WorldMesh> worldMeshes;
+        // free slots in object array
+        std::vector<unsigned int> freeObjects;
+
+        // queue of objects to be dynamically inserted
+        std::vector<BoundingRegion> queue;
+
+        // objects linked into a node since the pools were last put in depth first order
+        unsigned int noRelinked = 0;
+
+        // scratch lists reused each frame
+        std::vector<unsigned int> movedObjects;
+        std::vector<unsigned int> deadObjects;
+        std::vector<unsigned int> stack;
+        // new pool index of each node and object in compact
+        std::vector<unsigned int> newNodes;
+        std::vector<unsigned int> newObjects;
+        // nodes left in cullFrustum and if they are completely inside
+        std::vector<std::pair<unsigned int, bool>> cullStack;
+        // pairs of all threads in order of moved objects
+        std::vector<linearCandidate> candidates;
+        std::vector<linearCollision> collisions;
+        // one per thread
+        std::vector<linearUpdateContext> contexts;
+
+        /*
+            pool management
+        */
+
+        // take a node from the pool
+        unsigned int allocateNode(uint64_t code, unsigned int parent, glm::vec3 min, glm::vec3 max);
+        // return a leaf to the pool
+        void releaseNode(unsigned int idx);
+        // get child in octant, create if not active
+        unsigned int getOrCreateChild(unsigned int idx, unsigned char octant);
+
+        // take an object slot
+        unsigned int allocateObject(BoundingRegion&& obj);
+        // return an object slot
+        void releaseObject(unsigned int idx);
+
+        // link object into node
+        void link(unsigned int obj, unsigned int cell);
+        // unlink object from its node
+        void unlink(unsigned int obj);
+
+        // put nodes and objects in depth first order, the objects of a node next to each other
+        // - free slots are dropped, so pool indices of nodes and objects change
+        void compact();
+
+        /*
+            placement
+        */
+
+        // location code of the deepest cell that can contain the object (0 if not inside root)
+        uint64_t locate(const HotRegion& obj);
+
+        // push object down to the cell at the location code, dividing leaves on the way
+        void place(unsigned int obj, uint64_t target);
+
+        // move objects of a leaf one level down where they fit
+        void divide(unsigned int idx);
+
+        /*
+            collisions
+        */
+
+        // find objects in node that overlap the moved object
+        void checkCollisionsSelf(linearUpdateContext& ctx, unsigned int cell, unsigned int order);
+
+        // find objects in descendant nodes that overlap the moved object
+        void checkCollisionsChildren(linearUpdateContext& ctx, unsigned int cell, unsigned int order);
+
+        // cast up to RAY_PACKET_WIDTH rays together (walks the tree through parent links, without a stack)
+        void castPacket(const Ray* rays, unsigned int noRays, RayHit* hits);
+
+        /*
+            update stages
+        */
+
+        // lifespans, dead and moved objects of nodes in [begin, end)
+        void updateNodes(linearUpdateContext& ctx, unsigned int begin, unsigned int end);
+
+        // broad phase for moved objects in [begin, end)
+        void findCandidates(linearUpdateContext& ctx, unsigned int begin, unsigned int end);
+
+        // narrow phase for the pairs in [begin, end)
+        void findCollisions(linearUpdateContext& ctx, unsigned int begin, unsigned int end);
+    };
+}
+
+#endif
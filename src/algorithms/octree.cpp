@@ -1,13 +1,14 @@
-#include "octree.h"
-#include "avl.h"
-#include "../graphics/models/box.hpp"
+#include "octree.hpp"
+#include "avl.hpp"
+#include "../physics/worldmesh.hpp"
+#include <algorithm>
 #include <iostream>
 #include <csignal>
 
 //A memory leak occurs somewhere around here, so I put a band-aid on it by using a smart pointer (unique_ptr) for the children array 
 
 // calculate bounds of specified quadrant in bounding region
-void Octree::calculateBounds(BoundingRegion &out, Octant octant, BoundingRegion parentRegion) {
+void Octree::calculateBounds(BoundingRegion &out, Octant octant, const BoundingRegion &parentRegion) {
     // find min and max points of corresponding octant
     
     glm::vec3 center = parentRegion.calculateCenter();
@@ -37,6 +38,174 @@ void Octree::calculateBounds(BoundingRegion &out, Octant octant, BoundingRegion
     }
 }
 
+// test a pair of bounding regions for collision without responding (returns the case that collided, 0 if none)
+unsigned char Octree::testCollisionPair(const BoundingRegion &br, const BoundingRegion &obj, glm::vec3 &norm,
+    const WorldMesh* brMesh, const WorldMesh* objMesh) {
+    // coarse check for bounding region intersection
+    if (!br.intersectsWith(obj)) {
+        return 0;
+    }
+
+    // coarse check passed
+    return testCollisionPairFine(br, obj, norm, brMesh, objMesh);
+}
+
+// fine grain part of testCollisionPair, for callers that already did the coarse check
+unsigned char Octree::testCollisionPairFine(const BoundingRegion &br, const BoundingRegion &obj, glm::vec3 &norm,
+    const WorldMesh* brMesh, const WorldMesh* objMesh) {
+    unsigned int noFacesBr = br.collisionMesh ? br.collisionMesh->faces.size() : 0;
+    unsigned int noFacesObj = obj.collisionMesh ? obj.collisionMesh->faces.size() : 0;
+
+    if (noFacesBr) {
+        if (noFacesObj) {
+            // both have collision meshes
+            if (brMesh && objMesh) {
+                // meshes already in world space, test one face of br against a batch of faces in obj
+                return brMesh->collidesWith(*objMesh, norm) ? 1 : 0;
+            }
+
+            // check all faces in br against all faces in obj
+            for (unsigned int i = 0; i < noFacesBr; i++) {
+                for (unsigned int j = 0; j < noFacesObj; j++) {
+                    if (br.collisionMesh->faces[i].collidesWithFace(
+                        br.instance,
+                        obj.collisionMesh->faces[j],
+                        obj.instance,
+                        norm
+                    )) {
+                        return 1;
+                    }
+                }
+            }
+        }
+        else {
+            // br has a collision mesh, obj does not
+            // check all faces in br against the obj's sphere
+            for (unsigned int i = 0; i < noFacesBr; i++) {
+                if (br.collisionMesh->faces[i].collidesWithSphere(
+                    br.instance,
+                    obj,
+                    norm
+                )) {
+                    return 2;
+                }
+            }
+        }
+    }
+    else {
+        if (noFacesObj) {
+            // obj has a collision mesh, br does not
+            // check all faces in obj against br's sphere
+            for (unsigned int i = 0; i < noFacesObj; i++) {
+                if (obj.collisionMesh->faces[i].collidesWithSphere(
+                    obj.instance,
+                    br,
+                    norm
+                )) {
+                    return 3;
+                }
+            }
+        }
+        else {
+            // neither have a collision mesh
+            // coarse grain test pased (test collision between spheres)
+            norm = obj.center - br.center;
+            return 4;
+        }
+    }
+
+    return 0;
+}
+
+// test the motion of obj's swept instance against br (returns 5 if they collide, 0 if none)
+unsigned char Octree::testCollisionSwept(const BoundingRegion &br, const BoundingRegion &obj, glm::vec3 &norm, float &toi,
+    const WorldMesh* brMesh) {
+    // motion of obj relative to br, tested against br where it ended up
+    glm::vec3 dir = obj.sweep() - br.sweep();
+    glm::vec3 end = obj.calculateCenter();
+    glm::vec3 start = end - dir;
+
+    // obj as a sphere (boxes and meshes by their bounding sphere)
+    float radius = (obj.type == BoundTypes::SPHERE) ? obj.radius : 0.5f * glm::length(obj.max - obj.min);
+
+    toi = 1.0f;
+
+    if (br.collisionMesh) {
+        // faces of br, transformed here if the caller has no world space mesh
+        static thread_local WorldMesh tmpMesh;
+        if (!brMesh || !brMesh->valid) {
+            tmpMesh.update(br.collisionMesh, br.instance);
+            brMesh = &tmpMesh;
+        }
+
+        return brMesh->sweptSphere(start, dir, radius, toi, norm) ? 5 : 0;
+    }
+
+    // ray from the start of the motion against br grown by the radius
+    Ray r(start, dir);
+    float tmin, tmax;
+    if (br.type == BoundTypes::SPHERE) {
+        if (!r.intersectsBoundingRegion(BoundingRegion(br.center, br.radius + radius), tmin, tmax)) {
+            return 0;
+        }
+    }
+    else {
+        if (!r.intersectsBoundingRegion(BoundingRegion(br.min - radius, br.max + radius), tmin, tmax)) {
+            return 0;
+        }
+    }
+
+    if (tmax < 0.0f || tmin > 1.0f) {
+        // contact is before or after this motion
+        return 0;
+    }
+
+    toi = glm::max(tmin, 0.0f);
+
+    // from the closest point of br to the center of obj at the contact
+    glm::vec3 contact = start + toi * dir;
+    norm = contact - ((br.type == BoundTypes::SPHERE) ? br.center : glm::clamp(contact, br.min, br.max));
+    if (norm == glm::vec3(0.0f)) {
+        norm = -dir;
+    }
+
+    return 5;
+}
+
+// respond on obj's instance to a collision found by testCollisionPair or testCollisionSwept
+void Octree::respondToCollision(const BoundingRegion &br, const BoundingRegion &obj, glm::vec3 norm, float toi) {
+    if (toi < 1.0f) {
+        // stop the swept instance where it touched br
+        obj.instance->pos = glm::mix(obj.instance->prevPos, obj.instance->pos, toi);
+        obj.instance->update(0.0f);
+    }
+
+    obj.instance->handleCollision(br.instance, norm);
+}
+
+// test a pair of bounding regions for collision and respond on obj's instance
+void Octree::checkCollisionPair(const BoundingRegion &br, const BoundingRegion &obj) {
+    glm::vec3 norm;
+    float toi = 1.0f;
+    unsigned char collisionCase;
+
+    if (obj.instance->isSwept()) {
+        // coarse check of the boxes around both motions
+        glm::vec3 brMin, brMax, objMin, objMax;
+        br.sweptBounds(brMin, brMax);
+        obj.sweptBounds(objMin, objMax);
+        bool overlap = !(glm::any(glm::lessThan(brMax, objMin)) || glm::any(glm::greaterThan(brMin, objMax)));
+        collisionCase = overlap ? testCollisionSwept(br, obj, norm, toi) : 0;
+    }
+    else {
+        collisionCase = testCollisionPair(br, obj, norm);
+    }
+
+    if (collisionCase) {
+        respondToCollision(br, obj, norm, toi);
+    }
+}
+
 /*
     constructors
 */
@@ -47,16 +216,14 @@ Octree::node::node() : region(BoundTypes::AABB) {
 }
 
 // initialize with bounds (no objects yet)
-Octree::node::node(BoundingRegion bounds) : region(bounds) {
+Octree::node::node(const BoundingRegion &bounds) : region(bounds) {
     parent = nullptr;
 }
 
-// initialize with bounds and list of objects
-Octree::node::node(BoundingRegion bounds, std::vector<BoundingRegion> objectList) : region(bounds) {
+// initialize with bounds and list of objects (both are moved from)
+Octree::node::node(BoundingRegion &&bounds, std::vector<BoundingRegion> &&objectList)
+    : objects(std::move(objectList)), region(std::move(bounds)) {
     parent = nullptr;
-
-    // insert entire list of objects
-    objects.insert(objects.end(), objectList.begin(), objectList.end());
 }
 
 /*
@@ -64,12 +231,12 @@ Octree::node::node(BoundingRegion bounds, std::vector<BoundingRegion> objectList
 */
 
 // add instance to pending queue
-void Octree::node::addToPending(RigidBody* instance, Model *model) {
-    // get all bounding regions of model and put them in queue
-    for (BoundingRegion br : model->boundingRegions) {
-        br.instance = instance;
-        br.transform();
+void Octree::node::addToPending(RigidBody* instance, const std::vector<BoundingRegion> &regions) {
+    // put a copy of each bounding region in queue
+    for (const BoundingRegion &br : regions) {
         queue.push(br);
+        queue.back().instance = instance;
+        queue.back().transform();
     }
 }
 
@@ -107,11 +274,10 @@ void Octree::node::build() {
 
     // determine which octants to place objects in
     for (int i = 0, len = objects.size(); i < len; i++) {
-        BoundingRegion br = objects[i];
         for (int j = 0; j < NUM_CHILDREN; j++) {
-            if (octants[j].containsRegion(br)) {
+            if (octants[j].containsRegion(objects[i])) {
                 // octant contains region
-                octLists[j].push_back(br);
+                octLists[j].push_back(std::move(objects[i]));
                 objects.erase(objects.begin() + i);
 
                 // offset because removed object from list
@@ -126,7 +292,7 @@ void Octree::node::build() {
     for (int i = 0; i < NUM_CHILDREN; i++) {
         if (octLists[i].size() != 0) {
             // if children go into this octant, generate new child
-            children[i] = std::make_unique<node>(octants[i], octLists[i]);
+            children[i] = std::make_unique<node>(std::move(octants[i]), std::move(octLists[i]));
             States::activateIndex(&activeOctants, i); // activate octant
             children[i]->parent = this;
             children[i]->build();
@@ -145,10 +311,10 @@ setVars:
 }
 
 // update objects in tree (called during each iteration of main loop)
-void Octree::node::update(Box &box) {
+void Octree::node::update(std::vector<glm::vec3> &positions, std::vector<glm::vec3> &sizes) {
     if (treeBuilt && treeReady) {
-        box.positions.push_back(region.calculateCenter());
-        box.sizes.push_back(region.calculateDimensions());
+        positions.push_back(region.calculateCenter());
+        sizes.push_back(region.calculateDimensions());
 
         // countdown timer
         if (objects.size() == 0) {
@@ -192,8 +358,8 @@ void Octree::node::update(Box &box) {
                 objects[i].transform();
                 movedObjects.push(i);
             }
-            box.positions.push_back(objects[i].calculateCenter());
-            box.sizes.push_back(objects[i].calculateDimensions());
+            positions.push_back(objects[i].calculateCenter());
+            sizes.push_back(objects[i].calculateDimensions());
         }
 
         // remove dead branches
@@ -224,14 +390,13 @@ void Octree::node::update(Box &box) {
                     // active octant
                     if (children[i] != nullptr) {
                         // child not null
-                        children[i]->update(box);
+                        children[i]->update(positions, sizes);
                     }
                 }
             }
         }
         
         // move moved objects into new nodes
-        BoundingRegion movedObj; // placeholder
         while (movedObjects.size() != 0) {
             /*
                 for each moved object
@@ -239,7 +404,7 @@ void Octree::node::update(Box &box) {
                 - call insert (push object as far down as possible)
             */
 
-            movedObj = objects[movedObjects.top()]; // set to top object in stack
+            BoundingRegion movedObj = std::move(objects[movedObjects.top()]); // take top object in stack
             node* current = this; // placeholder
 
             while (!current->region.containsRegion(movedObj)) {
@@ -260,11 +425,21 @@ void Octree::node::update(Box &box) {
             */
             objects.erase(objects.begin() + movedObjects.top());
             movedObjects.pop();
-            current->queue.push(movedObj);
+            node* destination = current;
 
             // collision detection
-            // itself
             current = movedObj.cell;
+            if (movedObj.instance->isSwept()) {
+                // start from the cell holding the whole motion, so everything along the path is tested
+                glm::vec3 lo, hi;
+                movedObj.sweptBounds(lo, hi);
+                while (current->parent && (glm::any(glm::lessThan(lo, current->region.min)) ||
+                    glm::any(glm::greaterThan(hi, current->region.max)))) {
+                    current = current->parent;
+                }
+            }
+
+            // itself
             current->checkCollisionsSelf(movedObj);
 
             // children
@@ -276,6 +451,9 @@ void Octree::node::update(Box &box) {
                 current->checkCollisionsSelf(movedObj);
                 //std::cout << "Do we actually get in here?" << std::endl;
             }
+
+            // queue once nothing reads it anymore
+            destination->queue.push(std::move(movedObj));
         }
     }
 
@@ -287,28 +465,49 @@ void Octree::node::processPending() {
     if (!treeBuilt) {
         // add objects to be sorted into branches when built
         while (queue.size() != 0) {
-            objects.push_back(queue.front());
+            objects.push_back(std::move(queue.front()));
             queue.pop();
         }
         build();
     }
     else {
         for (int i = 0, len = queue.size(); i < len; i++) {
-            BoundingRegion br = queue.front();
+            BoundingRegion br = std::move(queue.front());
             if (region.containsRegion(br)) {
                 // insert object immediately
-                insert(br);
+                insert(std::move(br));
             }
             else {
                 // return to queue
                 br.transform();
-                queue.push(br);
+                queue.push(std::move(br));
             }
             queue.pop();
         }
     }
 }
 
+// remove the objects (and queued objects) of instances marked INSTANCE_DEAD in this node and its children
+void Octree::node::removeDead() {
+    objects.erase(std::remove_if(objects.begin(), objects.end(), [](const BoundingRegion& br) {
+        return States::isActive(&br.instance->state, INSTANCE_DEAD);
+    }), objects.end());
+
+    for (int i = 0, len = queue.size(); i < len; i++) {
+        if (!States::isActive(&queue.front().instance->state, INSTANCE_DEAD)) {
+            // keep, rotate through the queue
+            queue.push(std::move(queue.front()));
+        }
+        queue.pop();
+    }
+
+    for (unsigned char flags = activeOctants, i = 0; flags; flags >>= 1, i++) {
+        if (States::isIndexActive(&flags, 0) && children[i]) {
+            children[i]->removeDead();
+        }
+    }
+}
+
 // dynamically insert object into node
 bool Octree::node::insert(BoundingRegion obj) {
     /*
@@ -324,29 +523,22 @@ bool Octree::node::insert(BoundingRegion obj) {
         dimensions.z < MIN_BOUNDS
         ) {
         obj.cell = this;
-        objects.push_back(obj);
+        objects.push_back(std::move(obj));
         return true;
     }
 
     // safeguard if object doesn't fit
     if (!region.containsRegion(obj)) {
-        return parent == nullptr ? false : parent->insert(obj);
+        return parent == nullptr ? false : parent->insert(std::move(obj));
     }
 
-    // create regions if not defined
+    // create regions (existing children were created with the same bounds, so they are not copied)
     BoundingRegion octants[NUM_CHILDREN];
     for (int i = 0; i < NUM_CHILDREN; i++) {
-        if (children[i] != nullptr) {
-            // child exists, so take its region
-            octants[i] = children[i]->region;
-        }
-        else {
-            // get region for this octant
-            calculateBounds(octants[i], (Octant)(1 << i), region);
-        }
+        calculateBounds(octants[i], (Octant)(1 << i), region);
     }
 
-    objects.push_back(obj);
+    objects.push_back(std::move(obj));
 
     // determine which octants to put objects in
     std::vector<BoundingRegion> octLists[NUM_CHILDREN]; // array of list of objects in each octant
@@ -354,7 +546,7 @@ bool Octree::node::insert(BoundingRegion obj) {
         objects[i].cell = this;
         for (int j = 0; j < NUM_CHILDREN; j++) {
             if (octants[j].containsRegion(objects[i])) {
-                octLists[j].push_back(objects[i]);
+                octLists[j].push_back(std::move(objects[i]));
                 // remove from objects list
                 objects.erase(objects.begin() + i);
                 i--;
@@ -369,13 +561,13 @@ bool Octree::node::insert(BoundingRegion obj) {
         if (octLists[i].size() != 0) {
             // objects exist in this octant
             if (children[i]) {
-                for (BoundingRegion br : octLists[i]) {
-                    children[i]->insert(br);
+                for (BoundingRegion &br : octLists[i]) {
+                    children[i]->insert(std::move(br));
                 }
             }
             else {
                 // create new node
-                children[i] = std::make_unique<node>(octants[i], octLists[i]);
+                children[i] = std::make_unique<node>(std::move(octants[i]), std::move(octLists[i]));
                 children[i]->parent = this;
                 States::activateIndex(&activeOctants, i);
                 children[i]->build();
@@ -387,109 +579,19 @@ bool Octree::node::insert(BoundingRegion obj) {
 }
 
 // check collisions with all objects in node
-void Octree::node::checkCollisionsSelf(BoundingRegion obj) {
-    for (BoundingRegion br : objects) {
+void Octree::node::checkCollisionsSelf(const BoundingRegion &obj) {
+    for (const BoundingRegion &br : objects) {
         if (br.instance->instanceId == obj.instance->instanceId) {
             // do not test collisions with the same instance
             continue;
         }
 
-        // coarse check for bounding region intersection
-        if (br.intersectsWith(obj)) {
-            // coarse check passed
-
-            unsigned int noFacesBr = br.collisionMesh ? br.collisionMesh->faces.size() : 0;
-            unsigned int noFacesObj = obj.collisionMesh ? obj.collisionMesh->faces.size() : 0;
-
-            glm::vec3 norm;
-
-            if (noFacesBr) {
-                unsigned int noFacesBr = br.collisionMesh->faces.size();
-
-                if (noFacesObj) {
-                    // both have collision meshes
-                    unsigned int noFacesObj = obj.collisionMesh->faces.size();
-
-                    // check all faces in br against all faces in obj
-                    for (unsigned int i = 0; i < noFacesBr; i++) {
-                        for (unsigned int j = 0; j < noFacesObj; j++) {
-                            if (br.collisionMesh->faces[i].collidesWithFace(
-                                br.instance,
-                                obj.collisionMesh->faces[j],
-                                obj.instance,
-                                norm
-                            )) {
-                                std::cout << "Case 1: Instance " << br.instance->instanceId
-                                    << " (" << br.instance->modelId << ") collides with instance "
-                                    << obj.instance->instanceId << " (" << obj.instance->modelId << ")" << std::endl;
-                                
-                                obj.instance->handleCollision(br.instance, norm);
-                                
-                                break;
-                            }
-                        }
-                    }
-                }
-                else {
-                    // br has a collision mesh, obj does not
-                    // check all faces in br against the obj's sphere
-                    for (unsigned int i = 0; i < noFacesBr; i++) {
-                        if (br.collisionMesh->faces[i].collidesWithSphere(
-                            br.instance,
-                            obj,
-                            norm
-                        )) {
-                            std::cout << "Case 2: Instance " << br.instance->instanceId
-                                << " (" << br.instance->modelId << ") collides with instance "
-                                << obj.instance->instanceId << " (" << obj.instance->modelId << ")" << std::endl;
-                            
-                            obj.instance->handleCollision(br.instance, norm);
-                            
-                            break;
-                        }
-                    }
-                }
-            }
-            else {
-                if (noFacesObj) {
-                    // obj has a collision mesh, br does not
-                    // check all faces in obj against br's sphere
-                    unsigned int noFacesObj = obj.collisionMesh->faces.size();
-
-                    for (int i = 0; i < noFacesObj; i++) {
-                        if (obj.collisionMesh->faces[i].collidesWithSphere(
-                            obj.instance,
-                            br,
-                            norm
-                        )) {
-                            std::cout << "Case 3: Instance " << br.instance->instanceId
-                                << " (" << br.instance->modelId << ") collides with instance "
-                                << obj.instance->instanceId << " (" << obj.instance->modelId << ")" << std::endl;
-                            
-                            obj.instance->handleCollision(br.instance, norm);
-
-                            break;
-                        }
-                    }
-                }
-                else {
-                    // neither have a collision mesh
-                    // coarse grain test pased (test collision between spheres)
-                    std::cout << "Case 4: Instance " << br.instance->instanceId
-                        << " (" << br.instance->modelId << ") collides with instance "
-                        << obj.instance->instanceId << " (" << obj.instance->modelId << ")" << std::endl;
-                
-                    norm = obj.center - br.center;
-
-                    obj.instance->handleCollision(br.instance, norm);
-                }
-            }
-        }
+        checkCollisionPair(br, obj);
     }
 }
 
 // check collisions with all objects in child nodes
-void Octree::node::checkCollisionsChildren(BoundingRegion obj) {
+void Octree::node::checkCollisionsChildren(const BoundingRegion &obj) {
     if (children) {
         for (int flags = activeOctants, i = 0;
             flags > 0;
@@ -504,71 +606,158 @@ void Octree::node::checkCollisionsChildren(BoundingRegion obj) {
 
 // check collisions with a ray
 BoundingRegion* Octree::node::checkCollisionsRay(Ray r, float& tmin) {
+    glm::vec3 norm;
+    return castRay(r, tmin, norm);
+}
+
+// closest hit of a ray in this node and its children (only hits closer than tmin are taken)
+BoundingRegion* Octree::node::castRay(const Ray &r, float& tmin, glm::vec3& norm) {
     float tmin_tmp = std::numeric_limits<float>::max();
     float tmax_tmp = std::numeric_limits<float>::lowest();
-    float t_tmp = std::numeric_limits<float>::max();
 
     // check current region
-    if (r.intersectsBoundingRegion(region, tmin_tmp, tmax_tmp)) {
-        // know ray collides with the current region
-        if (tmin_tmp >= tmin) {
-            // found nearer collision
-            return nullptr;
-        }
+    if (!r.intersectsBoundingRegion(region, tmin_tmp, tmax_tmp) || tmin_tmp >= tmin) {
+        // missed or found nearer collision
+        return nullptr;
+    }
 
-        BoundingRegion* ret = nullptr, * ret_tmp = nullptr;
+    BoundingRegion* ret = nullptr, * ret_tmp = nullptr;
 
-        // check objects in the node
-        for (BoundingRegion& br : this->objects) {
-            tmin_tmp = std::numeric_limits<float>::max();
-            tmax_tmp = std::numeric_limits<float>::lowest();
+    // check objects in the node
+    for (BoundingRegion& br : this->objects) {
+        if (r.intersectsObject(br, tmin, norm)) {
+            ret = &br;
+        }
+    }
 
-            // coarse check - check against BR
-            if (r.intersectsBoundingRegion(br, tmin_tmp, tmax_tmp)) {
-                std::cout << "Passed coarse check, ";
-                if (tmin_tmp > tmin) {
-                    continue;
-                }
-                else if (br.collisionMesh) {
-                    // fine grain check with collision mesh
-                    t_tmp = std::numeric_limits<float>::max();
-                    if (r.intersectsMesh(br.collisionMesh, br.instance, t_tmp)) {
-                        if (t_tmp < tmin) {
-                            // found closer collision
-                            tmin = t_tmp;
-                            ret = &br;
-                        }
-                    }
-                }
-                else {
-                    // rely on coarse check
-                    if (tmin_tmp < tmin) {
-                        tmin = tmin_tmp;
-                        ret = &br;
-                    }
-                }
+    // check children
+    if (children) {
+        for (unsigned char flags = activeOctants, i = 0;
+            flags;
+            flags >>= 1, i++) {
+            if (!States::isIndexActive(&flags, 0) || !children[i]) {
+                continue;
             }
-            else {
-                std::cout << "Failed coarse check, ";
+
+            ret_tmp = children[i]->castRay(r, tmin, norm);
+            if (ret_tmp) {
+                ret = ret_tmp;
             }
         }
+    }
+
+    return ret;
+}
+
+// closest hit of each ray (hits[i] for rays[i])
+void Octree::node::castRays(std::span<const Ray> rays, std::span<RayHit> hits) {
+    for (unsigned int i = 0; i < rays.size(); i++) {
+        hits[i].t = std::numeric_limits<float>::max();
+        BoundingRegion* br = castRay(rays[i], hits[i].t, hits[i].norm);
+        hits[i].instance = br ? br->instance : nullptr;
+    }
+}
+
+// add the instances of the objects inside the frustum to visible (call on the root)
+// - objects in the pending queue are tested too, so instances outside the root are not culled
+void Octree::node::cullFrustum(const Frustum& frustum, VisibleInstances& visible, FrustumCullStats* stats) {
+    FrustumCullStats counts = {};
+
+    // root is tested alone, other nodes are tested together with their siblings
+    BoxPacket packet;
+    packet.add(region.min, region.max);
+    unsigned int insideMask;
+    if (frustum.testBoxes(packet, insideMask)) {
+        cullNode(frustum, visible, insideMask != 0, counts);
+    }
+
+    // objects waiting in the queue are not in the tree yet (or are outside the root), test them on their own
+    packet.noBoxes = 0;
+    RigidBody* instances[BOX_PACKET_WIDTH];
+    for (int i = 0, len = queue.size(); i < len; i++) {
+        glm::vec3 lo, hi;
+        queue.front().sweptBounds(lo, hi);
+        instances[packet.noBoxes] = queue.front().instance;
+        packet.add(lo, hi);
+        if (packet.isFull()) {
+            cullPacket(frustum, packet, instances, visible, counts);
+        }
 
-        // check children
-        if (children) {
-            for (unsigned char flags = activeOctants, i = 0;
-                flags;
-                flags >>= 1, i++) {
-                ret_tmp = children[i]->checkCollisionsRay(r, tmin);
-                if (ret_tmp) {
-                    ret = ret_tmp;
-                }
+        // rotate through the queue
+        queue.push(std::move(queue.front()));
+        queue.pop();
+    }
+    if (packet.noBoxes) {
+        cullPacket(frustum, packet, instances, visible, counts);
+    }
+
+    // instances are only read once the tree was walked
+    visible.addFound();
+
+    if (stats) {
+        *stats = counts;
+    }
+}
+
+// cull objects and children of a node whose region is visible (inside = region is completely inside)
+void Octree::node::cullNode(const Frustum& frustum, VisibleInstances& visible, bool inside, FrustumCullStats& stats) {
+    stats.noNodesVisited++;
+
+    if (inside) {
+        // whole subtree is visible, accept objects without testing them
+        stats.noNodesInside++;
+        for (BoundingRegion& br : objects) {
+            visible.found.push_back(br.instance);
+        }
+        stats.noObjectsAccepted += objects.size();
+
+        for (unsigned char flags = activeOctants, i = 0; flags; flags >>= 1, i++) {
+            if (States::isIndexActive(&flags, 0) && children[i]) {
+                children[i]->cullNode(frustum, visible, true, stats);
             }
         }
+        return;
+    }
+
+    // test objects in packets
+    BoxPacket packet;
+    RigidBody* instances[BOX_PACKET_WIDTH];
+    for (BoundingRegion& br : objects) {
+        instances[packet.noBoxes] = br.instance;
+        if (br.type == BoundTypes::AABB) {
+            packet.add(br.min, br.max);
+        }
+        else {
+            packet.add(br.center - glm::vec3(br.radius), br.center + glm::vec3(br.radius));
+        }
 
-        return ret;
+        if (packet.isFull()) {
+            cullPacket(frustum, packet, instances, visible, stats);
+        }
+    }
+    if (packet.noBoxes) {
+        cullPacket(frustum, packet, instances, visible, stats);
+    }
+
+    // test children together (at most 8, one packet)
+    node* active[NUM_CHILDREN];
+    for (unsigned char flags = activeOctants, i = 0; flags; flags >>= 1, i++) {
+        if (States::isIndexActive(&flags, 0) && children[i]) {
+            active[packet.noBoxes] = children[i].get();
+            packet.add(children[i]->region.min, children[i]->region.max);
+        }
+    }
+    if (!packet.noBoxes) {
+        return;
     }
 
-    return nullptr;
+    unsigned int insideMask;
+    unsigned int mask = frustum.testBoxes(packet, insideMask);
+    for (unsigned int i = 0; i < packet.noBoxes; i++) {
+        if (mask & (1u << i)) {
+            active[i]->cullNode(frustum, visible, (insideMask >> i) & 1, stats);
+        }
+    }
 }
 
 // destroy object (free memory)
@@ -8,16 +8,17 @@
 #include <queue>
 #include <stack>
 #include <memory>
+#include <span>
 
 #include "list.hpp"
 #include "states.hpp"
-#include "bounds.h"
-#include "ray.h"
-
-#include "../graphics/model.hpp"
+#include "bounds.hpp"
+#include "ray.hpp"
+#include "culling.hpp"
 
 // forward declaration
 class Model;
+class WorldMesh;
 class BoundingRegion;
 class Box;
 
@@ -46,7 +47,28 @@ namespace Octree {
     */
 
     // calculate bounds of specified quadrant in bounding region
-    void calculateBounds(BoundingRegion &out, Octant octant, BoundingRegion parentRegion);
+    void calculateBounds(BoundingRegion &out, Octant octant, const BoundingRegion &parentRegion);
+
+    // test a pair of bounding regions for collision without responding (returns the case that collided, 0 if none)
+    // - if both world space meshes are given, mesh against mesh is tested in batches
+    unsigned char testCollisionPair(const BoundingRegion &br, const BoundingRegion &obj, glm::vec3 &norm,
+        const WorldMesh* brMesh = nullptr, const WorldMesh* objMesh = nullptr);
+
+    // fine grain part of testCollisionPair, for callers that already did the coarse check
+    unsigned char testCollisionPairFine(const BoundingRegion &br, const BoundingRegion &obj, glm::vec3 &norm,
+        const WorldMesh* brMesh = nullptr, const WorldMesh* objMesh = nullptr);
+
+    // test the motion of obj's swept instance against br (returns 5 if they collide, 0 if none)
+    // - obj is tested as its bounding sphere, toi = fraction of the motion before the contact
+    unsigned char testCollisionSwept(const BoundingRegion &br, const BoundingRegion &obj, glm::vec3 &norm, float &toi,
+        const WorldMesh* brMesh = nullptr);
+
+    // respond on obj's instance to a collision found by testCollisionPair or testCollisionSwept
+    // - swept instances are moved back to the time of impact
+    void respondToCollision(const BoundingRegion &br, const BoundingRegion &obj, glm::vec3 norm, float toi = 1.0f);
+
+    // test a pair of bounding regions for collision and respond on obj's instance
+    void checkCollisionPair(const BoundingRegion &br, const BoundingRegion &obj);
 
     /*
         class to represent each node in the octree
@@ -90,10 +112,10 @@ namespace Octree {
         node();
         
         // initialize with bounds (no objects yet)
-        node(BoundingRegion bounds);
+        node(const BoundingRegion &bounds);
 
-        // initialize with bounds and list of objects
-        node(BoundingRegion bounds, std::vector<BoundingRegion> objectList);
+        // initialize with bounds and list of objects (both are moved from)
+        node(BoundingRegion &&bounds, std::vector<BoundingRegion> &&objectList);
 
         /*
             functionality
@@ -101,28 +123,48 @@ namespace Octree {
 
         // add instance to pending queue
         void addToPending(RigidBody* instance, Model *model);
+        void addToPending(RigidBody* instance, const std::vector<BoundingRegion> &regions);
 
         // build tree (called during initialization)
         void build();
 
         // update objects in tree (called during each iteration of main loop)
         void update(Box &box);
+        // positions and sizes of cells and objects are appended for debug drawing
+        void update(std::vector<glm::vec3> &positions, std::vector<glm::vec3> &sizes);
 
         // process pending queue
         void processPending();
 
-        // dynamically insert object into node
+        // remove the objects (and queued objects) of instances marked INSTANCE_DEAD in this node and its children
+        // - update does this too, call it before the instances are freed when no update runs in between
+        void removeDead();
+
+        // dynamically insert object into node (pass an rvalue to avoid a copy)
         bool insert(BoundingRegion obj);
 
         // check collisions with all objects in node
-        void checkCollisionsSelf(BoundingRegion obj);
+        void checkCollisionsSelf(const BoundingRegion &obj);
 
         // check collisions with all objects in child nodes
-        void checkCollisionsChildren(BoundingRegion obj);
+        void checkCollisionsChildren(const BoundingRegion &obj);
 
         // check collisions with a ray
         BoundingRegion* checkCollisionsRay(Ray r, float& tmin);
 
+        // closest hit of a ray in this node and its children (only hits closer than tmin are taken)
+        BoundingRegion* castRay(const Ray &r, float& tmin, glm::vec3& norm);
+
+        // closest hit of each ray (hits[i] for rays[i])
+        void castRays(std::span<const Ray> rays, std::span<RayHit> hits);
+
+        // add the instances of the objects inside the frustum to visible (call on the root)
+        // - instances marked INSTANCE_DEAD are not added
+        void cullFrustum(const Frustum& frustum, VisibleInstances& visible, FrustumCullStats* stats = nullptr);
+
+        // cull objects and children of a node whose region is visible (inside = region is completely inside)
+        void cullNode(const Frustum& frustum, VisibleInstances& visible, bool inside, FrustumCullStats& stats);
+
         // destroy object (free memory)
         void destroy();
     };
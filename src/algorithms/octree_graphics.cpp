@@ -0,0 +1,29 @@
+#include "octree.hpp"
+#include "linear_octree.hpp"
+#include "../graphics/model.hpp"
+#include "../graphics/models/box.hpp"
+
+/*
+    overloads that take graphics types
+    - kept apart so the octrees can be built without the renderer
+*/
+
+// add instance to pending queue
+void Octree::node::addToPending(RigidBody* instance, Model *model) {
+    addToPending(instance, model->boundingRegions);
+}
+
+// update objects in tree (called during each iteration of main loop)
+void Octree::node::update(Box &box) {
+    update(box.positions, box.sizes);
+}
+
+// add instance to pending queue
+void Octree::LinearTree::addToPending(RigidBody* instance, Model *model) {
+    addToPending(instance, model->boundingRegions);
+}
+
+// update objects in tree (called during each iteration of main loop)
+void Octree::LinearTree::update(Box &box) {
+    update(box.positions, box.sizes);
+}
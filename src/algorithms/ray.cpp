@@ -1,8 +1,13 @@
 #include "ray.hpp"
 
 #include "../algorithms/math/linalg.hpp"
+#include <cmath>
 #include <limits>
 
+#if RAY_PACKET_WIDTH > 1
+#include <immintrin.h>
+#endif
+
 Ray::Ray(glm::vec3 origin, glm::vec3 dir)
 	: origin(origin), dir(dir), invdir(1.0f) {
 	for (int i = 0; i < 3; i++) {
@@ -10,7 +15,7 @@ Ray::Ray(glm::vec3 origin, glm::vec3 dir)
 	}
 }
 
-bool Ray::intersectsBoundingRegion(BoundingRegion br, float& tmin, float& tmax) {
+bool Ray::intersectsBoundingRegion(const BoundingRegion& br, float& tmin, float& tmax) const {
 	if (br.type == BoundTypes::AABB) {
 		// slab algorithm
 		tmin = std::numeric_limits<float>::lowest(); // maxOfMin
@@ -50,11 +55,32 @@ bool Ray::intersectsBoundingRegion(BoundingRegion br, float& tmin, float& tmax)
 		tmax = (-b + D) / (2.0f * a);
 		tmin = (-b - D) / (2.0f * a);
 
-		return true;
+		// sphere is not behind the origin
+		return tmax >= 0.0f;
 	}
 }
 
-bool Ray::intersectsMesh(CollisionMesh* mesh, RigidBody* rb, float& t) {
+bool Ray::intersectsMesh(CollisionMesh* mesh, RigidBody* rb, float& t, glm::vec3* hitNorm) const {
+	if (!mesh->bvh.nodes.empty()) {
+		// bring ray into model space instead of transforming every face, t is the same in both spaces
+		glm::mat4 inv = glm::inverse(rb->model);
+		glm::vec3 localOrigin = glm::vec3(inv * glm::vec4(origin, 1.0f));
+		glm::vec3 localDir = glm::vec3(inv * glm::vec4(dir, 0.0f));
+
+		unsigned int face;
+		if (!mesh->bvh.intersectsRay(localOrigin, localDir, mesh->points, mesh->faces, t, &face)) {
+			return false;
+		}
+
+		if (hitNorm) {
+			*hitNorm = glm::normalize(rb->normalModel * mesh->faces[face].norm);
+			if (glm::dot(*hitNorm, dir) > 0.0f) {
+				*hitNorm = -*hitNorm;
+			}
+		}
+		return true;
+	}
+
 	bool intersects = false;
 
 	for (Face& f : mesh->faces) {
@@ -82,10 +108,143 @@ bool Ray::intersectsMesh(CollisionMesh* mesh, RigidBody* rb, float& t) {
 
 			if (faceContainsPoint(P2, P3, norm, intersection)) {
 				intersects = true;
-				t = fminf(t, tmp);
+				t = tmp;
+				if (hitNorm) {
+					*hitNorm = glm::normalize(glm::dot(norm, dir) > 0.0f ? -norm : norm);
+				}
 			}
 		}
 	}
 
 	return intersects;
-}
\ No newline at end of file
+}
+
+bool Ray::intersectsObject(const BoundingRegion& br, float& t, glm::vec3& norm) const {
+	float tmin = std::numeric_limits<float>::max();
+	float tmax = std::numeric_limits<float>::lowest();
+
+	// coarse check - check against BR
+	if (!intersectsBoundingRegion(br, tmin, tmax) || tmin > t) {
+		return false;
+	}
+
+	if (br.collisionMesh) {
+		// fine grain check with collision mesh
+		float tMesh = t;
+		if (intersectsMesh(br.collisionMesh, br.instance, tMesh, &norm)) {
+			t = tMesh;
+			return true;
+		}
+		return false;
+	}
+
+	// rely on coarse check
+	if (tmin >= t) {
+		return false;
+	}
+	t = tmin;
+
+	glm::vec3 point = origin + t * dir;
+	if (br.type == BoundTypes::AABB) {
+		// axis of the face the point is closest to
+		glm::vec3 center = (br.min + br.max) / 2.0f;
+		glm::vec3 halfExtents = glm::max((br.max - br.min) / 2.0f, glm::vec3(std::numeric_limits<float>::min()));
+		glm::vec3 rel = (point - center) / halfExtents;
+		int axis = 0;
+		for (int i = 1; i < 3; i++) {
+			if (fabsf(rel[i]) > fabsf(rel[axis])) {
+				axis = i;
+			}
+		}
+		norm = glm::vec3(0.0f);
+		norm[axis] = rel[axis] < 0.0f ? -1.0f : 1.0f;
+	}
+	else {
+		norm = point - br.center;
+	}
+
+	if (t < 0.0f || norm == glm::vec3(0.0f)) {
+		// origin inside the region
+		norm = -dir;
+	}
+	norm = glm::normalize(norm);
+
+	return true;
+}
+
+/*
+	ray packets
+*/
+
+RayPacket::RayPacket(const Ray* rays, unsigned int noRays)
+	: noRays(noRays), activeMask((1u << noRays) - 1) {
+	for (unsigned int i = 0; i < RAY_PACKET_WIDTH; i++) {
+		// padding lanes repeat the first ray and are masked out
+		const Ray& r = rays[i < noRays ? i : 0];
+		for (int a = 0; a < 3; a++) {
+			origin[a][i] = r.origin[a];
+			invdir[a][i] = r.invdir[a];
+		}
+	}
+}
+
+#if RAY_PACKET_WIDTH == 8
+typedef __m256 packType;
+#define packLoad _mm256_loadu_ps
+#define packSet1 _mm256_set1_ps
+#define packSub _mm256_sub_ps
+#define packMul _mm256_mul_ps
+#define packMin _mm256_min_ps
+#define packMax _mm256_max_ps
+#define packLessEqual(a, b) _mm256_cmp_ps(a, b, _CMP_LE_OQ)
+#define packLess(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define packAnd _mm256_and_ps
+#define packMask _mm256_movemask_ps
+#elif RAY_PACKET_WIDTH == 4
+typedef __m128 packType;
+#define packLoad _mm_loadu_ps
+#define packSet1 _mm_set1_ps
+#define packSub _mm_sub_ps
+#define packMul _mm_mul_ps
+#define packMin _mm_min_ps
+#define packMax _mm_max_ps
+#define packLessEqual _mm_cmple_ps
+#define packLess _mm_cmplt_ps
+#define packAnd _mm_and_ps
+#define packMask _mm_movemask_ps
+#endif
+
+unsigned int RayPacket::intersectsAABB(glm::vec3 min, glm::vec3 max, const float* tmax) const {
+#if RAY_PACKET_WIDTH > 1
+	// slab algorithm on all lanes, NaN (ray in a slab plane) leaves the running interval unchanged
+	// - tNear is negative if the origin is inside the box (same as intersectsBoundingRegion)
+	packType tNear = packSet1(std::numeric_limits<float>::lowest());
+	packType tFar = packSet1(std::numeric_limits<float>::max());
+	for (int a = 0; a < 3; a++) {
+		packType o = packLoad(origin[a]);
+		packType inv = packLoad(invdir[a]);
+		packType t1 = packMul(packSub(packSet1(min[a]), o), inv);
+		packType t2 = packMul(packSub(packSet1(max[a]), o), inv);
+
+		tNear = packMax(packMin(t1, t2), tNear);
+		tFar = packMin(packMax(t1, t2), tFar);
+	}
+
+	// enters before it leaves, leaves in front of the origin, enters before its closest hit so far
+	packType zero = packSet1(0.0f);
+	packType hits = packAnd(packAnd(packLessEqual(tNear, tFar), packLessEqual(zero, tFar)), packLess(tNear, packLoad(tmax)));
+	return (unsigned int)packMask(hits) & activeMask;
+#else
+	float tNear = std::numeric_limits<float>::lowest();
+	float tFar = std::numeric_limits<float>::max();
+	for (int a = 0; a < 3; a++) {
+		float t1 = (min[a] - origin[a][0]) * invdir[a][0];
+		float t2 = (max[a] - origin[a][0]) * invdir[a][0];
+
+		tNear = std::fmaxf(tNear, std::fminf(t1, t2));
+		tFar = std::fminf(tFar, std::fmaxf(t1, t2));
+	}
+
+	return (tNear <= tFar && tFar >= 0.0f && tNear < tmax[0]) ? activeMask : 0;
+#endif
+}
@@ -1,9 +1,26 @@
+#ifndef RAY_HPP
+#define RAY_HPP
+
 #include <glm/glm.hpp>
 
 #include "bounds.hpp"
 #include "../physics/collisionmesh.hpp"
 #include "../physics/rigidbody.hpp"
 
+/*
+	SIMD width of the ray packets
+	- AVX: 8 rays against a box at a time
+	- SSE: 4 rays against a box at a time
+	- scalar fallback otherwise (or with COLLISION_SCALAR defined)
+*/
+#if defined(__AVX__) && !defined(COLLISION_SCALAR)
+#define RAY_PACKET_WIDTH 8
+#elif (defined(__SSE__) || defined(_M_X64)) && !defined(COLLISION_SCALAR)
+#define RAY_PACKET_WIDTH 4
+#else
+#define RAY_PACKET_WIDTH 1
+#endif
+
 class Ray {
 public:
 	glm::vec3 origin;
@@ -12,6 +29,46 @@ public:
 
 	Ray(glm::vec3 origin, glm::vec3 dir);
 
-	bool intersectsBoundingRegion(BoundingRegion br, float &tmin, float &tmax);
-	bool intersectsMesh(CollisionMesh* mesh, RigidBody* rb, float &t);
+	bool intersectsBoundingRegion(const BoundingRegion& br, float &tmin, float &tmax) const;
+	// normal of the hit face is written to norm if given (facing the ray)
+	bool intersectsMesh(CollisionMesh* mesh, RigidBody* rb, float &t, glm::vec3* norm = nullptr) const;
+
+	// closest hit on an object in an octree (region, then its collision mesh if it has one)
+	// - only hits closer than t are taken, t and norm are set on a hit
+	bool intersectsObject(const BoundingRegion& br, float &t, glm::vec3 &norm) const;
+};
+
+/*
+	hit of a ray cast in a batch
+*/
+typedef struct RayHit {
+	// instance hit (nullptr if the ray missed)
+	RigidBody* instance;
+	// distance along the ray (in units of its direction)
+	float t;
+	// surface normal at the hit (facing the ray)
+	glm::vec3 norm;
+} RayHit;
+
+/*
+	up to RAY_PACKET_WIDTH rays in SoA (structure of arrays) form
+	- tested against a box together, so a batch walks the octree once per packet instead of once per ray
+*/
+
+class RayPacket {
+public:
+	// number of rays in packet (rest of the lanes are padding)
+	unsigned int noRays;
+	// mask of the lanes that hold rays
+	unsigned int activeMask;
+
+	float origin[3][RAY_PACKET_WIDTH];
+	float invdir[3][RAY_PACKET_WIDTH];
+
+	RayPacket(const Ray* rays, unsigned int noRays);
+
+	// mask of rays that enter the box closer than their tmax
+	unsigned int intersectsAABB(glm::vec3 min, glm::vec3 max, const float* tmax) const;
 };
+
+#endif
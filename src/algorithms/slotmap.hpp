@@ -0,0 +1,136 @@
+#ifndef SLOTMAP_HPP
+#define SLOTMAP_HPP
+
+#include <vector>
+#include <cstdint>
+
+// handle that never refers to an element
+#define NULL_SLOT_HANDLE 0xffffffffffffffffULL
+
+/*
+    slot map
+    - elements are kept densely packed (removal swaps the last element into the hole)
+    - elements are addressed by a handle: slot index (bits 0-31) + generation of the slot (bits 32-47)
+      + a tag given on insertion (bits 48-63, not checked)
+    - a slot's generation is increased when its element is removed, so stale handles are rejected
+      (16 bit generations wrap after 65536 reuses of one slot)
+    - insert, lookup and removal are O(1)
+*/
+
+template <typename T>
+class SlotMap {
+public:
+    /*
+        functionality
+    */
+
+    // insert element, returns its handle
+    uint64_t insert(T element, uint16_t tag = 0) {
+        uint32_t slot;
+        if (freeSlots.empty()) {
+            slot = slots.size();
+            slots.push_back({ 0, 0, 0 });
+        }
+        else {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+
+        slots[slot].denseIdx = dense.size();
+        slots[slot].tag = tag;
+        dense.push_back(element);
+        denseSlots.push_back(slot);
+
+        return makeHandle(slot, slots[slot].generation, tag);
+    }
+
+    // remove element, returns false if the handle is stale
+    bool erase(uint64_t handle) {
+        if (!contains(handle)) {
+            return false;
+        }
+
+        uint32_t slot = slotOf(handle);
+        uint32_t idx = slots[slot].denseIdx;
+
+        // move last element into the hole
+        uint32_t last = dense.size() - 1;
+        if (idx != last) {
+            dense[idx] = std::move(dense[last]);
+            denseSlots[idx] = denseSlots[last];
+            slots[denseSlots[idx]].denseIdx = idx;
+        }
+        dense.pop_back();
+        denseSlots.pop_back();
+
+        // invalidate handles to the slot
+        slots[slot].generation++;
+        freeSlots.push_back(slot);
+        return true;
+    }
+
+    // clear all elements (invalidates all handles)
+    void clear() {
+        for (uint32_t slot : denseSlots) {
+            slots[slot].generation++;
+            freeSlots.push_back(slot);
+        }
+        dense.clear();
+        denseSlots.clear();
+    }
+
+    /*
+        accessors
+    */
+
+    // if handle refers to an element
+    bool contains(uint64_t handle) const {
+        uint32_t slot = slotOf(handle);
+        return slot < slots.size() && slots[slot].generation == generationOf(handle);
+    }
+
+    // element with handle (nullptr if the handle is stale)
+    T* get(uint64_t handle) {
+        return contains(handle) ? &dense[slots[slotOf(handle)].denseIdx] : nullptr;
+    }
+
+    // number of elements
+    unsigned int size() const { return dense.size(); }
+
+    // densely packed elements (order changes on removal)
+    std::vector<T>& values() { return dense; }
+
+    // handle of the element at a dense index
+    uint64_t handleAt(unsigned int idx) const {
+        uint32_t slot = denseSlots[idx];
+        return makeHandle(slot, slots[slot].generation, slots[slot].tag);
+    }
+
+    // parts of a handle
+    static uint32_t slotOf(uint64_t handle) { return (uint32_t)handle; }
+    static uint16_t generationOf(uint64_t handle) { return (uint16_t)(handle >> 32); }
+    static uint16_t tagOf(uint64_t handle) { return (uint16_t)(handle >> 48); }
+    static uint64_t makeHandle(uint32_t slot, uint16_t generation, uint16_t tag = 0) {
+        return ((uint64_t)tag << 48) | ((uint64_t)generation << 32) | slot;
+    }
+
+private:
+    struct slotEntry {
+        // index of the element in the dense array
+        uint32_t denseIdx;
+        // increased each time the slot is freed
+        uint16_t generation;
+        // tag of the element in the slot
+        uint16_t tag;
+    };
+
+    std::vector<slotEntry> slots;
+    // freed slots (reused before new slots are added)
+    std::vector<uint32_t> freeSlots;
+
+    // elements and the slot of each
+    std::vector<T> dense;
+    std::vector<uint32_t> denseSlots;
+};
+
+#endif
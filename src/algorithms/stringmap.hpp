@@ -0,0 +1,152 @@
+#ifndef STRINGMAP_HPP
+#define STRINGMAP_HPP
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+/*
+    string map
+    - open addressing hash map with string keys (linear probing, power of two capacity)
+    - each key is interned once in the map, the hash is stored next to it so probes rarely compare strings
+    - removal shifts the following entries back, so there are no tombstones
+*/
+
+template <typename T>
+class StringMap {
+public:
+    /*
+        functionality
+    */
+
+    // insert element (replaces the element of an existing key), returns false if the key existed
+    bool insert(std::string_view key, T element) {
+        if ((noEntries + 1) * 4 > entries.size() * 3) {
+            // keep load factor below 3/4
+            rehash(entries.empty() ? 16 : entries.size() * 2);
+        }
+
+        uint64_t h = hash(key);
+        for (uint64_t i = h & mask();; i = (i + 1) & mask()) {
+            entry& e = entries[i];
+            if (!e.used) {
+                e = { h, std::string(key), element, true };
+                noEntries++;
+                return true;
+            }
+            if (e.hash == h && e.key == key) {
+                e.val = element;
+                return false;
+            }
+        }
+    }
+
+    // remove key, returns false if it does not exist
+    bool erase(std::string_view key) {
+        int64_t i = find(key);
+        if (i < 0) {
+            return false;
+        }
+
+        // shift following entries of the cluster back into the hole if their probe passes over it
+        uint64_t hole = i;
+        for (uint64_t j = (hole + 1) & mask(); entries[j].used; j = (j + 1) & mask()) {
+            uint64_t home = entries[j].hash & mask();
+            if (((j - home) & mask()) >= ((j - hole) & mask())) {
+                entries[hole] = std::move(entries[j]);
+                hole = j;
+            }
+        }
+        entries[hole] = entry();
+        noEntries--;
+        return true;
+    }
+
+    // remove all keys
+    void clear() {
+        entries.clear();
+        noEntries = 0;
+    }
+
+    /*
+        accessors
+    */
+
+    // element with key (nullptr if it does not exist)
+    T* get(std::string_view key) {
+        int64_t i = find(key);
+        return i < 0 ? nullptr : &entries[i].val;
+    }
+
+    // if key exists
+    bool contains(std::string_view key) { return find(key) >= 0; }
+
+    // number of keys
+    unsigned int size() const { return noEntries; }
+
+    // send each element to the callback
+    template <typename F>
+    void traverse(F itemViewer) {
+        for (entry& e : entries) {
+            if (e.used) {
+                itemViewer(e.val);
+            }
+        }
+    }
+
+    // FNV-1a
+    static uint64_t hash(std::string_view key) {
+        uint64_t h = 14695981039346656037ULL;
+        for (char c : key) {
+            h ^= (unsigned char)c;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+private:
+    struct entry {
+        uint64_t hash = 0;
+        std::string key;
+        T val = T();
+        bool used = false;
+    };
+
+    std::vector<entry> entries;
+    unsigned int noEntries = 0;
+
+    uint64_t mask() const { return entries.size() - 1; }
+
+    // index of the entry with key (-1 if it does not exist)
+    int64_t find(std::string_view key) const {
+        if (entries.empty()) {
+            return -1;
+        }
+
+        uint64_t h = hash(key);
+        for (uint64_t i = h & mask(); entries[i].used; i = (i + 1) & mask()) {
+            if (entries[i].hash == h && entries[i].key == key) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // move entries into a table of new capacity
+    void rehash(uint64_t capacity) {
+        std::vector<entry> old = std::move(entries);
+        entries = std::vector<entry>(capacity);
+        for (entry& e : old) {
+            if (e.used) {
+                uint64_t i = e.hash & mask();
+                while (entries[i].used) {
+                    i = (i + 1) & mask();
+                }
+                entries[i] = std::move(e);
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef TIMER_HPP
+#define TIMER_HPP
+
+#include <chrono>
+
+/*
+    timing of engine phases (the stats of the octree, caches and uploads)
+*/
+
+// ms since start
+inline double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+#endif
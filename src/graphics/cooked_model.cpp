@@ -0,0 +1,543 @@
+#include "cooked_model.hpp"
+
+// std
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//namespace lve {
+
+// first bytes of the file
+#define COOKED_MODEL_MAGIC 0x434c444d	// "MDLC"
+
+/*
+	file layout (host byte order, every table and array starts at a multiple of COOKED_MODEL_ALIGNMENT)
+		header
+		tables: fileDependency, fileMesh, fileMaterial and fileTexture entries
+		strings: paths, referenced by offset and length from the start of the strings
+		arrays: vertices, indices, collision points and indices of each mesh, at the offsets in its fileMesh
+*/
+struct fileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexStride;
+	uint32_t noDependencies;
+	uint32_t noMeshes;
+	uint32_t noMaterials;
+	uint32_t noTextures;
+	uint32_t reserved;
+	// from the start of the file
+	uint64_t dependenciesOffset;
+	uint64_t meshesOffset;
+	uint64_t materialsOffset;
+	uint64_t texturesOffset;
+	uint64_t stringsOffset;
+	uint64_t stringsSize;
+	uint64_t fileSize;
+};
+
+// file the import read, as it was when the model was cooked
+struct fileDependency {
+	uint64_t size;
+	int64_t modified;
+	uint32_t pathOffset;
+	uint32_t pathLength;
+};
+
+struct fileMesh {
+	// from the start of the file
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t collisionPointsOffset;
+	uint64_t collisionIndicesOffset;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexSize;
+	uint32_t materialIndex;
+	uint32_t noCollisionPoints;
+	uint32_t noCollisionFaces;
+	float sphere[4];
+	float min[4];
+	float max[4];
+};
+
+struct fileMaterial {
+	float diffuse[4];
+	float specular[4];
+	// range of the fileTexture table
+	uint32_t firstTexture;
+	uint32_t noTextures;
+};
+
+struct fileTexture {
+	uint32_t type;
+	uint32_t pathOffset;
+	uint32_t pathLength;
+	uint32_t reserved;
+};
+
+static uint64_t alignUp(uint64_t val) {
+	return (val + COOKED_MODEL_ALIGNMENT - 1) / COOKED_MODEL_ALIGNMENT * COOKED_MODEL_ALIGNMENT;
+}
+
+// if [offset, offset + count * stride) is inside a file of fileSize bytes (without overflowing)
+static bool inFile(uint64_t offset, uint64_t count, uint64_t stride, uint64_t fileSize) {
+	return offset <= fileSize && (!stride || count <= (fileSize - offset) / stride);
+}
+
+// if each of the count indices at src is below limit
+template <typename T>
+static bool indicesBelow(const char *src, uint64_t count, uint32_t limit) {
+	const T *indices = reinterpret_cast<const T *>(src);
+	for (uint64_t i = 0; i < count; i++) {
+		if (indices[i] >= limit) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// size and modification time of a file, false if it does not exist
+static bool fileInfo(const std::string &path, uint64_t &size, int64_t &modified) {
+	std::error_code error;
+	size = std::filesystem::file_size(path, error);
+	if (error) {
+		return false;
+	}
+	auto time = std::filesystem::last_write_time(path, error);
+	if (error) {
+		return false;
+	}
+	modified = static_cast<int64_t>(time.time_since_epoch().count());
+	return true;
+}
+
+CookedModel::~CookedModel() {
+	close();
+}
+
+/**
+ * Writes the cooked file of a model (to a temporary file that replaces path once it is complete)
+ * - meshes with fewer than 65536 vertices get 16 bit indices
+ *
+ * @param vertexStride Size of a vertex (open rejects files of another size)
+ * @param dependencies Files the import read, the file is stale once one of them changes
+ * @param error Set to what went wrong if false is returned
+ */
+bool CookedModel::write(
+		const std::string &path,
+		uint32_t vertexStride,
+		const std::vector<std::string> &dependencies,
+		const std::vector<MeshSource> &meshes,
+		const std::vector<Material> &materials,
+		std::string &error) {
+	std::string strings;
+	auto addString = [&strings](const std::string &str, uint32_t &offset, uint32_t &length) {
+		offset = static_cast<uint32_t>(strings.size());
+		length = static_cast<uint32_t>(str.size());
+		strings += str;
+	};
+
+	std::vector<fileDependency> fileDependencies(dependencies.size());
+	for (unsigned int i = 0; i < dependencies.size(); i++) {
+		if (!fileInfo(dependencies[i], fileDependencies[i].size, fileDependencies[i].modified)) {
+			error = "cannot read " + dependencies[i];
+			return false;
+		}
+		addString(dependencies[i], fileDependencies[i].pathOffset, fileDependencies[i].pathLength);
+	}
+
+	std::vector<fileMaterial> fileMaterials(materials.size());
+	std::vector<fileTexture> fileTextures;
+	for (unsigned int i = 0; i < materials.size(); i++) {
+		std::memcpy(fileMaterials[i].diffuse, materials[i].diffuse, sizeof(fileMaterials[i].diffuse));
+		std::memcpy(fileMaterials[i].specular, materials[i].specular, sizeof(fileMaterials[i].specular));
+		fileMaterials[i].firstTexture = static_cast<uint32_t>(fileTextures.size());
+		fileMaterials[i].noTextures = static_cast<uint32_t>(materials[i].textures.size());
+		for (const Texture &texture : materials[i].textures) {
+			fileTexture entry{texture.type, 0, 0, 0};
+			addString(texture.path, entry.pathOffset, entry.pathLength);
+			fileTextures.push_back(entry);
+		}
+	}
+
+	fileHeader header{};
+	header.magic = COOKED_MODEL_MAGIC;
+	header.version = COOKED_MODEL_VERSION;
+	header.vertexStride = vertexStride;
+	header.noDependencies = static_cast<uint32_t>(fileDependencies.size());
+	header.noMeshes = static_cast<uint32_t>(meshes.size());
+	header.noMaterials = static_cast<uint32_t>(fileMaterials.size());
+	header.noTextures = static_cast<uint32_t>(fileTextures.size());
+
+	// tables, then strings, then the arrays
+	uint64_t offset = alignUp(sizeof(fileHeader));
+	header.dependenciesOffset = offset;
+	offset = alignUp(offset + fileDependencies.size() * sizeof(fileDependency));
+	header.meshesOffset = offset;
+	offset = alignUp(offset + meshes.size() * sizeof(fileMesh));
+	header.materialsOffset = offset;
+	offset = alignUp(offset + fileMaterials.size() * sizeof(fileMaterial));
+	header.texturesOffset = offset;
+	offset = alignUp(offset + fileTextures.size() * sizeof(fileTexture));
+	header.stringsOffset = offset;
+	header.stringsSize = strings.size();
+	offset = alignUp(offset + strings.size());
+
+	std::vector<fileMesh> fileMeshes(meshes.size());
+	for (unsigned int i = 0; i < meshes.size(); i++) {
+		const MeshSource &mesh = meshes[i];
+		fileMesh &entry = fileMeshes[i];
+		entry = {};
+		entry.vertexCount = mesh.vertexCount;
+		entry.indexCount = mesh.indexCount;
+		entry.indexSize = mesh.vertexCount <= 0x10000 ? sizeof(uint16_t) : sizeof(uint32_t);
+		entry.materialIndex = mesh.materialIndex;
+		entry.noCollisionPoints = mesh.noCollisionPoints;
+		entry.noCollisionFaces = mesh.noCollisionFaces;
+		std::memcpy(entry.sphere, mesh.bounds.sphere, sizeof(mesh.bounds.sphere));
+		std::memcpy(entry.min, mesh.bounds.min, sizeof(mesh.bounds.min));
+		std::memcpy(entry.max, mesh.bounds.max, sizeof(mesh.bounds.max));
+
+		entry.vertexOffset = offset;
+		offset = alignUp(offset + static_cast<uint64_t>(mesh.vertexCount) * vertexStride);
+		entry.indexOffset = offset;
+		offset = alignUp(offset + static_cast<uint64_t>(mesh.indexCount) * entry.indexSize);
+		entry.collisionPointsOffset = offset;
+		offset = alignUp(offset + static_cast<uint64_t>(mesh.noCollisionPoints) * 3 * sizeof(float));
+		entry.collisionIndicesOffset = offset;
+		offset = alignUp(offset + static_cast<uint64_t>(mesh.noCollisionFaces) * 3 * sizeof(uint32_t));
+	}
+	header.fileSize = offset;
+
+	std::string tmpPath = path + ".tmp";
+	{
+		std::ofstream file{tmpPath, std::ios::binary | std::ios::trunc};
+		if (!file.is_open()) {
+			error = "cannot write " + tmpPath;
+			return false;
+		}
+
+		// pads the file up to an offset of the layout
+		auto seek = [&file](uint64_t pos) {
+			static const char zeros[COOKED_MODEL_ALIGNMENT] = {};
+			uint64_t current = static_cast<uint64_t>(file.tellp());
+			file.write(zeros, static_cast<std::streamsize>(pos - current));
+		};
+		auto writeArray = [&file, &seek](uint64_t pos, const void *src, uint64_t bytes) {
+			seek(pos);
+			file.write(static_cast<const char *>(src), static_cast<std::streamsize>(bytes));
+		};
+
+		file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		writeArray(header.dependenciesOffset, fileDependencies.data(), fileDependencies.size() * sizeof(fileDependency));
+		writeArray(header.meshesOffset, fileMeshes.data(), fileMeshes.size() * sizeof(fileMesh));
+		writeArray(header.materialsOffset, fileMaterials.data(), fileMaterials.size() * sizeof(fileMaterial));
+		writeArray(header.texturesOffset, fileTextures.data(), fileTextures.size() * sizeof(fileTexture));
+		writeArray(header.stringsOffset, strings.data(), strings.size());
+
+		std::vector<uint16_t> shortIndices;
+		for (unsigned int i = 0; i < meshes.size(); i++) {
+			const MeshSource &mesh = meshes[i];
+			const fileMesh &entry = fileMeshes[i];
+
+			writeArray(entry.vertexOffset, mesh.vertices, static_cast<uint64_t>(mesh.vertexCount) * vertexStride);
+			if (entry.indexSize == sizeof(uint16_t)) {
+				shortIndices.assign(mesh.indices, mesh.indices + mesh.indexCount);
+				writeArray(entry.indexOffset, shortIndices.data(), shortIndices.size() * sizeof(uint16_t));
+			} else {
+				writeArray(entry.indexOffset, mesh.indices, static_cast<uint64_t>(mesh.indexCount) * sizeof(uint32_t));
+			}
+			writeArray(entry.collisionPointsOffset, mesh.collisionPoints, static_cast<uint64_t>(mesh.noCollisionPoints) * 3 * sizeof(float));
+			writeArray(entry.collisionIndicesOffset, mesh.collisionIndices, static_cast<uint64_t>(mesh.noCollisionFaces) * 3 * sizeof(uint32_t));
+		}
+		seek(header.fileSize);
+
+		if (!file.good()) {
+			error = "cannot write " + tmpPath;
+			return false;
+		}
+	}
+
+	std::error_code renameError;
+	std::filesystem::rename(tmpPath, path, renameError);
+	if (renameError) {
+		error = "cannot replace " + path + " (" + renameError.message() + ")";
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Maps a cooked file, false if it is missing, invalid or stale (see getLoadError)
+ *
+ * @param vertexStride Size of a vertex of the engine, a file with another size is stale
+ */
+bool CookedModel::open(const std::string &path, uint32_t vertexStride) {
+	close();
+	loadError.clear();
+
+	if (!map(path)) {
+		return false;
+	}
+	if (!validate(vertexStride) || !dependenciesUnchanged()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void CookedModel::close() {
+	if (!data) {
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(mappingHandle);
+	CloseHandle(fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	munmap(const_cast<char *>(data), size);
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+bool CookedModel::map(const std::string &path) {
+#ifdef _WIN32
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		fileHandle = nullptr;
+		loadError = "no cooked file";
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(fileHeader))) {
+		CloseHandle(fileHandle);
+		fileHandle = nullptr;
+		loadError = "file too small";
+		return false;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	data = mappingHandle ? static_cast<const char *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+	if (!data) {
+		if (mappingHandle) {
+			CloseHandle(mappingHandle);
+		}
+		CloseHandle(fileHandle);
+		mappingHandle = nullptr;
+		fileHandle = nullptr;
+		loadError = "cannot map file";
+		return false;
+	}
+	size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		loadError = "no cooked file";
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) || info.st_size < static_cast<off_t>(sizeof(fileHeader))) {
+		::close(fd);
+		loadError = "file too small";
+		return false;
+	}
+
+	// the mapping stays valid after the descriptor is closed
+	void *mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapped == MAP_FAILED) {
+		loadError = "cannot map file";
+		return false;
+	}
+	data = static_cast<const char *>(mapped);
+	size = static_cast<size_t>(info.st_size);
+#endif
+	return true;
+}
+
+// checks the header, that every table, string and array is inside the file and that every index is below
+// the number of vertices (or collision points) of its mesh, so meshes built from the file never read past them
+bool CookedModel::validate(uint32_t vertexStride) {
+	const fileHeader *header = reinterpret_cast<const fileHeader *>(data);
+	if (header->magic != COOKED_MODEL_MAGIC) {
+		loadError = "not a cooked model";
+		return false;
+	}
+	if (header->version != COOKED_MODEL_VERSION) {
+		loadError = "version " + std::to_string(header->version) + ", expected " + std::to_string(COOKED_MODEL_VERSION);
+		return false;
+	}
+	if (header->vertexStride != vertexStride) {
+		loadError = "vertex size " + std::to_string(header->vertexStride) + ", expected " + std::to_string(vertexStride);
+		return false;
+	}
+	if (header->fileSize != size) {
+		loadError = "truncated file";
+		return false;
+	}
+
+	if (!inFile(header->dependenciesOffset, header->noDependencies, sizeof(fileDependency), size)
+			|| !inFile(header->meshesOffset, header->noMeshes, sizeof(fileMesh), size)
+			|| !inFile(header->materialsOffset, header->noMaterials, sizeof(fileMaterial), size)
+			|| !inFile(header->texturesOffset, header->noTextures, sizeof(fileTexture), size)
+			|| !inFile(header->stringsOffset, header->stringsSize, 1, size)) {
+		loadError = "table outside the file";
+		return false;
+	}
+
+	auto stringInFile = [header](uint32_t offset, uint32_t length) {
+		return static_cast<uint64_t>(offset) + length <= header->stringsSize;
+	};
+
+	const fileDependency *dependencies = reinterpret_cast<const fileDependency *>(data + header->dependenciesOffset);
+	for (uint32_t i = 0; i < header->noDependencies; i++) {
+		if (!stringInFile(dependencies[i].pathOffset, dependencies[i].pathLength)) {
+			loadError = "string outside the file";
+			return false;
+		}
+	}
+
+	const fileTexture *textures = reinterpret_cast<const fileTexture *>(data + header->texturesOffset);
+	for (uint32_t i = 0; i < header->noTextures; i++) {
+		if (!stringInFile(textures[i].pathOffset, textures[i].pathLength)) {
+			loadError = "string outside the file";
+			return false;
+		}
+	}
+
+	const fileMaterial *materials = reinterpret_cast<const fileMaterial *>(data + header->materialsOffset);
+	for (uint32_t i = 0; i < header->noMaterials; i++) {
+		if (static_cast<uint64_t>(materials[i].firstTexture) + materials[i].noTextures > header->noTextures) {
+			loadError = "texture outside the table";
+			return false;
+		}
+	}
+
+	const fileMesh *meshes = reinterpret_cast<const fileMesh *>(data + header->meshesOffset);
+	for (uint32_t i = 0; i < header->noMeshes; i++) {
+		const fileMesh &mesh = meshes[i];
+		if ((mesh.indexSize != sizeof(uint16_t) && mesh.indexSize != sizeof(uint32_t))
+				|| (header->noMaterials && mesh.materialIndex >= header->noMaterials)
+				|| !inFile(mesh.vertexOffset, mesh.vertexCount, vertexStride, size)
+				|| !inFile(mesh.indexOffset, mesh.indexCount, mesh.indexSize, size)
+				|| !inFile(mesh.collisionPointsOffset, mesh.noCollisionPoints, 3 * sizeof(float), size)
+				|| !inFile(mesh.collisionIndicesOffset, mesh.noCollisionFaces, 3 * sizeof(uint32_t), size)) {
+			loadError = "mesh " + std::to_string(i) + " outside the file";
+			return false;
+		}
+
+		bool indicesValid = mesh.indexSize == sizeof(uint16_t)
+			? indicesBelow<uint16_t>(data + mesh.indexOffset, mesh.indexCount, mesh.vertexCount)
+			: indicesBelow<uint32_t>(data + mesh.indexOffset, mesh.indexCount, mesh.vertexCount);
+		if (!indicesValid
+				|| !indicesBelow<uint32_t>(data + mesh.collisionIndicesOffset, static_cast<uint64_t>(mesh.noCollisionFaces) * 3, mesh.noCollisionPoints)) {
+			loadError = "mesh " + std::to_string(i) + " index out of range";
+			return false;
+		}
+	}
+	return true;
+}
+
+// if every file the import read still has the size and modification time it had when the model was cooked
+bool CookedModel::dependenciesUnchanged() {
+	const fileHeader *header = reinterpret_cast<const fileHeader *>(data);
+	const fileDependency *dependencies = reinterpret_cast<const fileDependency *>(data + header->dependenciesOffset);
+
+	for (uint32_t i = 0; i < header->noDependencies; i++) {
+		std::string path = readString(dependencies[i].pathOffset, dependencies[i].pathLength);
+		uint64_t fileSize;
+		int64_t modified;
+		if (!fileInfo(path, fileSize, modified)) {
+			loadError = path + " is missing";
+			return false;
+		}
+		if (fileSize != dependencies[i].size || modified != dependencies[i].modified) {
+			loadError = path + " changed";
+			return false;
+		}
+	}
+	return true;
+}
+
+std::string CookedModel::readString(uint32_t offset, uint32_t length) const {
+	const fileHeader *header = reinterpret_cast<const fileHeader *>(data);
+	return std::string(data + header->stringsOffset + offset, length);
+}
+
+unsigned int CookedModel::noMeshes() const {
+	return data ? reinterpret_cast<const fileHeader *>(data)->noMeshes : 0;
+}
+
+CookedModel::MeshView CookedModel::getMesh(unsigned int idx) const {
+	const fileHeader *header = reinterpret_cast<const fileHeader *>(data);
+	const fileMesh &mesh = reinterpret_cast<const fileMesh *>(data + header->meshesOffset)[idx];
+
+	MeshView ret;
+	ret.vertices = data + mesh.vertexOffset;
+	ret.vertexCount = mesh.vertexCount;
+	ret.indices = data + mesh.indexOffset;
+	ret.indexCount = mesh.indexCount;
+	ret.indexSize = mesh.indexSize;
+	ret.materialIndex = mesh.materialIndex;
+	std::memcpy(ret.bounds.sphere, mesh.sphere, sizeof(ret.bounds.sphere));
+	std::memcpy(ret.bounds.min, mesh.min, sizeof(ret.bounds.min));
+	std::memcpy(ret.bounds.max, mesh.max, sizeof(ret.bounds.max));
+	ret.collisionPoints = reinterpret_cast<const float *>(data + mesh.collisionPointsOffset);
+	ret.noCollisionPoints = mesh.noCollisionPoints;
+	ret.collisionIndices = reinterpret_cast<const uint32_t *>(data + mesh.collisionIndicesOffset);
+	ret.noCollisionFaces = mesh.noCollisionFaces;
+	return ret;
+}
+
+// copies the indices of a mesh as 32 bit indices (dst holds getMesh(idx).indexCount)
+void CookedModel::readIndices(unsigned int idx, uint32_t *dst) const {
+	MeshView mesh = getMesh(idx);
+	if (mesh.indexSize == sizeof(uint32_t)) {
+		std::memcpy(dst, mesh.indices, mesh.indexCount * sizeof(uint32_t));
+		return;
+	}
+
+	const uint16_t *src = static_cast<const uint16_t *>(mesh.indices);
+	for (uint32_t i = 0; i < mesh.indexCount; i++) {
+		dst[i] = src[i];
+	}
+}
+
+unsigned int CookedModel::noMaterials() const {
+	return data ? reinterpret_cast<const fileHeader *>(data)->noMaterials : 0;
+}
+
+CookedModel::Material CookedModel::getMaterial(unsigned int idx) const {
+	const fileHeader *header = reinterpret_cast<const fileHeader *>(data);
+	const fileMaterial &material = reinterpret_cast<const fileMaterial *>(data + header->materialsOffset)[idx];
+	const fileTexture *textures = reinterpret_cast<const fileTexture *>(data + header->texturesOffset);
+
+	Material ret;
+	std::memcpy(ret.diffuse, material.diffuse, sizeof(ret.diffuse));
+	std::memcpy(ret.specular, material.specular, sizeof(ret.specular));
+	for (uint32_t i = material.firstTexture; i < material.firstTexture + material.noTextures; i++) {
+		ret.textures.push_back({textures[i].type, readString(textures[i].pathOffset, textures[i].pathLength)});
+	}
+	return ret;
+}
+
+//}	// namespace lve
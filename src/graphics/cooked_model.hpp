@@ -0,0 +1,127 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//namespace lve {
+
+// appended to the path of a model file for its cooked file
+#define COOKED_MODEL_EXTENSION ".cooked"
+// layout of the file and of the import that produced it (assimp flags, vertex dedup),
+// files of another version are cooked again
+#define COOKED_MODEL_VERSION 1
+// alignment of every array in the file
+#define COOKED_MODEL_ALIGNMENT 16
+
+/*
+	Versioned binary file of an imported model, so Assimp only runs when the model changed
+	- holds what Model::loadModel builds from the Assimp scene: deduplicated vertices, 16 or 32 bit
+		indices, bounding spheres and boxes, collision meshes and the colors and texture paths of the
+		materials
+	- the file is memory mapped and read in place: tables and arrays are at aligned offsets, so
+		vertices and indices are copied straight from the mapping (into staging memory or a Mesh)
+	- it lists the files the import read (the model and e.g. its .bin or .mtl) with their size and
+		modification time, open() rejects it if any of them changed or if the version or the vertex
+		size differ, so a stale file falls back to the import and is cooked again
+	- nothing here needs a GPU or Assimp, vertices are opaque blocks of vertexStride bytes
+*/
+class CookedModel {
+ public:
+	// texture of a material (type is an aiTextureType)
+	struct Texture {
+		uint32_t type = 0;
+		std::string path;
+	};
+
+	struct Material {
+		float diffuse[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+		float specular[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+		std::vector<Texture> textures;
+	};
+
+	// bounding sphere (center, radius) and box of a mesh in model space
+	struct Bounds {
+		float sphere[4] = {};
+		float min[3] = {};
+		float max[3] = {};
+	};
+
+	// mesh to cook, the arrays are only read by write
+	struct MeshSource {
+		const void *vertices = nullptr;
+		uint32_t vertexCount = 0;
+		const uint32_t *indices = nullptr;
+		uint32_t indexCount = 0;
+		uint32_t materialIndex = 0;
+		Bounds bounds;
+		// optional collision mesh (xyz per point, 3 indices per face)
+		const float *collisionPoints = nullptr;
+		uint32_t noCollisionPoints = 0;
+		const uint32_t *collisionIndices = nullptr;
+		uint32_t noCollisionFaces = 0;
+	};
+
+	// mesh in the mapped file (pointers into the mapping, valid until close)
+	struct MeshView {
+		const void *vertices = nullptr;
+		uint32_t vertexCount = 0;
+		// uint16_t or uint32_t (indexSize bytes each)
+		const void *indices = nullptr;
+		uint32_t indexCount = 0;
+		uint32_t indexSize = 0;
+		uint32_t materialIndex = 0;
+		Bounds bounds;
+		const float *collisionPoints = nullptr;
+		uint32_t noCollisionPoints = 0;
+		const uint32_t *collisionIndices = nullptr;
+		uint32_t noCollisionFaces = 0;
+	};
+
+	CookedModel() = default;
+	~CookedModel();
+
+	CookedModel(const CookedModel &) = delete;
+	CookedModel &operator=(const CookedModel &) = delete;
+
+	static bool write(
+			const std::string &path,
+			uint32_t vertexStride,
+			const std::vector<std::string> &dependencies,
+			const std::vector<MeshSource> &meshes,
+			const std::vector<Material> &materials,
+			std::string &error);
+
+	bool open(const std::string &path, uint32_t vertexStride);
+	void close();
+
+	unsigned int noMeshes() const;
+	MeshView getMesh(unsigned int idx) const;
+	void readIndices(unsigned int idx, uint32_t *dst) const;
+	unsigned int noMaterials() const;
+	Material getMaterial(unsigned int idx) const;
+
+	// bytes mapped (0 if no file is open)
+	size_t getSize() const { return size; }
+	// why the last open failed (empty if it did not)
+	const std::string &getLoadError() const { return loadError; }
+
+ private:
+	bool map(const std::string &path);
+	bool validate(uint32_t vertexStride);
+	bool dependenciesUnchanged();
+	std::string readString(uint32_t offset, uint32_t length) const;
+
+	const char *data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void *fileHandle = nullptr;
+	void *mappingHandle = nullptr;
+#endif
+
+	std::string loadError;
+};
+
+//}	// namespace lve
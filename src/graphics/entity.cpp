@@ -66,43 +66,53 @@ void Entity::enableCollisionModel() {
 
 
 // render instance(s)
-void Entity::render(ShaderPipline& shader_pipeline, float dt, VkCommandBuffer& commandBuffer) {
-    if (!States::isActive(&switches, CONST_INSTANCES)) {
-        // dynamic instances - update VBO data
-
-        // create list of each
-        std::vector<glm::mat4> models(currentNumInstances);
-        std::vector<glm::mat3> normalModels(currentNumInstances);
-
-        // determine if instances are moving
-        bool doUpdate = States::isActive(&switches, DYNAMIC);
+void Entity::render(ShaderPipline& shader_pipeline, float dt, VkCommandBuffer& commandBuffer, int frameIndex,
+    VulkanRingBuffer* frameRing) {
+    // dynamic entities - nearly all instances move every frame, write them into this frame's slices of the ring
+    VulkanRingBuffer::Slice models, normalModels;
+    bool streamed = frameRing
+        && States::isActive(&switches, DYNAMIC)
+        && !States::isActive(&switches, CONST_INSTANCES)
+        && streamInstances(frameRing, models, normalModels);
+
+    if (!streamed && instancesStreamed) {
+        // instance buffers were not kept up to date
+        for (unsigned int i = 0; i < currentNumInstances; i++) {
+            patchInstance(i);
+        }
+    }
+    instancesStreamed = streamed;
 
-        // iterate through each instance
-        for (int i = 0; i < currentNumInstances; i++) {
-            if (doUpdate) {
-                // update Rigid Body and activate moved switch
-                instances[i]->update(dt);
-                States::activate(&instances[i]->state, INSTANCE_MOVED);
-            }
-            else {
-                // deactivate moved switch
-                States::deactivate(&instances[i]->state, INSTANCE_MOVED);
+    if (!streamed && !States::isActive(&switches, CONST_INSTANCES)) {
+        // dynamic instances - update VBO data of the instances that moved (moved by the physics world,
+        // interpolated between its steps), and once more when they stop
+        for (unsigned int i = 0; i < currentNumInstances; i++) {
+            bool moved = States::isActive(&instances[i]->state, INSTANCE_MOVED);
+            if (moved || movedSlots[i]) {
+                patchInstance(i);
             }
-
-            // add updated matrices
-            models[i] = instances[i]->model;
-            normalModels[i] = instances[i]->normalModel;
+            movedSlots[i] = moved;
         }
+    }
 
-        if (currentNumInstances) {
-            // set transformation data
-            instanceBuffer->map();
-            instanceBuffer->writeToBuffer((void*)models.data() );
-            normalInstanceBuffer->map();
-            normalInstanceBuffer->writeToBuffer((void*)normalModels.data() );
+    // set transformation data
+    if (!streamed) {
+        uploadDirtyInstances(frameIndex);
+    }
 
+    if (!States::isActive(&switches, CONST_INSTANCES)) {
+        if (currentNumInstances) {
             for (const std::unique_ptr<Mesh>& current_mesh : model->meshes) {
-                current_mesh->bind(commandBuffer, instanceBuffer->getBuffer(), normalInstanceBuffer->getBuffer());
+                // still uploading
+                if (!current_mesh->isReady()) {
+                    continue;
+                }
+                if (streamed) {
+                    current_mesh->bind(commandBuffer, models.buffer, normalModels.buffer, models.offset, normalModels.offset);
+                }
+                else {
+                    current_mesh->bind(commandBuffer, instanceBuffers[frameIndex]->getBuffer(), normalInstanceBuffers[frameIndex]->getBuffer());
+                }
                 current_mesh->draw(commandBuffer, currentNumInstances);
             }
         }
@@ -123,58 +133,59 @@ RigidBody* Entity::generateInstance(glm::vec3 size, float mass, glm::vec3 pos, g
     if (currentNumInstances >= maxNumInstances) {
         return nullptr; 
     }
-    instances[currentNumInstances] = new RigidBody(model_name, size, mass, pos, rot);   // instantiate new instance
+    RigidBody* rb = new RigidBody(size, mass, pos, rot);   // instantiate new instance
+    rb->instanceIdx = currentNumInstances;
+    instances.push_back(rb);
+    currentNumInstances++;
 
-    // Optimize this later if possible
-    for (unsigned int i = 0; i < model->meshes.size(); i++) {
-        //indirectCommands[currentNumInstances]->indexCount = model->meshes[currentNumInstances]->indices.size();   //Already defined
-        indirectCommands[i]->instanceCount = currentNumInstances;       // Dynamic count based on the frame
+    if (!instanceBuffers.empty()) {
+        patchInstance(rb->instanceIdx);
     }
-    return instances[currentNumInstances++];
+
+    updateInstanceCounts();
+    return rb;
 }
 
 
 //Later, MAYBE make it so that it only binds and draws if the instances exists IDK I gotta do some more digging
 void Entity::initInstances() {
-    // default values
-    std::unique_ptr<glm::mat4> posData = nullptr;
-    std::unique_ptr<glm::mat3> normalData = nullptr;
-
-    std::vector<glm::mat4> positions(currentNumInstances);
-    std::vector<glm::mat3> normals(currentNumInstances);
-
-    if (States::isActive(&switches, CONST_INSTANCES)) {
-        // instances won't change, set data pointers
-
-        for (unsigned int i = 0; i < currentNumInstances; i++) {
-            positions[i] = instances[i]->model;
-            normals[i] = instances[i]->normalModel;
-        }
-
-        if (currentNumInstances) {
-            posData = std::make_unique<glm::mat4>(&positions[0]);
-            normalData = std::make_unique<glm::mat3>(&normals[0]);
-        }
-    }
-
     uint32_t max_instances = static_cast<uint32_t>(maxNumInstances);
 	assert(max_instances >= 1 && "Max instance count must be at least 1");
 
-	uint32_t dataSize = sizeof(posData);
-	instanceBuffer = std::make_unique<VulkanBuffer>(
-			vulkanDevice,
-			dataSize,
-			max_instances,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_CREATE_SPARSE_BINDING_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	uint32_t normalDataSize = sizeof(normalData);
-    normalInstanceBuffer = std::make_unique<VulkanBuffer>(
-			vulkanDevice,
-			normalDataSize,
-			max_instances,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_CREATE_SPARSE_BINDING_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	// host visible and mapped for the lifetime of the entity, only dirty ranges are written each frame
+	// - one pair per frame in flight, so a frame never writes slots the device is still reading for the previous one
+	static_assert(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT <= 8, "dirtySlots keeps one bit per frame in flight");
+	uint32_t dataSize = sizeof(glm::mat4);
+	uint32_t normalDataSize = sizeof(glm::mat3);
+	instanceBuffers.clear();
+	normalInstanceBuffers.clear();
+	for (int frame = 0; frame < VulkanSwapChain::MAX_FRAMES_IN_FLIGHT; frame++) {
+		instanceBuffers.push_back(std::make_unique<VulkanBuffer>(
+				vulkanDevice,
+				dataSize,
+				max_instances,
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+		instanceBuffers.back()->map();
+
+		normalInstanceBuffers.push_back(std::make_unique<VulkanBuffer>(
+				vulkanDevice,
+				normalDataSize,
+				max_instances,
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+		normalInstanceBuffers.back()->map();
+	}
+
+    instanceModels.assign(max_instances, glm::mat4(1.0f));
+    instanceNormalModels.assign(max_instances, glm::mat3(1.0f));
+    dirtySlots.assign(max_instances, 0);
+    movedSlots.assign(max_instances, 0);
+
+    // current instances are written on the first render of each frame
+    for (unsigned int i = 0; i < currentNumInstances; i++) {
+        patchInstance(i);
+    }
 
     /*
 	uint32_t indirectCommandSize = sizeof(VkDrawIndexedIndirectCommand);
@@ -191,35 +202,179 @@ void Entity::initInstances() {
 
 // remove instance at idx
 void Entity::removeInstance(unsigned int idx) {
-    if (idx < maxNumInstances) {
-        // shift down
-        for (unsigned int i = idx + 1; i < currentNumInstances; i++) {
-            instances[i - 1] = instances[i];
+    if (idx < currentNumInstances) {
+        instances[idx]->instanceIdx = 0xffffffff;
+
+        // move last instance into the hole
+        unsigned int last = currentNumInstances - 1;
+        if (idx != last) {
+            instances[idx] = instances[last];
+            instances[idx]->instanceIdx = idx;
+            if (!instanceBuffers.empty()) {
+                movedSlots[idx] = movedSlots[last];
+                patchInstance(idx);
+            }
         }
-        currentNumInstances--;
-        for (unsigned int i = 0; i < model->meshes.size(); i++) {
-            indirectCommands[i]->instanceCount = currentNumInstances;       // Dynamic count based on the frame
+        if (!instanceBuffers.empty()) {
+            movedSlots[last] = 0;
         }
+        instances.pop_back();
+        currentNumInstances--;
+
+        updateInstanceCounts();
     }
 }
 
-// remove instance with id
-void Entity::removeInstance(std::string instanceId) {
-    int idx = getIdx(instanceId);
+// remove instance
+void Entity::removeInstance(RigidBody* instance) {
+    unsigned int idx = getIdx(instance);
     if (idx != -1) {
         removeInstance(idx);
     }
 }
 
-// get index of instance with id
-unsigned int Entity::getIdx(std::string id) {
-    // test each instance
-    for (int i = 0; i < currentNumInstances; i++) {
-        if (instances[i]->instanceId == id) {
-            return i;
+// get index of instance (-1 if it is not an instance of this entity)
+unsigned int Entity::getIdx(RigidBody* instance) {
+    unsigned int idx = instance->instanceIdx;
+    return (idx < currentNumInstances && instances[idx] == instance) ? idx : -1;
+}
+
+// copy the matrices of the instance at idx and mark its slot of the instance buffers of every frame for upload
+void Entity::patchInstance(unsigned int idx) {
+    // constant instances are drawn with their model matrices, dynamic ones between their physics steps
+    bool constant = States::isActive(&switches, CONST_INSTANCES);
+    instanceModels[idx] = constant ? instances[idx]->model : instances[idx]->renderModel;
+    instanceNormalModels[idx] = constant ? instances[idx]->normalModel : instances[idx]->renderNormalModel;
+    dirtySlots[idx] = (unsigned char)((1 << instanceBuffers.size()) - 1);
+}
+
+// write the matrices of all instances into slices of the frame's ring, false if it is full
+bool Entity::streamInstances(VulkanRingBuffer* frameRing, VulkanRingBuffer::Slice& models, VulkanRingBuffer::Slice& normalModels) {
+    if (!currentNumInstances) {
+        return false;
+    }
+
+    models = frameRing->allocate(currentNumInstances * sizeof(glm::mat4));
+    normalModels = frameRing->allocate(currentNumInstances * sizeof(glm::mat3));
+    if (!models.mapped || !normalModels.mapped) {
+        // slices that were allocated are released with the frame
+        return false;
+    }
+
+    glm::mat4* modelData = (glm::mat4*)models.mapped;
+    glm::mat3* normalModelData = (glm::mat3*)normalModels.mapped;
+    for (unsigned int i = 0; i < currentNumInstances; i++) {
+        modelData[i] = instances[i]->renderModel;
+        normalModelData[i] = instances[i]->renderNormalModel;
+    }
+
+    uploadedBytes = currentNumInstances * (sizeof(glm::mat4) + sizeof(glm::mat3));
+    return true;
+}
+
+// write the dirty slots of the instance buffers of frameIndex, one write per contiguous range
+void Entity::uploadDirtyInstances(int frameIndex) {
+    uploadedBytes = 0;
+
+    VulkanBuffer* models = instanceBuffers[frameIndex].get();
+    VulkanBuffer* normalModels = normalInstanceBuffers[frameIndex].get();
+    unsigned char frameBit = (unsigned char)(1 << frameIndex);
+    for (unsigned int i = 0; i < currentNumInstances; i++) {
+        if (!(dirtySlots[i] & frameBit)) {
+            continue;
+        }
+
+        // extend range over following dirty slots (and over short clean gaps, cheaper than another write)
+        unsigned int end = i + 1;
+        for (unsigned int j = end; j < currentNumInstances && j <= end + DIRTY_RANGE_MAX_GAP; j++) {
+            if (dirtySlots[j] & frameBit) {
+                end = j + 1;
+            }
+        }
+
+        unsigned int count = end - i;
+        models->writeToRange((void*)&instanceModels[i], i, count);
+        normalModels->writeToRange((void*)&instanceNormalModels[i], i, count);
+        if (!(models->getMemoryPropertyFlags() & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+            models->flushRange(i, count);
+            normalModels->flushRange(i, count);
+        }
+        uploadedBytes += count * (sizeof(glm::mat4) + sizeof(glm::mat3));
+
+        // the gap slots got the current matrices as well
+        for (unsigned int j = i; j < end; j++) {
+            dirtySlots[j] &= ~frameBit;
+        }
+        i = end - 1;
+    }
+}
+
+// copy the meshes into the shared buffers of the scene, false if they are full
+bool Entity::addToGeometry(VulkanGeometryBuffer& geometry) {
+    indirectCommands.clear();
+    geometryRanges.clear();
+    geometryTicket = 0;
+    boundingSphere = enclosingSphere(boundingRegions);
+
+    for (const std::unique_ptr<Mesh>& current_mesh : model->meshes) {
+        GeometryRange range;
+        if (!geometry.add(current_mesh->vertices.data(), current_mesh->vertices.size(),
+            current_mesh->indices.data(), current_mesh->indices.size(), range)) {
+            // undo the meshes already added
+            for (GeometryRange& added : geometryRanges) {
+                geometry.remove(added);
+            }
+            indirectCommands.clear();
+            geometryRanges.clear();
+            return false;
         }
+
+        geometryRanges.push_back(range);
+        // the mesh's textures are sampled too
+        geometryTicket = std::max(geometryTicket, std::max(range.ticket, current_mesh->getUploadTicket()));
+        indirectCommands.push_back({ range.indexCount, currentNumInstances, range.firstIndex, (int32_t)range.firstVertex, 0 });
+    }
+
+    return true;
+}
+
+// write the instances from firstInstance on and add a draw per mesh to the batch, returns the number of instances
+unsigned int Entity::batchDraws(DrawBatcher& batch, glm::mat4* models, glm::mat3* normalModels, unsigned int firstInstance,
+    CullInstance* cullInstances, uint32_t group, const std::vector<uint32_t>* visible) {
+    unsigned int noInstances = visible ? visible->size() : currentNumInstances;
+    if (!noInstances && visible) {
+        // nothing of this entity is in view
+        return 0;
+    }
+
+    // constant instances are drawn with their model matrices, dynamic ones between their physics steps
+    bool constant = States::isActive(&switches, CONST_INSTANCES);
+    for (unsigned int i = 0; i < noInstances; i++) {
+        const RigidBody* instance = instances[visible ? (*visible)[i] : i];
+        models[firstInstance + i] = constant ? instance->model : instance->renderModel;
+        normalModels[firstInstance + i] = constant ? instance->normalModel : instance->renderNormalModel;
+
+        if (cullInstances) {
+            cullInstances[firstInstance + i].sphere = transformSphere(models[firstInstance + i], boundingSphere);
+            cullInstances[firstInstance + i].group = group;
+        }
+    }
+
+    for (unsigned int i = 0, numMeshes = indirectCommands.size(); i < numMeshes; i++) {
+        IndirectCommand command = indirectCommands[i];
+        command.instanceCount = noInstances;
+        command.firstInstance = firstInstance;
+        batch.add(model->meshes[i]->hasTextures() ? 1 : 0, command, group);
+    }
+
+    return noInstances;
+}
+
+// set instance counts of the draw commands
+void Entity::updateInstanceCounts() {
+    for (IndirectCommand& command : indirectCommands) {
+        command.instanceCount = currentNumInstances;
     }
-    return -1;
 }
 
 
@@ -9,8 +9,12 @@
 #include <vector>
 #include <span>
 #include <utility>
+#include <algorithm>
 
 #include "vulkan_buffer.hpp"
+#include "vulkan_ring_buffer.hpp"
+#include "vulkan_geometry_buffer.hpp"
+#include "memory/drawbatcher.hpp"
 #include "vulkan_device.hpp"
 #include "vulkan_utils.hpp"
 
@@ -28,6 +32,7 @@
 #include "../physics/collisionmodel.hpp"
 #include "../physics/rigidbody.hpp"
 #include "../algorithms/bounds.hpp"
+#include "../algorithms/culling.hpp"
 #include "../algorithms/states.hpp"
 //#include "../scene.hpp"
 
@@ -38,6 +43,9 @@
 #define CONST_INSTANCES		(unsigned int)2 // 0b00000010
 #define NO_TEX				(unsigned int)4	// 0b00000100
 
+// clean slots between two dirty ones that are written anyway to keep a single range
+#define DIRTY_RANGE_MAX_GAP 4
+
 
 typedef enum modelTypeFlag {
     STATIC_INSTANCES = 1,			  // Model and instances are fully static, no changing after loading - consider combining with other models in a scene
@@ -103,10 +111,16 @@ class Entity {
 	std::unique_ptr<CollisionModel> collision;
 	// list of bounding regions (1 for each mesh)
 	std::vector<BoundingRegion> boundingRegions;
+	// sphere around all meshes in model space (set in addToGeometry)
+	glm::vec4 boundingSphere{0.0f};
     // list of instances
     std::vector<RigidBody*> instances;
-	// list of indexed indirect Commands (1 for each mesh)
-	std::vector<std::unique_ptr<VkDrawIndexedIndirectCommand>> indirectCommands;
+	// list of indexed indirect Commands (1 for each mesh, set in addToGeometry)
+	std::vector<IndirectCommand> indirectCommands;
+	// ranges of the meshes in the scene's geometry buffer
+	std::vector<GeometryRange> geometryRanges;
+	// last upload of the ranges and textures of the meshes, the entity is batched once it is ready
+	UploadTicket geometryTicket = 0;
 
     // maximum number of instances and current number of instances
     unsigned int maxNumInstances;
@@ -114,18 +128,42 @@ class Entity {
 
     // combination of switches above
     unsigned int switches;
+
+	// bytes written to the instance buffers in the last render
+	VkDeviceSize uploadedBytes = 0;
+
 	void initInstances();
+    // swaps the last instance into the slot (O(1), instance order is not kept)
     void removeInstance(unsigned int idx);
-    void removeInstance(std::string instanceId);
-    unsigned int getIdx(std::string id);
+    void removeInstance(RigidBody* instance);
+    unsigned int getIdx(RigidBody* instance);
 	void enableCollisionModel();
 
 	RigidBody* generateInstance(glm::vec3 size, float mass, glm::vec3 pos, glm::vec3 rot);
-	void render(ShaderPipline& shader_pipeline, float dt, VkCommandBuffer& commandBuffer);
+
+	// copy the meshes into the shared buffers of the scene, false if they are full
+	bool addToGeometry(VulkanGeometryBuffer& geometry);
+	// write the instances from firstInstance on and add a draw per mesh to the batch, returns the number of instances
+	// - with cullInstances, the world space spheres of the instances are written for the cull pass and the draws are tagged with group
+	// - with visible (indices into instances, from the frustum traversal of the octree), only those instances are written
+	unsigned int batchDraws(DrawBatcher& batch, glm::mat4* models, glm::mat3* normalModels, unsigned int firstInstance,
+		CullInstance* cullInstances = nullptr, uint32_t group = 0, const std::vector<uint32_t>* visible = nullptr);
+	// instances of DYNAMIC entities are written into frameRing if given (the instance buffers are used if it is full)
+	// - frameIndex selects the instance buffers of the frame being recorded
+	void render(ShaderPipline& shader_pipeline, float dt, VkCommandBuffer& commandBuffer, int frameIndex,
+		VulkanRingBuffer* frameRing = nullptr);
 
  private:
 	void createVertexBuffers();
 	void createIndexBuffers();
+	// copy the matrices of the instance at idx and mark its slot of the instance buffers of every frame for upload
+	void patchInstance(unsigned int idx);
+	// write the dirty slots of the instance buffers of frameIndex, one write per contiguous range
+	void uploadDirtyInstances(int frameIndex);
+	// write the matrices of all instances into slices of the frame's ring, false if it is full
+	bool streamInstances(VulkanRingBuffer* frameRing, VulkanRingBuffer::Slice& models, VulkanRingBuffer::Slice& normalModels);
+	// set instance counts of the draw commands
+	void updateInstanceCounts();
 	Entity(VulkanDevice &device, id_t objId ) : vulkanDevice{device}, id{objId} {}
 
 	id_t id;
@@ -133,8 +171,20 @@ class Entity {
 
 	VulkanDevice &vulkanDevice;
 
-	std::unique_ptr<VulkanBuffer> instanceBuffer;
-	std::unique_ptr<VulkanBuffer> normalInstanceBuffer;
+	// host visible, mapped once in initInstances
+	// - one per frame in flight, a frame only writes its own while the device may still read the others
+	std::vector<std::unique_ptr<VulkanBuffer>> instanceBuffers;
+	std::vector<std::unique_ptr<VulkanBuffer>> normalInstanceBuffers;
+
+	// copy of the matrices in the instance buffers (dirty ranges are written from here in one call)
+	std::vector<glm::mat4> instanceModels;
+	std::vector<glm::mat3> instanceNormalModels;
+	// frames whose instance buffers still miss the slot (bit per frame index)
+	std::vector<unsigned char> dirtySlots;
+	// slots whose instance moved before the last upload (written once more after it stops)
+	std::vector<unsigned char> movedSlots;
+	// if the last render read the instances from a ring instead of the instance buffers
+	bool instancesStreamed = false;
 	//std::unique_ptr<VulkanBuffer> indirectCommandBuffer;
 	//uint32_t instanceCount;
 	//uint32_t normalInstanceCount;
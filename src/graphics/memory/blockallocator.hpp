@@ -0,0 +1,429 @@
+#ifndef BLOCKALLOCATOR_HPP
+#define BLOCKALLOCATOR_HPP
+
+#include <vector>
+#include <set>
+#include <map>
+#include <algorithm>
+#include <cstdint>
+
+// default size of the blocks requested from the source
+#define MEMORY_BLOCK_SIZE (64ULL << 20)
+// smallest range handed out (power of two)
+#define MEMORY_MIN_ALLOCATION 256ULL
+// order of allocations that got a block of their own
+#define MEMORY_DEDICATED_ORDER 0xff
+
+/*
+    source of large memory blocks
+    - VulkanMemorySource allocates device memory, tests can hand out fake handles
+*/
+
+class MemoryBlockSource {
+public:
+    virtual ~MemoryBlockSource() {}
+
+    // allocate a block of a memory type, returns its handle (0 if out of memory)
+    // - mapped is set to the host address of the block for host visible memory types (nullptr otherwise)
+    virtual uint64_t allocateBlock(uint32_t memoryType, uint64_t size, void** mapped) = 0;
+    virtual void freeBlock(uint64_t block) = 0;
+};
+
+/*
+    range of a block handed out by the allocator
+*/
+typedef struct MemoryAllocation {
+    // handle of the block from the source (0 if the allocation failed or was freed)
+    uint64_t block = 0;
+    uint64_t offset = 0;
+    // size requested
+    uint64_t size = 0;
+    // host address of the range (nullptr if the memory is not host visible)
+    void* mapped = nullptr;
+
+    // where the range lives in the allocator
+    uint32_t poolIdx = 0;
+    uint32_t blockIdx = 0;
+    unsigned char order = 0;
+} MemoryAllocation;
+
+typedef struct MemoryStats {
+    unsigned int noBlocks = 0;
+    // blocks holding a single allocation too large for the shared blocks
+    unsigned int noDedicated = 0;
+    unsigned int noAllocations = 0;
+    // bytes requested from the source
+    uint64_t blockBytes = 0;
+    // bytes requested by the allocations
+    uint64_t usedBytes = 0;
+    // bytes in free ranges of the shared blocks, and the largest of them
+    uint64_t freeBytes = 0;
+    uint64_t largestFree = 0;
+    // share of the free bytes outside the largest free range of their block (0 when no block is split up)
+    float fragmentation = 0.0f;
+} MemoryStats;
+
+/*
+    block allocator
+    - requests large blocks from a source and sub-allocates them with a buddy system
+      (ranges are powers of two, aligned to their size, and merge with their buddy when both are free)
+    - one pool per memory type and resource kind: linear resources (buffers) and optimal resources
+      (images) never share a block, which keeps them bufferImageGranularity apart
+    - allocations larger than half a block get a dedicated block
+    - empty blocks are returned to the source, except one per pool to avoid thrashing
+    - not thread safe, VulkanDevice locks around every call
+*/
+
+class BlockAllocator {
+public:
+    BlockAllocator(MemoryBlockSource& source, uint64_t blockSize = MEMORY_BLOCK_SIZE, uint64_t minAllocation = MEMORY_MIN_ALLOCATION)
+        : source(source), minAllocation(minAllocation), maxOrder(0) {
+        // whole power of two multiple of the smallest range
+        while ((minAllocation << maxOrder) < blockSize) {
+            maxOrder++;
+        }
+        this->blockSize = minAllocation << maxOrder;
+    }
+
+    ~BlockAllocator() {
+        for (pool& p : pools) {
+            for (block& b : p.blocks) {
+                if (b.handle) {
+                    source.freeBlock(b.handle);
+                }
+            }
+        }
+    }
+
+    BlockAllocator(const BlockAllocator&) = delete;
+    BlockAllocator& operator=(const BlockAllocator&) = delete;
+
+    /*
+        functionality
+    */
+
+    // allocate size bytes aligned to alignment (power of two), returns false if the source is out of memory
+    bool allocate(uint32_t memoryType, bool linear, uint64_t size, uint64_t alignment, MemoryAllocation& out) {
+        out = MemoryAllocation();
+        if (!size) {
+            return false;
+        }
+
+        uint32_t poolIdx = memoryType * 2 + (linear ? 1 : 0);
+        if (poolIdx >= pools.size()) {
+            pools.resize(poolIdx + 1);
+        }
+        pool& p = pools[poolIdx];
+        p.memoryType = memoryType;
+
+        // buddy ranges are aligned to their size
+        uint64_t rangeSize = std::max(std::max(size, alignment), minAllocation);
+        unsigned char order = 0;
+        while ((minAllocation << order) < rangeSize) {
+            order++;
+        }
+
+        if (order >= maxOrder) {
+            return allocateDedicated(poolIdx, size, alignment, out);
+        }
+
+        // first block with a free range of the order (or a larger one to split)
+        for (uint32_t i = 0; i < p.blocks.size(); i++) {
+            if (p.blocks[i].handle && !p.blocks[i].dedicated && allocateFrom(p.blocks[i], order, size, out)) {
+                fill(out, poolIdx, i, size);
+                return true;
+            }
+        }
+
+        // new block
+        uint32_t blockIdx = addBlock(poolIdx, blockSize, false);
+        if (blockIdx == NO_BLOCK) {
+            return false;
+        }
+        allocateFrom(p.blocks[blockIdx], order, size, out);
+        fill(out, poolIdx, blockIdx, size);
+        return true;
+    }
+
+    // free an allocation (it is reset)
+    void free(MemoryAllocation& allocation) {
+        if (!allocation.block) {
+            return;
+        }
+
+        pool& p = pools[allocation.poolIdx];
+        block& b = p.blocks[allocation.blockIdx];
+        b.live.erase(allocation.offset);
+        b.usedBytes -= allocation.size;
+
+        if (b.dedicated) {
+            releaseBlock(p, allocation.blockIdx);
+        }
+        else {
+            // merge with free buddies
+            uint64_t offset = allocation.offset;
+            unsigned char order = allocation.order;
+            while (order < maxOrder) {
+                uint64_t buddy = offset ^ (minAllocation << order);
+                if (!b.freeLists[order].erase(buddy)) {
+                    break;
+                }
+                offset = std::min(offset, buddy);
+                order++;
+            }
+            b.freeLists[order].insert(offset);
+
+            if (b.live.empty()) {
+                releaseEmptyBlock(p, allocation.blockIdx);
+            }
+        }
+
+        allocation = MemoryAllocation();
+    }
+
+    /*
+        defragmentation hook
+        - moves allocations out of the least used shared blocks of each pool into fuller ones
+        - move(from, to) must copy the contents and rebind the resource that owns from to the new range
+          (return false to keep it where it is), from is freed afterwards
+        - blocks left empty are returned to the source
+        - returns the number of allocations moved
+    */
+    template <typename F>
+    unsigned int defragment(F move) {
+        unsigned int noMoved = 0;
+
+        for (uint32_t poolIdx = 0; poolIdx < pools.size(); poolIdx++) {
+            pool& p = pools[poolIdx];
+
+            // shared blocks, least used first
+            std::vector<uint32_t> order;
+            for (uint32_t i = 0; i < p.blocks.size(); i++) {
+                if (p.blocks[i].handle && !p.blocks[i].dedicated) {
+                    order.push_back(i);
+                }
+            }
+            std::sort(order.begin(), order.end(), [&p](uint32_t a, uint32_t b) {
+                return p.blocks[a].usedBytes < p.blocks[b].usedBytes;
+            });
+
+            for (unsigned int src = 0; src + 1 < order.size(); src++) {
+                // copy, live ranges change while moving
+                std::map<uint64_t, liveRange> live = p.blocks[order[src]].live;
+                for (auto& [offset, range] : live) {
+                    MemoryAllocation from;
+                    from.block = p.blocks[order[src]].handle;
+                    from.offset = offset;
+                    from.size = range.size;
+                    from.mapped = p.blocks[order[src]].mapped ? (char*)p.blocks[order[src]].mapped + offset : nullptr;
+                    from.poolIdx = poolIdx;
+                    from.blockIdx = order[src];
+                    from.order = range.order;
+
+                    // fullest blocks first
+                    MemoryAllocation to;
+                    bool placed = false;
+                    for (unsigned int dst = order.size() - 1; dst > src && !placed; dst--) {
+                        if (allocateFrom(p.blocks[order[dst]], range.order, range.size, to)) {
+                            fill(to, poolIdx, order[dst], range.size);
+                            placed = true;
+                        }
+                    }
+                    if (!placed) {
+                        continue;
+                    }
+
+                    if (move(from, to)) {
+                        free(from);
+                        noMoved++;
+                    }
+                    else {
+                        free(to);
+                    }
+                }
+            }
+        }
+
+        return noMoved;
+    }
+
+    /*
+        accessors
+    */
+
+    MemoryStats getStats() const {
+        MemoryStats ret;
+        // sum of the largest free range of each block
+        uint64_t largestFreeBytes = 0;
+        for (const pool& p : pools) {
+            for (const block& b : p.blocks) {
+                if (!b.handle) {
+                    continue;
+                }
+
+                ret.noBlocks++;
+                ret.noDedicated += b.dedicated;
+                ret.noAllocations += b.live.size();
+                ret.blockBytes += b.size;
+                ret.usedBytes += b.usedBytes;
+
+                if (!b.dedicated) {
+                    uint64_t blockLargest = 0;
+                    for (unsigned char order = 0; order <= maxOrder; order++) {
+                        uint64_t rangeSize = minAllocation << order;
+                        ret.freeBytes += b.freeLists[order].size() * rangeSize;
+                        if (!b.freeLists[order].empty()) {
+                            blockLargest = rangeSize;
+                        }
+                    }
+                    largestFreeBytes += blockLargest;
+                    ret.largestFree = std::max(ret.largestFree, blockLargest);
+                }
+            }
+        }
+
+        if (ret.freeBytes) {
+            ret.fragmentation = 1.0f - (float)largestFreeBytes / (float)ret.freeBytes;
+        }
+        return ret;
+    }
+
+    uint64_t getBlockSize() const { return blockSize; }
+
+private:
+    static const uint32_t NO_BLOCK = 0xffffffff;
+
+    struct liveRange {
+        unsigned char order;
+        uint64_t size;
+    };
+
+    struct block {
+        // handle from the source (0 once released, the slot is reused)
+        uint64_t handle = 0;
+        void* mapped = nullptr;
+        uint64_t size = 0;
+        bool dedicated = false;
+
+        // offsets of the free ranges of each order
+        std::vector<std::set<uint64_t>> freeLists;
+        // allocated ranges by offset
+        std::map<uint64_t, liveRange> live;
+        uint64_t usedBytes = 0;
+    };
+
+    struct pool {
+        uint32_t memoryType = 0;
+        std::vector<block> blocks;
+    };
+
+    MemoryBlockSource& source;
+    uint64_t blockSize;
+    uint64_t minAllocation;
+    unsigned char maxOrder;
+
+    // index = memory type * 2 + linear
+    std::vector<pool> pools;
+
+    // take a free range of the order from a block, splitting a larger one if needed
+    bool allocateFrom(block& b, unsigned char order, uint64_t size, MemoryAllocation& out) {
+        unsigned char j = order;
+        while (j <= maxOrder && b.freeLists[j].empty()) {
+            j++;
+        }
+        if (j > maxOrder) {
+            return false;
+        }
+
+        uint64_t offset = *b.freeLists[j].begin();
+        b.freeLists[j].erase(b.freeLists[j].begin());
+
+        // upper halves go back to the free lists
+        while (j > order) {
+            j--;
+            b.freeLists[j].insert(offset + (minAllocation << j));
+        }
+
+        b.live[offset] = { order, size };
+        b.usedBytes += size;
+
+        out.offset = offset;
+        out.order = order;
+        return true;
+    }
+
+    bool allocateDedicated(uint32_t poolIdx, uint64_t size, uint64_t alignment, MemoryAllocation& out) {
+        // blocks start at offset 0, which satisfies any alignment
+        uint32_t blockIdx = addBlock(poolIdx, size, true);
+        if (blockIdx == NO_BLOCK) {
+            return false;
+        }
+
+        block& b = pools[poolIdx].blocks[blockIdx];
+        b.live[0] = { MEMORY_DEDICATED_ORDER, size };
+        b.usedBytes = size;
+
+        out.offset = 0;
+        out.order = MEMORY_DEDICATED_ORDER;
+        fill(out, poolIdx, blockIdx, size);
+        return true;
+    }
+
+    void fill(MemoryAllocation& out, uint32_t poolIdx, uint32_t blockIdx, uint64_t size) {
+        const block& b = pools[poolIdx].blocks[blockIdx];
+        out.block = b.handle;
+        out.size = size;
+        out.mapped = b.mapped ? (char*)b.mapped + out.offset : nullptr;
+        out.poolIdx = poolIdx;
+        out.blockIdx = blockIdx;
+    }
+
+    // request a block from the source, returns its index in the pool (NO_BLOCK if out of memory)
+    uint32_t addBlock(uint32_t poolIdx, uint64_t size, bool dedicated) {
+        pool& p = pools[poolIdx];
+
+        void* mapped = nullptr;
+        uint64_t handle = source.allocateBlock(p.memoryType, size, &mapped);
+        if (!handle) {
+            return NO_BLOCK;
+        }
+
+        // reuse a released slot so indices held by allocations stay valid
+        uint32_t idx = 0;
+        while (idx < p.blocks.size() && p.blocks[idx].handle) {
+            idx++;
+        }
+        if (idx == p.blocks.size()) {
+            p.blocks.emplace_back();
+        }
+
+        block& b = p.blocks[idx];
+        b = block();
+        b.handle = handle;
+        b.mapped = mapped;
+        b.size = size;
+        b.dedicated = dedicated;
+        if (!dedicated) {
+            b.freeLists.resize(maxOrder + 1);
+            b.freeLists[maxOrder].insert(0);
+        }
+        return idx;
+    }
+
+    void releaseBlock(pool& p, uint32_t blockIdx) {
+        source.freeBlock(p.blocks[blockIdx].handle);
+        p.blocks[blockIdx] = block();
+    }
+
+    // return an empty shared block to the source if the pool has another empty one
+    void releaseEmptyBlock(pool& p, uint32_t blockIdx) {
+        for (uint32_t i = 0; i < p.blocks.size(); i++) {
+            if (i != blockIdx && p.blocks[i].handle && !p.blocks[i].dedicated && p.blocks[i].live.empty()) {
+                releaseBlock(p, blockIdx);
+                return;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef DRAWBATCHER_HPP
+#define DRAWBATCHER_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+/*
+    indexed indirect draw command
+    - same layout as VkDrawIndexedIndirectCommand, so arrays of it are written to indirect buffers as is
+*/
+typedef struct IndirectCommand {
+    uint32_t indexCount;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t firstInstance;
+} IndirectCommand;
+
+/*
+    contiguous commands of one bucket in the batch
+*/
+typedef struct DrawBucket {
+    // pipeline/material the commands are drawn with
+    uint64_t key;
+    // range in DrawBatcher::getCommands()
+    uint32_t firstCommand;
+    uint32_t noCommands;
+} DrawBucket;
+
+/*
+    draw batcher
+    - collects the draws of a frame with the key of the pipeline/material they need
+    - build() sorts them into one array with the commands of each bucket next to each other,
+      so each bucket is a single multi-draw indirect call on one buffer
+    - each command carries a tag (e.g. the cull group of its instances), kept next to it by the sort
+*/
+
+class DrawBatcher {
+public:
+    /*
+        functionality
+    */
+
+    // drop the draws of the last frame
+    void clear() {
+        draws.clear();
+        commands.clear();
+        tags.clear();
+        buckets.clear();
+    }
+
+    // add a draw to the bucket of key (draws without instances are skipped)
+    void add(uint64_t key, const IndirectCommand& command, uint32_t tag = 0) {
+        if (command.instanceCount && command.indexCount) {
+            draws.push_back({ key, command, tag });
+        }
+    }
+
+    // sort the draws into buckets
+    void build() {
+        // stable, draws of a bucket keep the order they were added in
+        std::stable_sort(draws.begin(), draws.end(), [](const keyedDraw& a, const keyedDraw& b) {
+            return a.key < b.key;
+        });
+
+        commands.clear();
+        tags.clear();
+        buckets.clear();
+        for (const keyedDraw& draw : draws) {
+            if (buckets.empty() || buckets.back().key != draw.key) {
+                buckets.push_back({ draw.key, (uint32_t)commands.size(), 0 });
+            }
+            commands.push_back(draw.command);
+            tags.push_back(draw.tag);
+            buckets.back().noCommands++;
+        }
+    }
+
+    /*
+        accessors
+    */
+
+    // commands of all buckets (after build)
+    const std::vector<IndirectCommand>& getCommands() const { return commands; }
+    // tag of each command
+    const std::vector<uint32_t>& getTags() const { return tags; }
+    const std::vector<DrawBucket>& getBuckets() const { return buckets; }
+
+private:
+    struct keyedDraw {
+        uint64_t key;
+        IndirectCommand command;
+        uint32_t tag;
+    };
+
+    std::vector<keyedDraw> draws;
+
+    std::vector<IndirectCommand> commands;
+    std::vector<uint32_t> tags;
+    std::vector<DrawBucket> buckets;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef RANGEALLOCATOR_HPP
+#define RANGEALLOCATOR_HPP
+
+#include <map>
+#include <iterator>
+#include <cstdint>
+
+// offset returned when a range does not fit
+#define RANGE_ALLOC_FAILED 0xffffffffffffffffULL
+
+/*
+    range allocator
+    - hands out ranges of [0, capacity) in any unit (bytes, vertices, indices)
+    - first fit over the free ranges (kept sorted by offset), freed ranges merge with free neighbours
+*/
+
+class RangeAllocator {
+public:
+    RangeAllocator(uint64_t capacity = 0)
+        : capacity(capacity), used(0) {
+        if (capacity) {
+            freeRanges[0] = capacity;
+        }
+    }
+
+    /*
+        functionality
+    */
+
+    // offset of a free range of size (RANGE_ALLOC_FAILED if no free range is large enough)
+    uint64_t allocate(uint64_t size) {
+        if (!size) {
+            return RANGE_ALLOC_FAILED;
+        }
+
+        for (auto it = freeRanges.begin(); it != freeRanges.end(); it++) {
+            if (it->second >= size) {
+                uint64_t offset = it->first;
+                uint64_t rest = it->second - size;
+                freeRanges.erase(it);
+                if (rest) {
+                    freeRanges[offset + size] = rest;
+                }
+
+                used += size;
+                return offset;
+            }
+        }
+        return RANGE_ALLOC_FAILED;
+    }
+
+    // return a range
+    void free(uint64_t offset, uint64_t size) {
+        if (!size) {
+            return;
+        }
+        used -= size;
+
+        auto next = freeRanges.lower_bound(offset);
+
+        // merge with the free range before
+        if (next != freeRanges.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == offset) {
+                offset = prev->first;
+                size += prev->second;
+                freeRanges.erase(prev);
+            }
+        }
+
+        // merge with the free range after
+        if (next != freeRanges.end() && offset + size == next->first) {
+            size += next->second;
+            freeRanges.erase(next);
+        }
+
+        freeRanges[offset] = size;
+    }
+
+    /*
+        accessors
+    */
+
+    uint64_t getCapacity() const { return capacity; }
+    uint64_t getUsed() const { return used; }
+    unsigned int getNoFreeRanges() const { return freeRanges.size(); }
+
+private:
+    uint64_t capacity;
+    uint64_t used;
+
+    // size of each free range by offset
+    std::map<uint64_t, uint64_t> freeRanges;
+};
+
+#endif
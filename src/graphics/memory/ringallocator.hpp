@@ -0,0 +1,122 @@
+#ifndef RINGALLOCATOR_HPP
+#define RINGALLOCATOR_HPP
+
+#include <vector>
+#include <cstdint>
+
+// offset returned when an allocation does not fit
+#define RING_ALLOC_FAILED 0xffffffffffffffffULL
+
+/*
+    ring allocator
+    - hands out aligned byte ranges of a fixed size buffer, in order, for the frame being recorded
+    - each frame in flight owns the bytes it allocated until the frame comes around again
+      (beginFrame must only be called once the device has finished the frame that last used the index,
+      i.e. after its fence was waited on)
+    - an allocation that does not fit before the end of the buffer starts again at 0, the skipped
+      bytes are owned by the frame until it is released
+    - only offsets are handled (no device memory), so the logic can be used and tested without a GPU
+*/
+
+class RingAllocator {
+public:
+    RingAllocator(uint64_t capacity = 0, uint64_t alignment = 1, unsigned int noFrames = 1)
+        : capacity(capacity), alignment(alignment ? alignment : 1), head(0), used(0),
+        currentFrame(0), frameBytes(noFrames ? noFrames : 1, 0) {}
+
+    /*
+        functionality
+    */
+
+    // release the bytes of the frame that last used frameIdx and start allocating for it
+    void beginFrame(unsigned int frameIdx) {
+        currentFrame = frameIdx % frameBytes.size();
+        used -= frameBytes[currentFrame];
+        frameBytes[currentFrame] = 0;
+
+        if (!used) {
+            // nothing in flight, restart at the front so large allocations do not have to wrap
+            head = 0;
+        }
+    }
+
+    // offset of size bytes aligned to the ring alignment (RING_ALLOC_FAILED if the ring is full)
+    uint64_t allocate(uint64_t size) {
+        if (!size || size > capacity) {
+            return RING_ALLOC_FAILED;
+        }
+
+        // start of the bytes still in flight
+        uint64_t tail = (head + capacity - used) % capacity;
+        bool wrapped = used && head <= tail;
+
+        uint64_t offset = alignUp(head);
+        uint64_t consumed;
+        if (!wrapped) {
+            // free bytes are [head, capacity) and [0, tail)
+            if (offset + size <= capacity) {
+                consumed = offset + size - head;
+            }
+            else if (size <= (used ? tail : capacity)) {
+                offset = 0;
+                consumed = capacity - head + size;
+            }
+            else {
+                return RING_ALLOC_FAILED;
+            }
+        }
+        else {
+            // free bytes are [head, tail)
+            if (offset + size > tail) {
+                return RING_ALLOC_FAILED;
+            }
+            consumed = offset + size - head;
+        }
+
+        head = (offset + size) % capacity;
+        used += consumed;
+        frameBytes[currentFrame] += consumed;
+        return offset;
+    }
+
+    // release all bytes (only once the device is idle)
+    void reset() {
+        head = 0;
+        used = 0;
+        for (uint64_t& bytes : frameBytes) {
+            bytes = 0;
+        }
+    }
+
+    /*
+        accessors
+    */
+
+    uint64_t getCapacity() const { return capacity; }
+    uint64_t getAlignment() const { return alignment; }
+    // bytes owned by frames in flight (including alignment padding and skipped bytes)
+    uint64_t getUsed() const { return used; }
+    // bytes allocated by a frame since its beginFrame
+    uint64_t getFrameBytes(unsigned int frameIdx) const { return frameBytes[frameIdx % frameBytes.size()]; }
+    unsigned int getNoFrames() const { return frameBytes.size(); }
+
+    // round val up to the next multiple of the ring alignment
+    uint64_t alignUp(uint64_t val) const {
+        return (val + alignment - 1) / alignment * alignment;
+    }
+
+private:
+    uint64_t capacity;
+    uint64_t alignment;
+
+    // next byte to allocate
+    uint64_t head;
+    // bytes owned by frames in flight, ending at head
+    uint64_t used;
+
+    unsigned int currentFrame;
+    // bytes owned by each frame
+    std::vector<uint64_t> frameBytes;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "mesh.hpp"
+#include <algorithm>
 #include <iostream>
 
 
@@ -146,7 +147,10 @@ void Mesh::setupTextures(std::vector<Texture> textures) {
     this->noTextures = false;
     this->textures.insert(this->textures.end(), textures.begin(), textures.end());
 
-    
+    // sampled once their uploads finished, so the mesh waits for them like for its buffers
+    for (const Texture& texture : textures) {
+        uploadTicket = std::max(uploadTicket, texture.uploadTicket);
+    }
 }
 
 // setup material colors
@@ -249,17 +253,6 @@ void Mesh::createVertexBuffers() {
     VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
     uint32_t vertexSize = sizeof(vertices[0]);
 
-    VulkanBuffer stagingBuffer{
-            vulkanDevice,
-            vertexSize,
-            vertexCount,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-    };
-
-    stagingBuffer.map();
-    stagingBuffer.writeToBuffer((void *)vertices.data());
-
     vertexBuffer = std::make_unique<VulkanBuffer>(
             vulkanDevice,
             vertexSize,
@@ -267,7 +260,9 @@ void Mesh::createVertexBuffers() {
             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-    vulkanDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+    // staged and copied on the transfer queue, drawn once isReady
+    uploadTicket = std::max(uploadTicket,
+        vulkanDevice.getUploadManager().uploadBuffer(vertexBuffer->getBuffer(), 0, vertices.data(), bufferSize));
 }
 
 
@@ -282,17 +277,6 @@ void Mesh::createIndexBuffers() {
 	VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
 	uint32_t indexSize = sizeof(indices[0]);
 
-	VulkanBuffer stagingBuffer{
-			vulkanDevice,
-			indexSize,
-			indexCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-	};
-
-	stagingBuffer.map();
-	stagingBuffer.writeToBuffer((void *)indices.data());
-
 	indexBuffer = std::make_unique<VulkanBuffer>(
 			vulkanDevice,
 			indexSize,
@@ -300,7 +284,12 @@ void Mesh::createIndexBuffers() {
 			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	vulkanDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+	uploadTicket = std::max(uploadTicket,
+			vulkanDevice.getUploadManager().uploadBuffer(indexBuffer->getBuffer(), 0, indices.data(), bufferSize));
+}
+
+bool Mesh::isReady() {
+	return vulkanDevice.getUploadManager().isReady(uploadTicket);
 }
 
 
@@ -308,10 +297,12 @@ void Mesh::createIndexBuffers() {
 
 
 
-void Mesh::bind(VkCommandBuffer commandBuffer, VkBuffer instanceBuffer, VkBuffer normalizedInstanceBuffer) {
-    // Bind the mesh's vertex buffer, the instance and normalized instance buffers (shared across meshes)
+void Mesh::bind(VkCommandBuffer commandBuffer, VkBuffer instanceBuffer, VkBuffer normalizedInstanceBuffer,
+    VkDeviceSize instanceOffset, VkDeviceSize normalizedInstanceOffset) {
+    // Bind the mesh's vertex buffer, the instance and normalized instance buffers (shared across meshes,
+    // offsets are used when they are slices of a ring buffer)
     VkBuffer buffers[] = { vertexBuffer->getBuffer(), instanceBuffer, normalizedInstanceBuffer };
-    VkDeviceSize offsets[] = { 0, 0, 0 };
+    VkDeviceSize offsets[] = { 0, instanceOffset, normalizedInstanceOffset };
     vkCmdBindVertexBuffers(commandBuffer, 0, 3, buffers, offsets);
 
     // Bind the mesh's index buffer if it exists
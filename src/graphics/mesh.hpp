@@ -148,8 +148,17 @@ public:
     // free up memory
     void cleanup();
 
+    // if drawn with textures (meshes with and without are batched apart)
+    bool hasTextures() const { return !noTextures; }
+
+    // if the uploads of the vertex and index buffers and of the textures finished (the mesh is skipped until then)
+    bool isReady();
+    // last upload the mesh waits for
+    UploadTicket getUploadTicket() const { return uploadTicket; }
+
     void pushConstants(ShaderPipline& shader_pipeline, VkCommandBuffer& commandBuffer);
-	void bind(VkCommandBuffer commandBuffer, VkBuffer instanceBuffer, VkBuffer normalizedInstanceBuffer);
+	void bind(VkCommandBuffer commandBuffer, VkBuffer instanceBuffer, VkBuffer normalizedInstanceBuffer,
+		VkDeviceSize instanceOffset = 0, VkDeviceSize normalizedInstanceOffset = 0);
 	void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount);
 
 private:
@@ -168,6 +177,9 @@ private:
 	std::unique_ptr<VulkanBuffer> indexBuffer;
 	uint32_t indexCount;
 
+	// last upload of the buffers and textures
+	UploadTicket uploadTicket = 0;
+
     // setup data with buffers
     //void setup();
 };
\ No newline at end of file
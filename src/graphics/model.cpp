@@ -4,6 +4,7 @@
 // libs
 //#define TINYOBJLOADER_IMPLEMENTATION
 //#include <tiny_obj_loader.h>
+#include <assimp/DefaultIOSystem.h>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -15,10 +16,13 @@
 // std
 #include <cassert>
 #include <cstring>
+#include <algorithm>
 #include <unordered_map>
+#include <unordered_set>
 #include <iostream>
 #include <limits>
 #include <span>
+#include <type_traits>
 
 //#include "../scene.hpp"
 
@@ -38,6 +42,9 @@ struct hash<Vertex> {
 };
 }	// namespace std
 
+// vertices are copied to and from cooked files as bytes
+static_assert(std::is_trivially_copyable_v<Vertex>, "Vertex must be trivially copyable");
+
 
 Model::~Model() {}
 /*
@@ -78,9 +85,93 @@ Model::Model(VulkanDevice &vulkanDevice, unsigned int flags = 0) : vulkanDevice{
 void Model::init() {}
 
 
+// records the files Assimp reads for a model (the model file and e.g. its .bin or .mtl)
+class RecordingIOSystem : public Assimp::DefaultIOSystem {
+public:
+    std::vector<std::string> paths;
+
+    Assimp::IOStream* Open(const char* file, const char* mode = "rb") override {
+        Assimp::IOStream* stream = DefaultIOSystem::Open(file, mode);
+        if (stream && std::find(paths.begin(), paths.end(), file) == paths.end()) {
+            paths.push_back(file);
+        }
+        return stream;
+    }
+};
+
+// colors and texture paths of an Assimp material, in the order processMesh uses them
+static CookedModel::Material importMaterial(aiMaterial* mat) {
+    CookedModel::Material ret;
+
+    aiColor4D diff(1.0f);
+    aiColor4D spec(1.0f);
+    aiGetMaterialColor(mat, AI_MATKEY_COLOR_DIFFUSE, &diff);
+    aiGetMaterialColor(mat, AI_MATKEY_COLOR_SPECULAR, &spec);
+    std::memcpy(ret.diffuse, &diff, sizeof(ret.diffuse));
+    std::memcpy(ret.specular, &spec, sizeof(ret.specular));
+
+    // Use HEIGHT for .obj files if needed
+    for (aiTextureType type : { aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_NORMALS }) {
+        for (unsigned int i = 0; i < mat->GetTextureCount(type); ++i) {
+            aiString str;
+            mat->GetTexture(type, i, &str);
+            ret.textures.push_back({ (uint32_t)type, str.C_Str() });
+        }
+    }
+    return ret;
+}
+
 // load model from path
+// - read from the cooked file next to it (filepath + COOKED_MODEL_EXTENSION) if it is up to date,
+//   otherwise imported with Assimp and cooked for the next run
+// - textures are decoded on the job system (meshes are too when Assimp imports them)
+// - Meshes are created on the calling thread, their buffers and the textures upload on the transfer queue
 void Model::loadModel(const std::string filepath) {
+    // Parse directory from filepath
+    directory = filepath.substr(0, filepath.find_last_of('/'));
+
+    std::vector<ImportedMesh> imported;
+    std::vector<CookedModel::Material> materials;
+
+    CookedModel cooked;
+    if (cooked.open(filepath + COOKED_MODEL_EXTENSION, sizeof(Vertex))) {
+        readCooked(cooked, imported, materials);
+        cooked.close();
+    }
+    else {
+        std::cout << "Cooked model not used for " << filepath << " (" << cooked.getLoadError() << ")" << std::endl;
+        if (!importScene(filepath, imported, materials)) {
+            return;
+        }
+    }
+
+    ModelImportProgress progress{ this, 0, 0, (unsigned int)imported.size(), 0 };
+
+    // textures the meshes use are decoded in parallel and uploaded before the meshes are created
+    if (!States::isActive<unsigned int>(&switches, NO_TEX)) {
+        loadSceneTextures(materials, progress);
+    }
+
+    for (ImportedMesh& current : imported) {
+        meshes.push_back(processMesh(current, materials));
+        boundingRegions.push_back(meshes.back()->meshBoundingRegion);
+
+        progress.noMeshesDone++;
+        if (onProgress) {
+            onProgress(progress);
+        }
+    }
+
+    // start the copies of this model instead of waiting for the next frame
+    vulkanDevice.getUploadManager().flush();
+}
+
+// import a model file with Assimp (meshes in parallel) and write its cooked file, false if it could not be read
+bool Model::importScene(const std::string& filepath, std::vector<ImportedMesh>& imported, std::vector<CookedModel::Material>& materials) {
     Assimp::Importer import;
+    // owned by the importer
+    RecordingIOSystem* io = new RecordingIOSystem();
+    import.SetIOHandler(io);
 
     // Load the model with ASSIMP
     const aiScene* scene = import.ReadFile(filepath, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
@@ -88,53 +179,116 @@ void Model::loadModel(const std::string filepath) {
     // Check for errors
     if (!scene || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) || !scene->mRootNode) {
         std::cerr << "Failed to load model: " << filepath << "\n" << import.GetErrorString() << std::endl;
-        return;
+        return false;
     }
 
-    // Parse directory from filepath
-    directory = filepath.substr(0, filepath.find_last_of('/'));
+    // meshes in the order of the node tree
+    std::vector<unsigned int> meshIndices;
+    processNode(scene->mRootNode, meshIndices);
+
+    // geometry of every mesh in parallel (only reads the aiScene)
+    imported.resize(meshIndices.size());
+    JobSystem::run(jobs, imported.size(), 1, [&](unsigned int begin, unsigned int end, unsigned int) {
+        for (unsigned int i = begin; i < end; i++) {
+            importMesh(scene->mMeshes[meshIndices[i]], imported[i]);
+        }
+    });
+
+    for (aiMaterial* mat : std::span(scene->mMaterials, scene->mNumMaterials)) {
+        materials.push_back(importMaterial(mat));
+    }
+
+    // cooked for the next run (the model still loads if it cannot be written)
+    std::vector<CookedModel::MeshSource> sources(imported.size());
+    for (unsigned int i = 0; i < imported.size(); i++) {
+        const ImportedMesh& current = imported[i];
+        CookedModel::MeshSource& source = sources[i];
+        source.vertices = current.vertices.data();
+        source.vertexCount = current.vertices.size();
+        source.indices = current.indices.data();
+        source.indexCount = current.indices.size();
+        source.materialIndex = current.materialIndex;
+        std::memcpy(source.bounds.sphere, &current.br.center, sizeof(glm::vec3));
+        source.bounds.sphere[3] = current.br.radius;
+        std::memcpy(source.bounds.min, &current.min, sizeof(glm::vec3));
+        std::memcpy(source.bounds.max, &current.max, sizeof(glm::vec3));
+        source.collisionPoints = current.collisionPoints.data();
+        source.noCollisionPoints = current.collisionPoints.size() / 3;
+        source.collisionIndices = current.collisionIndices.data();
+        source.noCollisionFaces = current.collisionIndices.size() / 3;
+    }
 
-    // Process the root node
-    processNode(scene->mRootNode, scene);
+    std::string error;
+    if (!CookedModel::write(filepath + COOKED_MODEL_EXTENSION, sizeof(Vertex), io->paths, sources, materials, error)) {
+        std::cerr << "Failed to cook model: " << filepath << "\n" << error << std::endl;
+    }
+    return true;
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene) {
-    // Process all meshes in the current node
-    for (unsigned int meshIndex : std::span(node->mMeshes, node->mNumMeshes)) {
-        aiMesh* mesh = scene->mMeshes[meshIndex];
+// copy the meshes and materials out of a mapped cooked file (meshes in parallel)
+void Model::readCooked(const CookedModel& cooked, std::vector<ImportedMesh>& imported, std::vector<CookedModel::Material>& materials) {
+    imported.resize(cooked.noMeshes());
+    JobSystem::run(jobs, imported.size(), 1, [&](unsigned int begin, unsigned int end, unsigned int) {
+        for (unsigned int i = begin; i < end; i++) {
+            CookedModel::MeshView view = cooked.getMesh(i);
+            ImportedMesh& current = imported[i];
+
+            // vertices are stored as the engine uses them
+            current.vertices.resize(view.vertexCount);
+            std::memcpy(current.vertices.data(), view.vertices, view.vertexCount * sizeof(Vertex));
+            current.indices.resize(view.indexCount);
+            cooked.readIndices(i, current.indices.data());
+            current.materialIndex = view.materialIndex;
+
+            current.br = BoundingRegion(BoundTypes::SPHERE);
+            current.br.center = glm::vec3(view.bounds.sphere[0], view.bounds.sphere[1], view.bounds.sphere[2]);
+            current.br.ogCenter = current.br.center;
+            current.br.radius = view.bounds.sphere[3];
+            current.br.ogRadius = current.br.radius;
+            current.br.collisionMesh = nullptr;
+            current.min = glm::vec3(view.bounds.min[0], view.bounds.min[1], view.bounds.min[2]);
+            current.max = glm::vec3(view.bounds.max[0], view.bounds.max[1], view.bounds.max[2]);
+
+            current.collisionPoints.assign(view.collisionPoints, view.collisionPoints + 3 * view.noCollisionPoints);
+            current.collisionIndices.assign(view.collisionIndices, view.collisionIndices + 3 * view.noCollisionFaces);
+        }
+    });
 
-		//we add the mesh to the meshes list
-        meshes.push_back(processMesh(mesh, scene));
-		//meshes.back() is the mesh we just processed the line above
-        boundingRegions.push_back(meshes.back()->meshBoundingRegion); // Push bounding region
+    for (unsigned int i = 0; i < cooked.noMaterials(); i++) {
+        materials.push_back(cooked.getMaterial(i));
     }
+}
+
+// collect the meshes of a node and its children
+void Model::processNode(aiNode* node, std::vector<unsigned int>& meshIndices) {
+    meshIndices.insert(meshIndices.end(), node->mMeshes, node->mMeshes + node->mNumMeshes);
 
     // Recursively process child nodes
     for (aiNode* child : std::span(node->mChildren, node->mNumChildren)) {
-        processNode(child, scene);
+        processNode(child, meshIndices);
     }
 }
 
+// vertices (without duplicates), indices and bounds of a mesh (no device calls, runs on any thread)
+void Model::importMesh(aiMesh* mesh, ImportedMesh& imported) {
+    imported.materialIndex = mesh->mMaterialIndex;
 
-// process mesh in object file
-std::unique_ptr<Mesh> Model::processMesh(aiMesh* mesh, const aiScene* scene) {
     // Reserve space to minimize reallocations
-    std::vector<Vertex> vertices(mesh->mNumVertices);
-    std::vector<uint32_t> indices(3 * mesh->mNumFaces);
-
-    //vertices.reserve(mesh->mNumVertices);
-    //indices.reserve(3 * mesh->mNumFaces);
-    std::vector<Texture> textures;
+    std::vector<Vertex>& vertices = imported.vertices;
+    std::vector<uint32_t>& indices = imported.indices;
+    vertices.reserve(mesh->mNumVertices);
+    indices.reserve(3 * mesh->mNumFaces);
 
     // Setup bounding region and initial values
     BoundingRegion br(BoundTypes::SPHERE);
     glm::vec3 min(std::numeric_limits<float>::max());
     glm::vec3 max(std::numeric_limits<float>::lowest());
 
-    // Process vertices
-	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+    // Process vertices, remap[i] is the unique vertex of assimp vertex i
+    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+    std::vector<uint32_t> remap(mesh->mNumVertices);
     for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
-		Vertex vertex{};
+        Vertex vertex{};
 
         glm::vec3 position(
             mesh->mVertices[i].x,
@@ -162,12 +316,19 @@ std::unique_ptr<Mesh> Model::processMesh(aiMesh* mesh, const aiScene* scene) {
             mesh->mTangents[i].z
         );
 
-		//We do this so we only account for unique vectors. Less processing power needed
-		if (uniqueVertices.count(vertex) == 0) {
-			uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-			vertices.push_back(vertex);
-		}
-		indices.push_back(uniqueVertices[vertex]);
+        //We do this so we only account for unique vectors. Less processing power needed
+        auto [it, inserted] = uniqueVertices.try_emplace(vertex, static_cast<uint32_t>(vertices.size()));
+        if (inserted) {
+            vertices.push_back(vertex);
+        }
+        remap[i] = it->second;
+    }
+
+    // faces index the assimp vertices
+    for (const aiFace& face : std::span(mesh->mFaces, mesh->mNumFaces)) {
+        for (unsigned int index : std::span(face.mIndices, face.mNumIndices)) {
+            indices.push_back(remap[index]);
+        }
     }
 
     // Compute bounding region
@@ -180,39 +341,100 @@ std::unique_ptr<Mesh> Model::processMesh(aiMesh* mesh, const aiScene* scene) {
         br.radius = glm::max(br.radius, glm::length(vertex.position - br.center));
     }
     br.ogRadius = br.radius;
+    imported.br = br;
+    imported.min = min;
+    imported.max = max;
+}
 
+// create the Mesh of an imported mesh with its material (its buffers upload on the transfer queue)
+std::unique_ptr<Mesh> Model::processMesh(ImportedMesh& imported, const std::vector<CookedModel::Material>& materials) {
+    static const CookedModel::Material noMaterial;
+    const CookedModel::Material& material = imported.materialIndex < materials.size() ? materials[imported.materialIndex] : noMaterial;
 
     // Process material
     std::unique_ptr<Mesh> ret;     //Set bounding region
-    if (mesh->mMaterialIndex >= 0) {
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-
-        if (States::isActive<unsigned int>(&switches, NO_TEX)) {
-            // Use material colors
-            aiColor4D diff(1.0f);
-            aiColor4D spec(1.0f);
-            aiGetMaterialColor(material, AI_MATKEY_COLOR_DIFFUSE, &diff);
-            aiGetMaterialColor(material, AI_MATKEY_COLOR_SPECULAR, &spec);
-            ret = std::make_unique<Mesh>(br, diff, spec);
-        } else {
-            // Load textures
-            auto loadAndInsert = [&](aiTextureType type) {
-                auto maps = loadTextures(material, type);
-                textures.insert(textures.end(), maps.begin(), maps.end());
-            };
-            loadAndInsert(aiTextureType_DIFFUSE);
-            loadAndInsert(aiTextureType_SPECULAR);
-            loadAndInsert(aiTextureType_NORMALS); // Use HEIGHT for .obj files if needed
-            ret = std::make_unique<Mesh>(br, textures);
+    if (States::isActive<unsigned int>(&switches, NO_TEX)) {
+        // Use material colors
+        aiColor4D diff(material.diffuse[0], material.diffuse[1], material.diffuse[2], material.diffuse[3]);
+        aiColor4D spec(material.specular[0], material.specular[1], material.specular[2], material.specular[3]);
+        ret = std::make_unique<Mesh>(vulkanDevice, imported.br, diff, spec);
+    } else {
+        // textures were loaded by loadSceneTextures (ones that failed to decode are left out)
+        std::vector<Texture> textures;
+        for (const CookedModel::Texture& texture : material.textures) {
+            auto it = std::find_if(
+                textures_loaded.begin(), textures_loaded.end(),
+                [&texture](const Texture& tex) { return tex.path == texture.path; });
+            if (it != textures_loaded.end()) {
+                textures.push_back(*it);
+            }
         }
+        ret = std::make_unique<Mesh>(vulkanDevice, imported.br, textures);
     }
+
+    if (!imported.collisionPoints.empty()) {
+        ret->loadCollisionMesh(imported.collisionPoints.size() / 3, imported.collisionPoints.data(),
+            imported.collisionIndices.size() / 3, imported.collisionIndices.data());
+    }
+
     // Load vertex and index data (also create buffer)
-    ret->loadData(vertices, indices);
+    ret->loadData(std::move(imported.vertices), std::move(imported.indices));
 
-    return std::move(ret);
+    return ret;
 }
 
+// decode the textures of the materials that are not loaded yet in parallel and upload them
+// - decoded in waves of at most MODEL_IMPORT_TEXTURE_BYTES (sizes are read from the file headers),
+//   each wave is uploaded and freed before the next one is decoded
+void Model::loadSceneTextures(const std::vector<CookedModel::Material>& materials, ModelImportProgress& progress) {
+    // every path once, in the order processMesh asks for them
+    std::unordered_set<std::string> paths;
+    for (const Texture& loadedTex : textures_loaded) {
+        paths.insert(loadedTex.path);
+    }
+    std::vector<Texture> pending;
+    for (const CookedModel::Material& material : materials) {
+        for (const CookedModel::Texture& texture : material.textures) {
+            if (paths.insert(texture.path).second) {
+                pending.emplace_back(vulkanDevice, directory, texture.path, (aiTextureType)texture.type);
+            }
+        }
+    }
+    progress.noTextures = pending.size();
+
+    std::vector<char> decoded(pending.size(), 0);
+    for (unsigned int first = 0, noPending = pending.size(); first < noPending;) {
+        // at least one texture per wave, however large
+        unsigned int last = first;
+        unsigned long long waveBytes = 0;
+        do {
+            int width = 0, height = 0, channels = 0;
+            stbi_info((directory + "/" + pending[last].path).c_str(), &width, &height, &channels);
+            waveBytes += 4ULL * width * height;
+            last++;
+        } while (last < noPending && waveBytes < MODEL_IMPORT_TEXTURE_BYTES);
+
+        JobSystem::run(jobs, last - first, 1, [&](unsigned int begin, unsigned int end, unsigned int) {
+            for (unsigned int i = first + begin; i < first + end; i++) {
+                decoded[i] = pending[i].decode(false);
+            }
+        });
+
+        // the pixels are copied into the staging ring and freed
+        for (unsigned int i = first; i < last; i++) {
+            if (decoded[i]) {
+                pending[i].upload();
+                textures_loaded.push_back(pending[i]);
+            }
+        }
 
+        progress.noTexturesDone = last;
+        if (onProgress) {
+            onProgress(progress);
+        }
+        first = last;
+    }
+}
 
 // load list of textures
 std::vector<Texture> Model::loadTextures(aiMaterial* mat, aiTextureType type) {
@@ -240,7 +462,7 @@ std::vector<Texture> Model::loadTextures(aiMaterial* mat, aiTextureType type) {
         } 
         else {
             Texture tex(vulkanDevice, directory, texturePath, type);  // Load and add the new texture
-            tex.loadTextureImage(false);
+            tex.load(vulkanDevice, false);
             textures.push_back(tex);
             loadedPaths.insert(texturePath);
             textures_loaded.push_back(tex);             // Store in the global loaded textures
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "cooked_model.hpp"
 #include "mesh.hpp"
 #include "shader_pipeline.hpp"
 #include "texture.hpp"
@@ -16,6 +17,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 // std
+#include <functional>
 #include <memory>
 #include <vector>
 #include <span>
@@ -26,6 +28,7 @@
 #include "../physics/collisionmodel.hpp"
 #include "../physics/rigidbody.hpp"
 #include "../algorithms/bounds.hpp"
+#include "../algorithms/jobsystem.hpp"
 #include "../algorithms/states.hpp"
 //#include "../scene.hpp"
 
@@ -35,7 +38,36 @@
 #define CONST_INSTANCES		(unsigned int)2 // 0b00000010
 #define NO_TEX				(unsigned int)4	// 0b00000100
 
-
+// decoded texture bytes a model may hold at once while importing (textures are decoded in waves)
+#define MODEL_IMPORT_TEXTURE_BYTES (256ULL * 1024 * 1024)
+
+class Model;
+
+// progress of loadModel, reported on the loading thread after each texture wave and each mesh
+typedef struct ModelImportProgress {
+	const Model* model;
+	unsigned int noTextures;
+	unsigned int noTexturesDone;
+	unsigned int noMeshes;
+	unsigned int noMeshesDone;
+} ModelImportProgress;
+
+// e.g. renders a frame, meshes already created are drawn once their uploads are ready
+typedef std::function<void(const ModelImportProgress& progress)> ModelImportCallback;
+
+// geometry of a mesh (from Assimp or a cooked file), imported on any thread before its Mesh is created
+typedef struct ImportedMesh {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	uint32_t materialIndex = 0;
+	BoundingRegion br;
+	// box around the vertices (br is a sphere)
+	glm::vec3 min{0.0f};
+	glm::vec3 max{0.0f};
+	// optional collision mesh (xyz per point, 3 indices per face)
+	std::vector<float> collisionPoints;
+	std::vector<uint32_t> collisionIndices;
+} ImportedMesh;
 
 
 class Model {
@@ -50,6 +82,11 @@ class Model {
 	std::vector<Texture> textures_loaded;	// list of loaded textures
 	unsigned int switches;					// combination of switches above
 
+	// meshes are imported and textures decoded on these threads (on the calling thread if null)
+	JobSystem* jobs = nullptr;
+	// called on the loading thread while loadModel runs
+	ModelImportCallback onProgress;
+
 	//void render(Shader shader, float dt, Scene* scene);
 
     /*
@@ -73,8 +110,12 @@ class Model {
     virtual void init();
 
 	void loadModel(const std::string filepath);
-	void processNode(aiNode* node, const aiScene* scene);
-	std::unique_ptr<Mesh> processMesh(aiMesh* mesh, const aiScene* scene);
+	bool importScene(const std::string& filepath, std::vector<ImportedMesh>& imported, std::vector<CookedModel::Material>& materials);
+	void readCooked(const CookedModel& cooked, std::vector<ImportedMesh>& imported, std::vector<CookedModel::Material>& materials);
+	void processNode(aiNode* node, std::vector<unsigned int>& meshIndices);
+	void importMesh(aiMesh* mesh, ImportedMesh& imported);
+	std::unique_ptr<Mesh> processMesh(ImportedMesh& imported, const std::vector<CookedModel::Material>& materials);
+	void loadSceneTextures(const std::vector<CookedModel::Material>& materials, ModelImportProgress& progress);
 	std::vector<stbi_uc*> Model::loadTexturesAsPixels(aiMaterial* mat, aiTextureType type);
 	std::vector<Texture> Model::loadTextures(aiMaterial* mat, aiTextureType type);
 
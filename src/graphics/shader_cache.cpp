@@ -0,0 +1,434 @@
+#include "shader_cache.hpp"
+#include "../algorithms/timer.hpp"
+
+// std
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+//namespace lve {
+
+// first bytes of the archive and version of its layout
+#define SHADER_ARCHIVE_MAGIC 0x43565053	// "SPVC"
+#define SHADER_ARCHIVE_VERSION 1
+
+/*
+	archive layout (host byte order)
+		header
+		index: one indexEntry per shader, each followed by its path
+		blobs: SPIR-V words of each shader at the offset in its index entry
+*/
+struct archiveHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t noEntries;
+	uint32_t reserved;
+};
+
+struct indexEntry {
+	uint64_t key;
+	uint64_t variant;
+	// from the start of the file
+	uint64_t offset;
+	uint32_t noWords;
+	uint32_t pathLength;
+};
+
+/**
+ * @param sourceDirectory Directory the paths of requests and includes are relative to
+ * @param archivePath File the entries are loaded from and saved to
+ * @param compilerVersion Version of the compiler (part of every key, so a new compiler misses the old entries)
+ * @param compiler Compiles the shaders that are not in the cache
+ */
+ShaderCache::ShaderCache(
+		const std::string &sourceDirectory,
+		const std::string &archivePath,
+		const std::string &compilerVersion,
+		Compiler compiler)
+		: sourceDirectory{sourceDirectory},
+			archivePath{archivePath},
+			compilerVersion{compilerVersion},
+			compiler{std::move(compiler)} {}
+
+/**
+ * FNV-1a over data, continuing from seed (pass the previous hash to hash several pieces as one)
+ */
+uint64_t ShaderCache::hash(const void *data, size_t size, uint64_t seed) {
+	const unsigned char *bytes = static_cast<const unsigned char *>(data);
+	uint64_t ret = seed;
+	for (size_t i = 0; i < size; i++) {
+		ret ^= bytes[i];
+		ret *= 1099511628211ULL;
+	}
+	return ret;
+}
+
+/**
+ * Reads the index of the archive, blobs are read when they are hit
+ *
+ * @return false if there is no archive or it is not valid (the cache then starts empty)
+ */
+bool ShaderCache::load() {
+	auto start = std::chrono::steady_clock::now();
+	entries.clear();
+	dirty = false;
+
+	std::ifstream file{archivePath, std::ios::ate | std::ios::binary};
+	if (!file.is_open()) {
+		stats.loadMs += msSince(start);
+		return false;
+	}
+	uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+	file.seekg(0);
+
+	archiveHeader header{};
+	bool valid = file.read(reinterpret_cast<char *>(&header), sizeof(header))
+			&& header.magic == SHADER_ARCHIVE_MAGIC
+			&& header.version == SHADER_ARCHIVE_VERSION;
+
+	for (uint32_t i = 0; valid && i < header.noEntries; i++) {
+		indexEntry index{};
+		Entry entry;
+		valid = file.read(reinterpret_cast<char *>(&index), sizeof(index))
+				&& index.offset + uint64_t(index.noWords) * sizeof(uint32_t) <= fileSize
+				&& index.pathLength < fileSize;
+		if (valid) {
+			entry.path.resize(index.pathLength);
+			valid = static_cast<bool>(file.read(entry.path.data(), index.pathLength));
+		}
+
+		entry.variant = index.variant;
+		entry.offset = index.offset;
+		entry.noWords = index.noWords;
+		entries[index.key] = std::move(entry);
+	}
+
+	if (!valid) {
+		// stale or damaged, everything is compiled again
+		entries.clear();
+	}
+
+	stats.loadMs += msSince(start);
+	return valid;
+}
+
+/**
+ * Reads the SPIR-V of an entry from the archive
+ *
+ * @return false if the archive no longer holds it
+ */
+bool ShaderCache::readBlob(Entry &entry) {
+	if (!entry.noWords) {
+		return false;
+	}
+
+	std::ifstream file{archivePath, std::ios::binary};
+	if (!file.is_open()) {
+		return false;
+	}
+
+	entry.spirv.resize(entry.noWords);
+	file.seekg(static_cast<std::streamoff>(entry.offset));
+	if (!file.read(reinterpret_cast<char *>(entry.spirv.data()), entry.noWords * sizeof(uint32_t))) {
+		entry.spirv.clear();
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Rewrites the archive if entries were added
+ * - entries of a variant that was compiled again are dropped, all others are kept
+ * - written to a temporary file first, so a failed save leaves the old archive
+ *
+ * @return false if the archive could not be written
+ */
+bool ShaderCache::save() {
+	if (!dirty) {
+		return true;
+	}
+	auto start = std::chrono::steady_clock::now();
+
+	// variants hit or compiled in this run, older entries of them are out of date
+	std::unordered_map<uint64_t, uint64_t> currentKeys;
+	for (auto &[key, entry] : entries) {
+		if (entry.used) {
+			currentKeys[entry.variant] = key;
+		}
+	}
+
+	std::vector<uint64_t> kept;
+	for (auto it = entries.begin(); it != entries.end();) {
+		auto current = currentKeys.find(it->second.variant);
+		bool superseded = current != currentKeys.end() && current->second != it->first;
+
+		// blobs still in the old archive are read before it is replaced
+		if (superseded || (it->second.spirv.empty() && !readBlob(it->second))) {
+			it = entries.erase(it);
+			continue;
+		}
+		kept.push_back(it->first);
+		it++;
+	}
+
+	// index first, blobs after it
+	uint64_t offset = sizeof(archiveHeader);
+	for (uint64_t key : kept) {
+		offset += sizeof(indexEntry) + entries[key].path.size();
+	}
+
+	std::string tmpPath = archivePath + ".tmp";
+	{
+		std::ofstream file{tmpPath, std::ios::binary | std::ios::trunc};
+		if (!file.is_open()) {
+			stats.saveMs += msSince(start);
+			return false;
+		}
+
+		archiveHeader header{SHADER_ARCHIVE_MAGIC, SHADER_ARCHIVE_VERSION, static_cast<uint32_t>(kept.size()), 0};
+		file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+		for (uint64_t key : kept) {
+			Entry &entry = entries[key];
+			entry.offset = offset;
+			entry.noWords = static_cast<uint32_t>(entry.spirv.size());
+			offset += entry.noWords * sizeof(uint32_t);
+
+			indexEntry index{key, entry.variant, entry.offset, entry.noWords, static_cast<uint32_t>(entry.path.size())};
+			file.write(reinterpret_cast<const char *>(&index), sizeof(index));
+			file.write(entry.path.data(), entry.path.size());
+		}
+
+		for (uint64_t key : kept) {
+			const Entry &entry = entries[key];
+			file.write(reinterpret_cast<const char *>(entry.spirv.data()), entry.spirv.size() * sizeof(uint32_t));
+		}
+
+		if (!file) {
+			stats.saveMs += msSince(start);
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tmpPath, archivePath, error);
+	if (error) {
+		stats.saveMs += msSince(start);
+		return false;
+	}
+
+	dirty = false;
+	stats.saveMs += msSince(start);
+	return true;
+}
+
+/**
+ * Reads a source file once per getOrCompile, shared between the preprocessing threads
+ */
+const std::string &ShaderCache::readSource(const std::string &path) {
+	{
+		std::lock_guard<std::mutex> lock(sourcesMutex);
+		auto it = sources.find(path);
+		if (it != sources.end()) {
+			return it->second;
+		}
+	}
+
+	std::string fullPath = sourceDirectory + '/' + path;
+	std::ifstream file{fullPath, std::ios::ate | std::ios::binary};
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open shader: " + fullPath);
+	}
+
+	std::string contents(static_cast<size_t>(file.tellg()), '\0');
+	file.seekg(0);
+	file.read(contents.data(), contents.size());
+
+	// another thread may have read it meanwhile, the first copy is kept
+	std::lock_guard<std::mutex> lock(sourcesMutex);
+	return sources.emplace(path, std::move(contents)).first->second;
+}
+
+/**
+ * Appends the source of path to out, with its #include lines replaced by the included files
+ * - "file" and <file> are looked up next to the including file, then in the source directory
+ */
+void ShaderCache::expandIncludes(
+		const std::string &path, std::string &out, std::vector<std::string> &dependencies, unsigned int depth) {
+	if (depth > SHADER_MAX_INCLUDE_DEPTH) {
+		throw std::runtime_error("too many nested includes in shader: " + path);
+	}
+
+	const std::string &source = readSource(path);
+	dependencies.push_back(path);
+
+	for (size_t begin = 0, end; begin < source.size(); begin = end + 1) {
+		end = source.find('\n', begin);
+		if (end == std::string::npos) {
+			end = source.size();
+		}
+
+		size_t directive = source.find_first_not_of(" \t", begin);
+		if (directive >= end || source.compare(directive, 8, "#include") != 0) {
+			out.append(source, begin, end - begin);
+			out += '\n';
+			continue;
+		}
+
+		size_t open = source.find_first_of("\"<", directive + 8);
+		size_t close = open < end ? source.find_first_of("\">", open + 1) : std::string::npos;
+		if (open >= end || close >= end) {
+			throw std::runtime_error("malformed #include in shader: " + path);
+		}
+		std::string name = source.substr(open + 1, close - open - 1);
+
+		std::string relative = (std::filesystem::path(path).parent_path() / name).lexically_normal().generic_string();
+		bool nextToFile = std::filesystem::exists(sourceDirectory + '/' + relative);
+		expandIncludes(nextToFile ? relative : name, out, dependencies, depth + 1);
+	}
+}
+
+/**
+ * Expands the includes of a shader, adds the default header and defines, and hashes the result
+ */
+void ShaderCache::preprocess(const ShaderRequest &request, ShaderSource &source) {
+	source.request = &request;
+	source.dependencies.clear();
+
+	std::string body;
+	expandIncludes(request.path, body, source.dependencies, 0);
+	source.text = request.includeDefaultHeader ? defaultHeader + body : std::move(body);
+
+	if (!request.defines.empty()) {
+		std::string defineLines;
+		for (const std::string &define : request.defines) {
+			defineLines += "#define " + define + '\n';
+		}
+
+		// defines have to follow the #version line
+		size_t version = source.text.rfind("#version", 0) == 0 ? 0 : source.text.find("\n#version");
+		size_t pos = 0;
+		if (version != std::string::npos) {
+			pos = source.text.find('\n', version + 1);
+			pos = pos == std::string::npos ? source.text.size() : pos + 1;
+		}
+		source.text.insert(pos, defineLines);
+	}
+
+	source.key = hash(compilerVersion.data(), compilerVersion.size());
+	source.key = hash(&request.stage, sizeof(request.stage), source.key);
+	source.key = hash(source.text.data(), source.text.size(), source.key);
+
+	source.variant = hash(request.path.data(), request.path.size());
+	source.variant = hash(&request.stage, sizeof(request.stage), source.variant);
+	source.variant = hash(&request.includeDefaultHeader, sizeof(request.includeDefaultHeader), source.variant);
+	for (const std::string &define : request.defines) {
+		source.variant = hash(define.data(), define.size() + 1, source.variant);
+	}
+}
+
+/**
+ * Gets the SPIR-V of every request, compiling the ones that are not in the cache in parallel
+ * - sources are read once per call, even if several requests include them
+ * - new entries are kept in memory until save()
+ *
+ * @param spirv Set to the SPIR-V of each request, in order
+ * @throws std::runtime_error if a shader could not be read or compiled (with the compiler log)
+ */
+void ShaderCache::getOrCompile(std::span<const ShaderRequest> requests, std::vector<std::vector<uint32_t>> &spirv) {
+	unsigned int noRequests = static_cast<unsigned int>(requests.size());
+	spirv.resize(noRequests);
+
+	// preprocess
+	auto start = std::chrono::steady_clock::now();
+	sources.clear();
+	std::vector<ShaderSource> preprocessed(noRequests);
+	std::vector<std::string> errors(noRequests);
+	JobSystem::run(jobs, noRequests, 1, [&](unsigned int begin, unsigned int end, unsigned int) {
+		for (unsigned int i = begin; i < end; i++) {
+			// exceptions must not leave a worker thread
+			try {
+				preprocess(requests[i], preprocessed[i]);
+			} catch (const std::exception &e) {
+				errors[i] = e.what();
+			}
+		}
+	});
+	sources.clear();
+	stats.preprocessMs += msSince(start);
+
+	for (const std::string &error : errors) {
+		if (!error.empty()) {
+			throw std::runtime_error(error);
+		}
+	}
+
+	// look up, each missing key is compiled once
+	std::vector<unsigned int> misses;
+	std::unordered_map<uint64_t, unsigned int> missIndices;
+	for (unsigned int i = 0; i < noRequests; i++) {
+		auto it = entries.find(preprocessed[i].key);
+		if (it != entries.end() && (!it->second.spirv.empty() || readBlob(it->second))) {
+			it->second.used = true;
+			spirv[i] = it->second.spirv;
+			stats.noHits++;
+			continue;
+		}
+
+		stats.noMisses++;
+		if (missIndices.emplace(preprocessed[i].key, static_cast<unsigned int>(misses.size())).second) {
+			misses.push_back(i);
+		}
+	}
+	if (misses.empty()) {
+		return;
+	}
+
+	// compile
+	start = std::chrono::steady_clock::now();
+	std::vector<std::vector<uint32_t>> compiled(misses.size());
+	std::vector<unsigned char> compiledOk(misses.size(), 0);
+	std::vector<std::string> logs(misses.size());
+	JobSystem::run(jobs, static_cast<unsigned int>(misses.size()), 1, [&](unsigned int begin, unsigned int end, unsigned int) {
+		for (unsigned int m = begin; m < end; m++) {
+			try {
+				compiledOk[m] = compiler(preprocessed[misses[m]], compiled[m], logs[m]);
+			} catch (const std::exception &e) {
+				logs[m] = e.what();
+			}
+		}
+	});
+	stats.compileMs += msSince(start);
+
+	// successful shaders are cached even if another one failed
+	std::string failures;
+	for (unsigned int m = 0; m < misses.size(); m++) {
+		const ShaderSource &source = preprocessed[misses[m]];
+		if (!compiledOk[m]) {
+			failures += "failed to compile shader " + source.request->path + ":\n" + logs[m] + '\n';
+			continue;
+		}
+
+		Entry &entry = entries[source.key];
+		entry.path = source.request->path;
+		entry.variant = source.variant;
+		entry.offset = 0;
+		entry.noWords = 0;
+		entry.spirv = std::move(compiled[m]);
+		entry.used = true;
+		dirty = true;
+	}
+	if (!failures.empty()) {
+		throw std::runtime_error(failures);
+	}
+
+	for (unsigned int i = 0; i < noRequests; i++) {
+		if (spirv[i].empty()) {
+			spirv[i] = entries[preprocessed[i].key].spirv;
+		}
+	}
+}
+
+//}	// namespace lve
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "../algorithms/jobsystem.hpp"
+
+// std
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//namespace lve {
+
+// most nested #include levels before a shader is rejected (catches include cycles)
+#define SHADER_MAX_INCLUDE_DEPTH 16
+
+/*
+	shader to get from the cache
+*/
+struct ShaderRequest {
+	// path relative to the source directory
+	std::string path;
+	// stage of the compiler (EShLanguage for glslang), part of the key
+	int stage = 0;
+	// put the default header (defaultHead.gh) in front of the source
+	bool includeDefaultHeader = false;
+	// "NAME" or "NAME VALUE", added as #define lines after the #version line
+	std::vector<std::string> defines;
+};
+
+/*
+	shader after preprocessing, as the compiler gets it
+*/
+struct ShaderSource {
+	const ShaderRequest *request = nullptr;
+	// default header, defines and source with its includes expanded
+	std::string text;
+	// files that were read (the shader first, then its includes)
+	std::vector<std::string> dependencies;
+	// hash of the text, stage and compiler version
+	uint64_t key = 0;
+	// hash of the request (path, stage, header and defines), the same for every edit of the shader
+	uint64_t variant = 0;
+};
+
+/*
+	Content addressed cache of compiled shaders (SPIR-V)
+	- a shader is looked up by the hash of everything that goes into compiling it: its source with the
+		includes expanded, the default header, the defines, the stage and the compiler version,
+		so editing any of them (or updating the compiler) compiles it again
+	- entries are kept in a single archive file with an index in front, load() only reads the index and
+		blobs are read when they are hit
+	- shaders that are not in the cache are compiled in parallel on the job system
+	- nothing here needs a GPU or a compiler, the compiler is passed in (VulkanPipeline passes glslang)
+*/
+class ShaderCache {
+ public:
+	// compile a source into SPIR-V, false with the errors in log (called from any thread of the job system)
+	typedef std::function<bool(const ShaderSource &source, std::vector<uint32_t> &spirv, std::string &log)> Compiler;
+
+	// counts and timings since the cache was created
+	struct Stats {
+		uint32_t noHits = 0;
+		uint32_t noMisses = 0;
+		double loadMs = 0.0;
+		double preprocessMs = 0.0;
+		double compileMs = 0.0;
+		double saveMs = 0.0;
+	};
+
+	// splits preprocessing and compiling between threads (nullptr = calling thread only)
+	JobSystem *jobs = nullptr;
+
+	ShaderCache(
+			const std::string &sourceDirectory,
+			const std::string &archivePath,
+			const std::string &compilerVersion,
+			Compiler compiler);
+
+	ShaderCache(const ShaderCache &) = delete;
+	ShaderCache &operator=(const ShaderCache &) = delete;
+
+	void setDefaultHeader(const std::string &header) { defaultHeader = header; }
+
+	bool load();
+	bool save();
+
+	void getOrCompile(std::span<const ShaderRequest> requests, std::vector<std::vector<uint32_t>> &spirv);
+	void preprocess(const ShaderRequest &request, ShaderSource &source);
+
+	const Stats &getStats() const { return stats; }
+	uint32_t noEntries() const { return static_cast<uint32_t>(entries.size()); }
+	// if entries were added since the archive was loaded or saved
+	bool isDirty() const { return dirty; }
+
+	static uint64_t hash(const void *data, size_t size, uint64_t seed = 14695981039346656037ULL);
+
+ private:
+	struct Entry {
+		// shader the entry was compiled from (entries replaced by a newer key of the same variant are dropped in save)
+		std::string path;
+		uint64_t variant = 0;
+		// blob in the archive (noWords = 0 if the entry is not in the archive yet)
+		uint64_t offset = 0;
+		uint32_t noWords = 0;
+		// SPIR-V, empty until read from the archive or compiled
+		std::vector<uint32_t> spirv;
+		// if the entry was hit or compiled since the cache was created
+		bool used = false;
+	};
+
+	bool readBlob(Entry &entry);
+	const std::string &readSource(const std::string &path);
+	void expandIncludes(const std::string &path, std::string &out, std::vector<std::string> &dependencies, unsigned int depth);
+
+	std::string sourceDirectory;
+	std::string archivePath;
+	std::string compilerVersion;
+	Compiler compiler;
+	std::string defaultHeader;
+
+	std::unordered_map<uint64_t, Entry> entries;
+	bool dirty = false;
+
+	// sources read during the current getOrCompile (shared by the preprocessing threads)
+	std::unordered_map<std::string, std::string> sources;
+	std::mutex sourcesMutex;
+
+	Stats stats;
+};
+
+//}	// namespace lve
@@ -73,6 +73,8 @@ void ShaderPipline::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
 	if (vkCreatePipelineLayout(vulkanDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create pipeline layout!");
 	}
+	// pipelines are shared with other systems that create the same layout
+	vulkanDevice.getPipelineCache().registerPipelineLayout(pipelineLayout, pipelineLayoutInfo);
 }
 
 //CONSIDER HOW TO UPLOAD DATA TO SHADERS IN ORDER FOR SHADERS TO WORK
@@ -123,19 +125,24 @@ void ShaderPipline::set4Float(const std::string& name, float v1, float v2, float
 
 
 
-void ShaderPipline::renderGameObjects(FrameInfo& frameInfo) {
-    shaderPipeline->bind(frameInfo.commandBuffer);
-    //obj.render(shader_pipeline, dt, frameInfo.commandBuffer);
+// bind pipeline and global descriptor set (every secondary command buffer has to bind them again)
+void ShaderPipline::bind(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet) {
+    shaderPipeline->bind(commandBuffer);
 
     vkCmdBindDescriptorSets(
-        frameInfo.commandBuffer,
+        commandBuffer,
         VK_PIPELINE_BIND_POINT_GRAPHICS,
         pipelineLayout,
         0,
         1,
-        &frameInfo.globalDescriptorSet,
+        &globalDescriptorSet,
         0,
         nullptr);
+}
+
+void ShaderPipline::renderGameObjects(FrameInfo& frameInfo) {
+    bind(frameInfo.commandBuffer, frameInfo.globalDescriptorSet);
+    //obj.render(shader_pipeline, dt, frameInfo.commandBuffer);
 
     for (auto& kv : frameInfo.gameObjects) {
         auto& obj = kv.second;
@@ -78,6 +78,9 @@ class ShaderPipline {
     static std::vector<uint32_t> getOrCompileSPIRV(const std::string& glslFile, EShLanguage shaderType);
     void renderGameObjects(FrameInfo& frameInfo);
 
+    // bind pipeline and global descriptor set (every secondary command buffer has to bind them again)
+    void bind(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet);
+
     VkPipelineLayout getPipelineLayout() { return pipelineLayout; };
 
  private:
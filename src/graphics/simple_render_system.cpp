@@ -26,6 +26,8 @@ SimpleRenderSystem::SimpleRenderSystem(
 }
 
 SimpleRenderSystem::~SimpleRenderSystem() {
+	vulkanPipeline.reset();
+	vulkanDevice.getPipelineCache().unregisterPipelineLayout(pipelineLayout);
 	vkDestroyPipelineLayout(vulkanDevice.device(), pipelineLayout, nullptr);
 }
 
@@ -46,6 +48,8 @@ void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLay
 	if (vkCreatePipelineLayout(vulkanDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create pipeline layout!");
 	}
+	// pipelines are shared with other systems that create the same layout
+	vulkanDevice.getPipelineCache().registerPipelineLayout(pipelineLayout, pipelineLayoutInfo);
 }
 
 void SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
@@ -244,33 +244,36 @@ const void* getTileFromTexture(ktxTexture2* texture, uint32_t tileIndex) {
 
 // load texture from path
 void Texture::load(VulkanDevice &vulkanDevice, bool flip) {
-    stbi_set_flip_vertically_on_load(flip);
-    pixels = stbi_load((dir + "/" + path).c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
-
+    if (decode(flip)) {
+        upload();
+    }
+}
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    vulkanDevice.createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-                            stagingBuffer, stagingBufferMemory);
-    
-    
-    void* data;
-    vkMapMemory(vulkanDevice.device(), stagingBufferMemory, 0, imageSize, 0, &data);
-        memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(vulkanDevice.device(), stagingBufferMemory);
+// decode the image file into pixels (RGBA), false if it could not be read
+bool Texture::decode(bool flip) {
+    // per thread, textures of a model are decoded in parallel
+    stbi_set_flip_vertically_on_load_thread(flip);
+    pixels = stbi_load((dir + "/" + path).c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    if (!pixels) {
+        std::cerr << "Failed to load texture: " << dir << "/" << path << std::endl;
+        return false;
+    }
 
-    stbi_image_free(pixels);
+    imageSize = static_cast<VkDeviceSize>(texWidth) * texHeight * 4;
+    return true;
+}
 
+// create the image from the decoded pixels (on the thread that owns the device)
+void Texture::upload() {
     createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageAllocation);
 
-    transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-    transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    // staged and copied on the transfer queue (including both layout transitions), meshes using the texture wait for uploadTicket
+    uploadTicket = vulkanDevice.getUploadManager().uploadImage(
+        textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 1, pixels, imageSize);
 
-    vkDestroyBuffer(vulkanDevice.device(), stagingBuffer, nullptr);
-    vkFreeMemory(vulkanDevice.device(), stagingBufferMemory, nullptr);
+    stbi_image_free(pixels);
+    pixels = nullptr;
 
     //we now have a textureImage
 }
@@ -385,7 +388,7 @@ VkImageView Texture::createImageView(VkImage image, VkFormat format) {
 }
 
 void Texture::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, 
-				VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+				VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageAllocation) {
 	VkImageCreateInfo imageInfo{};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -401,23 +404,8 @@ void Texture::createImage(uint32_t width, uint32_t height, VkFormat format, VkIm
 	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-	if (vkCreateImage(vulkanDevice.device(), &imageInfo, nullptr, &image) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create image!");
-	}
-
-	VkMemoryRequirements memRequirements;
-	vkGetImageMemoryRequirements(vulkanDevice.device(), image, &memRequirements);
-
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = vulkanDevice.findMemoryType(memRequirements.memoryTypeBits, properties);
-
-	if (vkAllocateMemory(vulkanDevice.device(), &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate image memory!");
-	}
-
-	vkBindImageMemory(vulkanDevice.device(), image, imageMemory, 0);
+	// sub-allocated from the device's memory blocks
+	vulkanDevice.createImageWithInfo(imageInfo, properties, image, imageAllocation);
 }
 
 void Texture::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
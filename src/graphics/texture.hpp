@@ -90,20 +90,25 @@ public:
     std::string path;
 
 	VkImage textureImage;
-	VkDeviceMemory textureImageMemory;
+	MemoryAllocation textureImageAllocation;
 	VkImageView textureImageView;
 	VkSampler textureSampler;
+	// upload of textureImage, part of the ticket of the meshes using it (see Mesh::isReady)
+	UploadTicket uploadTicket = 0;
 
     int texWidth, texHeight, texChannels;
     stbi_uc* pixels;
     VkDeviceSize imageSize;
     
     void load(VulkanDevice &vulkanDevice, bool flip);
+    // load in two steps: decode has no device calls (runs on any thread), upload frees the pixels
+    bool decode(bool flip);
+    void upload();
     void createTextureImageView();
     void createTextureSampler();
     VkImageView createImageView(VkImage image, VkFormat format);
     void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, 
-				VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+				VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageAllocation);
     void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
     void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
 
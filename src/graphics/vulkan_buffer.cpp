@@ -44,7 +44,7 @@ VulkanBuffer::VulkanBuffer(
 				
 		alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
 		bufferSize = alignmentSize * instanceCount;
-		device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+		device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, allocation);
 }
 
 
@@ -52,13 +52,15 @@ VulkanBuffer::VulkanBuffer(
 VulkanBuffer::~VulkanBuffer() {
 	unmap();
 	vkDestroyBuffer(vulkanDevice.device(), buffer, nullptr);
-	vkFreeMemory(vulkanDevice.device(), memory, nullptr);
+	vulkanDevice.freeMemory(allocation);
 }
 
 
 /**
  * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
  *
+ * @note Host visible blocks are mapped once by the device memory allocator, this only points mapped into them
+ *
  * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
  * buffer range.
  * @param offset (Optional) Byte offset from beginning
@@ -66,28 +68,27 @@ VulkanBuffer::~VulkanBuffer() {
  * @return VkResult of the buffer mapping call
  */
 VkResult VulkanBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
-	assert(buffer && memory && "Called map on buffer before create");
-	return vkMapMemory(vulkanDevice.device(), memory, offset, size, 0, &mapped);
+	assert(buffer && allocation.block && "Called map on buffer before create");
+	if (!allocation.mapped) {
+		return VK_ERROR_MEMORY_MAP_FAILED;
+	}
+	mapped = (char *)allocation.mapped + offset;
+	return VK_SUCCESS;
 }
 
 /**
  * Unmap a mapped memory range
  *
- * @note Does not return a result as vkUnmapMemory can't fail
+ * @note The block stays mapped until it is freed
  */
 void VulkanBuffer::unmap() {
-	if (mapped) {
-		vkUnmapMemory(vulkanDevice.device(), memory);
-		mapped = nullptr;
-	}
+	mapped = nullptr;
 }
 
 
 void VulkanBuffer::UpdateInstanceBuffer(const std::vector<glm::mat4>& instances) {
-    void* data;
-    memcpy(data, instances.data(), sizeof(glm::mat4) * instances.size());
-    vkMapMemory(vulkanDevice.device(), memory, 0, VK_WHOLE_SIZE, 0, &data);
-    vkUnmapMemory(vulkanDevice.device(), memory);
+    assert(allocation.mapped && "Cannot copy to a buffer that is not host visible");
+    memcpy(allocation.mapped, instances.data(), sizeof(glm::mat4) * instances.size());
 }
 
 
@@ -126,9 +127,9 @@ void VulkanBuffer::writeToBuffer(void *data, VkDeviceSize size, VkDeviceSize off
 VkResult VulkanBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
 	VkMappedMemoryRange mappedRange = {};
 	mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-	mappedRange.memory = memory;
-	mappedRange.offset = offset;
-	mappedRange.size = size;
+	mappedRange.memory = getMemory();
+	mappedRange.offset = allocation.offset + offset;
+	mappedRange.size = size == VK_WHOLE_SIZE ? bufferSize - offset : size;
 	return vkFlushMappedMemoryRanges(vulkanDevice.device(), 1, &mappedRange);
 }
 
@@ -146,9 +147,9 @@ VkResult VulkanBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
 VkResult VulkanBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
 	VkMappedMemoryRange mappedRange = {};
 	mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-	mappedRange.memory = memory;
-	mappedRange.offset = offset;
-	mappedRange.size = size;
+	mappedRange.memory = getMemory();
+	mappedRange.offset = allocation.offset + offset;
+	mappedRange.size = size == VK_WHOLE_SIZE ? bufferSize - offset : size;
 	return vkInvalidateMappedMemoryRanges(vulkanDevice.device(), 1, &mappedRange);
 }
 
@@ -188,6 +189,34 @@ void VulkanBuffer::writeToIndex(void *data, int index) {
  */
 VkResult VulkanBuffer::flushIndex(int index) { return flush(alignmentSize, index * alignmentSize); }
 
+/**
+ * Copies "count" consecutive instances of tightly packed data to the mapped buffer, starting at index firstIndex
+ *
+ * @note Only usable when alignmentSize == instanceSize (the data has no padding between instances)
+ *
+ * @param data Pointer to the data to copy
+ * @param firstIndex Index of the first instance written
+ * @param count Number of instances written
+ *
+ */
+void VulkanBuffer::writeToRange(void *data, int firstIndex, int count) {
+	assert(alignmentSize == instanceSize && "Range writes need tightly packed instances");
+	writeToBuffer(data, count * instanceSize, firstIndex * alignmentSize);
+}
+
+/**
+ *	Flush the memory range of "count" instances starting at index firstIndex to make it visible to the device
+ *
+ * @note Only required for non-coherent memory
+ *
+ * @param firstIndex Index of the first instance flushed
+ * @param count Number of instances flushed
+ *
+ */
+VkResult VulkanBuffer::flushRange(int firstIndex, int count) {
+	return flush(count * alignmentSize, firstIndex * alignmentSize);
+}
+
 /**
  * Create a buffer info descriptor
  *
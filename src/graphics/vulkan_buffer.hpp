@@ -32,6 +32,8 @@ class VulkanBuffer {
 
 	void writeToIndex(void* data, int index);
 	VkResult flushIndex(int index);
+	void writeToRange(void* data, int firstIndex, int count);
+	VkResult flushRange(int firstIndex, int count);
 	VkDescriptorBufferInfo descriptorInfoForIndex(int index);
 	VkResult invalidateIndex(int index);
 
@@ -43,7 +45,9 @@ class VulkanBuffer {
 	VkBufferUsageFlags getUsageFlags() const { return usageFlags; }
 	VkMemoryPropertyFlags getMemoryPropertyFlags() const { return memoryPropertyFlags; }
 	VkDeviceSize getBufferSize() const { return bufferSize; }
-	VkDeviceMemory getMemory() const { return memory; }
+	VkDeviceMemory getMemory() const { return VulkanMemorySource::memoryOf(allocation); }
+	// offset of the buffer in its memory block
+	VkDeviceSize getMemoryOffset() const { return allocation.offset; }
 
  private:
 	static VkDeviceSize getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment);
@@ -51,7 +55,8 @@ class VulkanBuffer {
 	VulkanDevice& vulkanDevice;
 	void* mapped = nullptr;
 	VkBuffer buffer = VK_NULL_HANDLE;
-	VkDeviceMemory memory = VK_NULL_HANDLE;
+	// range of a block of the device memory allocator
+	MemoryAllocation allocation;
 
 	VkDeviceSize bufferSize;
 	uint32_t instanceCount;
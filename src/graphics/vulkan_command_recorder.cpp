@@ -0,0 +1,177 @@
+#include "vulkan_command_recorder.hpp"
+#include "../algorithms/timer.hpp"
+
+// std
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+//namespace lve {
+
+/**
+ * Creates a command pool for every thread of the job system in every frame in flight
+ *
+ * @param jobs Threads the jobs of record() run on (the calling thread takes part)
+ * @param noFrames Number of frames that can be in flight at once
+ */
+VulkanCommandRecorder::VulkanCommandRecorder(VulkanDevice &device, JobSystem &jobs, uint32_t noFrames)
+		: vulkanDevice{device}, jobs{jobs} {
+	createPools(noFrames);
+	threadStats.resize(jobs.noThreads());
+}
+
+VulkanCommandRecorder::~VulkanCommandRecorder() {
+	// buffers are freed with their pools
+	for (std::vector<ThreadPool> &threadPools : frames) {
+		for (ThreadPool &threadPool : threadPools) {
+			vkDestroyCommandPool(vulkanDevice.device(), threadPool.commandPool, nullptr);
+		}
+	}
+}
+
+void VulkanCommandRecorder::createPools(uint32_t noFrames) {
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	// buffers are rerecorded every frame and only reset together with their pool
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = vulkanDevice.findPhysicalQueueFamilies().graphicsFamily;
+
+	frames.resize(noFrames);
+	for (std::vector<ThreadPool> &threadPools : frames) {
+		threadPools.resize(jobs.noThreads());
+		for (ThreadPool &threadPool : threadPools) {
+			if (vkCreateCommandPool(vulkanDevice.device(), &poolInfo, nullptr, &threadPool.commandPool) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create recording command pool!");
+			}
+		}
+	}
+}
+
+/**
+ * Resets the pools of the frame that last used frameIndex, their buffers are handed out again
+ *
+ * @note The device must have finished that frame (its fence was waited on)
+ */
+void VulkanCommandRecorder::beginFrame(int frameIndex) {
+	currentFrameIndex = frameIndex;
+	for (ThreadPool &threadPool : frames[frameIndex]) {
+		if (!threadPool.noUsed) {
+			continue;
+		}
+
+		vkResetCommandPool(vulkanDevice.device(), threadPool.commandPool, 0);
+		threadPool.noUsed = 0;
+	}
+}
+
+/**
+ * Takes the next free secondary buffer of a pool, allocating one if all are in use
+ *
+ * @note Only called by the thread the pool belongs to
+ */
+VkCommandBuffer VulkanCommandRecorder::acquireBuffer(ThreadPool &threadPool) {
+	if (threadPool.noUsed == threadPool.buffers.size()) {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandPool = threadPool.commandPool;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(vulkanDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate secondary command buffer!");
+		}
+		threadPool.buffers.push_back(commandBuffer);
+	}
+
+	return threadPool.buffers[threadPool.noUsed++];
+}
+
+/**
+ * Records noJobs secondary buffers on the job system threads and executes them on commandBuffer
+ *
+ * @param commandBuffer Primary buffer of the frame, inside target's render pass
+ *   (begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS)
+ * @param job Called once per job with its own secondary buffer, from any thread of the job system
+ *   (jobs must not share state that is written without synchronization)
+ */
+void VulkanCommandRecorder::record(
+		VkCommandBuffer commandBuffer, const Target &target, unsigned int noJobs, const RecordJob &job) {
+	auto start = std::chrono::steady_clock::now();
+
+	for (ThreadStats &stats : threadStats) {
+		stats = ThreadStats{};
+	}
+	secondaryBuffers.resize(noJobs);
+
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = target.renderPass;
+	inheritanceInfo.subpass = target.subpass;
+	inheritanceInfo.framebuffer = target.framebuffer;
+
+	VkViewport viewport{};
+	viewport.width = static_cast<float>(target.extent.width);
+	viewport.height = static_cast<float>(target.extent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	VkRect2D scissor{{0, 0}, target.extent};
+
+	std::vector<ThreadPool> &threadPools = frames[currentFrameIndex];
+	jobs.parallelFor(noJobs, 1, [&](unsigned int begin, unsigned int end, unsigned int thread) {
+		auto threadStart = std::chrono::steady_clock::now();
+
+		for (unsigned int i = begin; i < end; i++) {
+			VkCommandBuffer secondary = acquireBuffer(threadPools[thread]);
+
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			beginInfo.pInheritanceInfo = &inheritanceInfo;
+			if (vkBeginCommandBuffer(secondary, &beginInfo) != VK_SUCCESS) {
+				throw std::runtime_error("failed to begin recording secondary command buffer!");
+			}
+
+			vkCmdSetViewport(secondary, 0, 1, &viewport);
+			vkCmdSetScissor(secondary, 0, 1, &scissor);
+			job(secondary, i);
+
+			if (vkEndCommandBuffer(secondary) != VK_SUCCESS) {
+				throw std::runtime_error("failed to record secondary command buffer!");
+			}
+			secondaryBuffers[i] = secondary;
+		}
+
+		// a thread may take several chunks of the batch
+		threadStats[thread].recordMs += msSince(threadStart);
+		threadStats[thread].noBuffers += end - begin;
+	});
+
+	if (noJobs) {
+		vkCmdExecuteCommands(commandBuffer, noJobs, secondaryBuffers.data());
+	}
+
+	recordMs = msSince(start);
+}
+
+/**
+ * Formats the stats of the last record, one line per thread that recorded a buffer
+ */
+std::string VulkanCommandRecorder::getStatsText() const {
+	char line[96];
+	std::snprintf(line, sizeof(line), "record: %.3f ms", recordMs);
+	std::string ret = line;
+
+	for (unsigned int i = 0; i < threadStats.size(); i++) {
+		if (!threadStats[i].noBuffers) {
+			continue;
+		}
+
+		std::snprintf(line, sizeof(line), "\nthread %u: %.3f ms (%u buffers)", i, threadStats[i].recordMs, threadStats[i].noBuffers);
+		ret += line;
+	}
+	return ret;
+}
+
+//}	// namespace lve
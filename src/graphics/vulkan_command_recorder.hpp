@@ -0,0 +1,88 @@
+#pragma once
+
+#include "vulkan_device.hpp"
+#include "vulkan_swap_chain.hpp"
+#include "../algorithms/jobsystem.hpp"
+
+// std
+#include <functional>
+#include <string>
+#include <vector>
+
+//namespace lve {
+
+/*
+	Records the draws of a render pass into secondary command buffers on the job system threads
+	- every thread has its own command pool per frame in flight, so threads never share a pool
+	- pools of a frame are reset in beginFrame, which VulkanRenderer calls after waiting on the
+		frame's fence (see VulkanRenderer::addCommandRecorder), and their buffers are reused
+	- record() runs one job per secondary buffer and executes them on the primary buffer in job order,
+		the render pass has to be begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+*/
+class VulkanCommandRecorder {
+ public:
+	// render pass the secondary buffers continue
+	struct Target {
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		uint32_t subpass = 0;
+		// VK_NULL_HANDLE if unknown (may be slower on some implementations)
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+		// viewport and scissor of the secondary buffers (dynamic state is not inherited)
+		VkExtent2D extent{};
+	};
+
+	// recording of one job into a secondary buffer that is already begun, with the viewport and scissor set
+	typedef std::function<void(VkCommandBuffer commandBuffer, unsigned int job)> RecordJob;
+
+	// time spent by one thread in the jobs of the last record
+	struct ThreadStats {
+		double recordMs = 0.0;
+		uint32_t noBuffers = 0;
+	};
+
+	VulkanCommandRecorder(
+			VulkanDevice &device,
+			JobSystem &jobs,
+			uint32_t noFrames = VulkanSwapChain::MAX_FRAMES_IN_FLIGHT);
+	~VulkanCommandRecorder();
+
+	VulkanCommandRecorder(const VulkanCommandRecorder &) = delete;
+	VulkanCommandRecorder &operator=(const VulkanCommandRecorder &) = delete;
+
+	void beginFrame(int frameIndex);
+	void record(VkCommandBuffer commandBuffer, const Target &target, unsigned int noJobs, const RecordJob &job);
+
+	// per thread (index is the thread of the job system), and wall time of the last record
+	const std::vector<ThreadStats> &getThreadStats() const { return threadStats; }
+	double getRecordMs() const { return recordMs; }
+	// one line per thread, for a stats overlay
+	std::string getStatsText() const;
+
+ private:
+	// command pool of one thread in one frame
+	struct ThreadPool {
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		// secondary buffers allocated so far (kept when the pool is reset)
+		std::vector<VkCommandBuffer> buffers;
+		// buffers handed out since the last reset
+		uint32_t noUsed = 0;
+	};
+
+	void createPools(uint32_t noFrames);
+	VkCommandBuffer acquireBuffer(ThreadPool &threadPool);
+
+	VulkanDevice &vulkanDevice;
+	JobSystem &jobs;
+
+	// pools by frame index, then by thread
+	std::vector<std::vector<ThreadPool>> frames;
+	int currentFrameIndex = 0;
+
+	// secondary buffer of each job of the current record
+	std::vector<VkCommandBuffer> secondaryBuffers;
+
+	std::vector<ThreadStats> threadStats;
+	double recordMs = 0.0;
+};
+
+//}	// namespace lve
@@ -0,0 +1,378 @@
+#include "vulkan_cull_pass.hpp"
+#include "vulkan_pipeline.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+//namespace lve {
+
+// workgroup size of depth_pyramid.comp (both axes)
+#define PYRAMID_GROUP_SIZE 8
+
+static_assert(sizeof(CullInstance) == 32, "CullInstance must match Instance in cull.comp");
+static_assert(sizeof(CullGroup) == 8, "CullGroup must match Group in cull.comp");
+static_assert(sizeof(CullDraw) == 24, "CullDraw must match Draw in cull.comp");
+static_assert(sizeof(glm::mat3) == 9 * sizeof(float), "normal matrices are read as 9 packed floats");
+
+static VkDeviceSize alignUp(VkDeviceSize val, VkDeviceSize alignment) {
+	return (val + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * @param maxInstances Instances tested per frame
+ * @param maxGroups Groups of instances per frame (one per entity)
+ * @param maxDraws Draw commands per frame
+ * @param noFrames Frames in flight, each has its own buffers
+ */
+VulkanCullPass::VulkanCullPass(
+		VulkanDevice &device, uint32_t maxInstances, uint32_t maxGroups, uint32_t maxDraws, uint32_t noFrames)
+		: vulkanDevice{device}, maxInstances{maxInstances}, maxGroups{maxGroups}, maxDraws{maxDraws} {
+	// regions bound as separate descriptors start at a multiple of the offset alignments
+	VkDeviceSize alignment = std::max(
+			vulkanDevice.properties.limits.minUniformBufferOffsetAlignment,
+			vulkanDevice.properties.limits.minStorageBufferOffsetAlignment);
+
+	instancesOffset = alignUp(sizeof(CullParams), alignment);
+	modelsOffset = alignUp(instancesOffset + maxInstances * sizeof(CullInstance), alignment);
+	normalsOffset = alignUp(modelsOffset + maxInstances * sizeof(glm::mat4), alignment);
+	groupsOffset = alignUp(normalsOffset + maxInstances * sizeof(glm::mat3), alignment);
+	drawsOffset = alignUp(groupsOffset + maxGroups * sizeof(CullGroup), alignment);
+	inputSize = drawsOffset + maxDraws * sizeof(CullDraw);
+
+	outModelsOffset = alignUp(maxDraws * sizeof(IndirectCommand), alignment);
+	outNormalsOffset = alignUp(outModelsOffset + maxInstances * sizeof(glm::mat4), alignment);
+	outputSize = outNormalsOffset + maxInstances * sizeof(glm::mat3);
+
+	createLayouts(noFrames);
+	createPyramidBuffer(1, 1);
+	createFrames(noFrames);
+
+	cullPipeline = createComputePipeline("cull/cull.comp", cullPipelineLayout);
+	pyramidPipeline = createComputePipeline("cull/depth_pyramid.comp", pyramidPipelineLayout);
+}
+
+VulkanCullPass::~VulkanCullPass() {
+	vulkanDevice.getPipelineCache().release(cullPipeline);
+	vulkanDevice.getPipelineCache().release(pyramidPipeline);
+	vkDestroyPipelineLayout(vulkanDevice.device(), cullPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(vulkanDevice.device(), pyramidPipelineLayout, nullptr);
+}
+
+/**
+ * Host addresses of the arrays of a frame
+ *
+ * @note Only written once the frame's fence was waited on (after VulkanRenderer::beginFrame)
+ */
+VulkanCullPass::FrameData VulkanCullPass::getFrameData(int frameIndex) {
+	char *mapped = static_cast<char *>(frames[frameIndex].input->getMappedMemory());
+
+	FrameData ret;
+	ret.instances = reinterpret_cast<CullInstance *>(mapped + instancesOffset);
+	ret.models = reinterpret_cast<glm::mat4 *>(mapped + modelsOffset);
+	ret.normalModels = reinterpret_cast<glm::mat3 *>(mapped + normalsOffset);
+	ret.groups = reinterpret_cast<CullGroup *>(mapped + groupsOffset);
+	ret.draws = reinterpret_cast<CullDraw *>(mapped + drawsOffset);
+	return ret;
+}
+
+/**
+ * Records the culling of the frame's instances (outside of a render pass)
+ *
+ * @param viewProj View-projection matrix the frustum and pyramid tests use
+ * @param noInstances Instances written to getFrameData
+ * @param noDraws Draws written to getFrameData
+ *
+ * @note Ends with a barrier for indirect and vertex reads, so the output can be drawn in the following render pass
+ */
+void VulkanCullPass::record(
+		VkCommandBuffer commandBuffer, int frameIndex, const glm::mat4 &viewProj, uint32_t noInstances, uint32_t noDraws) {
+	assert(noInstances <= maxInstances && noDraws <= maxDraws && "Too many instances or draws for the cull pass");
+
+	FrameResources &frame = frames[frameIndex];
+
+	CullParams params{};
+	params.viewProj = viewProj;
+	Frustum frustum(viewProj);
+	std::copy(std::begin(frustum.planes), std::end(frustum.planes), std::begin(params.planes));
+	params.counts[0] = noInstances;
+	params.counts[1] = noDraws;
+	params.counts[2] = pyramidBuilt ? 1 : 0;
+	params.pyramid[0] = pyramidWidth;
+	params.pyramid[1] = pyramidHeight;
+	params.pyramid[2] = DepthPyramid::noLevels(pyramidWidth, pyramidHeight);
+	std::memcpy(frame.input->getMappedMemory(), &params, sizeof(CullParams));
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+	vkCmdBindDescriptorSets(
+			commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+
+	// pyramid of the last recordDepthPyramid
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(
+			commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	// test instances
+	uint32_t mode = 0;
+	vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &mode);
+	if (noInstances) {
+		vkCmdDispatch(commandBuffer, (noInstances + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	}
+
+	// visible counts of the groups
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(
+			commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	// write commands
+	mode = 1;
+	vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &mode);
+	if (noDraws) {
+		vkCmdDispatch(commandBuffer, (noDraws + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	}
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	vkCmdPipelineBarrier(
+			commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+/**
+ * Sets the depth buffer the pyramid is reduced from (again after the swap chain was recreated)
+ *
+ * @param depthView View of a depth image created with VK_IMAGE_USAGE_SAMPLED_BIT
+ * @param depthSampler Nearest sampler (texels are fetched without filtering)
+ *
+ * @note The device must be idle, the pyramid is recreated if the size changes
+ */
+void VulkanCullPass::setDepthSource(VkImageView depthView, VkSampler depthSampler, uint32_t width, uint32_t height) {
+	this->depthView = depthView;
+	this->depthSampler = depthSampler;
+	if (width != pyramidWidth || height != pyramidHeight) {
+		createPyramidBuffer(width, height);
+	}
+	writePyramidDescriptors();
+	pyramidBuilt = false;
+}
+
+/**
+ * Records the reduction of the depth buffer into the pyramid, one dispatch per level
+ *
+ * @note The depth image must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL (after the render pass that wrote it)
+ */
+void VulkanCullPass::recordDepthPyramid(VkCommandBuffer commandBuffer) {
+	if (depthView == VK_NULL_HANDLE) {
+		return;
+	}
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramidPipeline);
+	vkCmdBindDescriptorSets(
+			commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramidPipelineLayout, 0, 1, &pyramidDescriptorSet, 0, nullptr);
+
+	// the cull pass of this frame read the pyramid
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	PyramidPush push{};
+	uint32_t offset = 0;
+	for (uint32_t level = 0, noLevels = DepthPyramid::noLevels(pyramidWidth, pyramidHeight); level < noLevels; level++) {
+		vkCmdPipelineBarrier(
+				commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		push.srcOffset = push.dstOffset;
+		push.srcSize[0] = push.dstSize[0];
+		push.srcSize[1] = push.dstSize[1];
+		push.dstOffset = offset;
+		push.dstSize[0] = DepthPyramid::levelSize(pyramidWidth, level);
+		push.dstSize[1] = DepthPyramid::levelSize(pyramidHeight, level);
+		push.level = level;
+		offset += push.dstSize[0] * push.dstSize[1];
+
+		vkCmdPushConstants(
+				commandBuffer, pyramidPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PyramidPush), &push);
+		vkCmdDispatch(
+				commandBuffer,
+				(push.dstSize[0] + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+				(push.dstSize[1] + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+				1);
+	}
+
+	pyramidBuilt = true;
+}
+
+void VulkanCullPass::createLayouts(uint32_t noFrames) {
+	cullSetLayout = VulkanDescriptorSetLayout::Builder(vulkanDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(9, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+
+	pyramidSetLayout = VulkanDescriptorSetLayout::Builder(vulkanDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(uint32_t);
+
+	VkDescriptorSetLayout setLayout = cullSetLayout->getDescriptorSetLayout();
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (vkCreatePipelineLayout(vulkanDevice.device(), &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create cull pipeline layout!");
+	}
+
+	pushConstantRange.size = sizeof(PyramidPush);
+	setLayout = pyramidSetLayout->getDescriptorSetLayout();
+	if (vkCreatePipelineLayout(vulkanDevice.device(), &pipelineLayoutInfo, nullptr, &pyramidPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create depth pyramid pipeline layout!");
+	}
+
+	descriptorPool = VulkanDescriptorPool::Builder(vulkanDevice)
+			.setMaxSets(noFrames + 1)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, noFrames)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 9 * noFrames + 1)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
+			.build();
+}
+
+void VulkanCullPass::createFrames(uint32_t noFrames) {
+	frames.resize(noFrames);
+	for (FrameResources &frame : frames) {
+		frame.input = std::make_unique<VulkanBuffer>(
+				vulkanDevice,
+				inputSize,
+				1,
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		frame.input->map();
+
+		frame.output = std::make_unique<VulkanBuffer>(
+				vulkanDevice,
+				outputSize,
+				1,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		VkDescriptorBufferInfo infos[] = {
+				frame.input->descriptorInfo(sizeof(CullParams), 0),
+				frame.input->descriptorInfo(maxInstances * sizeof(CullInstance), instancesOffset),
+				frame.input->descriptorInfo(maxInstances * sizeof(glm::mat4), modelsOffset),
+				frame.input->descriptorInfo(maxInstances * sizeof(glm::mat3), normalsOffset),
+				frame.input->descriptorInfo(maxGroups * sizeof(CullGroup), groupsOffset),
+				frame.input->descriptorInfo(maxDraws * sizeof(CullDraw), drawsOffset),
+				frame.output->descriptorInfo(maxDraws * sizeof(IndirectCommand), 0),
+				frame.output->descriptorInfo(maxInstances * sizeof(glm::mat4), outModelsOffset),
+				frame.output->descriptorInfo(maxInstances * sizeof(glm::mat3), outNormalsOffset),
+				pyramidBuffer->descriptorInfo()};
+
+		VulkanDescriptorWriter writer(*cullSetLayout, *descriptorPool);
+		for (uint32_t binding = 0; binding < 10; binding++) {
+			writer.writeBuffer(binding, &infos[binding]);
+		}
+		if (!writer.build(frame.descriptorSet)) {
+			throw std::runtime_error("failed to allocate cull descriptor set!");
+		}
+	}
+}
+
+void VulkanCullPass::createPyramidBuffer(uint32_t width, uint32_t height) {
+	pyramidWidth = width;
+	pyramidHeight = height;
+	pyramidBuffer = std::make_unique<VulkanBuffer>(
+			vulkanDevice,
+			sizeof(float),
+			DepthPyramid::noTexels(width, height),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+void VulkanCullPass::writePyramidDescriptors() {
+	VkDescriptorBufferInfo pyramidInfo = pyramidBuffer->descriptorInfo();
+
+	// read by the cull pass of every frame
+	for (FrameResources &frame : frames) {
+		VulkanDescriptorWriter(*cullSetLayout, *descriptorPool)
+				.writeBuffer(9, &pyramidInfo)
+				.overwrite(frame.descriptorSet);
+	}
+
+	VkDescriptorImageInfo depthInfo{};
+	depthInfo.sampler = depthSampler;
+	depthInfo.imageView = depthView;
+	depthInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VulkanDescriptorWriter writer(*pyramidSetLayout, *descriptorPool);
+	writer.writeImage(0, &depthInfo).writeBuffer(1, &pyramidInfo);
+	if (pyramidDescriptorSet == VK_NULL_HANDLE) {
+		if (!writer.build(pyramidDescriptorSet)) {
+			throw std::runtime_error("failed to allocate depth pyramid descriptor set!");
+		}
+	} else {
+		writer.overwrite(pyramidDescriptorSet);
+	}
+}
+
+VkPipeline VulkanCullPass::createComputePipeline(const std::string &shaderPath, VkPipelineLayout layout) {
+	std::vector<char> code = VulkanPipeline::getOrCompileSPIRV(shaderPath, EShLangCompute);
+
+	// a compute pipeline is only its shader and layout
+	uint64_t key = ShaderCache::hash(&layout, sizeof(layout));
+	key = ShaderCache::hash(code.data(), code.size(), key);
+
+	return vulkanDevice.getPipelineCache().acquire(key, [&](VkPipelineCache cache) {
+		VkShaderModuleCreateInfo moduleInfo{};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = code.size();
+		moduleInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(vulkanDevice.device(), &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create shader module");
+		}
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = shaderModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = layout;
+
+		VkPipeline pipeline;
+		VkResult result = vkCreateComputePipelines(vulkanDevice.device(), cache, 1, &pipelineInfo, nullptr, &pipeline);
+		vkDestroyShaderModule(vulkanDevice.device(), shaderModule, nullptr);
+		if (result != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute pipeline: " + shaderPath);
+		}
+		return pipeline;
+	});
+}
+
+//}	// namespace lve
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "vulkan_buffer.hpp"
+#include "vulkan_descriptors.hpp"
+#include "vulkan_device.hpp"
+#include "vulkan_swap_chain.hpp"
+#include "../algorithms/culling.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <memory>
+#include <string>
+#include <vector>
+
+//namespace lve {
+
+/*
+	GPU culling of the instances of a frame (CPU reference in algorithms/culling.hpp)
+	- the host fills the arrays of getFrameData, then record() dispatches the cull shader (outside a render pass)
+	- visible instances are compacted to the front of their group in the output buffer and each draw command
+	  gets the visible count of its group, ready for VulkanGeometryBuffer::drawIndirect
+	- with a depth source, recordDepthPyramid() reduces the depth buffer of a frame into the Hi-Z pyramid
+	  the following frames are tested against (instances coming out behind an occluder can show a frame late)
+*/
+class VulkanCullPass {
+ public:
+	// arrays of a frame, written by the host before record
+	struct FrameData {
+		CullInstance *instances = nullptr;
+		glm::mat4 *models = nullptr;
+		glm::mat3 *normalModels = nullptr;
+		// visibleCount must be 0
+		CullGroup *groups = nullptr;
+		CullDraw *draws = nullptr;
+	};
+
+	VulkanCullPass(
+			VulkanDevice &device,
+			uint32_t maxInstances,
+			uint32_t maxGroups,
+			uint32_t maxDraws,
+			uint32_t noFrames = VulkanSwapChain::MAX_FRAMES_IN_FLIGHT);
+	~VulkanCullPass();
+
+	VulkanCullPass(const VulkanCullPass &) = delete;
+	VulkanCullPass &operator=(const VulkanCullPass &) = delete;
+
+	FrameData getFrameData(int frameIndex);
+	void record(VkCommandBuffer commandBuffer, int frameIndex, const glm::mat4 &viewProj, uint32_t noInstances, uint32_t noDraws);
+
+	void setDepthSource(VkImageView depthView, VkSampler depthSampler, uint32_t width, uint32_t height);
+	void recordDepthPyramid(VkCommandBuffer commandBuffer);
+
+	// output of a frame: commands, then instance matrices, then normal matrices
+	VkBuffer getOutputBuffer(int frameIndex) const { return frames[frameIndex].output->getBuffer(); }
+	VkDeviceSize getCommandsOffset() const { return 0; }
+	VkDeviceSize getModelsOffset() const { return outModelsOffset; }
+	VkDeviceSize getNormalModelsOffset() const { return outNormalsOffset; }
+
+	uint32_t getMaxInstances() const { return maxInstances; }
+	uint32_t getMaxGroups() const { return maxGroups; }
+	uint32_t getMaxDraws() const { return maxDraws; }
+
+ private:
+	// uniform block of cull.comp
+	struct CullParams {
+		glm::mat4 viewProj;
+		glm::vec4 planes[6];
+		// instances, draws, 1 if the pyramid is used
+		uint32_t counts[4];
+		// width and height of level 0, levels
+		uint32_t pyramid[4];
+	};
+
+	// push constants of depth_pyramid.comp
+	struct PyramidPush {
+		uint32_t srcOffset;
+		uint32_t dstOffset;
+		uint32_t srcSize[2];
+		uint32_t dstSize[2];
+		uint32_t level;
+	};
+
+	struct FrameResources {
+		// host visible: params, instances, matrices, groups, draws
+		std::unique_ptr<VulkanBuffer> input;
+		// device local: commands, matrices of the visible instances
+		std::unique_ptr<VulkanBuffer> output;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	};
+
+	void createLayouts(uint32_t noFrames);
+	void createFrames(uint32_t noFrames);
+	void createPyramidBuffer(uint32_t width, uint32_t height);
+	void writePyramidDescriptors();
+	VkPipeline createComputePipeline(const std::string &shaderPath, VkPipelineLayout layout);
+
+	VulkanDevice &vulkanDevice;
+
+	uint32_t maxInstances;
+	uint32_t maxGroups;
+	uint32_t maxDraws;
+
+	// region offsets in the frame buffers
+	VkDeviceSize instancesOffset;
+	VkDeviceSize modelsOffset;
+	VkDeviceSize normalsOffset;
+	VkDeviceSize groupsOffset;
+	VkDeviceSize drawsOffset;
+	VkDeviceSize inputSize;
+	VkDeviceSize outModelsOffset;
+	VkDeviceSize outNormalsOffset;
+	VkDeviceSize outputSize;
+
+	std::unique_ptr<VulkanDescriptorPool> descriptorPool;
+	std::unique_ptr<VulkanDescriptorSetLayout> cullSetLayout;
+	std::unique_ptr<VulkanDescriptorSetLayout> pyramidSetLayout;
+	VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+	VkPipelineLayout pyramidPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline cullPipeline = VK_NULL_HANDLE;
+	VkPipeline pyramidPipeline = VK_NULL_HANDLE;
+
+	std::vector<FrameResources> frames;
+
+	// Hi-Z pyramid, all levels packed (DepthPyramid layout)
+	std::unique_ptr<VulkanBuffer> pyramidBuffer;
+	VkDescriptorSet pyramidDescriptorSet = VK_NULL_HANDLE;
+	uint32_t pyramidWidth = 0;
+	uint32_t pyramidHeight = 0;
+	VkImageView depthView = VK_NULL_HANDLE;
+	VkSampler depthSampler = VK_NULL_HANDLE;
+	// if recordDepthPyramid was called since the depth source was set
+	bool pyramidBuilt = false;
+};
+
+//}	// namespace lve
@@ -56,9 +56,24 @@ VulkanDevice::VulkanDevice(VulkanWindow &window) : window{window} {
 	pickPhysicalDevice();
 	createLogicalDevice();
 	createCommandPool();
+	createMemoryAllocator();
+	createPipelineCache();
+	createUploadManager();
 }
 
 VulkanDevice::~VulkanDevice() {
+	// waits for the uploads in flight, staging memory is freed before the allocator
+	std::cout << uploadManager->getStatsText() << std::endl;
+	uploadManager.reset();
+
+	// saved to disk before the device is destroyed
+	std::cout << pipelineCache->getStatsText() << std::endl;
+	pipelineCache.reset();
+
+	// blocks are freed before the device is destroyed
+	memoryAllocator.reset();
+	memorySource.reset();
+
 	vkDestroyCommandPool(device_, commandPool, nullptr);
 	vkDestroyDevice(device_, nullptr);
 
@@ -81,7 +96,8 @@ void VulkanDevice::createInstance() {
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	// 1.2 for timeline semaphores (uploads fall back to fences on older devices)
+	appInfo.apiVersion = VK_API_VERSION_1_2;
 
 	VkInstanceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -140,6 +156,9 @@ void VulkanDevice::createLogicalDevice() {
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 	std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily, indices.sparseFamily};
+	if (indices.transferFamilyHasValue) {
+		uniqueQueueFamilies.insert(indices.transferFamily);
+	}
 
 	float queuePriority = 1.0f;
 	for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -158,8 +177,30 @@ void VulkanDevice::createLogicalDevice() {
 	deviceFeatures.sparseResidencyBuffer = VK_TRUE; // Optional, for sparse buffers
 	deviceFeatures.sparseResidencyImage2D = VK_TRUE; // Optional, for 2D sparse images
 
+	// indirect draws of many meshes at once (VulkanGeometryBuffer falls back to direct draws without them)
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+	multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+	deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+
+	// upload batches signal a timeline semaphore (core in 1.2)
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	if (properties.apiVersion >= VK_API_VERSION_1_2) {
+		VkPhysicalDeviceFeatures2 supportedFeatures2{};
+		supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supportedFeatures2.pNext = &timelineFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+	}
+	timelineSemaphores = timelineFeatures.timelineSemaphore;
+
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	if (timelineSemaphores) {
+		createInfo.pNext = &timelineFeatures;
+	}
 
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -184,6 +225,11 @@ void VulkanDevice::createLogicalDevice() {
 	vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
 	vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
 	vkGetDeviceQueue(device_, indices.sparseFamily, 0, &sparseQueue_);
+	if (indices.transferFamilyHasValue) {
+		vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+	} else {
+		transferQueue_ = graphicsQueue_;
+	}
 }
 
 void VulkanDevice::createCommandPool() {
@@ -360,6 +406,20 @@ QueueFamilyIndices VulkanDevice::findQueueFamilies(VkPhysicalDevice device) {
 		i++;
 	}
 
+	// optional transfer family without graphics, its queue is used without graphicsQueueMutex,
+	// so it must not be the family presenting (or binding sparse memory) either
+	for (i = 0; i < static_cast<int>(queueFamilies.size()); i++) {
+		const VkQueueFamilyProperties &queueFamily = queueFamilies[i];
+		if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT
+				&& !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+				&& !(indices.presentFamilyHasValue && indices.presentFamily == static_cast<uint32_t>(i))
+				&& !(indices.sparseFamilyHasValue && indices.sparseFamily == static_cast<uint32_t>(i))) {
+			indices.transferFamily = i;
+			indices.transferFamilyHasValue = true;
+			break;
+		}
+	}
+
 	return indices;
 }
 
@@ -405,6 +465,26 @@ VkFormat VulkanDevice::findSupportedFormat(
 	throw std::runtime_error("failed to find supported format!");
 }
 
+void VulkanDevice::createMemoryAllocator() {
+	memorySource = std::make_unique<VulkanMemorySource>(device_, physicalDevice);
+	memoryAllocator = std::make_unique<BlockAllocator>(*memorySource);
+}
+
+void VulkanDevice::createPipelineCache() {
+	pipelineCache = std::make_unique<VulkanPipelineCache>(device_, properties, PIPELINE_CACHE_FILE);
+	if (pipelineCache->getLoadError().empty()) {
+		std::cout << "pipeline cache: " << pipelineCache->getStats().loadedSize << " bytes loaded" << std::endl;
+	} else {
+		std::cout << "pipeline cache: not used (" << pipelineCache->getLoadError() << ")" << std::endl;
+	}
+}
+
+void VulkanDevice::createUploadManager() {
+	uploadManager = std::make_unique<VulkanUploadManager>(*this);
+	std::cout << "uploads: " << (uploadManager->hasTransferQueue() ? "transfer" : "graphics") << " queue, "
+			<< (timelineSemaphores ? "timeline semaphore" : "fences") << std::endl;
+}
+
 uint32_t VulkanDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
 	VkPhysicalDeviceMemoryProperties memProperties;
 	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
@@ -473,6 +553,44 @@ void VulkanDevice::createBuffer(
 
 
 
+void VulkanDevice::createBuffer(
+	VkDeviceSize size,
+	VkBufferUsageFlags usage,
+	VkMemoryPropertyFlags properties,
+	VkBuffer &buffer,
+	MemoryAllocation &allocation) {
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create vertex buffer!");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
+
+	uint32_t memoryType = findMemoryType(memRequirements.memoryTypeBits, properties);
+	{
+		std::lock_guard<std::mutex> lock(memoryMutex);
+		if (!memoryAllocator->allocate(memoryType, true, memRequirements.size, memRequirements.alignment, allocation)) {
+			throw std::runtime_error("failed to allocate vertex buffer memory!");
+		}
+	}
+
+	if (vkBindBufferMemory(device_, buffer, VulkanMemorySource::memoryOf(allocation), allocation.offset) != VK_SUCCESS) {
+		throw std::runtime_error("failed to bind buffer memory!");
+	}
+}
+
+void VulkanDevice::freeMemory(MemoryAllocation &allocation) {
+	std::lock_guard<std::mutex> lock(memoryMutex);
+	memoryAllocator->free(allocation);
+}
+
 VkCommandBuffer VulkanDevice::beginSingleTimeCommands() {
 	VkCommandBufferAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -499,22 +617,27 @@ void VulkanDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
 
-	vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(graphicsQueue_);
+	// waits for this submit only, not for the frames in flight
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	VkFence fence;
+	if (vkCreateFence(device_, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create single time fence!");
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(graphicsQueueMutex);
+		vkQueueSubmit(graphicsQueue_, 1, &submitInfo, fence);
+	}
+	vkWaitForFences(device_, 1, &fence, VK_TRUE, UINT64_MAX);
+	vkDestroyFence(device_, fence, nullptr);
 
 	vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
 
-void VulkanDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-	VkBufferCopy copyRegion{};
-	copyRegion.srcOffset = 0;  // Optional
-	copyRegion.dstOffset = 0;  // Optional
-	copyRegion.size = size;
-	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-	endSingleTimeCommands(commandBuffer);
+// on the transfer queue, returns once the copy completed (so srcBuffer can be freed)
+void VulkanDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset) {
+	uploadManager->wait(uploadManager->copyBuffer(srcBuffer, dstBuffer, size, dstOffset));
 }
 
 void VulkanDevice::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount) {
@@ -570,6 +693,34 @@ void VulkanDevice::createImageWithInfo(
 	}
 }
 
+void VulkanDevice::createImageWithInfo(
+	const VkImageCreateInfo &imageInfo,
+	VkMemoryPropertyFlags properties,
+	VkImage &image,
+	MemoryAllocation &allocation) {
+
+	if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create image!");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device_, image, &memRequirements);
+
+	// linear images may share blocks with buffers, optimal ones are kept apart (bufferImageGranularity)
+	bool linear = imageInfo.tiling == VK_IMAGE_TILING_LINEAR;
+	uint32_t memoryType = findMemoryType(memRequirements.memoryTypeBits, properties);
+	{
+		std::lock_guard<std::mutex> lock(memoryMutex);
+		if (!memoryAllocator->allocate(memoryType, linear, memRequirements.size, memRequirements.alignment, allocation)) {
+			throw std::runtime_error("failed to allocate image memory!");
+		}
+	}
+
+	if (vkBindImageMemory(device_, image, VulkanMemorySource::memoryOf(allocation), allocation.offset) != VK_SUCCESS) {
+		throw std::runtime_error("failed to bind image memory!");
+	}
+}
+
 
 
 
@@ -669,19 +820,15 @@ VkResult VulkanDevice::AllocateOrGetMemoryRange(
         return VK_SUCCESS; }
 	*pSize = memoryRequirements->size;
 
-    // Create memory allocation info structure
-    VkMemoryAllocateInfo allocateInfo = {};
-    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocateInfo.allocationSize = *pSize;
-    allocateInfo.memoryTypeIndex = findMemoryType(memoryRequirements->memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    // Allocate memory
-    VkResult result = vkAllocateMemory(device, &allocateInfo, nullptr, pMemory);
-    if (result != VK_SUCCESS) {
-        return result; }
+    // Sub-allocate the range from a block of the memory allocator
+    MemoryAllocation allocation;
+    uint32_t memoryType = findMemoryType(memoryRequirements->memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    std::lock_guard<std::mutex> lock(memoryMutex);
+    if (!memoryAllocator->allocate(memoryType, false, *pSize, memoryRequirements->alignment, allocation)) {
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY; }
 
-    // Set the memory offset (for example, if we are using a single large allocation)
-    *pMemoryOffset = 0;
+    *pMemory = VulkanMemorySource::memoryOf(allocation);
+    *pMemoryOffset = allocation.offset;
 
     return VK_SUCCESS;
 }
@@ -1,8 +1,13 @@
 #pragma once
 
 #include "vulkan_window.hpp"
+#include "vulkan_memory.hpp"
+#include "vulkan_pipeline_cache.hpp"
+#include "vulkan_upload_manager.hpp"
 
 // std lib headers
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -18,9 +23,12 @@ struct QueueFamilyIndices {
 	uint32_t graphicsFamily;
 	uint32_t presentFamily;
 	uint32_t sparseFamily;
+	// family with transfer but without graphics (uploads use the graphics queue if there is none)
+	uint32_t transferFamily;
 	bool graphicsFamilyHasValue = false;
 	bool presentFamilyHasValue = false;
 	bool sparseFamilyHasValue = false;
+	bool transferFamilyHasValue = false;
 	bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue && sparseFamilyHasValue; }
 };
 
@@ -47,6 +55,10 @@ public:
 	VkSurfaceKHR surface() { return surface_; }
 	VkQueue graphicsQueue() { return graphicsQueue_; }
 	VkQueue presentQueue() { return presentQueue_; }
+	// the graphics queue if there is no dedicated transfer family
+	VkQueue transferQueue() { return transferQueue_; }
+	// held around every submit and present to the graphics queue (uploads may submit from other threads)
+	std::mutex &getGraphicsQueueMutex() { return graphicsQueueMutex; }
 
 	SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
 	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -61,9 +73,16 @@ public:
 		VkMemoryPropertyFlags properties,
 		VkBuffer &buffer,
 		VkDeviceMemory &bufferMemory);
+	// sub-allocated from the blocks of the memory allocator (free with freeMemory)
+	void createBuffer(
+		VkDeviceSize size,
+		VkBufferUsageFlags usage,
+		VkMemoryPropertyFlags properties,
+		VkBuffer &buffer,
+		MemoryAllocation &allocation);
 	VkCommandBuffer beginSingleTimeCommands();
 	void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset = 0);
 	void copyBufferToImage(
 		VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
@@ -73,6 +92,24 @@ public:
 		VkImage &image,
 		VkDeviceMemory &imageMemory);
 
+	// sub-allocated from the blocks of the memory allocator (free with freeMemory)
+	void createImageWithInfo(
+		const VkImageCreateInfo &imageInfo,
+		VkMemoryPropertyFlags properties,
+		VkImage &image,
+		MemoryAllocation &allocation);
+	void freeMemory(MemoryAllocation &allocation);
+	MemoryStats getMemoryStats() const {
+		std::lock_guard<std::mutex> lock(memoryMutex);
+		return memoryAllocator->getStats();
+	}
+	// not locked, only use it while no other thread creates or frees memory (e.g. to defragment between frames)
+	BlockAllocator &getMemoryAllocator() { return *memoryAllocator; }
+	// pipelines are created through it (saved to PIPELINE_CACHE_FILE when the device is destroyed)
+	VulkanPipelineCache &getPipelineCache() { return *pipelineCache; }
+	// buffers and images are uploaded through it on the transfer queue
+	VulkanUploadManager &getUploadManager() { return *uploadManager; }
+
 	void createSparseImageWithInfo(
 		const VkImageCreateInfo &imageInfo,
 		VkMemoryPropertyFlags properties,
@@ -87,6 +124,10 @@ public:
 		VkDeviceSize* pSize);
 
 	VkPhysicalDeviceProperties properties;
+	// optional features, enabled when supported
+	bool multiDrawIndirect = false;
+	bool drawIndirectFirstInstance = false;
+	bool timelineSemaphores = false;
 
 private:
 	void createInstance();
@@ -95,6 +136,9 @@ private:
 	void pickPhysicalDevice();
 	void createLogicalDevice();
 	void createCommandPool();
+	void createMemoryAllocator();
+	void createPipelineCache();
+	void createUploadManager();
 
 	// helper functions
 	bool isDeviceSuitable(VkPhysicalDevice device);
@@ -117,6 +161,18 @@ private:
 	VkQueue graphicsQueue_;
 	VkQueue presentQueue_;
 	VkQueue sparseQueue_;
+	VkQueue transferQueue_;
+	std::mutex graphicsQueueMutex;
+
+	// sub-allocates buffers and images from large blocks (declared after the source it uses)
+	std::unique_ptr<VulkanMemorySource> memorySource;
+	std::unique_ptr<BlockAllocator> memoryAllocator;
+	// guards memoryAllocator, memory is created and freed from loader, upload and recording threads
+	mutable std::mutex memoryMutex;
+
+	std::unique_ptr<VulkanPipelineCache> pipelineCache;
+	// staging memory comes from the memory allocator (declared after it)
+	std::unique_ptr<VulkanUploadManager> uploadManager;
 
 	// For the sparse images
 	uint32_t MAX_CHUNKS = 64;
@@ -0,0 +1,175 @@
+#include "vulkan_geometry_buffer.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+
+//namespace lve {
+
+static_assert(sizeof(IndirectCommand) == sizeof(VkDrawIndexedIndirectCommand), "IndirectCommand must match VkDrawIndexedIndirectCommand");
+
+VulkanGeometryBuffer::VulkanGeometryBuffer(
+		VulkanDevice &device, VkDeviceSize vertexSize, uint32_t maxVertices, uint32_t maxIndices)
+		: vulkanDevice{device}, vertexSize{vertexSize}, vertexRanges{maxVertices}, indexRanges{maxIndices} {
+	vertexBuffer = std::make_unique<VulkanBuffer>(
+			vulkanDevice,
+			vertexSize,
+			maxVertices,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	indexBuffer = std::make_unique<VulkanBuffer>(
+			vulkanDevice,
+			sizeof(uint32_t),
+			maxIndices,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+/**
+ * Copies the vertices and indices of a mesh into free ranges of the buffers
+ * - the copies run on the transfer queue, the mesh can be drawn once range.ticket is ready
+ *
+ * @param range Set to the ranges of the mesh
+ *
+ * @return false if either buffer has no free range large enough (nothing is copied)
+ */
+bool VulkanGeometryBuffer::add(
+		const void *vertices, uint32_t vertexCount, const uint32_t *indices, uint32_t indexCount, GeometryRange &range) {
+	uint64_t firstVertex = vertexRanges.allocate(vertexCount);
+	if (firstVertex == RANGE_ALLOC_FAILED) {
+		return false;
+	}
+
+	uint64_t firstIndex = 0;
+	if (indexCount) {
+		firstIndex = indexRanges.allocate(indexCount);
+		if (firstIndex == RANGE_ALLOC_FAILED) {
+			vertexRanges.free(firstVertex, vertexCount);
+			return false;
+		}
+	}
+
+	range.firstVertex = static_cast<uint32_t>(firstVertex);
+	range.vertexCount = vertexCount;
+	range.firstIndex = static_cast<uint32_t>(firstIndex);
+	range.indexCount = indexCount;
+
+	range.ticket = upload(*vertexBuffer, vertices, vertexCount * vertexSize, firstVertex * vertexSize);
+	if (indexCount) {
+		range.ticket = std::max(range.ticket, upload(*indexBuffer, indices, indexCount * sizeof(uint32_t), firstIndex * sizeof(uint32_t)));
+	}
+	return true;
+}
+
+/**
+ * Returns the ranges of a mesh (it is reset)
+ *
+ * @note The device must not be drawing the mesh anymore
+ */
+void VulkanGeometryBuffer::remove(GeometryRange &range) {
+	vertexRanges.free(range.firstVertex, range.vertexCount);
+	indexRanges.free(range.firstIndex, range.indexCount);
+	range = GeometryRange();
+}
+
+/**
+ * Binds the shared buffers and the instance data of the frame (once for all buckets)
+ */
+void VulkanGeometryBuffer::bind(
+		VkCommandBuffer commandBuffer,
+		VkBuffer instanceBuffer,
+		VkDeviceSize instanceOffset,
+		VkBuffer normalizedInstanceBuffer,
+		VkDeviceSize normalizedInstanceOffset) {
+	VkBuffer buffers[] = {vertexBuffer->getBuffer(), instanceBuffer, normalizedInstanceBuffer};
+	VkDeviceSize offsets[] = {0, instanceOffset, normalizedInstanceOffset};
+	vkCmdBindVertexBuffers(commandBuffer, 0, 3, buffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+}
+
+/**
+ * Draws a built batch, one indirect draw per bucket
+ *
+ * @param frameRing Ring the commands are written to (created with VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT)
+ * @param bindBucket Binds the pipeline and descriptors of a bucket key before its draws
+ *
+ * @note Without the multiDrawIndirect and drawIndirectFirstInstance features, the commands of a bucket
+ * are issued as direct draws (the buffers are still bound only once)
+ */
+void VulkanGeometryBuffer::draw(
+		VkCommandBuffer commandBuffer,
+		const DrawBatcher &batch,
+		VulkanRingBuffer &frameRing,
+		const std::function<void(uint64_t key)> &bindBucket) {
+	const std::vector<IndirectCommand> &commands = batch.getCommands();
+	if (commands.empty()) {
+		return;
+	}
+
+	VulkanRingBuffer::Slice slice;
+	if (vulkanDevice.multiDrawIndirect && vulkanDevice.drawIndirectFirstInstance) {
+		slice = frameRing.write(commands.data(), commands.size() * sizeof(IndirectCommand));
+	}
+
+	for (const DrawBucket &bucket : batch.getBuckets()) {
+		bindBucket(bucket.key);
+
+		if (slice.mapped) {
+			vkCmdDrawIndexedIndirect(
+					commandBuffer,
+					slice.buffer,
+					slice.offset + bucket.firstCommand * sizeof(IndirectCommand),
+					bucket.noCommands,
+					sizeof(IndirectCommand));
+		} else {
+			for (uint32_t i = bucket.firstCommand; i < bucket.firstCommand + bucket.noCommands; i++) {
+				const IndirectCommand &command = commands[i];
+				vkCmdDrawIndexed(
+						commandBuffer,
+						command.indexCount,
+						command.instanceCount,
+						command.firstIndex,
+						command.vertexOffset,
+						command.firstInstance);
+			}
+		}
+	}
+}
+
+/**
+ * Draws a built batch from commands the device wrote (e.g. VulkanCullPass), in the order of the batch
+ *
+ * @param indirectBuffer Buffer holding the commands of the batch from indirectOffset on
+ * @param bindBucket Binds the pipeline and descriptors of a bucket key before its draws
+ *
+ * @note Requires drawIndirectFirstInstance, without multiDrawIndirect each command is its own indirect draw
+ */
+void VulkanGeometryBuffer::drawIndirect(
+		VkCommandBuffer commandBuffer,
+		const DrawBatcher &batch,
+		VkBuffer indirectBuffer,
+		VkDeviceSize indirectOffset,
+		const std::function<void(uint64_t key)> &bindBucket) {
+	assert(vulkanDevice.drawIndirectFirstInstance && "Indirect draws need drawIndirectFirstInstance");
+
+	for (const DrawBucket &bucket : batch.getBuckets()) {
+		bindBucket(bucket.key);
+
+		VkDeviceSize offset = indirectOffset + bucket.firstCommand * sizeof(IndirectCommand);
+		if (vulkanDevice.multiDrawIndirect) {
+			vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, offset, bucket.noCommands, sizeof(IndirectCommand));
+		} else {
+			for (uint32_t i = 0; i < bucket.noCommands; i++) {
+				vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, offset + i * sizeof(IndirectCommand), 1, sizeof(IndirectCommand));
+			}
+		}
+	}
+}
+
+// staged and copied on the transfer queue without waiting (data can be freed once this returns)
+UploadTicket VulkanGeometryBuffer::upload(VulkanBuffer &dst, const void *data, VkDeviceSize size, VkDeviceSize offset) {
+	return vulkanDevice.getUploadManager().uploadBuffer(dst.getBuffer(), offset, data, size);
+}
+
+//}	// namespace lve
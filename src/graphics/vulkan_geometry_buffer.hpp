@@ -0,0 +1,77 @@
+#pragma once
+
+#include "vulkan_buffer.hpp"
+#include "vulkan_device.hpp"
+#include "vulkan_ring_buffer.hpp"
+#include "memory/drawbatcher.hpp"
+#include "memory/rangeallocator.hpp"
+
+// std
+#include <functional>
+#include <memory>
+
+//namespace lve {
+
+/*
+	vertices and indices of a mesh in a VulkanGeometryBuffer
+*/
+typedef struct GeometryRange {
+	// first vertex (vertexOffset of its draws, indices stay relative to the mesh)
+	uint32_t firstVertex = 0;
+	uint32_t vertexCount = 0;
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	// upload of both ranges, drawn once it is ready (see VulkanUploadManager::isReady)
+	UploadTicket ticket = 0;
+} GeometryRange;
+
+/*
+	Shared vertex and index buffers for the meshes of a scene
+	- each mesh gets a range of both buffers, so they are bound once per frame instead of once per mesh
+	- a DrawBatcher of the frame is drawn with one indirect draw per bucket (pipeline/material)
+*/
+class VulkanGeometryBuffer {
+ public:
+	VulkanGeometryBuffer(VulkanDevice &device, VkDeviceSize vertexSize, uint32_t maxVertices, uint32_t maxIndices);
+
+	VulkanGeometryBuffer(const VulkanGeometryBuffer &) = delete;
+	VulkanGeometryBuffer &operator=(const VulkanGeometryBuffer &) = delete;
+
+	bool add(const void *vertices, uint32_t vertexCount, const uint32_t *indices, uint32_t indexCount, GeometryRange &range);
+	void remove(GeometryRange &range);
+
+	void bind(
+			VkCommandBuffer commandBuffer,
+			VkBuffer instanceBuffer,
+			VkDeviceSize instanceOffset,
+			VkBuffer normalizedInstanceBuffer,
+			VkDeviceSize normalizedInstanceOffset);
+	void draw(
+			VkCommandBuffer commandBuffer,
+			const DrawBatcher &batch,
+			VulkanRingBuffer &frameRing,
+			const std::function<void(uint64_t key)> &bindBucket);
+	void drawIndirect(
+			VkCommandBuffer commandBuffer,
+			const DrawBatcher &batch,
+			VkBuffer indirectBuffer,
+			VkDeviceSize indirectOffset,
+			const std::function<void(uint64_t key)> &bindBucket);
+
+	uint32_t getUsedVertices() const { return static_cast<uint32_t>(vertexRanges.getUsed()); }
+	uint32_t getUsedIndices() const { return static_cast<uint32_t>(indexRanges.getUsed()); }
+
+ private:
+	UploadTicket upload(VulkanBuffer &dst, const void *data, VkDeviceSize size, VkDeviceSize offset);
+
+	VulkanDevice &vulkanDevice;
+	VkDeviceSize vertexSize;
+
+	std::unique_ptr<VulkanBuffer> vertexBuffer;
+	std::unique_ptr<VulkanBuffer> indexBuffer;
+	// free ranges of the buffers (in vertices and indices)
+	RangeAllocator vertexRanges;
+	RangeAllocator indexRanges;
+};
+
+//}	// namespace lve
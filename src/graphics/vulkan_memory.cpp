@@ -0,0 +1,43 @@
+#include "vulkan_memory.hpp"
+
+//namespace lve {
+
+VulkanMemorySource::VulkanMemorySource(VkDevice device, VkPhysicalDevice physicalDevice) : device{device} {
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+}
+
+/**
+ * Allocates a block of device memory, mapped for its whole lifetime if the memory type is host visible
+ *
+ * @return Handle of the block (0 if the allocation failed)
+ */
+uint64_t VulkanMemorySource::allocateBlock(uint32_t memoryType, uint64_t size, void **mapped) {
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryType;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		return 0;
+	}
+
+	*mapped = nullptr;
+	if (memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+			vkFreeMemory(device, memory, nullptr);
+			return 0;
+		}
+	}
+
+	return (uint64_t)(uintptr_t)memory;
+}
+
+/**
+ * Frees a block (implicitly unmapping it)
+ */
+void VulkanMemorySource::freeBlock(uint64_t block) {
+	vkFreeMemory(device, memoryOf(block), nullptr);
+}
+
+//}	// namespace lve
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "memory/blockallocator.hpp"
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+
+//namespace lve {
+
+/*
+	Device memory blocks for the BlockAllocator of a VulkanDevice
+	- host visible blocks are mapped once when allocated, so every range in them has a host address
+		(a VkDeviceMemory can only be mapped once at a time)
+*/
+class VulkanMemorySource : public MemoryBlockSource {
+ public:
+	VulkanMemorySource(VkDevice device, VkPhysicalDevice physicalDevice);
+
+	uint64_t allocateBlock(uint32_t memoryType, uint64_t size, void **mapped) override;
+	void freeBlock(uint64_t block) override;
+
+	// device memory of a block handle
+	static VkDeviceMemory memoryOf(uint64_t block) { return (VkDeviceMemory)(uintptr_t)block; }
+	static VkDeviceMemory memoryOf(const MemoryAllocation &allocation) { return memoryOf(allocation.block); }
+
+ private:
+	VkDevice device;
+	VkPhysicalDeviceMemoryProperties memProperties;
+};
+
+//}	// namespace lve
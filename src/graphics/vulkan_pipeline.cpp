@@ -47,10 +47,8 @@ VulkanPipeline::VulkanPipeline(
 
 
 VulkanPipeline::~VulkanPipeline() {
-	vkDestroyShaderModule(vulkanDevice.device(), vertShaderModule, nullptr);
-	vkDestroyShaderModule(vulkanDevice.device(), fragShaderModule, nullptr);
-	vkDestroyShaderModule(vulkanDevice.device(), geoShaderModule, nullptr);
-	vkDestroyPipeline(vulkanDevice.device(), graphicsPipeline, nullptr);
+	// destroyed by the cache once no other VulkanPipeline shares it
+	vulkanDevice.getPipelineCache().release(graphicsPipeline);
 }
 
 std::vector<char> VulkanPipeline::readFile(const std::string& filepath) {
@@ -83,10 +81,35 @@ void VulkanPipeline::createGraphicsPipeline(
 	assert( configInfo.renderPass != VK_NULL_HANDLE &&
 			"Cannot create graphics pipeline: no renderPass provided in configInfo");
 
-    auto vertSpirv = getOrCompileSPIRV(vertFilepath, EShLangVertex);
-    auto fragSpirv = getOrCompileSPIRV(fragFilepath, EShLangFragment);
-	createShaderModule(vertSpirv, &vertShaderModule);
-	createShaderModule(fragSpirv, &fragShaderModule);
+    // all stages in one batch, so the missing ones compile in parallel
+    std::vector<ShaderRequest> requests{
+        {vertFilepath, EShLangVertex, includeDefaultHeader},
+        {fragFilepath, EShLangFragment, includeDefaultHeader}};
+    if ( !geoFilepath.empty() ) {
+        requests.push_back({geoFilepath, EShLangGeometry, includeDefaultHeader}); }
+
+    std::vector<std::vector<uint32_t>> spirv;
+    getOrCompileSPIRV(requests, spirv);
+
+    // identical pipelines (same state, shaders and compatible render pass) are created once
+    VulkanPipelineCache& pipelineCache = vulkanDevice.getPipelineCache();
+    uint64_t key = hashPipeline(configInfo,
+        pipelineCache.getRenderPassKey(configInfo.renderPass), pipelineCache.getPipelineLayoutKey(configInfo.pipelineLayout), spirv);
+    graphicsPipeline = pipelineCache.acquire(key, [&](VkPipelineCache cache) {
+        return createGraphicsPipeline(configInfo, spirv, cache);
+    });
+}
+
+// create the pipeline from SPIR-V (on a miss of the pipeline cache)
+VkPipeline VulkanPipeline::createGraphicsPipeline(
+        const PipelineConfigInfo& configInfo,
+        const std::vector<std::vector<uint32_t>>& spirv,
+        VkPipelineCache cache) {
+    VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+    VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+    VkShaderModule geoShaderModule = VK_NULL_HANDLE;
+	createShaderModule(spirv[0], &vertShaderModule);
+	createShaderModule(spirv[1], &fragShaderModule);
 
 	std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
 
@@ -113,9 +136,8 @@ void VulkanPipeline::createGraphicsPipeline(
     shaderStages.push_back(fragShaderStage);
 
     // We add Geomatry Shader stage only if we are procided one
-    if ( !geoFilepath.empty() ) {
-        auto geoSpirv = getOrCompileSPIRV(geoFilepath, EShLangGeometry);
-	    createShaderModule(geoSpirv, &geoShaderModule);
+    if ( spirv.size() > 2 ) {
+	    createShaderModule(spirv[2], &geoShaderModule);
 
         // Geometry Shader Stage
         VkPipelineShaderStageCreateInfo geoShaderStage{};
@@ -160,23 +182,109 @@ void VulkanPipeline::createGraphicsPipeline(
 	pipelineInfo.basePipelineIndex = -1;
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-	if (vkCreateGraphicsPipelines(
+	VkPipeline pipeline;
+	VkResult result = vkCreateGraphicsPipelines(
 					vulkanDevice.device(),
-					VK_NULL_HANDLE,
+					cache,
 					1,
 					&pipelineInfo,
 					nullptr,
-					&graphicsPipeline) != VK_SUCCESS) {
+					&pipeline);
+
+	// the pipeline keeps what it needs of the modules
+	vkDestroyShaderModule(vulkanDevice.device(), vertShaderModule, nullptr);
+	vkDestroyShaderModule(vulkanDevice.device(), fragShaderModule, nullptr);
+	vkDestroyShaderModule(vulkanDevice.device(), geoShaderModule, nullptr);
+
+	if (result != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline");
 	}
+	return pipeline;
+}
+
+/**
+ * Hashes everything a graphics pipeline is created from, field by field (pointers in the
+ * create infos differ between identical configs)
+ *
+ * @param renderPassKey Key of the render pass from VulkanPipelineCache::getRenderPassKey
+ * @param layoutKey Key of the pipeline layout from VulkanPipelineCache::getPipelineLayoutKey
+ * @param spirv SPIR-V of the stages
+ */
+uint64_t VulkanPipeline::hashPipeline(
+        const PipelineConfigInfo& configInfo,
+        uint64_t renderPassKey,
+        uint64_t layoutKey,
+        const std::vector<std::vector<uint32_t>>& spirv) {
+    uint64_t ret = renderPassKey;
+    auto hashValue = [&ret](const auto& value) {
+        ret = ShaderCache::hash(&value, sizeof(value), ret); };
+    auto hashArray = [&ret](const auto* values, size_t count) {
+        ret = ShaderCache::hash(&count, sizeof(count), ret);
+        if (values) {
+            ret = ShaderCache::hash(values, count * sizeof(*values), ret); } };
+
+    hashValue(layoutKey);
+    hashValue(configInfo.subpass);
+    for (const std::vector<uint32_t>& stage : spirv) {
+        hashArray(stage.data(), stage.size()); }
+
+    hashArray(configInfo.bindingDescriptions.data(), configInfo.bindingDescriptions.size());
+    hashArray(configInfo.attributeDescriptions.data(), configInfo.attributeDescriptions.size());
+
+    hashValue(configInfo.inputAssemblyInfo.topology);
+    hashValue(configInfo.inputAssemblyInfo.primitiveRestartEnable);
+
+    hashValue(configInfo.viewportInfo.viewportCount);
+    hashValue(configInfo.viewportInfo.scissorCount);
+    hashArray(configInfo.viewportInfo.pViewports, configInfo.viewportInfo.pViewports ? configInfo.viewportInfo.viewportCount : 0);
+    hashArray(configInfo.viewportInfo.pScissors, configInfo.viewportInfo.pScissors ? configInfo.viewportInfo.scissorCount : 0);
+
+    const VkPipelineRasterizationStateCreateInfo& raster = configInfo.rasterizationInfo;
+    hashValue(raster.depthClampEnable);
+    hashValue(raster.rasterizerDiscardEnable);
+    hashValue(raster.polygonMode);
+    hashValue(raster.cullMode);
+    hashValue(raster.frontFace);
+    hashValue(raster.depthBiasEnable);
+    hashValue(raster.depthBiasConstantFactor);
+    hashValue(raster.depthBiasClamp);
+    hashValue(raster.depthBiasSlopeFactor);
+    hashValue(raster.lineWidth);
+
+    const VkPipelineMultisampleStateCreateInfo& multisample = configInfo.multisampleInfo;
+    hashValue(multisample.rasterizationSamples);
+    hashValue(multisample.sampleShadingEnable);
+    hashValue(multisample.minSampleShading);
+    hashValue(multisample.alphaToCoverageEnable);
+    hashValue(multisample.alphaToOneEnable);
+
+    const VkPipelineColorBlendStateCreateInfo& blend = configInfo.colorBlendInfo;
+    hashValue(blend.logicOpEnable);
+    hashValue(blend.logicOp);
+    hashArray(blend.pAttachments, blend.attachmentCount);
+    hashValue(blend.blendConstants);
+
+    const VkPipelineDepthStencilStateCreateInfo& depth = configInfo.depthStencilInfo;
+    hashValue(depth.depthTestEnable);
+    hashValue(depth.depthWriteEnable);
+    hashValue(depth.depthCompareOp);
+    hashValue(depth.depthBoundsTestEnable);
+    hashValue(depth.stencilTestEnable);
+    hashValue(depth.front);
+    hashValue(depth.back);
+    hashValue(depth.minDepthBounds);
+    hashValue(depth.maxDepthBounds);
+
+    hashArray(configInfo.dynamicStateInfo.pDynamicStates, configInfo.dynamicStateInfo.dynamicStateCount);
+    return ret;
 }
 
 
-void VulkanPipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
+void VulkanPipeline::createShaderModule(const std::vector<uint32_t>& code, VkShaderModule* shaderModule) {
 	VkShaderModuleCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+	createInfo.codeSize = code.size() * sizeof(uint32_t);
+	createInfo.pCode = code.data();
 
 	if (vkCreateShaderModule(vulkanDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create shader module"); }
@@ -334,45 +442,73 @@ std::vector<char> VulkanPipeline::readFile(const std::string& filepath) {
 
 
 
-std::vector<char> VulkanPipeline::getOrCompileSPIRV(const std::string& filePath, EShLanguage shaderType) {
-    std::string spirvFilePath = VulkanPipeline::defaultDirectory + '/' + filePath + ".spv";
-
-    // Check if SPIR-V file already exists
-    if (std::filesystem::exists(spirvFilePath)) {
-		return readFile(filePath); }
+// compile GLSL with glslang (called by the shader cache from the job system threads)
+static bool compileGlslang(const ShaderSource& source, std::vector<uint32_t>& spirv, std::string& log) {
+    EShLanguage shaderType = static_cast<EShLanguage>(source.request->stage);
 
     // Initialize GLSLang shader
-    glslang::TShader shader(shaderType);		// Read GLSL source code
-    const char* sourceCStr = readFile(filePath).data();
+    glslang::TShader shader(shaderType);
+    const char* sourceCStr = source.text.c_str();
     shader.setStrings(&sourceCStr, 1);
     TBuiltInResource defaultResource = InitResources();		//Defined in TBuiltInResource_default
 
     // Parse GLSL
     if (!shader.parse(&defaultResource, 100, false, EShMsgDefault)) {
-        throw std::runtime_error("GLSL Parsing Failed: " + std::string(shader.getInfoLog())); }
+        log = "GLSL Parsing Failed: " + std::string(shader.getInfoLog());
+        return false; }
 
     // Link into a program
     glslang::TProgram program;
     program.addShader(&shader);
     if (!program.link(EShMsgDefault)) {
-        throw std::runtime_error("GLSL Linking Failed: " + std::string(program.getInfoLog())); }
+        log = "GLSL Linking Failed: " + std::string(program.getInfoLog());
+        return false; }
 
     // Convert to SPIR-V
-    std::vector<uint32_t> spirv;
     glslang::GlslangToSpv(*program.getIntermediate(shaderType), spirv);
+    return true;
+}
 
-    // Convert the uint32_t vector into a char vector (byte-by-byte)
-    std::vector<char> spirvCharData(reinterpret_cast<const char*>(spirv.data()), 
-                                    reinterpret_cast<const char*>(spirv.data()) + spirv.size() * sizeof(uint32_t));
-
-    // Save SPIR-V binary to a file
-    std::ofstream spirvFile(spirvFilePath, std::ios::binary);
-    if (!spirvFile.is_open()) {
-        throw std::runtime_error("Failed to open file for writing: " + spirvFilePath); }
-    spirvFile.write(spirvCharData.data(), spirvCharData.size());
-
-    return spirvCharData;
+// shader cache in defaultDirectory, created on first use
+ShaderCache& VulkanPipeline::getShaderCache() {
+    static ShaderCache* cache = [] {
+        glslang::InitializeProcess();
+
+        // a new glslang misses every entry of the old one
+        glslang::Version version = glslang::GetVersion();
+        std::string compilerVersion = "glslang " + std::to_string(version.major) + '.'
+            + std::to_string(version.minor) + '.' + std::to_string(version.patch) + version.flavor;
+
+        ShaderCache* ret = new ShaderCache(VulkanPipeline::defaultDirectory,
+            VulkanPipeline::defaultDirectory + "/shaders.cache", compilerVersion, compileGlslang);
+        ret->load();
+        return ret;
+    }();
+    return *cache;
 }
 
+/**
+ * Gets the SPIR-V of several shaders, the ones not in the shader cache are compiled in parallel
+ * and the cache is saved
+ *
+ * @param spirv Set to the SPIR-V of each request, in order
+ */
+void VulkanPipeline::getOrCompileSPIRV(std::span<const ShaderRequest> requests, std::vector<std::vector<uint32_t>>& spirv) {
+    ShaderCache& cache = getShaderCache();
+    // part of the key, so editing defaultHead.gh compiles the shaders that include it again
+    cache.setDefaultHeader(VulkanPipeline::defaultHeaders.str());
+
+    cache.getOrCompile(requests, spirv);
+    if (cache.isDirty() && !cache.save()) {
+        std::cerr << "failed to save shader cache" << std::endl; }
+}
 
+// single shader as bytes (for createShaderModule calls outside of VulkanPipeline)
+std::vector<char> VulkanPipeline::getOrCompileSPIRV(const std::string& filePath, EShLanguage shaderType) {
+    ShaderRequest request{filePath, shaderType, includeDefaultHeader};
+    std::vector<std::vector<uint32_t>> spirv;
+    getOrCompileSPIRV(std::span<const ShaderRequest>(&request, 1), spirv);
 
+    const char* bytes = reinterpret_cast<const char*>(spirv[0].data());
+    return std::vector<char>(bytes, bytes + spirv[0].size() * sizeof(uint32_t));
+}
@@ -1,9 +1,11 @@
 #pragma once
 
 #include "vulkan_device.hpp"
+#include "shader_cache.hpp"
 #include <vulkan/vulkan.hpp>
 
 // std
+#include <span>
 #include <string>
 #include <vector>
 #include <sstream>
@@ -76,6 +78,8 @@ class VulkanPipeline {
     static void loadIntoDefault(const std::string& filepath);	// load into default header
     static void clearDefault();									// clear default header (after shader compilation)
     static std::vector<char> getOrCompileSPIRV(const std::string& glslFile, EShLanguage shaderType);
+    static void getOrCompileSPIRV(std::span<const ShaderRequest> requests, std::vector<std::vector<uint32_t>>& spirv);
+    static ShaderCache& getShaderCache();						// compiled shaders (set jobs to compile in parallel)
 
  private:
 	static std::vector<char> readFile(const std::string& filepath);
@@ -86,13 +90,21 @@ class VulkanPipeline {
 		const std::string& fragFilepath,
 		const std::string& geoFilepath = "");
 
-	void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+	VkPipeline createGraphicsPipeline(
+		const PipelineConfigInfo& configInfo,
+		const std::vector<std::vector<uint32_t>>& spirv,
+		VkPipelineCache cache);
+	static uint64_t hashPipeline(
+		const PipelineConfigInfo& configInfo,
+		uint64_t renderPassKey,
+		uint64_t layoutKey,
+		const std::vector<std::vector<uint32_t>>& spirv);
+
+	void createShaderModule(const std::vector<uint32_t>& code, VkShaderModule* shaderModule);
     static const bool includeDefaultHeader = false;
 
 	VulkanDevice& vulkanDevice;
+	// shared with every VulkanPipeline of the same state (see VulkanPipelineCache)
 	VkPipeline graphicsPipeline;
-	VkShaderModule vertShaderModule;
-	VkShaderModule fragShaderModule;
-	static VkShaderModule geoShaderModule;
 };
 
@@ -0,0 +1,368 @@
+#include "vulkan_pipeline_cache.hpp"
+#include "shader_cache.hpp"
+#include "../algorithms/timer.hpp"
+
+// std
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+//namespace lve {
+
+// first bytes of the file and version of its layout
+#define PIPELINE_CACHE_MAGIC 0x48434c50	// "PLCH"
+#define PIPELINE_CACHE_VERSION 1
+
+/*
+	file layout: fileHeader, then the data of vkGetPipelineCacheData
+	- the driver checks its own header in the data too, but some drivers crash or silently ignore
+		data from another driver version, so it is checked here before the driver sees it
+*/
+struct fileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	uint64_t dataSize;
+	// hash of the data, catches files that were cut off while saving
+	uint64_t dataHash;
+};
+
+/**
+ * Creates the VkPipelineCache with the data of the file at path if it is valid for this device
+ *
+ * @param properties Properties of the physical device (identify the driver the data is for)
+ */
+VulkanPipelineCache::VulkanPipelineCache(
+		VkDevice device, const VkPhysicalDeviceProperties &properties, const std::string &path)
+		: device{device}, properties{properties}, path{path} {
+	auto start = std::chrono::steady_clock::now();
+	std::vector<char> data = load();
+
+	VkPipelineCacheCreateInfo cacheInfo{};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = data.size();
+	cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+		// rejected by the driver after all, start empty
+		loadError = "rejected by the driver";
+		cacheInfo.initialDataSize = 0;
+		cacheInfo.pInitialData = nullptr;
+		if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline cache!");
+		}
+		data.clear();
+	}
+
+	stats.loadedSize = data.size();
+	stats.loadMs = msSince(start);
+}
+
+/**
+ * Saves the cache and destroys it
+ *
+ * @note Every pipeline acquired from the cache has to be released before
+ */
+VulkanPipelineCache::~VulkanPipelineCache() {
+	if (!save()) {
+		std::cerr << "failed to save pipeline cache to " << path << std::endl;
+	}
+
+	// pipelines that were not released
+	for (auto &[key, shared] : pipelines) {
+		vkDestroyPipeline(device, shared.pipeline, nullptr);
+	}
+	vkDestroyPipelineCache(device, pipelineCache, nullptr);
+}
+
+/**
+ * Reads the file, the data is empty (with the reason in loadError) if it is missing or not for this device
+ */
+std::vector<char> VulkanPipelineCache::load() {
+	std::vector<char> data;
+
+	std::ifstream file{path, std::ios::ate | std::ios::binary};
+	if (!file.is_open()) {
+		loadError = "no file";
+		return data;
+	}
+
+	std::vector<char> contents(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(contents.data(), contents.size());
+
+	validate(contents, data);
+	return data;
+}
+
+/**
+ * Checks a file against the device and copies out its data
+ *
+ * @return false with the reason in loadError if the file is not valid for this device
+ */
+bool VulkanPipelineCache::validate(const std::vector<char> &file, std::vector<char> &data) {
+	fileHeader header{};
+	if (file.size() < sizeof(header)) {
+		loadError = "file too small";
+		return false;
+	}
+	std::memcpy(&header, file.data(), sizeof(header));
+
+	if (header.magic != PIPELINE_CACHE_MAGIC || header.version != PIPELINE_CACHE_VERSION) {
+		loadError = "unknown file format";
+		return false;
+	}
+	if (header.vendorID != properties.vendorID
+			|| header.deviceID != properties.deviceID
+			|| header.driverVersion != properties.driverVersion
+			|| std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+		loadError = "written by another device or driver";
+		return false;
+	}
+
+	const char *begin = file.data() + sizeof(header);
+	if (header.dataSize != file.size() - sizeof(header)
+			|| header.dataHash != ShaderCache::hash(begin, header.dataSize)) {
+		loadError = "data is damaged";
+		return false;
+	}
+
+	// header the driver wrote in front of its data
+	VkPipelineCacheHeaderVersionOne driverHeader{};
+	if (header.dataSize < sizeof(driverHeader)) {
+		loadError = "data is damaged";
+		return false;
+	}
+	std::memcpy(&driverHeader, begin, sizeof(driverHeader));
+	if (driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			|| driverHeader.vendorID != properties.vendorID
+			|| driverHeader.deviceID != properties.deviceID
+			|| std::memcmp(driverHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+		loadError = "data is for another device or driver";
+		return false;
+	}
+
+	data.assign(begin, begin + header.dataSize);
+	loadError.clear();
+	return true;
+}
+
+/**
+ * Writes the data of the cache to the file if the driver created pipelines since it was loaded
+ * - written to a temporary file first, so a failed save leaves the old file
+ */
+bool VulkanPipelineCache::save() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!dirty) {
+		return true;
+	}
+	auto start = std::chrono::steady_clock::now();
+
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS) {
+		return false;
+	}
+	std::vector<char> data(dataSize);
+	if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) != VK_SUCCESS) {
+		return false;
+	}
+	data.resize(dataSize);
+
+	fileHeader header{};
+	header.magic = PIPELINE_CACHE_MAGIC;
+	header.version = PIPELINE_CACHE_VERSION;
+	header.vendorID = properties.vendorID;
+	header.deviceID = properties.deviceID;
+	header.driverVersion = properties.driverVersion;
+	std::memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = data.size();
+	header.dataHash = ShaderCache::hash(data.data(), data.size());
+
+	std::string tmpPath = path + ".tmp";
+	{
+		std::ofstream file{tmpPath, std::ios::binary | std::ios::trunc};
+		file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		file.write(data.data(), data.size());
+		if (!file) {
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tmpPath, path, error);
+	if (error) {
+		return false;
+	}
+
+	dirty = false;
+	stats.saveMs += msSince(start);
+	return true;
+}
+
+/**
+ * Gets the pipeline of a key, creating it the first time
+ *
+ * @param key Hash of everything the pipeline is created from (see VulkanPipeline::hashPipeline),
+ *   render passes and layouts should be included with getRenderPassKey and getPipelineLayoutKey
+ * @param create Creates the pipeline with the VkPipelineCache, only called on a miss
+ * @return Pipeline to give back with release
+ */
+VkPipeline VulkanPipelineCache::acquire(uint64_t key, const CreatePipeline &create) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	SharedPipeline &shared = pipelines[key];
+	if (shared.pipeline != VK_NULL_HANDLE) {
+		shared.noUsers++;
+		stats.noShared++;
+		return shared.pipeline;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	try {
+		pipeline = create(pipelineCache);
+	} catch (...) {
+		pipelines.erase(key);
+		throw;
+	}
+	stats.createMs += msSince(start);
+	stats.noCreated++;
+
+	shared.pipeline = pipeline;
+	shared.noUsers = 1;
+	pipelineKeys[pipeline] = key;
+	dirty = true;
+	return pipeline;
+}
+
+/**
+ * Gives back a pipeline from acquire, it is destroyed once no one uses it
+ */
+void VulkanPipelineCache::release(VkPipeline pipeline) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto keyIt = pipelineKeys.find(pipeline);
+	if (keyIt == pipelineKeys.end()) {
+		return;
+	}
+
+	auto it = pipelines.find(keyIt->second);
+	if (--it->second.noUsers) {
+		return;
+	}
+
+	vkDestroyPipeline(device, pipeline, nullptr);
+	pipelines.erase(it);
+	pipelineKeys.erase(keyIt);
+}
+
+/**
+ * Hashes what makes render passes compatible: the format and samples of every attachment
+ * a subpass references (dependencies too if there are several subpasses)
+ */
+void VulkanPipelineCache::registerRenderPass(VkRenderPass renderPass, const VkRenderPassCreateInfo &createInfo) {
+	uint64_t key = ShaderCache::hash(&createInfo.subpassCount, sizeof(createInfo.subpassCount));
+
+	auto hashReference = [&](const VkAttachmentReference &reference) {
+		uint32_t attachment[2] = {VK_ATTACHMENT_UNUSED, 0};
+		if (reference.attachment != VK_ATTACHMENT_UNUSED) {
+			attachment[0] = createInfo.pAttachments[reference.attachment].format;
+			attachment[1] = createInfo.pAttachments[reference.attachment].samples;
+		}
+		key = ShaderCache::hash(attachment, sizeof(attachment), key);
+	};
+	auto hashReferences = [&](const VkAttachmentReference *references, uint32_t count) {
+		key = ShaderCache::hash(&count, sizeof(count), key);
+		for (uint32_t i = 0; references && i < count; i++) {
+			hashReference(references[i]);
+		}
+	};
+
+	for (uint32_t i = 0; i < createInfo.subpassCount; i++) {
+		const VkSubpassDescription &subpass = createInfo.pSubpasses[i];
+		key = ShaderCache::hash(&subpass.pipelineBindPoint, sizeof(subpass.pipelineBindPoint), key);
+		hashReferences(subpass.pInputAttachments, subpass.inputAttachmentCount);
+		hashReferences(subpass.pColorAttachments, subpass.colorAttachmentCount);
+		hashReferences(subpass.pResolveAttachments, subpass.pResolveAttachments ? subpass.colorAttachmentCount : 0);
+		hashReference(subpass.pDepthStencilAttachment
+				? *subpass.pDepthStencilAttachment
+				: VkAttachmentReference{VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED});
+	}
+
+	if (createInfo.subpassCount > 1) {
+		for (uint32_t i = 0; i < createInfo.dependencyCount; i++) {
+			key = ShaderCache::hash(&createInfo.pDependencies[i], sizeof(VkSubpassDependency), key);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	renderPassKeys[renderPass] = key;
+}
+
+void VulkanPipelineCache::unregisterRenderPass(VkRenderPass renderPass) {
+	std::lock_guard<std::mutex> lock(mutex);
+	renderPassKeys.erase(renderPass);
+}
+
+/**
+ * Key of a render pass for pipeline keys, the handle itself if it was not registered
+ */
+uint64_t VulkanPipelineCache::getRenderPassKey(VkRenderPass renderPass) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = renderPassKeys.find(renderPass);
+	if (it != renderPassKeys.end()) {
+		return it->second;
+	}
+	return ShaderCache::hash(&renderPass, sizeof(renderPass));
+}
+
+/**
+ * Hashes what makes pipeline layouts compatible: the set layouts and push constant ranges
+ */
+void VulkanPipelineCache::registerPipelineLayout(VkPipelineLayout layout, const VkPipelineLayoutCreateInfo &createInfo) {
+	uint64_t key = ShaderCache::hash(&createInfo.setLayoutCount, sizeof(createInfo.setLayoutCount));
+	key = ShaderCache::hash(createInfo.pSetLayouts, createInfo.setLayoutCount * sizeof(VkDescriptorSetLayout), key);
+	key = ShaderCache::hash(&createInfo.pushConstantRangeCount, sizeof(createInfo.pushConstantRangeCount), key);
+	key = ShaderCache::hash(createInfo.pPushConstantRanges, createInfo.pushConstantRangeCount * sizeof(VkPushConstantRange), key);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	layoutKeys[layout] = key;
+}
+
+void VulkanPipelineCache::unregisterPipelineLayout(VkPipelineLayout layout) {
+	std::lock_guard<std::mutex> lock(mutex);
+	layoutKeys.erase(layout);
+}
+
+/**
+ * Key of a pipeline layout for pipeline keys, the handle itself if it was not registered
+ */
+uint64_t VulkanPipelineCache::getPipelineLayoutKey(VkPipelineLayout layout) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = layoutKeys.find(layout);
+	if (it != layoutKeys.end()) {
+		return it->second;
+	}
+	return ShaderCache::hash(&layout, sizeof(layout));
+}
+
+/**
+ * Formats the stats, for a stats overlay or the log
+ */
+std::string VulkanPipelineCache::getStatsText() const {
+	char line[160];
+	std::snprintf(line, sizeof(line),
+			"pipelines: %u created in %.3f ms, %u shared\npipeline cache: %zu bytes loaded in %.3f ms%s%s",
+			stats.noCreated, stats.createMs, stats.noShared, stats.loadedSize, stats.loadMs,
+			loadError.empty() ? "" : ", not used: ", loadError.c_str());
+	return line;
+}
+
+//}	// namespace lve
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//namespace lve {
+
+// file the driver's pipeline cache is kept in (relative to the working directory)
+#define PIPELINE_CACHE_FILE "pipelines.cache"
+
+/*
+	Pipeline creation without repeated work
+	- owns a VkPipelineCache that is loaded from disk when the device is created and saved when it is
+		destroyed, the file is only used if it was written by the same vendor, device, driver version
+		and pipeline cache UUID (a stale file is thrown away, never passed to the driver)
+	- shares pipelines within the process: pipelines are looked up by a hash of their state, shaders
+		and render pass compatibility, so an identical pipeline is created once and reference counted
+	- render passes and pipeline layouts are hashed by what makes them compatible (formats, samples
+		and attachment references, set layouts and push constant ranges), so ones that are created
+		again (on resize, by another render system) keep their pipelines
+*/
+class VulkanPipelineCache {
+ public:
+	// creates a pipeline on a miss, with the VkPipelineCache to pass to vkCreate*Pipelines
+	typedef std::function<VkPipeline(VkPipelineCache pipelineCache)> CreatePipeline;
+
+	// counts and timings since the device was created
+	struct Stats {
+		// pipelines created by the driver, and requests that got an existing pipeline
+		uint32_t noCreated = 0;
+		uint32_t noShared = 0;
+		double createMs = 0.0;
+		double loadMs = 0.0;
+		double saveMs = 0.0;
+		// size of the cache data that was loaded (0 if there was no valid file)
+		size_t loadedSize = 0;
+	};
+
+	VulkanPipelineCache(VkDevice device, const VkPhysicalDeviceProperties &properties, const std::string &path);
+	~VulkanPipelineCache();
+
+	VulkanPipelineCache(const VulkanPipelineCache &) = delete;
+	VulkanPipelineCache &operator=(const VulkanPipelineCache &) = delete;
+
+	VkPipelineCache getHandle() { return pipelineCache; }
+
+	VkPipeline acquire(uint64_t key, const CreatePipeline &create);
+	void release(VkPipeline pipeline);
+
+	void registerRenderPass(VkRenderPass renderPass, const VkRenderPassCreateInfo &createInfo);
+	void unregisterRenderPass(VkRenderPass renderPass);
+	uint64_t getRenderPassKey(VkRenderPass renderPass);
+	void registerPipelineLayout(VkPipelineLayout layout, const VkPipelineLayoutCreateInfo &createInfo);
+	void unregisterPipelineLayout(VkPipelineLayout layout);
+	uint64_t getPipelineLayoutKey(VkPipelineLayout layout);
+
+	bool save();
+
+	const Stats &getStats() const { return stats; }
+	// why the file on disk was not used (empty if it was)
+	const std::string &getLoadError() const { return loadError; }
+	std::string getStatsText() const;
+
+ private:
+	// pipeline shared by every request with the same key
+	struct SharedPipeline {
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		uint32_t noUsers = 0;
+	};
+
+	std::vector<char> load();
+	bool validate(const std::vector<char> &file, std::vector<char> &data);
+
+	VkDevice device;
+	VkPhysicalDeviceProperties properties;
+	std::string path;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	// set when the driver created a pipeline, so the data changed since it was loaded
+	bool dirty = false;
+
+	std::unordered_map<uint64_t, SharedPipeline> pipelines;
+	std::unordered_map<VkPipeline, uint64_t> pipelineKeys;
+	std::unordered_map<VkRenderPass, uint64_t> renderPassKeys;
+	std::unordered_map<VkPipelineLayout, uint64_t> layoutKeys;
+	// pipelines may be created from the job system threads
+	std::mutex mutex;
+
+	Stats stats;
+	std::string loadError;
+};
+
+//}	// namespace lve
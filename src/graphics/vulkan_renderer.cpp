@@ -24,6 +24,11 @@ void VulkanRenderer::recreateSwapChain() {
 	}
 	vkDeviceWaitIdle(vulkanDevice.device());
 
+	// nothing is in flight anymore
+	for (VulkanRingBuffer *ring : frameRings) {
+		ring->reset();
+	}
+
 	if (vulkanSwapChain == nullptr) {
 		vulkanSwapChain = std::make_unique<VulkanSwapChain>(vulkanDevice, extent);
 	} else {
@@ -75,6 +80,14 @@ VkCommandBuffer VulkanRenderer::beginFrame() {
 
 	isFrameStarted = true;
 
+	// acquireNextImage waited on the fence of the frame that last used this index
+	for (VulkanRingBuffer *ring : frameRings) {
+		ring->beginFrame(currentFrameIndex);
+	}
+	for (VulkanCommandRecorder *recorder : commandRecorders) {
+		recorder->beginFrame(currentFrameIndex);
+	}
+
 	auto commandBuffer = getCurrentCommandBuffer();
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -82,6 +95,11 @@ VkCommandBuffer VulkanRenderer::beginFrame() {
 	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
 		throw std::runtime_error("failed to begin recording command buffer!");
 	}
+
+	// uploads recorded since the last frame start copying, finished ones are acquired before any draw
+	VulkanUploadManager &uploads = vulkanDevice.getUploadManager();
+	uploads.flush();
+	uploads.recordAcquires(commandBuffer);
 	return commandBuffer;
 }
 
@@ -105,7 +123,18 @@ void VulkanRenderer::endFrame() {
 	currentFrameIndex = (currentFrameIndex + 1) % VulkanSwapChain::MAX_FRAMES_IN_FLIGHT;
 }
 
-void VulkanRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+VulkanCommandRecorder::Target VulkanRenderer::getSwapChainTarget() const {
+	assert(isFrameStarted && "Cannot get render target when frame not in progress");
+
+	VulkanCommandRecorder::Target target{};
+	target.renderPass = vulkanSwapChain->getRenderPass();
+	target.subpass = 0;
+	target.framebuffer = vulkanSwapChain->getFrameBuffer(currentImageIndex);
+	target.extent = vulkanSwapChain->getSwapChainExtent();
+	return target;
+}
+
+void VulkanRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents) {
 	assert(isFrameStarted && "Can't call beginSwapChainRenderPass if frame is not in progress");
 	assert(
 			commandBuffer == getCurrentCommandBuffer() &&
@@ -125,7 +154,11 @@ void VulkanRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
 	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 	renderPassInfo.pClearValues = clearValues.data();
 
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+	if (contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) {
+		// only secondary buffers may be executed in the subpass, they set their own viewport and scissor
+		return;
+	}
 
 	VkViewport viewport{};
 	viewport.x = 0.0f;
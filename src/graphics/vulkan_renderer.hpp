@@ -1,6 +1,8 @@
 #pragma once
 
+#include "vulkan_command_recorder.hpp"
 #include "vulkan_device.hpp"
+#include "vulkan_ring_buffer.hpp"
 #include "vulkan_swap_chain.hpp"
 #include "vulkan_window.hpp"
 
@@ -33,9 +35,18 @@ class VulkanRenderer {
 		return currentFrameIndex;
 	}
 
+	// ring recycled at the start of each frame, once the frame's fence was waited on
+	void addFrameRing(VulkanRingBuffer *ring) { frameRings.push_back(ring); }
+	// command pools of the frame recycled the same way
+	void addCommandRecorder(VulkanCommandRecorder *recorder) { commandRecorders.push_back(recorder); }
+
+	// swap chain render pass of the current frame, for secondary command buffers
+	VulkanCommandRecorder::Target getSwapChainTarget() const;
+
 	VkCommandBuffer beginFrame();
 	void endFrame();
-	void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+	// contents = VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS to draw with VulkanCommandRecorder::record
+	void beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 	void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
  private:
@@ -47,6 +58,8 @@ class VulkanRenderer {
 	VulkanDevice &vulkanDevice;
 	std::unique_ptr<VulkanSwapChain> vulkanSwapChain;
 	std::vector<VkCommandBuffer> commandBuffers;
+	std::vector<VulkanRingBuffer *> frameRings;
+	std::vector<VulkanCommandRecorder *> commandRecorders;
 
 	uint32_t currentImageIndex;
 	int currentFrameIndex{0};
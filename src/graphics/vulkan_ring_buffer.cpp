@@ -0,0 +1,97 @@
+#include "vulkan_ring_buffer.hpp"
+
+// std
+#include <cassert>
+#include <cstring>
+
+//namespace lve {
+
+/**
+ * Creates the buffer and maps it for its whole lifetime
+ *
+ * @param capacity Size of the buffer in bytes (shared by all frames in flight)
+ * @param minOffsetAlignment Alignment of each slice offset (eg minUniformBufferOffsetAlignment for uniform data)
+ * @param noFrames Number of frames that can be in flight at once
+ */
+VulkanRingBuffer::VulkanRingBuffer(
+		VulkanDevice &device,
+		VkDeviceSize capacity,
+		VkBufferUsageFlags usageFlags,
+		VkDeviceSize minOffsetAlignment,
+		unsigned int noFrames)
+		: allocator(capacity, minOffsetAlignment, noFrames) {
+	// whole multiple of the alignment, so slices never run past the end
+	allocator = RingAllocator(allocator.alignUp(capacity), minOffsetAlignment, noFrames);
+
+	buffer = std::make_unique<VulkanBuffer>(
+			device,
+			1,
+			static_cast<uint32_t>(allocator.getCapacity()),
+			usageFlags,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	buffer->map();
+}
+
+/**
+ * Releases the slices of the frame that last used frameIndex
+ *
+ * @note The device must have finished that frame (its fence was waited on)
+ */
+void VulkanRingBuffer::beginFrame(int frameIndex) { allocator.beginFrame(frameIndex); }
+
+/**
+ * Releases the slices of all frames
+ *
+ * @note The device must be idle
+ */
+void VulkanRingBuffer::reset() { allocator.reset(); }
+
+/**
+ * Reserves a slice of the ring for the current frame
+ *
+ * @return The slice, with mapped == nullptr if the ring is full
+ */
+VulkanRingBuffer::Slice VulkanRingBuffer::allocate(VkDeviceSize size) {
+	Slice ret;
+	uint64_t offset;
+	{
+		std::lock_guard<std::mutex> lock(allocateMutex);
+		offset = allocator.allocate(size);
+	}
+	if (offset == RING_ALLOC_FAILED) {
+		return ret;
+	}
+
+	ret.buffer = buffer->getBuffer();
+	ret.offset = offset;
+	ret.size = size;
+	ret.mapped = (char *)buffer->getMappedMemory() + offset;
+	return ret;
+}
+
+/**
+ * Copies data into a new slice of the ring for the current frame
+ *
+ * @return The slice, with mapped == nullptr if the ring is full (nothing is copied)
+ */
+VulkanRingBuffer::Slice VulkanRingBuffer::write(const void *data, VkDeviceSize size) {
+	Slice ret = allocate(size);
+	if (ret.mapped) {
+		memcpy(ret.mapped, data, size);
+	}
+	return ret;
+}
+
+/**
+ * Create a buffer info descriptor for a slice
+ */
+VkDescriptorBufferInfo VulkanRingBuffer::descriptorInfo(const Slice &slice) const {
+	assert(slice.mapped && "Cannot describe a failed allocation");
+	return VkDescriptorBufferInfo{
+			slice.buffer,
+			slice.offset,
+			slice.size,
+	};
+}
+
+//}	// namespace lve
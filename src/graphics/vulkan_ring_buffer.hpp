@@ -0,0 +1,59 @@
+#pragma once
+
+#include "vulkan_buffer.hpp"
+#include "vulkan_device.hpp"
+#include "vulkan_swap_chain.hpp"
+#include "memory/ringallocator.hpp"
+
+// std
+#include <memory>
+#include <mutex>
+
+//namespace lve {
+
+/*
+	Persistently mapped (host coherent) buffer for data rewritten every frame (instance matrices, GlobalUbo)
+	- each frame in flight gets its own slices, so the host never writes bytes the device may still read
+	- slices of a frame are recycled in beginFrame, which VulkanRenderer calls after waiting on the
+		frame's fence (see VulkanRenderer::addFrameRing)
+	- allocate and write may be called from several recording threads at once
+*/
+class VulkanRingBuffer {
+ public:
+	// slice of the ring for the current frame
+	struct Slice {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		// host address of the slice (nullptr if the ring was full)
+		void *mapped = nullptr;
+	};
+
+	VulkanRingBuffer(
+			VulkanDevice &device,
+			VkDeviceSize capacity,
+			VkBufferUsageFlags usageFlags,
+			VkDeviceSize minOffsetAlignment = 1,
+			unsigned int noFrames = VulkanSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+	VulkanRingBuffer(const VulkanRingBuffer &) = delete;
+	VulkanRingBuffer &operator=(const VulkanRingBuffer &) = delete;
+
+	void beginFrame(int frameIndex);
+	void reset();
+
+	Slice allocate(VkDeviceSize size);
+	Slice write(const void *data, VkDeviceSize size);
+	VkDescriptorBufferInfo descriptorInfo(const Slice &slice) const;
+
+	VkBuffer getBuffer() const { return buffer->getBuffer(); }
+	const RingAllocator &getAllocator() const { return allocator; }
+
+ private:
+	std::unique_ptr<VulkanBuffer> buffer;
+	RingAllocator allocator;
+	// guards allocator while threads record
+	std::mutex allocateMutex;
+};
+
+//}	// namespace lve
@@ -6,6 +6,7 @@
 #include <cstring>
 #include <iostream>
 #include <limits>
+#include <mutex>
 #include <set>
 #include <stdexcept>
 
@@ -53,6 +54,7 @@ VulkanSwapChain::~VulkanSwapChain() {
 		vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
 	}
 
+	device.getPipelineCache().unregisterRenderPass(renderPass);
 	vkDestroyRenderPass(device.device(), renderPass, nullptr);
 
 	// cleanup synchronization objects
@@ -105,6 +107,8 @@ VkResult VulkanSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers, u
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
 	vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
+	// uploads may submit to the same queue from loader threads
+	std::lock_guard<std::mutex> queueLock(device.getGraphicsQueueMutex());
 	if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
 		VK_SUCCESS) {
 	throw std::runtime_error("failed to submit draw command buffer!");
@@ -217,11 +221,12 @@ void VulkanSwapChain::createRenderPass() {
 	depthAttachment.format = findDepthFormat();
 	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	// kept and left readable for the depth pyramid of the cull pass (VulkanCullPass::recordDepthPyramid)
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
 	VkAttachmentReference depthAttachmentRef{};
 	depthAttachmentRef.attachment = 1;
@@ -255,6 +260,16 @@ void VulkanSwapChain::createRenderPass() {
 	dependency.srcAccessMask = 0;
 	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
 
+	// depth writes are done before compute shaders read the depth image
+	VkSubpassDependency depthDependency = {};
+	depthDependency.srcSubpass = 0;
+	depthDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	depthDependency.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	depthDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+	depthDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	depthDependency.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+	std::array<VkSubpassDependency, 2> dependencies = {dependency, depthDependency};
 	std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
 	VkRenderPassCreateInfo renderPassInfo = {};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -262,12 +277,15 @@ void VulkanSwapChain::createRenderPass() {
 	renderPassInfo.pAttachments = attachments.data();
 	renderPassInfo.subpassCount = 1;
 	renderPassInfo.pSubpasses = &subpass;
-	renderPassInfo.dependencyCount = 1;
-	renderPassInfo.pDependencies = &dependency;
+	renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	renderPassInfo.pDependencies = dependencies.data();
 
 	if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
 	throw std::runtime_error("failed to create render pass!");
 	}
+
+	// pipelines created for the render pass of the old swap chain are shared with this one
+	device.getPipelineCache().registerRenderPass(renderPass, renderPassInfo);
 }
 
 void VulkanSwapChain::createFramebuffers() {
@@ -316,7 +334,7 @@ void VulkanSwapChain::createDepthResources() {
 		imageInfo.format = depthFormat;
 		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		//imageInfo.flags = VK_IMAGE_CREATE_SPARSE_BINDING_BIT;
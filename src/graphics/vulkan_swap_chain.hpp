@@ -28,6 +28,8 @@ class VulkanSwapChain {
 	VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
 	VkRenderPass getRenderPass() { return renderPass; }
 	VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+	// sampled by the cull pass, in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL after the render pass
+	VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
 	size_t imageCount() { return swapChainImages.size(); }
 	VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
 	VkExtent2D getSwapChainExtent() { return swapChainExtent; }
@@ -0,0 +1,578 @@
+#include "vulkan_upload_manager.hpp"
+#include "vulkan_device.hpp"
+#include "../algorithms/timer.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+//namespace lve {
+
+// stages and accesses that may read an uploaded buffer on the graphics queue
+#define UPLOAD_BUFFER_DST_STAGES (VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT \
+		| VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+#define UPLOAD_BUFFER_DST_ACCESS (VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT \
+		| VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT)
+
+/**
+ * Creates the staging ring and the batches on the transfer queue of the device
+ * (the graphics queue if it has no dedicated transfer family)
+ *
+ * @param stagingSize Size of the staging ring in bytes
+ */
+VulkanUploadManager::VulkanUploadManager(VulkanDevice &device, VkDeviceSize stagingSize)
+		: vulkanDevice{device} {
+	QueueFamilyIndices indices = vulkanDevice.findPhysicalQueueFamilies();
+	graphicsFamily = indices.graphicsFamily;
+	transferFamily = indices.transferFamilyHasValue ? indices.transferFamily : indices.graphicsFamily;
+	queue = vulkanDevice.transferQueue();
+
+	createStaging(stagingSize);
+	createBatches();
+}
+
+/**
+ * Waits for the batches in flight and frees everything
+ *
+ * @note Acquires that were not recorded yet are dropped
+ */
+VulkanUploadManager::~VulkanUploadManager() {
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (batches[nextTicket % UPLOAD_MAX_BATCHES].recording) {
+			submit(batches[nextTicket % UPLOAD_MAX_BATCHES]);
+		}
+		waitLocked(lock, submittedTicket);
+		poll();
+	}
+
+	for (Batch &batch : batches) {
+		if (batch.fence != VK_NULL_HANDLE) {
+			vkDestroyFence(vulkanDevice.device(), batch.fence, nullptr);
+		}
+	}
+	if (timeline != VK_NULL_HANDLE) {
+		vkDestroySemaphore(vulkanDevice.device(), timeline, nullptr);
+	}
+	// command buffers are freed with their pool
+	vkDestroyCommandPool(vulkanDevice.device(), commandPool, nullptr);
+
+	vkDestroyBuffer(vulkanDevice.device(), stagingBuffer, nullptr);
+	vulkanDevice.freeMemory(stagingAllocation);
+}
+
+void VulkanUploadManager::createStaging(VkDeviceSize stagingSize) {
+	// copies to images need offsets that are a multiple of the texel size
+	VkDeviceSize alignment = std::max<VkDeviceSize>(16, vulkanDevice.properties.limits.optimalBufferCopyOffsetAlignment);
+	staging = RingAllocator(stagingSize, alignment, UPLOAD_MAX_BATCHES);
+
+	// host visible blocks are mapped by the allocator for their whole lifetime
+	vulkanDevice.createBuffer(
+			staging.getCapacity(),
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			stagingBuffer,
+			stagingAllocation);
+}
+
+void VulkanUploadManager::createBatches() {
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = transferFamily;
+	if (vkCreateCommandPool(vulkanDevice.device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload command pool!");
+	}
+
+	VkCommandBuffer commandBuffers[UPLOAD_MAX_BATCHES];
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = commandPool;
+	allocInfo.commandBufferCount = UPLOAD_MAX_BATCHES;
+	if (vkAllocateCommandBuffers(vulkanDevice.device(), &allocInfo, commandBuffers) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate upload command buffers!");
+	}
+
+	if (vulkanDevice.timelineSemaphores) {
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+		if (vkCreateSemaphore(vulkanDevice.device(), &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload timeline semaphore!");
+		}
+	}
+
+	for (unsigned int i = 0; i < UPLOAD_MAX_BATCHES; i++) {
+		batches[i].commandBuffer = commandBuffers[i];
+		if (timeline != VK_NULL_HANDLE) {
+			continue;
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(vulkanDevice.device(), &fenceInfo, nullptr, &batches[i].fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload fence!");
+		}
+	}
+}
+
+/**
+ * Batch uploads are recorded into, begun if it is not recording yet
+ * - its slot is reused once the batch that had it before completed (waits if it did not)
+ *
+ * @note Called with the mutex held
+ */
+VulkanUploadManager::Batch &VulkanUploadManager::recordingBatch() {
+	std::unique_lock<std::mutex> lock(mutex, std::adopt_lock);
+	// another thread may begin (or submit) a batch while the mutex is released by waitLocked
+	while (!batches[nextTicket % UPLOAD_MAX_BATCHES].recording
+			&& nextTicket > UPLOAD_MAX_BATCHES && completedTicket < nextTicket - UPLOAD_MAX_BATCHES) {
+		waitLocked(lock, nextTicket - UPLOAD_MAX_BATCHES);
+	}
+	lock.release();
+
+	unsigned int slot = nextTicket % UPLOAD_MAX_BATCHES;
+	Batch &batch = batches[slot];
+	if (batch.recording) {
+		return batch;
+	}
+
+	// gives back the staging bytes of the batch that had the slot
+	staging.beginFrame(slot);
+
+	vkResetCommandBuffer(batch.commandBuffer, 0);
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if (vkBeginCommandBuffer(batch.commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording upload command buffer!");
+	}
+
+	batch.ticket = nextTicket;
+	batch.recording = true;
+	batch.noBytes = 0;
+	return batch;
+}
+
+/**
+ * Submits a recording batch, signaling its ticket
+ *
+ * @note Called with the mutex held
+ */
+void VulkanUploadManager::submit(Batch &batch) {
+	if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record upload command buffer!");
+	}
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	if (timeline != VK_NULL_HANDLE) {
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &batch.ticket;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &timeline;
+	} else {
+		vkResetFences(vulkanDevice.device(), 1, &batch.fence);
+	}
+
+	VkResult result;
+	if (hasTransferQueue()) {
+		result = vkQueueSubmit(queue, 1, &submitInfo, batch.fence);
+	} else {
+		// shared with the frames of the renderer
+		std::lock_guard<std::mutex> queueLock(vulkanDevice.getGraphicsQueueMutex());
+		result = vkQueueSubmit(queue, 1, &submitInfo, batch.fence);
+	}
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit upload command buffer!");
+	}
+
+	batch.recording = false;
+	submittedTicket = batch.ticket;
+	nextTicket++;
+	stats.noBatches++;
+}
+
+/**
+ * Collects the batches that completed since the last poll: their acquires are queued for the next
+ * frame and their dedicated staging buffers are freed
+ *
+ * @note Called with the mutex held
+ */
+void VulkanUploadManager::poll() {
+	UploadTicket completed = completedTicket;
+	if (timeline != VK_NULL_HANDLE) {
+		vkGetSemaphoreCounterValue(vulkanDevice.device(), timeline, &completed);
+	} else {
+		while (completed < submittedTicket
+				&& vkGetFenceStatus(vulkanDevice.device(), batches[(completed + 1) % UPLOAD_MAX_BATCHES].fence) == VK_SUCCESS) {
+			completed++;
+		}
+	}
+
+	for (UploadTicket ticket = completedTicket + 1; ticket <= completed; ticket++) {
+		Batch &batch = batches[ticket % UPLOAD_MAX_BATCHES];
+		bufferAcquires.insert(bufferAcquires.end(), batch.bufferAcquires.begin(), batch.bufferAcquires.end());
+		imageAcquires.insert(imageAcquires.end(), batch.imageAcquires.begin(), batch.imageAcquires.end());
+		batch.bufferAcquires.clear();
+		batch.imageAcquires.clear();
+
+		for (auto &[buffer, allocation] : batch.dedicated) {
+			vkDestroyBuffer(vulkanDevice.device(), buffer, nullptr);
+			vulkanDevice.freeMemory(allocation);
+		}
+		batch.dedicated.clear();
+	}
+	completedTicket = completed;
+
+	if (!hasTransferQueue()) {
+		// nothing to acquire, the barrier is in the batch
+		readyTicket = completedTicket;
+	}
+}
+
+/**
+ * Waits until the batch of a ticket completed, submitting it first if it is still recording
+ * - the mutex is released while waiting, so other threads can keep recording
+ *
+ * @note Called with the mutex held (by lock)
+ */
+void VulkanUploadManager::waitLocked(std::unique_lock<std::mutex> &lock, UploadTicket ticket) {
+	if (ticket > submittedTicket && batches[ticket % UPLOAD_MAX_BATCHES].recording) {
+		submit(batches[ticket % UPLOAD_MAX_BATCHES]);
+	}
+
+	poll();
+	if (ticket <= completedTicket) {
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	VkFence fence = batches[ticket % UPLOAD_MAX_BATCHES].fence;
+	lock.unlock();
+
+	if (timeline != VK_NULL_HANDLE) {
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &timeline;
+		waitInfo.pValues = &ticket;
+		vkWaitSemaphores(vulkanDevice.device(), &waitInfo, UINT64_MAX);
+	} else {
+		// the slot is only reused once this batch completed, so at worst this waits for a later batch too
+		vkWaitForFences(vulkanDevice.device(), 1, &fence, VK_TRUE, UINT64_MAX);
+	}
+
+	lock.lock();
+	poll();
+	stats.noWaits++;
+	stats.waitMs += msSince(start);
+}
+
+/**
+ * Copies data into the staging ring for the recording batch
+ * - if the ring is full, the recording batch is submitted and the next ones are begun until older
+ *   batches give their bytes back
+ * - data larger than the ring gets a staging buffer of its own
+ *
+ * @param stagingBuffer Set to the buffer the data is in
+ * @return Offset of the data in stagingBuffer
+ * @note Called with the mutex held
+ */
+VkDeviceSize VulkanUploadManager::stage(const void *data, VkDeviceSize size, VkBuffer &stagingBuffer) {
+	if (size > staging.getCapacity()) {
+		std::pair<VkBuffer, MemoryAllocation> dedicated;
+		vulkanDevice.createBuffer(
+				size,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				dedicated.first,
+				dedicated.second);
+		std::memcpy(dedicated.second.mapped, data, static_cast<size_t>(size));
+
+		recordingBatch().dedicated.push_back(dedicated);
+		stagingBuffer = dedicated.first;
+		stats.noDedicated++;
+		return 0;
+	}
+
+	recordingBatch();
+	uint64_t offset = staging.allocate(size);
+	for (unsigned int i = 0; offset == RING_ALLOC_FAILED && i < UPLOAD_MAX_BATCHES; i++) {
+		submit(batches[nextTicket % UPLOAD_MAX_BATCHES]);
+		recordingBatch();
+		offset = staging.allocate(size);
+	}
+	if (offset == RING_ALLOC_FAILED) {
+		throw std::runtime_error("failed to allocate upload staging memory!");
+	}
+
+	std::memcpy(static_cast<char *>(stagingAllocation.mapped) + offset, data, static_cast<size_t>(size));
+	stagingBuffer = this->stagingBuffer;
+	return offset;
+}
+
+/**
+ * Makes a written buffer range visible to the graphics queue (released to it with a transfer queue)
+ *
+ * @note Called with the mutex held
+ */
+void VulkanUploadManager::releaseBuffer(Batch &batch, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = UPLOAD_BUFFER_DST_ACCESS;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+
+	if (!hasTransferQueue()) {
+		vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, UPLOAD_BUFFER_DST_STAGES,
+				0, 0, nullptr, 1, &barrier, 0, nullptr);
+		return;
+	}
+
+	// release half on the transfer queue, the acquire half is recorded by the graphics queue
+	barrier.srcQueueFamilyIndex = transferFamily;
+	barrier.dstQueueFamilyIndex = graphicsFamily;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = UPLOAD_BUFFER_DST_ACCESS;
+	batch.bufferAcquires.push_back(barrier);
+}
+
+/**
+ * Moves a written image to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL for the graphics queue
+ * (released to it with a transfer queue, the layout changes in the release/acquire pair)
+ *
+ * @note Called with the mutex held
+ */
+void VulkanUploadManager::releaseImage(Batch &batch, VkImage image, uint32_t layerCount) {
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, layerCount};
+
+	if (!hasTransferQueue()) {
+		vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &barrier);
+		return;
+	}
+
+	barrier.srcQueueFamilyIndex = transferFamily;
+	barrier.dstQueueFamilyIndex = graphicsFamily;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	batch.imageAcquires.push_back(barrier);
+}
+
+/**
+ * Counts an upload recorded into batch, submitting the batch if it is full
+ *
+ * @note Called with the mutex held
+ */
+UploadTicket VulkanUploadManager::finishUpload(Batch &batch, VkDeviceSize size) {
+	UploadTicket ticket = batch.ticket;
+	batch.noBytes += size;
+	stats.noUploads++;
+	stats.noBytes += size;
+
+	if (batch.noBytes >= UPLOAD_BATCH_BYTES) {
+		submit(batch);
+	}
+	return ticket;
+}
+
+/**
+ * Uploads data to a range of a buffer (the buffer needs VK_BUFFER_USAGE_TRANSFER_DST_BIT)
+ *
+ * @note dstBuffer must stay alive until the ticket completed, the range must not be in use by the device
+ * @return Ticket to wait for before the range is read
+ */
+UploadTicket VulkanUploadManager::uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size) {
+	if (!size) {
+		return 0;
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+
+	VkBuffer srcBuffer;
+	VkDeviceSize srcOffset = stage(data, size, srcBuffer);
+	Batch &batch = recordingBatch();
+
+	VkBufferCopy copyRegion{srcOffset, dstOffset, size};
+	vkCmdCopyBuffer(batch.commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+	releaseBuffer(batch, dstBuffer, dstOffset, size);
+	return finishUpload(batch, size);
+}
+
+/**
+ * Copies a buffer the caller filled into a range of another
+ *
+ * @note srcBuffer must stay alive until the ticket completed
+ * @return Ticket to wait for before the range is read (or srcBuffer is freed)
+ */
+UploadTicket VulkanUploadManager::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset) {
+	if (!size) {
+		return 0;
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	Batch &batch = recordingBatch();
+
+	VkBufferCopy copyRegion{0, dstOffset, size};
+	vkCmdCopyBuffer(batch.commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+	releaseBuffer(batch, dstBuffer, dstOffset, size);
+	return finishUpload(batch, size);
+}
+
+/**
+ * Uploads the first mip level of a color image, tightly packed layer after layer
+ * - the image goes from VK_IMAGE_LAYOUT_UNDEFINED (its contents are replaced) to
+ *   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+ *
+ * @note image must stay alive until the ticket completed
+ * @return Ticket to wait for before the image is sampled
+ */
+UploadTicket VulkanUploadManager::uploadImage(
+		VkImage image, uint32_t width, uint32_t height, uint32_t layerCount, const void *data, VkDeviceSize size) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	VkBuffer srcBuffer;
+	VkDeviceSize srcOffset = stage(data, size, srcBuffer);
+	Batch &batch = recordingBatch();
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, layerCount};
+	vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = srcOffset;
+	region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, layerCount};
+	region.imageOffset = {0, 0, 0};
+	region.imageExtent = {width, height, 1};
+	vkCmdCopyBufferToImage(batch.commandBuffer, srcBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	releaseImage(batch, image, layerCount);
+	return finishUpload(batch, size);
+}
+
+/**
+ * Submits the batch being recorded
+ *
+ * @return Ticket of the last submitted batch
+ */
+UploadTicket VulkanUploadManager::flush() {
+	std::lock_guard<std::mutex> lock(mutex);
+	Batch &batch = batches[nextTicket % UPLOAD_MAX_BATCHES];
+	if (batch.recording) {
+		submit(batch);
+	}
+	return submittedTicket;
+}
+
+/**
+ * Blocks until a ticket completed (its batch is submitted if it was still recording)
+ *
+ * @note With a transfer queue the ticket is ready to draw only after the next recordAcquires
+ */
+void VulkanUploadManager::wait(UploadTicket ticket) {
+	std::unique_lock<std::mutex> lock(mutex);
+	waitLocked(lock, ticket);
+}
+
+bool VulkanUploadManager::isComplete(UploadTicket ticket) {
+	std::lock_guard<std::mutex> lock(mutex);
+	poll();
+	return ticket <= completedTicket;
+}
+
+/**
+ * If what was uploaded with a ticket can be used by the commands of the current frame
+ */
+bool VulkanUploadManager::isReady(UploadTicket ticket) {
+	if (ticket <= readyTicket) {
+		return true;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	poll();
+	return ticket <= readyTicket;
+}
+
+/**
+ * Records the ownership acquires of the batches that completed, before any command of the frame
+ * that uses them (VulkanRenderer::beginFrame calls it right after beginning the frame)
+ */
+void VulkanUploadManager::recordAcquires(VkCommandBuffer commandBuffer) {
+	std::lock_guard<std::mutex> lock(mutex);
+	poll();
+
+	if (!bufferAcquires.empty() || !imageAcquires.empty()) {
+		vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				UPLOAD_BUFFER_DST_STAGES,
+				0,
+				0,
+				nullptr,
+				static_cast<uint32_t>(bufferAcquires.size()),
+				bufferAcquires.data(),
+				static_cast<uint32_t>(imageAcquires.size()),
+				imageAcquires.data());
+		bufferAcquires.clear();
+		imageAcquires.clear();
+	}
+	readyTicket = completedTicket;
+}
+
+/**
+ * Formats the stats, for a stats overlay or the log
+ */
+std::string VulkanUploadManager::getStatsText() const {
+	char line[160];
+	std::snprintf(line, sizeof(line),
+			"uploads: %u (%.1f MB, %u dedicated) in %u batches on the %s queue, %u waits %.3f ms",
+			stats.noUploads, stats.noBytes / (1024.0 * 1024.0), stats.noDedicated, stats.noBatches,
+			hasTransferQueue() ? "transfer" : "graphics", stats.noWaits, stats.waitMs);
+	return line;
+}
+
+//}	// namespace lve
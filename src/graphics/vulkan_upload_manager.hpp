@@ -0,0 +1,139 @@
+#pragma once
+
+#include "memory/ringallocator.hpp"
+#include "vulkan_memory.hpp"
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//namespace lve {
+
+class VulkanDevice;
+
+// bytes of the staging ring (uploads larger than it get a staging buffer of their own)
+#define UPLOAD_STAGING_SIZE (64ULL * 1024 * 1024)
+// batches that can be in flight at once (each owns the staging bytes it wrote until it completes)
+#define UPLOAD_MAX_BATCHES 8
+// a batch is submitted once it holds this many bytes, without waiting for flush
+#define UPLOAD_BATCH_BYTES (8ULL * 1024 * 1024)
+
+// batch an upload was recorded in, complete once the batch is (0 = nothing to wait for)
+typedef uint64_t UploadTicket;
+
+/*
+	Uploads buffers and images on the transfer queue without stalling the graphics queue
+	- data is copied into a persistently mapped staging ring and the copies are recorded into a batch,
+		which is submitted by flush() (VulkanRenderer flushes once per frame), by wait() or once it is full
+	- batches complete in order, each signals the next value of a timeline semaphore (a fence per
+		batch on devices without timeline semaphores), so a ticket is just the value of its batch
+	- with a dedicated transfer queue family, resources are released by the batch and acquired by the
+		graphics queue in the first frame after the batch completed (recordAcquires), only then is
+		the ticket ready to be drawn
+	- every function may be called from any thread (loader threads wait on their own tickets)
+*/
+class VulkanUploadManager {
+ public:
+	// counts and timings since the manager was created
+	struct Stats {
+		uint32_t noUploads = 0;
+		uint32_t noBatches = 0;
+		// uploads larger than the ring, with a staging buffer of their own
+		uint32_t noDedicated = 0;
+		uint64_t noBytes = 0;
+		// host waits on tickets (wait() and a full ring)
+		uint32_t noWaits = 0;
+		double waitMs = 0.0;
+	};
+
+	VulkanUploadManager(VulkanDevice &device, VkDeviceSize stagingSize = UPLOAD_STAGING_SIZE);
+	~VulkanUploadManager();
+
+	VulkanUploadManager(const VulkanUploadManager &) = delete;
+	VulkanUploadManager &operator=(const VulkanUploadManager &) = delete;
+
+	UploadTicket uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size);
+	UploadTicket copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+	UploadTicket uploadImage(
+			VkImage image, uint32_t width, uint32_t height, uint32_t layerCount, const void *data, VkDeviceSize size);
+
+	UploadTicket flush();
+	void wait(UploadTicket ticket);
+	bool isComplete(UploadTicket ticket);
+	// complete and usable on the graphics queue
+	bool isReady(UploadTicket ticket);
+
+	void recordAcquires(VkCommandBuffer commandBuffer);
+
+	// if uploads run on a queue family of their own
+	bool hasTransferQueue() const { return transferFamily != graphicsFamily; }
+	// signaled with the ticket of each batch (VK_NULL_HANDLE without timeline semaphores)
+	VkSemaphore getTimelineSemaphore() const { return timeline; }
+
+	const Stats &getStats() const { return stats; }
+	std::string getStatsText() const;
+
+ private:
+	// batch of copies in one command buffer
+	struct Batch {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		// signaled by the submit when there is no timeline semaphore
+		VkFence fence = VK_NULL_HANDLE;
+		UploadTicket ticket = 0;
+		bool recording = false;
+		VkDeviceSize noBytes = 0;
+		// staging buffers of uploads that did not fit the ring, freed once the batch completes
+		std::vector<std::pair<VkBuffer, MemoryAllocation>> dedicated;
+		// ownership acquires the graphics queue records once the batch completes
+		std::vector<VkBufferMemoryBarrier> bufferAcquires;
+		std::vector<VkImageMemoryBarrier> imageAcquires;
+	};
+
+	void createStaging(VkDeviceSize stagingSize);
+	void createBatches();
+
+	Batch &recordingBatch();
+	void submit(Batch &batch);
+	UploadTicket finishUpload(Batch &batch, VkDeviceSize size);
+	void poll();
+	void waitLocked(std::unique_lock<std::mutex> &lock, UploadTicket ticket);
+	VkDeviceSize stage(const void *data, VkDeviceSize size, VkBuffer &stagingBuffer);
+	void releaseBuffer(Batch &batch, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+	void releaseImage(Batch &batch, VkImage image, uint32_t layerCount);
+
+	VulkanDevice &vulkanDevice;
+	uint32_t graphicsFamily;
+	uint32_t transferFamily;
+	VkQueue queue;
+
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	MemoryAllocation stagingAllocation;
+	// one frame of the allocator per batch slot (slot = ticket % UPLOAD_MAX_BATCHES)
+	RingAllocator staging;
+
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	VkSemaphore timeline = VK_NULL_HANDLE;
+	Batch batches[UPLOAD_MAX_BATCHES];
+
+	// ticket of the batch being recorded, and of the last submitted and completed batches
+	UploadTicket nextTicket = 1;
+	UploadTicket submittedTicket = 0;
+	UploadTicket completedTicket = 0;
+	// batches up to this ticket can be drawn (completed, and acquired with a transfer queue),
+	// read without the mutex by isReady
+	std::atomic<UploadTicket> readyTicket{0};
+
+	// acquires of completed batches, recorded in the next frame
+	std::vector<VkBufferMemoryBarrier> bufferAcquires;
+	std::vector<VkImageMemoryBarrier> imageAcquires;
+
+	std::mutex mutex;
+	Stats stats;
+};
+
+//}	// namespace lve
@@ -29,7 +29,7 @@ struct TransformComponent {
 	glm::mat3 normalMatrix();
 };
 
-glm::mat4 TransformComponent::mat4() {
+inline glm::mat4 TransformComponent::mat4() {
     // Precompute trigonometric values
     const float cX = glm::cos(rotation.x), sX = glm::sin(rotation.x);
     const float cY = glm::cos(rotation.y), sY = glm::sin(rotation.y);
@@ -53,7 +53,7 @@ glm::mat4 TransformComponent::mat4() {
         {translation.x, translation.y, translation.z, 1.0f}};
 }
 
-glm::mat3 TransformComponent::normalMatrix() {
+inline glm::mat3 TransformComponent::normalMatrix() {
     // Precompute trigonometric values
     const float cX = glm::cos(rotation.x), sX = glm::sin(rotation.x);
     const float cY = glm::cos(rotation.y), sY = glm::sin(rotation.y);
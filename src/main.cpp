@@ -310,7 +310,7 @@ int main() {
         box.render(boxShader);
 
         // send new frame to window
-        scene.newFrame(box);    //THIS FUNCTION CALL IS WHERE SPHERE HAS BEEN CAUSING SEGFAULTS - CHECK MORE LATER IF NEEDE
+        scene.newFrame(box, dt);    //THIS FUNCTION CALL IS WHERE SPHERE HAS BEEN CAUSING SEGFAULTS - CHECK MORE LATER IF NEEDE
 
         // clear instances that have been marked for deletion
         scene.clearDeadInstances();
@@ -338,6 +338,8 @@ void launchItem(float dt) {
     RigidBody* rb = scene.generateInstance(sphere.id, glm::vec3(0.1f), 1.0f, cam.cameraPos);
     if (rb) {
         // instance generated successfully
+        // fast enough to pass through the wall in one frame
+        States::activate(&rb->state, INSTANCE_CCD);
         rb->transferEnergy(25.0f, cam.cameraFront);
         rb->applyAcceleration(Environment::gravitationalAcceleration);
     }
@@ -346,11 +348,11 @@ void launchItem(float dt) {
 void emitRay() {
     Ray r(cam.cameraPos, cam.cameraFront);
 
-    float tmin = std::numeric_limits<float>::max();
-    BoundingRegion* intersected = scene.octree->checkCollisionsRay(r, tmin);
-    if (intersected) {
-        std::cout << "Hits " << intersected->instance->instanceId << " at t = " << tmin << std::endl;
-        scene.markForDeletion(intersected->instance->instanceId);
+    RayHit hit;
+    scene.octree->castRays({ &r, 1 }, { &hit, 1 });
+    if (hit.instance) {
+        std::cout << "Hits " << scene.getInstanceName(hit.instance->instanceId) << " at t = " << hit.t << std::endl;
+        scene.markForDeletion(hit.instance->instanceId);
     }
     else {
         std::cout << "No hit" << std::endl;
@@ -0,0 +1,268 @@
+#include "bvh.hpp"
+#include "collisionmesh.hpp"
+
+#include <limits>
+#include <algorithm>
+#include <utility>
+
+// surface area of a box (half, only used for comparisons)
+static inline float halfArea(glm::vec3 min, glm::vec3 max) {
+	glm::vec3 e = max - min;
+	return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+/*
+	functionality
+*/
+
+// build over faces
+void BVH::build(const std::vector<glm::vec3>& points, const std::vector<Face>& faces) {
+	unsigned int noFaces = faces.size();
+
+	nodes.clear();
+	depth = 0;
+	faceIndices.resize(noFaces);
+	if (noFaces == 0) {
+		return;
+	}
+
+	// face bounds and centroids
+	std::vector<glm::vec3> faceMin(noFaces), faceMax(noFaces), centroids(noFaces);
+	for (unsigned int i = 0; i < noFaces; i++) {
+		glm::vec3 P1 = points[faces[i].i1];
+		glm::vec3 P2 = points[faces[i].i2];
+		glm::vec3 P3 = points[faces[i].i3];
+
+		faceMin[i] = glm::min(P1, glm::min(P2, P3));
+		faceMax[i] = glm::max(P1, glm::max(P2, P3));
+		centroids[i] = (P1 + P2 + P3) / 3.0f;
+		faceIndices[i] = i;
+	}
+
+	// a binary tree with one face per leaf has at most 2n - 1 nodes
+	nodes.reserve(2 * noFaces - 1);
+	nodes.push_back({ glm::vec3(0.0f), 0, glm::vec3(0.0f), noFaces });
+
+	// nodes waiting to be split (with their depth)
+	std::vector<std::pair<unsigned int, unsigned int>> stack = { { 0, 0 } };
+	while (!stack.empty()) {
+		auto [idx, level] = stack.back();
+		stack.pop_back();
+		depth = std::max(depth, level);
+
+		unsigned int first = nodes[idx].leftOrFirst;
+		unsigned int count = nodes[idx].noFaces;
+
+		// bounds of node and of centroids
+		glm::vec3 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+		glm::vec3 cmin = min, cmax = max;
+		for (unsigned int i = first; i < first + count; i++) {
+			unsigned int f = faceIndices[i];
+			min = glm::min(min, faceMin[f]);
+			max = glm::max(max, faceMax[f]);
+			cmin = glm::min(cmin, centroids[f]);
+			cmax = glm::max(cmax, centroids[f]);
+		}
+		nodes[idx].min = min;
+		nodes[idx].max = max;
+
+		if (count <= BVH_MAX_LEAF_FACES) {
+			// small enough to be a leaf
+			continue;
+		}
+
+		// find cheapest split (binned SAH)
+		float bestCost = std::numeric_limits<float>::max();
+		int bestAxis = -1;
+		unsigned int bestBin = 0;
+		for (int axis = 0; axis < 3; axis++) {
+			float extent = cmax[axis] - cmin[axis];
+			if (extent <= 0.0f) {
+				// all centroids on one plane
+				continue;
+			}
+
+			unsigned int binCount[BVH_BINS] = { 0 };
+			glm::vec3 binMin[BVH_BINS], binMax[BVH_BINS];
+			for (int b = 0; b < BVH_BINS; b++) {
+				binMin[b] = glm::vec3(std::numeric_limits<float>::max());
+				binMax[b] = glm::vec3(std::numeric_limits<float>::lowest());
+			}
+
+			float scale = BVH_BINS / extent;
+			for (unsigned int i = first; i < first + count; i++) {
+				unsigned int f = faceIndices[i];
+				int b = std::min(BVH_BINS - 1, (int)((centroids[f][axis] - cmin[axis]) * scale));
+				binCount[b]++;
+				binMin[b] = glm::min(binMin[b], faceMin[f]);
+				binMax[b] = glm::max(binMax[b], faceMax[f]);
+			}
+
+			// sweep from the right to get the cost of everything after each split
+			float rightArea[BVH_BINS - 1];
+			unsigned int rightCount[BVH_BINS - 1];
+			glm::vec3 rmin(std::numeric_limits<float>::max()), rmax(std::numeric_limits<float>::lowest());
+			unsigned int rcount = 0;
+			for (int b = BVH_BINS - 1; b > 0; b--) {
+				rcount += binCount[b];
+				if (binCount[b]) {
+					rmin = glm::min(rmin, binMin[b]);
+					rmax = glm::max(rmax, binMax[b]);
+				}
+				rightCount[b - 1] = rcount;
+				rightArea[b - 1] = rcount ? halfArea(rmin, rmax) : 0.0f;
+			}
+
+			// sweep from the left, split after bin b
+			glm::vec3 lmin(std::numeric_limits<float>::max()), lmax(std::numeric_limits<float>::lowest());
+			unsigned int lcount = 0;
+			for (int b = 0; b < BVH_BINS - 1; b++) {
+				lcount += binCount[b];
+				if (binCount[b]) {
+					lmin = glm::min(lmin, binMin[b]);
+					lmax = glm::max(lmax, binMax[b]);
+				}
+				if (lcount == 0 || rightCount[b] == 0) {
+					continue;
+				}
+
+				float cost = lcount * halfArea(lmin, lmax) + rightCount[b] * rightArea[b];
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+
+		if (bestAxis == -1 || bestCost >= count * halfArea(min, max)) {
+			// splitting would not pay off
+			continue;
+		}
+
+		// partition faces on the split
+		float scale = BVH_BINS / (cmax[bestAxis] - cmin[bestAxis]);
+		unsigned int* mid = std::partition(&faceIndices[first], &faceIndices[first] + count, [&](unsigned int f) {
+			int b = std::min(BVH_BINS - 1, (int)((centroids[f][bestAxis] - cmin[bestAxis]) * scale));
+			return b <= (int)bestBin;
+		});
+		unsigned int leftCount = mid - &faceIndices[first];
+		if (leftCount == 0 || leftCount == count) {
+			continue;
+		}
+
+		// children next to each other
+		unsigned int left = nodes.size();
+		nodes.push_back({ glm::vec3(0.0f), first, glm::vec3(0.0f), leftCount });
+		nodes.push_back({ glm::vec3(0.0f), first + leftCount, glm::vec3(0.0f), count - leftCount });
+		nodes[idx].leftOrFirst = left;
+		nodes[idx].noFaces = 0;
+
+		stack.push_back({ left + 1, level + 1 });
+		stack.push_back({ left, level + 1 });
+	}
+}
+
+// slab test against a node, returns entry distance (max float if missed)
+static inline float rayNodeDistance(const BVHNode& node, glm::vec3 origin, glm::vec3 invdir, float t) {
+	glm::vec3 t1 = (node.min - origin) * invdir;
+	glm::vec3 t2 = (node.max - origin) * invdir;
+	glm::vec3 tNear = glm::min(t1, t2);
+	glm::vec3 tFar = glm::max(t1, t2);
+
+	float tmin = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float tmax = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, t));
+
+	return tmin <= tmax ? tmin : std::numeric_limits<float>::max();
+}
+
+// closest hit of a ray in the mesh's model space (only hits closer than t are taken)
+bool BVH::intersectsRay(glm::vec3 origin, glm::vec3 dir, const std::vector<glm::vec3>& points, const std::vector<Face>& faces, float& t,
+	unsigned int* hitFace) const {
+	if (nodes.empty()) {
+		return false;
+	}
+
+	glm::vec3 invdir = 1.0f / dir;
+	bool intersects = false;
+
+	// each level adds at most one node to the stack, only deep trees need a heap allocation
+	unsigned int localStack[64];
+	std::vector<unsigned int> heapStack;
+	unsigned int* stack = localStack;
+	if (depth + 1 > 64) {
+		heapStack.resize(depth + 1);
+		stack = heapStack.data();
+	}
+	unsigned int stackSize = 0;
+
+	if (rayNodeDistance(nodes[0], origin, invdir, t) == std::numeric_limits<float>::max()) {
+		return false;
+	}
+	stack[stackSize++] = 0;
+
+	while (stackSize) {
+		const BVHNode& node = nodes[stack[--stackSize]];
+
+		if (node.isLeaf()) {
+			for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.noFaces; i++) {
+				const Face& f = faces[faceIndices[i]];
+				float tmp;
+				if (rayTriIntersect(origin, dir, points[f.i1], points[f.i2], points[f.i3], tmp) && tmp < t) {
+					t = tmp;
+					intersects = true;
+					if (hitFace) {
+						*hitFace = faceIndices[i];
+					}
+				}
+			}
+			continue;
+		}
+
+		// visit nearer child first
+		unsigned int c1 = node.leftOrFirst, c2 = node.leftOrFirst + 1;
+		float d1 = rayNodeDistance(nodes[c1], origin, invdir, t);
+		float d2 = rayNodeDistance(nodes[c2], origin, invdir, t);
+		if (d1 > d2) {
+			std::swap(c1, c2);
+			std::swap(d1, d2);
+		}
+
+		if (d2 != std::numeric_limits<float>::max()) {
+			stack[stackSize++] = c2;
+		}
+		if (d1 != std::numeric_limits<float>::max()) {
+			stack[stackSize++] = c1;
+		}
+	}
+
+	return intersects;
+}
+
+// Moller-Trumbore ray-triangle test (t of the hit if in front of the origin)
+bool rayTriIntersect(glm::vec3 origin, glm::vec3 dir, glm::vec3 V0, glm::vec3 V1, glm::vec3 V2, float& t) {
+	glm::vec3 e1 = V1 - V0;
+	glm::vec3 e2 = V2 - V0;
+	glm::vec3 p = glm::cross(dir, e2);
+	float det = glm::dot(e1, p);
+	if (det == 0.0f) {
+		// parallel to the face
+		return false;
+	}
+
+	float invDet = 1.0f / det;
+	glm::vec3 s = origin - V0;
+	float u = glm::dot(s, p) * invDet;
+	if (u < 0.0f || u > 1.0f) {
+		return false;
+	}
+
+	glm::vec3 q = glm::cross(s, e1);
+	float v = glm::dot(dir, q) * invDet;
+	if (v < 0.0f || u + v > 1.0f) {
+		return false;
+	}
+
+	t = glm::dot(e2, q) * invDet;
+	return t >= 0.0f;
+}
@@ -0,0 +1,62 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// number of bins along an axis when looking for the best split
+#define BVH_BINS 12
+// faces in a node before it is considered for splitting
+#define BVH_MAX_LEAF_FACES 4
+
+// forward declarations
+struct Face;
+
+/*
+	node of a flattened BVH (32 bytes)
+	- children of an interior node are next to each other, so only the first is stored
+*/
+
+typedef struct BVHNode {
+	glm::vec3 min;
+	// interior: index of first child (second is leftOrFirst + 1), leaf: index of first face in faceIndices
+	unsigned int leftOrFirst;
+	glm::vec3 max;
+	// number of faces (0 if interior)
+	unsigned int noFaces;
+
+	bool isLeaf() const { return noFaces != 0; }
+} BVHNode;
+
+/*
+	static bounding volume hierarchy over the faces of a collision mesh (in model space)
+	- built once with the surface area heuristic (binned)
+	- root is nodes[0]
+*/
+
+class BVH {
+public:
+	// flattened nodes (root first)
+	std::vector<BVHNode> nodes;
+	// faces in leaf order
+	std::vector<unsigned int> faceIndices;
+	// number of levels below the root
+	unsigned int depth = 0;
+
+	/*
+		functionality
+	*/
+
+	// build over faces
+	void build(const std::vector<glm::vec3>& points, const std::vector<Face>& faces);
+
+	// closest hit of a ray in the mesh's model space (only hits closer than t are taken)
+	// - index of the face that was hit is written to hitFace if given
+	bool intersectsRay(glm::vec3 origin, glm::vec3 dir, const std::vector<glm::vec3>& points, const std::vector<Face>& faces, float& t,
+		unsigned int* hitFace = nullptr) const;
+};
+
+// Moller-Trumbore ray-triangle test (t of the hit if in front of the origin)
+bool rayTriIntersect(glm::vec3 origin, glm::vec3 dir, glm::vec3 V0, glm::vec3 V1, glm::vec3 V2, float& t);
+
+#endif
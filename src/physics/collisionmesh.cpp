@@ -99,7 +99,7 @@ bool Face::collidesWithFace(RigidBody* thisRB, Face& face, RigidBody* faceRB, gl
 	return false;
 }
 
-bool Face::collidesWithSphere(RigidBody* thisRB, BoundingRegion& br, glm::vec3& retNorm) {
+bool Face::collidesWithSphere(RigidBody* thisRB, const BoundingRegion& br, glm::vec3& retNorm) {
 	if (br.type != BoundTypes::SPHERE) {
 		return false;
 	}
@@ -181,4 +181,7 @@ CollisionMesh::CollisionMesh(unsigned int noPoints, float* coordinates,
 			N			// normal placeholder
 		};
 	}
+
+	// build hierarchy for ray and mesh-mesh queries
+	bvh.build(points, faces);
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "../algorithms/bounds.hpp"
+#include "bvh.hpp"
 
 // forward declarations
 class CollisionModel;
@@ -18,7 +19,7 @@ typedef struct Face {
 	glm::vec3 norm;
 
 	bool collidesWithFace(RigidBody* thisRB, struct Face& face, RigidBody* faceRB, glm::vec3& retNorm);
-	bool collidesWithSphere(RigidBody* thisRB, BoundingRegion& br, glm::vec3& retNorm);
+	bool collidesWithSphere(RigidBody* thisRB, const BoundingRegion& br, glm::vec3& retNorm);
 } Face;
 
 class CollisionMesh {
@@ -29,6 +30,9 @@ public:
 	std::vector<glm::vec3> points;
 	std::vector<Face> faces;
 
+	// hierarchy over faces in model space (built once on load)
+	BVH bvh;
+
 	CollisionMesh(unsigned int noPoints, float* coordinates, unsigned int noFaces, unsigned int* indices);
 };
 
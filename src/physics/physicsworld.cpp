@@ -0,0 +1,81 @@
+#include "physicsworld.hpp"
+
+#include <cmath>
+
+/*
+    bodies
+*/
+
+// integrate a body every step
+void PhysicsWorld::addBody(RigidBody* rb) {
+    store.add(rb);
+}
+
+// stop integrating a body
+void PhysicsWorld::removeBody(RigidBody* rb) {
+    if (rb->handle != NULL_HANDLE) {
+        store.remove(rb->handle);
+    }
+}
+
+// stop integrating bodies marked INSTANCE_DEAD and take their regions out of the octree
+void PhysicsWorld::removeDead(const std::vector<RigidBody*> &bodies) {
+    for (RigidBody* rb : bodies) {
+        removeBody(rb);
+    }
+
+    if (octree) {
+        octree->removeDead();
+    }
+}
+
+/*
+    simulation
+*/
+
+// advance by the frame time, returns the number of steps run
+unsigned int PhysicsWorld::update(float dt, std::vector<glm::vec3> &positions, std::vector<glm::vec3> &sizes) {
+    accumulator += dt;
+
+    unsigned int noSteps = 0;
+    while (accumulator >= fixedDt && noSteps < maxSteps) {
+        step(positions, sizes);
+        accumulator -= fixedDt;
+        noSteps++;
+    }
+
+    if (noSteps == maxSteps && accumulator >= fixedDt) {
+        // fell behind, drop the time instead of catching up over the next frames
+        accumulator = std::fmod(accumulator, fixedDt);
+    }
+
+    // place bodies between the last two steps for rendering
+    store.interpolate(alpha());
+
+    return noSteps;
+}
+
+// run one step
+void PhysicsWorld::step(std::vector<glm::vec3> &positions, std::vector<glm::vec3> &sizes) {
+    float h = fixedDt / noSubsteps;
+    for (unsigned int s = 0; s < noSubsteps; s++) {
+        // take in forces, impulses and collision responses applied since the last update
+        store.gather();
+        if (s == 0) {
+            store.beginStep();
+        }
+
+        // integrate
+        store.integrate(h);
+        store.scatter(h);
+
+        // move bodies in the tree and respond to collisions
+        if (octree) {
+            positions.clear();
+            sizes.clear();
+
+            octree->processPending();
+            octree->update(positions, sizes);
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef PHYSICSWORLD_H
+#define PHYSICSWORLD_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "rigidbody.hpp"
+#include "rigidbodystore.hpp"
+#include "../algorithms/octree.hpp"
+
+#ifdef LINEAR_OCTREE
+#include "../algorithms/linear_octree.hpp"
+// pool-allocated octree addressed by Morton codes
+typedef Octree::LinearTree SceneOctree;
+#else
+// pointer octree (one allocation per node)
+typedef Octree::node SceneOctree;
+#endif
+
+// default length of a simulation step in s
+#define PHYSICS_FIXED_DT (1.0f / 60.0f)
+// most steps run in one frame, time beyond this is dropped
+#define PHYSICS_MAX_STEPS 8
+
+/*
+    PhysicsWorld class
+    - integrates rigid bodies and runs the octree (collisions) in fixed steps, independent of the frame rate
+    - frame time is collected in an accumulator and spent in whole steps
+    - rendering interpolates between the last two steps with the time left over
+    - bodies are integrated in batches in a structure of arrays store
+*/
+
+class PhysicsWorld {
+public:
+    // length of a step in s
+    float fixedDt = PHYSICS_FIXED_DT;
+    // each step is split into this many updates of fixedDt / noSubsteps
+    unsigned int noSubsteps = 1;
+    // most steps run in one frame (so a slow frame does not make the next one slower)
+    unsigned int maxSteps = PHYSICS_MAX_STEPS;
+
+    // octree tested after every substep (owned by the scene)
+    SceneOctree* octree = nullptr;
+
+    /*
+        bodies
+    */
+
+    // integrate a body every step
+    void addBody(RigidBody* rb);
+
+    // stop integrating a body
+    void removeBody(RigidBody* rb);
+
+    // stop integrating bodies marked INSTANCE_DEAD and take their regions out of the octree
+    // - the octree only drops dead instances in a step, and a frame shorter than a step runs none,
+    //   so this must be called before the bodies are freed
+    void removeDead(const std::vector<RigidBody*> &bodies);
+
+    // number of bodies integrated
+    unsigned int noBodies() { return store.size(); }
+
+    // state of the bodies (render matrices are in store order)
+    RigidBodyStore& bodies() { return store; }
+
+    /*
+        simulation
+    */
+
+    // advance by the frame time, returns the number of steps run
+    // - positions and sizes of the octree cells are written for debug drawing
+    unsigned int update(float dt, std::vector<glm::vec3> &positions, std::vector<glm::vec3> &sizes);
+
+    // run one step
+    void step(std::vector<glm::vec3> &positions, std::vector<glm::vec3> &sizes);
+
+    // time left in the accumulator as a fraction of a step (interpolation factor)
+    float alpha() { return accumulator / fixedDt; }
+
+private:
+    // bodies integrated each step
+    RigidBodyStore store;
+
+    // frame time not yet simulated
+    float accumulator = 0.0f;
+};
+
+#endif
@@ -5,12 +5,12 @@
 //#include <glm/gtx/quaternion.hpp>
 
 // test for equivalence of two rigid bodies
-bool RigidBody::operator==(RigidBody rb) {
+bool RigidBody::operator==(const RigidBody& rb) const {
     return instanceId == rb.instanceId;
 }
 
 // test for equivalence of two rigid bodies
-bool RigidBody::operator==(std::string id) {
+bool RigidBody::operator==(InstanceId id) const {
     return instanceId == id;
 }
 
@@ -19,11 +19,13 @@ bool RigidBody::operator==(std::string id) {
 */
 
 // construct with parameters and default
-RigidBody::RigidBody(std::string modelId, glm::vec3 size, float mass, glm::vec3 pos, glm::vec3 rot)
-    : modelId(modelId), size(size), mass(mass), pos(pos), rot(rot),
-    velocity(0.0f), acceleration(0.0f), state(0),
-    lastCollision(COLLISION_THRESHOLD), lastCollisionID("") {
+RigidBody::RigidBody(glm::vec3 size, float mass, glm::vec3 pos, glm::vec3 rot)
+    : state(0), handle(0xffffffff), instanceIdx(0xffffffff), mass(mass), pos(pos),
+    velocity(0.0f), acceleration(0.0f), size(size), rot(rot), instanceId(NULL_INSTANCE_ID),
+    lastCollision(COLLISION_THRESHOLD), lastCollisionId(NULL_INSTANCE_ID) {
     update(0.0f);
+    beginStep();
+    interpolate(1.0f);
 }
 
 /*
@@ -32,6 +34,7 @@ RigidBody::RigidBody(std::string modelId, glm::vec3 size, float mass, glm::vec3
 
 // update position with velocity and acceleration
 void RigidBody::update(float dt) {
+    prevPos = pos;
     pos += velocity * dt + 0.5f * acceleration * (dt * dt);
     velocity += acceleration * dt;
 
@@ -59,11 +62,30 @@ void RigidBody::update(float dt) {
     normalModel = rigid_body_transform.normalMatrix();
 
     lastCollision += dt;
+
+    States::activate(&state, INSTANCE_EDITED);
+}
+
+// remember the pose at the start of a fixed step
+void RigidBody::beginStep() {
+    stepPos = pos;
+    stepRot = rot;
+}
+
+// set the render matrices between the start (alpha = 0) and end (alpha = 1) of the last fixed step
+void RigidBody::interpolate(float alpha) {
+    TransformComponent renderTransform = rigid_body_transform;
+    renderTransform.translation = glm::mix(stepPos, pos, alpha);
+    renderTransform.rotation = glm::mix(stepRot, rot, alpha);
+
+    renderModel = renderTransform.mat4();
+    renderNormalModel = renderTransform.normalMatrix();
 }
 
 // apply a force
 void RigidBody::applyForce(glm::vec3 force) {
     acceleration += force / mass;
+    States::activate(&state, INSTANCE_EDITED);
 }
 
 // apply a force
@@ -74,6 +96,7 @@ void RigidBody::applyForce(glm::vec3 direction, float magnitude) {
 // apply an acceleration (remove redundancy of dividing by mass)
 void RigidBody::applyAcceleration(glm::vec3 a) {
     acceleration += a;
+    States::activate(&state, INSTANCE_EDITED);
 }
 
 // apply an acceleration (remove redundancy of dividing by mass)
@@ -84,6 +107,7 @@ void RigidBody::applyAcceleration(glm::vec3 direction, float magnitude) {
 // apply force over time
 void RigidBody::applyImpulse(glm::vec3 force, float dt) {
     velocity += force / mass * dt;
+    States::activate(&state, INSTANCE_EDITED);
 }
 
 // apply force over time
@@ -102,16 +126,18 @@ void RigidBody::transferEnergy(float joules, glm::vec3 direction) {
     glm::vec3 deltaV = x * direction;
 
     velocity += joules > 0 ? deltaV : -deltaV;
+    States::activate(&state, INSTANCE_EDITED);
 }
 
 /*
     collisions
 */
 void RigidBody::handleCollision(RigidBody* inst, glm::vec3 norm) {
-    if (lastCollision >= COLLISION_THRESHOLD || lastCollisionID != inst->instanceId) {
+    if (lastCollision >= COLLISION_THRESHOLD || lastCollisionId != inst->instanceId) {
         this->velocity = glm::reflect(this->velocity, glm::normalize(norm)); // register (elastic) collision
         lastCollision = 0.0f; // reset counter
+        States::activate(&state, INSTANCE_EDITED);
     }
 
-    lastCollisionID = inst->instanceId;
+    lastCollisionId = inst->instanceId;
 }
\ No newline at end of file
@@ -1,17 +1,34 @@
+#ifndef RIGIDBODY_HPP
+#define RIGIDBODY_HPP
+
 #include <glm/glm.hpp>
 
+#include <cstdint>
 #include <iostream>
 #include <string>
 
 #include "../graphics/vulkan_utils.hpp"
+#include "../algorithms/states.hpp"
 
 
 // switches for instance states
 #define INSTANCE_DEAD		(unsigned char)0b00000001
 #define INSTANCE_MOVED		(unsigned char)0b00000010
+#define INSTANCE_CCD		(unsigned char)0b00000100	// test the swept motion of each update (fast instances)
+#define INSTANCE_EDITED		(unsigned char)0b00001000	// moving state changed outside of the physics world (set after writing it directly)
 
 #define COLLISION_THRESHOLD 0.05f
 
+/*
+    instance ids (64 bit, compared and copied without allocating)
+    - handle of the instance in the scene's registry: slot (bits 0-31) + generation of the slot (bits 32-47)
+    - index of the instance's model in the scene (bits 48-63)
+    - names are only built for debugging (Scene::getInstanceName)
+*/
+typedef uint64_t InstanceId;
+#define NULL_INSTANCE_ID 0xffffffffffffffffULL
+#define INSTANCE_ID_MODEL(id) ((unsigned int)((id) >> 48))
+
 /*
     Rigid Body class
     - represents physical body and holds all parameters
@@ -22,11 +39,18 @@ public:
     // combination of switches above
     unsigned char state;
 
+    // handle in the physics world's store (0xffffffff if not in one)
+    unsigned int handle;
+    // index in its model's list of instances, same as its slot in the instance buffers (0xffffffff if not in one)
+    unsigned int instanceIdx;
+
     // mass in kg
     float mass;
 
     // position in m
     glm::vec3 pos;
+    // position before the last update (swept tests run from here to pos)
+    glm::vec3 prevPos;
     // velocity in m/s
     glm::vec3 velocity;
     // acceleration in m/s^2
@@ -42,25 +66,30 @@ public:
     glm::mat4 model;
     glm::mat3 normalModel;
 
-    // ids for quick access to instance/model
-    std::string modelId;
-    std::string instanceId;
+    // pose at the start of the last fixed step (rendering interpolates from here)
+    glm::vec3 stepPos;
+    glm::vec3 stepRot;
+    // model matrices between the last two fixed steps (for rendering)
+    glm::mat4 renderModel;
+    glm::mat3 renderNormalModel;
+
+    // id for quick access to instance/model (NULL_INSTANCE_ID if not in a scene)
+    InstanceId instanceId;
 
     // data of previous collision
     float lastCollision;
-    std::string lastCollisionID;
+    InstanceId lastCollisionId;
 
     // test for equivalence of two rigid bodies
-    bool operator==(RigidBody rb);
-    bool operator==(std::string id);
+    bool operator==(const RigidBody& rb) const;
+    bool operator==(InstanceId id) const;
 
     /*
         constructor
     */
 
     // construct with parameters and default
-    RigidBody(std::string modelId = "",
-        glm::vec3 size = glm::vec3(1.0f),
+    RigidBody(glm::vec3 size = glm::vec3(1.0f),
         float mass = 1.0f,
         glm::vec3 pos = glm::vec3(0.0f),
         glm::vec3 rot = glm::vec3(0.0f));
@@ -72,6 +101,15 @@ public:
     // update position with velocity and acceleration
     void update(float dt);
 
+    // remember the pose at the start of a fixed step
+    void beginStep();
+
+    // set the render matrices between the start (alpha = 0) and end (alpha = 1) of the last fixed step
+    void interpolate(float alpha);
+
+    // if collisions are tested along the motion of the last update
+    bool isSwept() { return States::isActive(&state, INSTANCE_CCD) && prevPos != pos; }
+
     // apply a force
     void applyForce(glm::vec3 force);
     void applyForce(glm::vec3 direction, float magnitude);
@@ -95,3 +133,5 @@ public:
 
 	TransformComponent rigid_body_transform{};
 };
+
+#endif
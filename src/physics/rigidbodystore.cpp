@@ -0,0 +1,307 @@
+#include "rigidbodystore.hpp"
+
+#include <cmath>
+
+#if RIGIDBODYSTORE_WIDTH > 1
+#include <immintrin.h>
+#endif
+
+/*
+	packs of RIGIDBODYSTORE_WIDTH floats
+*/
+#if RIGIDBODYSTORE_WIDTH == 8
+typedef __m256 pack;
+static inline pack packLoad(const float* p) { return _mm256_loadu_ps(p); }
+static inline void packStore(float* p, pack a) { _mm256_storeu_ps(p, a); }
+static inline pack packSet1(float f) { return _mm256_set1_ps(f); }
+static inline pack packAdd(pack a, pack b) { return _mm256_add_ps(a, b); }
+static inline pack packSub(pack a, pack b) { return _mm256_sub_ps(a, b); }
+static inline pack packMul(pack a, pack b) { return _mm256_mul_ps(a, b); }
+static inline pack packDiv(pack a, pack b) { return _mm256_div_ps(a, b); }
+#elif RIGIDBODYSTORE_WIDTH == 4
+typedef __m128 pack;
+static inline pack packLoad(const float* p) { return _mm_loadu_ps(p); }
+static inline void packStore(float* p, pack a) { _mm_storeu_ps(p, a); }
+static inline pack packSet1(float f) { return _mm_set1_ps(f); }
+static inline pack packAdd(pack a, pack b) { return _mm_add_ps(a, b); }
+static inline pack packSub(pack a, pack b) { return _mm_sub_ps(a, b); }
+static inline pack packMul(pack a, pack b) { return _mm_mul_ps(a, b); }
+static inline pack packDiv(pack a, pack b) { return _mm_div_ps(a, b); }
+#else
+typedef float pack;
+static inline pack packLoad(const float* p) { return *p; }
+static inline void packStore(float* p, pack a) { *p = a; }
+static inline pack packSet1(float f) { return f; }
+static inline pack packAdd(pack a, pack b) { return a + b; }
+static inline pack packSub(pack a, pack b) { return a - b; }
+static inline pack packMul(pack a, pack b) { return a * b; }
+static inline pack packDiv(pack a, pack b) { return a / b; }
+#endif
+
+/*
+	bodies
+*/
+
+// add a body, returns its handle
+unsigned int RigidBodyStore::add(RigidBody* rb) {
+	unsigned int handle;
+	if (freeHandles.size()) {
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+	}
+	else {
+		handle = handleToIndex.size();
+		handleToIndex.push_back(NULL_HANDLE);
+	}
+
+	unsigned int idx = bodies.size();
+	bodies.push_back(rb);
+	indexToHandle.push_back(handle);
+	handleToIndex[handle] = idx;
+	rb->handle = handle;
+
+	resize();
+	load(idx);
+	for (int a = 0; a < 3; a++) {
+		stepPos[a][idx] = pos[a][idx];
+	}
+
+	// matrices until the first update
+	models[idx] = rb->model;
+	normalModels[idx] = rb->normalModel;
+	renderModels[idx] = rb->renderModel;
+	renderNormalModels[idx] = rb->renderNormalModel;
+
+	return handle;
+}
+
+// remove the body with a handle
+void RigidBodyStore::remove(unsigned int handle) {
+	unsigned int idx = handleToIndex[handle];
+	unsigned int last = bodies.size() - 1;
+
+	bodies[idx]->handle = NULL_HANDLE;
+
+	if (idx != last) {
+		// move last body into the slot
+		bodies[idx] = bodies[last];
+		indexToHandle[idx] = indexToHandle[last];
+		handleToIndex[indexToHandle[idx]] = idx;
+
+		for (int a = 0; a < 3; a++) {
+			pos[a][idx] = pos[a][last];
+			velocity[a][idx] = velocity[a][last];
+			acceleration[a][idx] = acceleration[a][last];
+			stepPos[a][idx] = stepPos[a][last];
+			scale[a][idx] = scale[a][last];
+			sinRot[a][idx] = sinRot[a][last];
+			cosRot[a][idx] = cosRot[a][last];
+		}
+		models[idx] = models[last];
+		normalModels[idx] = normalModels[last];
+		renderModels[idx] = renderModels[last];
+		renderNormalModels[idx] = renderNormalModels[last];
+	}
+
+	bodies.pop_back();
+	indexToHandle.pop_back();
+	handleToIndex[handle] = NULL_HANDLE;
+	freeHandles.push_back(handle);
+
+	resize();
+}
+
+/*
+	simulation
+*/
+
+// copy the state of bodies edited outside of the store
+void RigidBodyStore::gather() {
+	for (unsigned int i = 0, len = bodies.size(); i < len; i++) {
+		if (States::isActive(&bodies[i]->state, INSTANCE_EDITED)) {
+			load(i);
+		}
+	}
+}
+
+// remember the position at the start of a fixed step
+void RigidBodyStore::beginStep() {
+	for (int a = 0; a < 3; a++) {
+		stepPos[a] = pos[a];
+	}
+}
+
+// integrate every body and calculate its model matrices
+void RigidBodyStore::integrate(float dt) {
+	unsigned int noPadded = pos[0].size();
+
+	pack h = packSet1(dt);
+	pack halfH2 = packSet1(0.5f * dt * dt);
+
+	for (int a = 0; a < 3; a++) {
+		float* p = pos[a].data();
+		float* v = velocity[a].data();
+		const float* acc = acceleration[a].data();
+
+		for (unsigned int i = 0; i < noPadded; i += RIGIDBODYSTORE_WIDTH) {
+			// pos += v * dt + 1/2 * a * dt^2, v += a * dt
+			pack va = packLoad(v + i);
+			pack aa = packLoad(acc + i);
+			packStore(p + i, packAdd(packLoad(p + i), packAdd(packMul(va, h), packMul(aa, halfH2))));
+			packStore(v + i, packAdd(va, packMul(aa, h)));
+		}
+	}
+
+	const float* positions[3] = { pos[0].data(), pos[1].data(), pos[2].data() };
+	calculateMatrices(positions, models.data(), normalModels.data());
+}
+
+// copy the integrated state to the bodies (and mark the ones that moved)
+void RigidBodyStore::scatter(float dt) {
+	for (unsigned int i = 0, len = bodies.size(); i < len; i++) {
+		RigidBody* rb = bodies[i];
+
+		// resting bodies are not transformed in the octree or uploaded again
+		bool moved = rb->model != models[i];
+
+		rb->prevPos = rb->pos;
+		rb->pos = glm::vec3(pos[0][i], pos[1][i], pos[2][i]);
+		rb->velocity = glm::vec3(velocity[0][i], velocity[1][i], velocity[2][i]);
+		rb->rigid_body_transform.translation = rb->pos;
+		rb->model = models[i];
+		rb->normalModel = normalModels[i];
+		rb->lastCollision += dt;
+
+		if (moved || rb->pos != rb->prevPos) {
+			States::activate(&rb->state, INSTANCE_MOVED);
+		}
+		else {
+			States::deactivate(&rb->state, INSTANCE_MOVED);
+		}
+	}
+}
+
+// calculate the render matrices between the start (alpha = 0) and end (alpha = 1) of the last step
+void RigidBodyStore::interpolate(float alpha) {
+	unsigned int noPadded = pos[0].size();
+	pack t = packSet1(alpha);
+
+	for (int a = 0; a < 3; a++) {
+		const float* p0 = stepPos[a].data();
+		const float* p1 = pos[a].data();
+		float* out = renderPos[a].data();
+
+		for (unsigned int i = 0; i < noPadded; i += RIGIDBODYSTORE_WIDTH) {
+			pack start = packLoad(p0 + i);
+			packStore(out + i, packAdd(start, packMul(packSub(packLoad(p1 + i), start), t)));
+		}
+	}
+
+	const float* positions[3] = { renderPos[0].data(), renderPos[1].data(), renderPos[2].data() };
+	calculateMatrices(positions, renderModels.data(), renderNormalModels.data());
+
+	for (unsigned int i = 0, len = bodies.size(); i < len; i++) {
+		bodies[i]->renderModel = renderModels[i];
+		bodies[i]->renderNormalModel = renderNormalModels[i];
+	}
+}
+
+// copy the state of one body into the arrays
+void RigidBodyStore::load(unsigned int idx) {
+	RigidBody* rb = bodies[idx];
+
+	for (int a = 0; a < 3; a++) {
+		pos[a][idx] = rb->pos[a];
+		velocity[a][idx] = rb->velocity[a];
+		acceleration[a][idx] = rb->acceleration[a];
+		scale[a][idx] = rb->rigid_body_transform.scale[a];
+		sinRot[a][idx] = std::sin(rb->rot[a]);
+		cosRot[a][idx] = std::cos(rb->rot[a]);
+	}
+
+	States::deactivate(&rb->state, INSTANCE_EDITED);
+}
+
+// resize the arrays to the padded number of bodies
+void RigidBodyStore::resize() {
+	unsigned int noBodies = bodies.size();
+	unsigned int noPadded = (noBodies + RIGIDBODYSTORE_WIDTH - 1) / RIGIDBODYSTORE_WIDTH * RIGIDBODYSTORE_WIDTH;
+
+	// padding bodies do not move and have unit scale, so every pack can be evaluated
+	for (int a = 0; a < 3; a++) {
+		pos[a].resize(noPadded, 0.0f);
+		velocity[a].resize(noPadded, 0.0f);
+		acceleration[a].resize(noPadded, 0.0f);
+		stepPos[a].resize(noPadded, 0.0f);
+		renderPos[a].resize(noPadded, 0.0f);
+		scale[a].resize(noPadded, 1.0f);
+		sinRot[a].resize(noPadded, 0.0f);
+		cosRot[a].resize(noPadded, 1.0f);
+	}
+
+	models.resize(noBodies);
+	normalModels.resize(noBodies);
+	renderModels.resize(noBodies);
+	renderNormalModels.resize(noBodies);
+}
+
+// model and normal matrices from positions [axis][body] for bodies [0, size)
+// - same as TransformComponent::mat4 and TransformComponent::normalMatrix, for a pack of bodies at a time
+void RigidBodyStore::calculateMatrices(const float* const* positions, glm::mat4* outModels, glm::mat3* outNormalModels) {
+	unsigned int noBodies = bodies.size();
+	pack one = packSet1(1.0f);
+
+	// [column * 3 + row] of the rotation, then the translation
+	float lanes[12][RIGIDBODYSTORE_WIDTH];
+
+	for (unsigned int i = 0; i < noBodies; i += RIGIDBODYSTORE_WIDTH) {
+		pack sX = packLoad(&sinRot[0][i]), cX = packLoad(&cosRot[0][i]);
+		pack sY = packLoad(&sinRot[1][i]), cY = packLoad(&cosRot[1][i]);
+		pack sZ = packLoad(&sinRot[2][i]), cZ = packLoad(&cosRot[2][i]);
+
+		// common terms
+		pack cYcZ = packMul(cY, cZ), cYsZ = packMul(cY, sZ);
+		pack sYsZ = packMul(sY, sZ), sYcZ = packMul(sY, cZ);
+		pack cXsY = packMul(cX, sY), cXcY = packMul(cX, cY);
+
+		// rotation (Ry * Rx * Rz) without scale
+		pack R[9] = {
+			packAdd(cYcZ, packMul(sYsZ, sX)), packMul(cX, sZ), packSub(packMul(sYcZ, sX), cYsZ),
+			packSub(packMul(sYsZ, cX), packMul(cYcZ, sX)), packMul(cX, cZ), packAdd(packMul(cYsZ, sX), sYcZ),
+			cXsY, packSub(packSet1(0.0f), sX), cXcY
+		};
+
+		// model: columns scaled by scale
+		for (int c = 0; c < 3; c++) {
+			pack s = packLoad(&scale[c][i]);
+			for (int r = 0; r < 3; r++) {
+				packStore(lanes[c * 3 + r], packMul(R[c * 3 + r], s));
+			}
+			packStore(lanes[9 + c], packLoad(&positions[c][i]));
+		}
+
+		unsigned int noLanes = glm::min((unsigned int)RIGIDBODYSTORE_WIDTH, noBodies - i);
+		for (unsigned int l = 0; l < noLanes; l++) {
+			glm::mat4& m = outModels[i + l];
+			for (int c = 0; c < 3; c++) {
+				m[c] = glm::vec4(lanes[c * 3][l], lanes[c * 3 + 1][l], lanes[c * 3 + 2][l], 0.0f);
+			}
+			m[3] = glm::vec4(lanes[9][l], lanes[10][l], lanes[11][l], 1.0f);
+		}
+
+		// normal: columns scaled by inverse scale
+		for (int c = 0; c < 3; c++) {
+			pack s = packDiv(one, packLoad(&scale[c][i]));
+			for (int r = 0; r < 3; r++) {
+				packStore(lanes[c * 3 + r], packMul(R[c * 3 + r], s));
+			}
+		}
+
+		for (unsigned int l = 0; l < noLanes; l++) {
+			glm::mat3& n = outNormalModels[i + l];
+			for (int c = 0; c < 3; c++) {
+				n[c] = glm::vec3(lanes[c * 3][l], lanes[c * 3 + 1][l], lanes[c * 3 + 2][l]);
+			}
+		}
+	}
+}
@@ -0,0 +1,110 @@
+#ifndef RIGIDBODYSTORE_H
+#define RIGIDBODYSTORE_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "rigidbody.hpp"
+
+/*
+	SIMD width of the batched integration
+	- AVX: 8 bodies at a time
+	- SSE: 4 bodies at a time
+	- scalar fallback otherwise (or with PHYSICS_SCALAR defined)
+*/
+#if defined(__AVX__) && !defined(PHYSICS_SCALAR)
+#define RIGIDBODYSTORE_WIDTH 8
+#elif (defined(__SSE__) || defined(_M_X64)) && !defined(PHYSICS_SCALAR)
+#define RIGIDBODYSTORE_WIDTH 4
+#else
+#define RIGIDBODYSTORE_WIDTH 1
+#endif
+
+// handle of a body that is not in a store
+#define NULL_HANDLE 0xffffffff
+
+/*
+	structure of arrays storage of the moving state of rigid bodies
+	- bodies are packed at the front of each array (removal swaps in the last body)
+	- a handle stays valid while its body is in the store, the index of the body may change
+	- the store holds the state that is integrated, the RigidBody objects get a copy after
+	  each update (for collisions) and are copied back in when they are edited (INSTANCE_EDITED)
+*/
+
+class RigidBodyStore {
+public:
+	// model matrices of the last update, in store order
+	std::vector<glm::mat4> models;
+	std::vector<glm::mat3> normalModels;
+	// model matrices interpolated between the last two fixed steps, in store order (upload arrays)
+	std::vector<glm::mat4> renderModels;
+	std::vector<glm::mat3> renderNormalModels;
+
+	/*
+		bodies
+	*/
+
+	// add a body, returns its handle
+	unsigned int add(RigidBody* rb);
+
+	// remove the body with a handle
+	void remove(unsigned int handle);
+
+	// number of bodies
+	unsigned int size() { return bodies.size(); }
+
+	// index of the body with a handle in the arrays
+	unsigned int index(unsigned int handle) { return handleToIndex[handle]; }
+
+	/*
+		simulation
+	*/
+
+	// copy the state of bodies edited outside of the store
+	void gather();
+
+	// remember the position at the start of a fixed step
+	void beginStep();
+
+	// integrate every body and calculate its model matrices
+	void integrate(float dt);
+
+	// copy the integrated state to the bodies (and mark them as moved)
+	void scatter(float dt);
+
+	// calculate the render matrices between the start (alpha = 0) and end (alpha = 1) of the last step
+	void interpolate(float alpha);
+
+private:
+	// bodies in store order
+	std::vector<RigidBody*> bodies;
+
+	// handle of the body at each index, index of the body with each handle
+	std::vector<unsigned int> indexToHandle;
+	std::vector<unsigned int> handleToIndex;
+	// unused handles
+	std::vector<unsigned int> freeHandles;
+
+	// [axis][body], padded to RIGIDBODYSTORE_WIDTH
+	std::vector<float> pos[3];
+	std::vector<float> velocity[3];
+	std::vector<float> acceleration[3];
+	std::vector<float> stepPos[3];
+	std::vector<float> renderPos[3];
+	std::vector<float> scale[3];
+
+	// sine and cosine of the rotation (rotation is not integrated, so only edits change them)
+	std::vector<float> sinRot[3];
+	std::vector<float> cosRot[3];
+
+	// copy the state of one body into the arrays
+	void load(unsigned int idx);
+
+	// resize the arrays to the padded number of bodies
+	void resize();
+
+	// model and normal matrices from positions [axis][body] for bodies [0, size)
+	void calculateMatrices(const float* const* positions, glm::mat4* outModels, glm::mat3* outNormalModels);
+};
+
+#endif
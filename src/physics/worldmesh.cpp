@@ -0,0 +1,624 @@
+#include "worldmesh.hpp"
+#include "collisionmesh.hpp"
+#include "rigidbody.hpp"
+
+#include "../algorithms/math/linalg.hpp"
+
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#if WORLDMESH_WIDTH > 1
+#include <immintrin.h>
+#endif
+
+/*
+	functionality
+*/
+
+// transform the mesh with the instance's model matrix
+void WorldMesh::update(CollisionMesh* mesh, RigidBody* rb) {
+	// transform each point once
+	unsigned int noPoints = mesh->points.size();
+	points.resize(noPoints);
+	min = glm::vec3(std::numeric_limits<float>::max());
+	max = glm::vec3(std::numeric_limits<float>::lowest());
+	for (unsigned int i = 0; i < noPoints; i++) {
+		points[i] = mat4vec3mult(rb->model, mesh->points[i]);
+		min = glm::min(min, points[i]);
+		max = glm::max(max, points[i]);
+	}
+
+	noFaces = mesh->faces.size();
+	noPaddedFaces = (noFaces + WORLDMESH_WIDTH - 1) / WORLDMESH_WIDTH * WORLDMESH_WIDTH;
+
+	// extra padding so a batch can start at any face
+	unsigned int noSlots = noPaddedFaces + WORLDMESH_WIDTH - 1;
+	for (int v = 0; v < 3; v++) {
+		for (int a = 0; a < 3; a++) {
+			verts[v][a].resize(noSlots);
+		}
+		normals[v].resize(noSlots);
+	}
+	dists.resize(noSlots);
+
+	bvh = mesh->bvh.nodes.empty() ? nullptr : &mesh->bvh;
+
+	for (unsigned int f = 0; f < noFaces; f++) {
+		Face& face = mesh->faces[bvh ? bvh->faceIndices[f] : f];
+		glm::vec3 P[3] = { points[face.i1], points[face.i2], points[face.i3] };
+		glm::vec3 N = glm::cross(P[1] - P[0], P[2] - P[0]);
+
+		for (int v = 0; v < 3; v++) {
+			for (int a = 0; a < 3; a++) {
+				verts[v][a][f] = P[v][a];
+			}
+			normals[v][f] = N[v];
+		}
+		dists[f] = -glm::dot(N, P[0]);
+	}
+
+	// padding faces have no normal and a positive offset, so every plane test rejects them
+	for (unsigned int f = noFaces; f < noSlots; f++) {
+		for (int v = 0; v < 3; v++) {
+			for (int a = 0; a < 3; a++) {
+				verts[v][a][f] = 0.0f;
+			}
+			normals[v][f] = 0.0f;
+		}
+		dists[f] = 1.0f;
+	}
+
+	if (bvh) {
+		// transform node bounds (Arvo, "Transforming Axis-Aligned Bounding Boxes")
+		unsigned int noNodes = bvh->nodes.size();
+		nodeMin.resize(noNodes);
+		nodeMax.resize(noNodes);
+
+		glm::mat3 absRot = glm::mat3(rb->model);
+		for (int c = 0; c < 3; c++) {
+			absRot[c] = glm::abs(absRot[c]);
+		}
+
+		for (unsigned int n = 0; n < noNodes; n++) {
+			glm::vec3 center = 0.5f * (bvh->nodes[n].min + bvh->nodes[n].max);
+			glm::vec3 extents = 0.5f * (bvh->nodes[n].max - bvh->nodes[n].min);
+
+			center = mat4vec3mult(rb->model, center);
+			extents = absRot * extents;
+
+			nodeMin[n] = center - extents;
+			nodeMax[n] = center + extents;
+		}
+	}
+
+	valid = true;
+}
+
+/*
+	plane rejection for one face of a against WORLDMESH_WIDTH faces of b, starting at f
+	- rejects if all vertices of b's face are on one side of a's plane
+	- rejects if all vertices of a's face are on one side of b's plane
+	returns a bitmask of the faces that have to go through the exact test
+*/
+static inline unsigned int planeTests(const WorldMesh& a, unsigned int i, const WorldMesh& b, unsigned int f) {
+#if WORLDMESH_WIDTH == 8
+	__m256 zero = _mm256_setzero_ps();
+
+	// distance of b's vertices to a's plane
+	__m256 nx = _mm256_set1_ps(a.normals[0][i]);
+	__m256 ny = _mm256_set1_ps(a.normals[1][i]);
+	__m256 nz = _mm256_set1_ps(a.normals[2][i]);
+	__m256 nd = _mm256_set1_ps(a.dists[i]);
+
+	__m256 pos = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+	__m256 neg = pos;
+	for (int v = 0; v < 3; v++) {
+		__m256 dist = _mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(nx, _mm256_loadu_ps(&b.verts[v][0][f])),
+			_mm256_mul_ps(ny, _mm256_loadu_ps(&b.verts[v][1][f]))),
+			_mm256_add_ps(_mm256_mul_ps(nz, _mm256_loadu_ps(&b.verts[v][2][f])), nd));
+		pos = _mm256_and_ps(pos, _mm256_cmp_ps(dist, zero, _CMP_GT_OQ));
+		neg = _mm256_and_ps(neg, _mm256_cmp_ps(dist, zero, _CMP_LT_OQ));
+	}
+	__m256 reject = _mm256_or_ps(pos, neg);
+
+	// distance of a's vertices to b's planes
+	nx = _mm256_loadu_ps(&b.normals[0][f]);
+	ny = _mm256_loadu_ps(&b.normals[1][f]);
+	nz = _mm256_loadu_ps(&b.normals[2][f]);
+	nd = _mm256_loadu_ps(&b.dists[f]);
+
+	pos = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+	neg = pos;
+	for (int v = 0; v < 3; v++) {
+		__m256 dist = _mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(nx, _mm256_set1_ps(a.verts[v][0][i])),
+			_mm256_mul_ps(ny, _mm256_set1_ps(a.verts[v][1][i]))),
+			_mm256_add_ps(_mm256_mul_ps(nz, _mm256_set1_ps(a.verts[v][2][i])), nd));
+		pos = _mm256_and_ps(pos, _mm256_cmp_ps(dist, zero, _CMP_GT_OQ));
+		neg = _mm256_and_ps(neg, _mm256_cmp_ps(dist, zero, _CMP_LT_OQ));
+	}
+	reject = _mm256_or_ps(reject, _mm256_or_ps(pos, neg));
+
+	return ~_mm256_movemask_ps(reject) & 0xff;
+#elif WORLDMESH_WIDTH == 4
+	__m128 zero = _mm_setzero_ps();
+
+	// distance of b's vertices to a's plane
+	__m128 nx = _mm_set1_ps(a.normals[0][i]);
+	__m128 ny = _mm_set1_ps(a.normals[1][i]);
+	__m128 nz = _mm_set1_ps(a.normals[2][i]);
+	__m128 nd = _mm_set1_ps(a.dists[i]);
+
+	__m128 pos = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	__m128 neg = pos;
+	for (int v = 0; v < 3; v++) {
+		__m128 dist = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(nx, _mm_loadu_ps(&b.verts[v][0][f])),
+			_mm_mul_ps(ny, _mm_loadu_ps(&b.verts[v][1][f]))),
+			_mm_add_ps(_mm_mul_ps(nz, _mm_loadu_ps(&b.verts[v][2][f])), nd));
+		pos = _mm_and_ps(pos, _mm_cmpgt_ps(dist, zero));
+		neg = _mm_and_ps(neg, _mm_cmplt_ps(dist, zero));
+	}
+	__m128 reject = _mm_or_ps(pos, neg);
+
+	// distance of a's vertices to b's planes
+	nx = _mm_loadu_ps(&b.normals[0][f]);
+	ny = _mm_loadu_ps(&b.normals[1][f]);
+	nz = _mm_loadu_ps(&b.normals[2][f]);
+	nd = _mm_loadu_ps(&b.dists[f]);
+
+	pos = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	neg = pos;
+	for (int v = 0; v < 3; v++) {
+		__m128 dist = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(nx, _mm_set1_ps(a.verts[v][0][i])),
+			_mm_mul_ps(ny, _mm_set1_ps(a.verts[v][1][i]))),
+			_mm_add_ps(_mm_mul_ps(nz, _mm_set1_ps(a.verts[v][2][i])), nd));
+		pos = _mm_and_ps(pos, _mm_cmpgt_ps(dist, zero));
+		neg = _mm_and_ps(neg, _mm_cmplt_ps(dist, zero));
+	}
+	reject = _mm_or_ps(reject, _mm_or_ps(pos, neg));
+
+	return ~_mm_movemask_ps(reject) & 0xf;
+#else
+	// scalar fallback
+	glm::vec3 N = a.normal(i);
+	float d = a.dists[i];
+	bool pos = true, neg = true;
+	for (int v = 0; v < 3; v++) {
+		float dist = glm::dot(N, b.vertex(f, v)) + d;
+		pos = pos && dist > 0.0f;
+		neg = neg && dist < 0.0f;
+	}
+	if (pos || neg) {
+		return 0;
+	}
+
+	N = b.normal(f);
+	d = b.dists[f];
+	pos = neg = true;
+	for (int v = 0; v < 3; v++) {
+		float dist = glm::dot(N, a.vertex(i, v)) + d;
+		pos = pos && dist > 0.0f;
+		neg = neg && dist < 0.0f;
+	}
+
+	return (pos || neg) ? 0 : 1;
+#endif
+}
+
+// boxes overlap
+static inline bool overlaps(glm::vec3 min1, glm::vec3 max1, glm::vec3 min2, glm::vec3 max2) {
+	return !(glm::any(glm::lessThan(max1, min2)) || glm::any(glm::greaterThan(min1, max2)));
+}
+
+// test faces against faces of another mesh (dual BVH traversal if both have one), retNorm = normal of the face hit in other
+bool WorldMesh::collidesWith(const WorldMesh& other, glm::vec3& retNorm) const {
+	// meshes do not overlap
+	if (!overlaps(min, max, other.min, other.max)) {
+		return false;
+	}
+
+	if (!bvh || !other.bvh) {
+		// every face against every face
+		return collidesWith(other, 0, noFaces, 0, other.noFaces, other.min, other.max, retNorm);
+	}
+
+	// pairs of nodes whose world bounds still have to be tested
+	static thread_local std::vector<std::pair<unsigned int, unsigned int>> stack;
+	stack.clear();
+	stack.push_back({ 0, 0 });
+
+	while (!stack.empty()) {
+		auto [a, b] = stack.back();
+		stack.pop_back();
+
+		if (!overlaps(nodeMin[a], nodeMax[a], other.nodeMin[b], other.nodeMax[b])) {
+			continue;
+		}
+
+		const BVHNode& nodeA = bvh->nodes[a];
+		const BVHNode& nodeB = other.bvh->nodes[b];
+
+		if (nodeA.isLeaf() && nodeB.isLeaf()) {
+			if (collidesWith(other, nodeA.leftOrFirst, nodeA.noFaces,
+				nodeB.leftOrFirst, nodeB.noFaces, other.nodeMin[b], other.nodeMax[b], retNorm)) {
+				return true;
+			}
+			continue;
+		}
+
+		// descend into the larger node (or the one that is not a leaf)
+		glm::vec3 extentA = nodeMax[a] - nodeMin[a];
+		glm::vec3 extentB = other.nodeMax[b] - other.nodeMin[b];
+		bool descendA = nodeB.isLeaf() ||
+			(!nodeA.isLeaf() && extentA.x * extentA.y * extentA.z >= extentB.x * extentB.y * extentB.z);
+
+		if (descendA) {
+			stack.push_back({ nodeA.leftOrFirst + 1, b });
+			stack.push_back({ nodeA.leftOrFirst, b });
+		}
+		else {
+			stack.push_back({ a, nodeB.leftOrFirst + 1 });
+			stack.push_back({ a, nodeB.leftOrFirst });
+		}
+	}
+
+	return false;
+}
+
+// test faces [first, first + count) against faces [otherFirst, otherFirst + otherCount) of another mesh
+bool WorldMesh::collidesWith(const WorldMesh& other, unsigned int first, unsigned int count,
+	unsigned int otherFirst, unsigned int otherCount, glm::vec3 otherMin, glm::vec3 otherMax, glm::vec3& retNorm) const {
+	unsigned int otherEnd = otherFirst + otherCount;
+
+	for (unsigned int i = first; i < first + count; i++) {
+		glm::vec3 V0 = vertex(i, 0);
+		glm::vec3 V1 = vertex(i, 1);
+		glm::vec3 V2 = vertex(i, 2);
+
+		// skip faces outside the other bounds
+		if (!overlaps(glm::min(V0, glm::min(V1, V2)), glm::max(V0, glm::max(V1, V2)), otherMin, otherMax)) {
+			continue;
+		}
+
+		for (unsigned int f = otherFirst; f < otherEnd; f += WORLDMESH_WIDTH) {
+			unsigned int mask = planeTests(*this, i, other, f);
+			if (otherEnd - f < WORLDMESH_WIDTH) {
+				// batch runs past the range
+				mask &= (1u << (otherEnd - f)) - 1;
+			}
+
+			// exact test on the faces that pass the plane tests, in order
+			for (; mask; mask &= mask - 1) {
+				unsigned int j = f + std::countr_zero(mask);
+				if (triTriIntersect(V0, V1, V2, other.vertex(j, 0), other.vertex(j, 1), other.vertex(j, 2))) {
+					retNorm = other.normal(j);
+					return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+// earliest hit of a sphere moving from start to start + dir (only hits with t <= toi are taken)
+bool WorldMesh::sweptSphere(glm::vec3 start, glm::vec3 dir, float radius, float& toi, glm::vec3& retNorm) const {
+	// box around the whole motion
+	glm::vec3 sweepMin = glm::min(start, start + dir) - radius;
+	glm::vec3 sweepMax = glm::max(start, start + dir) + radius;
+	if (!overlaps(min, max, sweepMin, sweepMax)) {
+		return false;
+	}
+
+	bool intersects = false;
+
+	if (!bvh) {
+		for (unsigned int i = 0; i < noFaces; i++) {
+			intersects |= sweptSphereTri(start, dir, radius, vertex(i, 0), vertex(i, 1), vertex(i, 2), toi, retNorm);
+		}
+		return intersects;
+	}
+
+	// nodes whose world bounds overlap the motion
+	static thread_local std::vector<unsigned int> stack;
+	stack.clear();
+	stack.push_back(0);
+
+	while (!stack.empty()) {
+		unsigned int n = stack.back();
+		stack.pop_back();
+
+		if (!overlaps(nodeMin[n], nodeMax[n], sweepMin, sweepMax)) {
+			continue;
+		}
+
+		const BVHNode& node = bvh->nodes[n];
+		if (node.isLeaf()) {
+			for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.noFaces; i++) {
+				intersects |= sweptSphereTri(start, dir, radius, vertex(i, 0), vertex(i, 1), vertex(i, 2), toi, retNorm);
+			}
+			continue;
+		}
+
+		stack.push_back(node.leftOrFirst + 1);
+		stack.push_back(node.leftOrFirst);
+	}
+
+	return intersects;
+}
+
+/*
+	swept sphere-triangle test
+*/
+
+// point in the plane of a triangle is inside it (barycentric coordinates)
+static bool pointInFace(glm::vec3 P, glm::vec3 V0, glm::vec3 V1, glm::vec3 V2) {
+	glm::vec3 e0 = V1 - V0, e1 = V2 - V0, p = P - V0;
+	float d00 = glm::dot(e0, e0), d01 = glm::dot(e0, e1), d11 = glm::dot(e1, e1);
+	float d20 = glm::dot(p, e0), d21 = glm::dot(p, e1);
+	float denom = d00 * d11 - d01 * d01;
+
+	float v = (d11 * d20 - d01 * d21) / denom;
+	float w = (d00 * d21 - d01 * d20) / denom;
+	return v >= 0.0f && w >= 0.0f && v + w <= 1.0f;
+}
+
+// moving sphere against a sphere of the same radius at a vertex (ray against sphere)
+static bool sweptSphereVertex(glm::vec3 start, glm::vec3 dir, float radius, glm::vec3 V, float& toi, glm::vec3& retNorm) {
+	glm::vec3 m = start - V;
+	float a = glm::dot(dir, dir);
+	float b = glm::dot(m, dir);
+	float c = glm::dot(m, m) - radius * radius;
+
+	// starts outside and moves away, or misses
+	float D = b * b - a * c;
+	if (c > 0.0f && (b >= 0.0f || D < 0.0f)) {
+		return false;
+	}
+
+	float t = c > 0.0f ? (-b - sqrtf(D)) / a : 0.0f;
+	if (t > toi) {
+		return false;
+	}
+
+	toi = t;
+	retNorm = start + t * dir - V;
+	return true;
+}
+
+// moving sphere against the cylinder around an edge (ray against cylinder, Ericson 5.3.7)
+static bool sweptSphereEdge(glm::vec3 start, glm::vec3 dir, float radius, glm::vec3 P, glm::vec3 Q, float& toi, glm::vec3& retNorm) {
+	glm::vec3 e = Q - P, m = start - P;
+	float md = glm::dot(m, e), nd = glm::dot(dir, e), dd = glm::dot(e, e);
+	float nn = glm::dot(dir, dir), mn = glm::dot(m, dir);
+
+	float a = dd * nn - nd * nd;
+	if (fabs(a) < 1e-8f) {
+		// moving along the edge, the vertices are hit first
+		return false;
+	}
+
+	float k = glm::dot(m, m) - radius * radius;
+	float c = dd * k - md * md;
+	float b = dd * mn - nd * md;
+	float D = b * b - a * c;
+	if (D < 0.0f) {
+		return false;
+	}
+
+	float t = (-b - sqrtf(D)) / a;
+	if (t < 0.0f || t > toi) {
+		// already overlapping at the start (caught by the face test) or too late
+		return false;
+	}
+
+	// hit must be between the end points
+	float s = md + t * nd;
+	if (s < 0.0f || s > dd) {
+		return false;
+	}
+
+	toi = t;
+	retNorm = (start + t * dir) - (P + (s / dd) * e);
+	return true;
+}
+
+// time of impact of a moving sphere against a triangle
+bool sweptSphereTri(glm::vec3 start, glm::vec3 dir, float radius,
+	glm::vec3 V0, glm::vec3 V1, glm::vec3 V2, float& toi, glm::vec3& retNorm) {
+	glm::vec3 N = glm::cross(V1 - V0, V2 - V0);
+	if (N == glm::vec3(0.0f)) {
+		// degenerate face
+		return false;
+	}
+	N = glm::normalize(N);
+
+	// face the side the sphere starts on
+	float dist = glm::dot(start - V0, N);
+	float speed = glm::dot(dir, N);
+	if (dist < 0.0f) {
+		N = -N;
+		dist = -dist;
+		speed = -speed;
+	}
+
+	// time the sphere touches the plane
+	float t = -1.0f;
+	if (dist <= radius) {
+		t = 0.0f;
+	}
+	else if (speed < 0.0f) {
+		t = (dist - radius) / -speed;
+	}
+
+	if (t >= 0.0f && t <= toi && pointInFace(start + t * dir - radius * N, V0, V1, V2)) {
+		// touches the inside of the face first
+		toi = t;
+		retNorm = N;
+		return true;
+	}
+
+	// touches the border of the face first (if at all)
+	bool intersects = false;
+	intersects |= sweptSphereEdge(start, dir, radius, V0, V1, toi, retNorm);
+	intersects |= sweptSphereEdge(start, dir, radius, V1, V2, toi, retNorm);
+	intersects |= sweptSphereEdge(start, dir, radius, V2, V0, toi, retNorm);
+	intersects |= sweptSphereVertex(start, dir, radius, V0, toi, retNorm);
+	intersects |= sweptSphereVertex(start, dir, radius, V1, toi, retNorm);
+	intersects |= sweptSphereVertex(start, dir, radius, V2, toi, retNorm);
+	return intersects;
+}
+
+/*
+	exact triangle-triangle test
+*/
+
+#define TRITRI_EPSILON 1e-6f
+
+// interval where the triangle crosses the line of intersection (false if coplanar)
+static bool computeInterval(float VV0, float VV1, float VV2, float D0, float D1, float D2, float& isect0, float& isect1) {
+	// vertex on its own side of the other plane goes first
+	if (D0 * D1 > 0.0f) {
+		std::swap(VV0, VV2); std::swap(D0, D2);
+	}
+	else if (D0 * D2 > 0.0f) {
+		std::swap(VV0, VV1); std::swap(D0, D1);
+	}
+	else if (D1 * D2 > 0.0f || D0 != 0.0f) {
+		// D0 already on its own side
+	}
+	else if (D1 != 0.0f) {
+		std::swap(VV0, VV1); std::swap(D0, D1);
+	}
+	else if (D2 != 0.0f) {
+		std::swap(VV0, VV2); std::swap(D0, D2);
+	}
+	else {
+		// triangles are coplanar
+		return false;
+	}
+
+	isect0 = VV0 + (VV1 - VV0) * D0 / (D0 - D1);
+	isect1 = VV0 + (VV2 - VV0) * D0 / (D0 - D2);
+	if (isect0 > isect1) {
+		std::swap(isect0, isect1);
+	}
+
+	return true;
+}
+
+// 2d segment intersection (projected onto axes i0, i1)
+static bool edgesIntersect(glm::vec3 A0, glm::vec3 A1, glm::vec3 B0, glm::vec3 B1, int i0, int i1) {
+	glm::vec2 a0(A0[i0], A0[i1]), a1(A1[i0], A1[i1]), b0(B0[i0], B0[i1]), b1(B1[i0], B1[i1]);
+	auto orient = [](glm::vec2 p, glm::vec2 q, glm::vec2 r) {
+		return (q.x - p.x) * (r.y - p.y) - (q.y - p.y) * (r.x - p.x);
+	};
+
+	float o1 = orient(a0, a1, b0), o2 = orient(a0, a1, b1);
+	float o3 = orient(b0, b1, a0), o4 = orient(b0, b1, a1);
+	return o1 * o2 <= 0.0f && o3 * o4 <= 0.0f;
+}
+
+// 2d point in triangle (projected onto axes i0, i1)
+static bool pointInTri(glm::vec3 P, glm::vec3 U0, glm::vec3 U1, glm::vec3 U2, int i0, int i1) {
+	glm::vec3 U[3] = { U0, U1, U2 };
+	float side[3];
+	for (int k = 0; k < 3; k++) {
+		glm::vec3 A = U[k], B = U[(k + 1) % 3];
+		side[k] = (B[i0] - A[i0]) * (P[i1] - A[i1]) - (B[i1] - A[i1]) * (P[i0] - A[i0]);
+	}
+	return (side[0] >= 0.0f && side[1] >= 0.0f && side[2] >= 0.0f) ||
+		(side[0] <= 0.0f && side[1] <= 0.0f && side[2] <= 0.0f);
+}
+
+// coplanar triangles, project onto the plane most aligned with the normal
+static bool coplanarTriTri(glm::vec3 N, glm::vec3 V[3], glm::vec3 U[3]) {
+	glm::vec3 A = glm::abs(N);
+	int i0, i1;
+	if (A.x > A.y) {
+		if (A.x > A.z) { i0 = 1; i1 = 2; }
+		else { i0 = 0; i1 = 1; }
+	}
+	else {
+		if (A.z > A.y) { i0 = 0; i1 = 1; }
+		else { i0 = 0; i1 = 2; }
+	}
+
+	// test all edges of V against all edges of U
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			if (edgesIntersect(V[i], V[(i + 1) % 3], U[j], U[(j + 1) % 3], i0, i1)) {
+				return true;
+			}
+		}
+	}
+
+	// one triangle completely inside the other
+	return pointInTri(V[0], U[0], U[1], U[2], i0, i1) || pointInTri(U[0], V[0], V[1], V[2], i0, i1);
+}
+
+bool triTriIntersect(glm::vec3 V0, glm::vec3 V1, glm::vec3 V2, glm::vec3 U0, glm::vec3 U1, glm::vec3 U2) {
+	// plane of V
+	glm::vec3 N1 = glm::cross(V1 - V0, V2 - V0);
+	float d1 = -glm::dot(N1, V0);
+	if (N1 == glm::vec3(0.0f)) {
+		// degenerate face
+		return false;
+	}
+
+	// signed distances of U to plane of V
+	float du0 = glm::dot(N1, U0) + d1;
+	float du1 = glm::dot(N1, U1) + d1;
+	float du2 = glm::dot(N1, U2) + d1;
+	if (fabs(du0) < TRITRI_EPSILON) du0 = 0.0f;
+	if (fabs(du1) < TRITRI_EPSILON) du1 = 0.0f;
+	if (fabs(du2) < TRITRI_EPSILON) du2 = 0.0f;
+
+	// U on one side of plane of V
+	if (du0 * du1 > 0.0f && du0 * du2 > 0.0f) {
+		return false;
+	}
+
+	// plane of U
+	glm::vec3 N2 = glm::cross(U1 - U0, U2 - U0);
+	float d2 = -glm::dot(N2, U0);
+	if (N2 == glm::vec3(0.0f)) {
+		// degenerate face
+		return false;
+	}
+
+	// signed distances of V to plane of U
+	float dv0 = glm::dot(N2, V0) + d2;
+	float dv1 = glm::dot(N2, V1) + d2;
+	float dv2 = glm::dot(N2, V2) + d2;
+	if (fabs(dv0) < TRITRI_EPSILON) dv0 = 0.0f;
+	if (fabs(dv1) < TRITRI_EPSILON) dv1 = 0.0f;
+	if (fabs(dv2) < TRITRI_EPSILON) dv2 = 0.0f;
+
+	// V on one side of plane of U
+	if (dv0 * dv1 > 0.0f && dv0 * dv2 > 0.0f) {
+		return false;
+	}
+
+	// direction of the line of intersection, project onto its largest axis
+	glm::vec3 D = glm::abs(glm::cross(N1, N2));
+	int index = 0;
+	if (D.y > D[index]) index = 1;
+	if (D.z > D[index]) index = 2;
+
+	float isect1[2], isect2[2];
+	if (!computeInterval(V0[index], V1[index], V2[index], dv0, dv1, dv2, isect1[0], isect1[1]) ||
+		!computeInterval(U0[index], U1[index], U2[index], du0, du1, du2, isect2[0], isect2[1])) {
+		glm::vec3 V[3] = { V0, V1, V2 };
+		glm::vec3 U[3] = { U0, U1, U2 };
+		return coplanarTriTri(N1, V, U);
+	}
+
+	// intervals must overlap
+	return !(isect1[1] < isect2[0] || isect2[1] < isect1[0]);
+}
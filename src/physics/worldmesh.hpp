@@ -0,0 +1,110 @@
+#ifndef WORLDMESH_H
+#define WORLDMESH_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "bvh.hpp"
+
+/*
+	SIMD width of the batched triangle tests
+	- AVX: one triangle against 8 at a time
+	- SSE: one triangle against 4 at a time
+	- scalar fallback otherwise (or with COLLISION_SCALAR defined)
+*/
+#if defined(__AVX__) && !defined(COLLISION_SCALAR)
+#define WORLDMESH_WIDTH 8
+#elif (defined(__SSE__) || defined(_M_X64)) && !defined(COLLISION_SCALAR)
+#define WORLDMESH_WIDTH 4
+#else
+#define WORLDMESH_WIDTH 1
+#endif
+
+// forward declarations
+class CollisionMesh;
+class RigidBody;
+
+/*
+	collision mesh transformed into world space for one instance
+	- points are transformed once per update instead of once per face pair
+	- faces are stored as SoA (structure of arrays) and padded to the SIMD width, so
+	  one triangle can be tested against WORLDMESH_WIDTH triangles at a time
+	- faces are in the leaf order of the mesh's BVH, so each leaf is one contiguous range
+*/
+
+class WorldMesh {
+public:
+	// if the cache holds the current transformation
+	bool valid = false;
+
+	// number of faces (before padding)
+	unsigned int noFaces = 0;
+	// number of faces after padding to WORLDMESH_WIDTH
+	unsigned int noPaddedFaces = 0;
+
+	// world space points
+	std::vector<glm::vec3> points;
+
+	// face vertices [vertex][axis][face]
+	std::vector<float> verts[3][3];
+	// face plane (unnormalized normal and offset, n . x + d = 0) [axis][face]
+	std::vector<float> normals[3];
+	std::vector<float> dists;
+
+	// world space bounds of all points
+	glm::vec3 min;
+	glm::vec3 max;
+
+	// hierarchy of the collision mesh (nullptr if it has none)
+	const BVH* bvh = nullptr;
+	// world space bounds of each BVH node
+	std::vector<glm::vec3> nodeMin;
+	std::vector<glm::vec3> nodeMax;
+
+	/*
+		functionality
+	*/
+
+	// transform the mesh with the instance's model matrix
+	void update(CollisionMesh* mesh, RigidBody* rb);
+
+	// test faces against faces of another mesh (dual BVH traversal if both have one), retNorm = normal of the face hit in other
+	bool collidesWith(const WorldMesh& other, glm::vec3& retNorm) const;
+
+	// test faces [first, first + count) against faces [otherFirst, otherFirst + otherCount) of another mesh
+	// - faces outside of [otherMin, otherMax] are skipped
+	bool collidesWith(const WorldMesh& other, unsigned int first, unsigned int count,
+		unsigned int otherFirst, unsigned int otherCount, glm::vec3 otherMin, glm::vec3 otherMax, glm::vec3& retNorm) const;
+
+	// earliest hit of a sphere moving from start to start + dir (only hits with t <= toi are taken)
+	// - toi is the fraction of dir travelled before touching, retNorm = normal at the contact
+	bool sweptSphere(glm::vec3 start, glm::vec3 dir, float radius, float& toi, glm::vec3& retNorm) const;
+
+	/*
+		accessors
+	*/
+
+	// vertex of a face
+	glm::vec3 vertex(unsigned int face, unsigned int v) const {
+		return glm::vec3(verts[v][0][face], verts[v][1][face], verts[v][2][face]);
+	}
+
+	// unnormalized normal of a face
+	glm::vec3 normal(unsigned int face) const {
+		return glm::vec3(normals[0][face], normals[1][face], normals[2][face]);
+	}
+};
+
+/*
+	exact triangle-triangle test (Moller, "A Fast Triangle-Triangle Intersection Test", 1997)
+*/
+bool triTriIntersect(glm::vec3 V0, glm::vec3 V1, glm::vec3 V2, glm::vec3 U0, glm::vec3 U1, glm::vec3 U2);
+
+/*
+	time of impact of a moving sphere against a triangle (face, then edges and vertices)
+	- only hits with t <= toi are taken
+*/
+bool sweptSphereTri(glm::vec3 start, glm::vec3 dir, float radius,
+	glm::vec3 V0, glm::vec3 V1, glm::vec3 V2, float& toi, glm::vec3& retNorm);
+
+#endif
@@ -1,4 +1,5 @@
 #include "scene.hpp"
+#include "graphics/vulkan_pipeline.hpp"
 
 #define MAX_POINT_LIGHTS 10
 #define MAX_SPOT_LIGHTS 2
@@ -6,6 +7,7 @@
 unsigned int Scene::scrWidth = 0;
 unsigned int Scene::scrHeight = 0;
 
+#include <algorithm>
 #include <iostream>
 #include <csignal>
 
@@ -30,13 +32,13 @@ void Scene::framebufferSizeCallback(SDL_Window* window, int width, int height) {
 */
 
 // default
-Scene::Scene() : currentId("aaaaaaaa"), lightUBO(0) {}
+Scene::Scene() : lightUBO(0) {}
 
 // set with values
 Scene::Scene(int SDL2VersionMajor, int SDL2VersionMinor, const char* title, unsigned int scrWidth, unsigned int scrHeight)
     : SDL2VersionMajor(SDL2VersionMajor), SDL2VersionMinor(SDL2VersionMinor), title(title), // window title
     // default indices/vals
-    activeCamera(-1), activePointLights(0), activeSpotLights(0), currentId("aaaaaaaa"), lightUBO(0) {
+    activeCamera(-1), activePointLights(0), activeSpotLights(0), lightUBO(0) {
     
     // window dimensions
     Scene::scrWidth = scrWidth;
@@ -113,16 +115,22 @@ bool Scene::init() {
     SDL_SetRelativeMouseMode(SDL_TRUE);
     
 
-    /*
-        init model/instance trees
-    */
-    models = avl_createEmptyRoot(strkeycmp);
-    instances = trie::Trie<RigidBody*>(trie::ascii_lowercase);
-
     /*
         init octree
     */
-    octree = std::make_unique<Octree::node>( BoundingRegion(glm::vec3(-16.0f), glm::vec3(16.0f)) );
+    octree = std::make_unique<SceneOctree>( BoundingRegion(glm::vec3(-16.0f), glm::vec3(16.0f)) );
+
+    jobs = std::make_unique<JobSystem>();
+#ifdef SINGLE_THREADED_UPDATE
+    // force single threaded execution to compare results
+    jobs->singleThreaded = true;
+#endif
+#ifdef LINEAR_OCTREE
+    octree->jobs = jobs.get();
+#endif
+    // shaders missing from the cache compile on the same threads
+    VulkanPipeline::getShaderCache().jobs = jobs.get();
+    physics.octree = octree.get();
 
     /*
         initialize freetype library
@@ -337,16 +345,10 @@ void Scene::update() {
 }
 
 
-// update screen after frame
-void Scene::newFrame(Box &box) {
-
-    box.positions.clear();
-    box.sizes.clear();
-
-    // process pending objects
-    octree->processPending();
-    //std::cout << "Does this part work?" << std::endl;
-    octree->update(box);
+// update screen after frame (advances physics by the frame time)
+void Scene::newFrame(Box &box, float dt) {
+    // integrate, process pending objects and update octree in fixed steps
+    physics.update(dt, box.positions, box.sizes);
 
     // send new frame to window
     SDL_GL_SwapWindow(window);
@@ -445,11 +447,159 @@ void Scene::renderSpotLightShader(Shader shader, unsigned int idx) {
 
 // render specified model's instances
 void Scene::renderInstances(std::string modelId, Shader shader, float dt) {
-    void* val = avl_get(models, (void*)modelId.c_str());
-    if (val) {
+    unsigned int* idx = modelIndices.get(modelId);
+    if (idx) {
         // render each mesh in specified model
         shader.activate();
-        ((Model*)val)->render(shader, dt, this);
+        models[*idx]->render(shader, dt, this);
+    }
+}
+
+// find the instances in the view frustum by walking the octree (CPU culling for renderBatched)
+void Scene::cullVisible() {
+    visibleInstances.clear();
+    octree->cullFrustum(Frustum(projection * view), visibleInstances, &frustumStats);
+}
+
+// draw all models from the shared geometry buffers (bindBucket binds the pipeline for each bucket)
+bool Scene::renderBatched(VkCommandBuffer commandBuffer, VulkanRingBuffer& frameRing, const std::function<void(uint64_t)>& bindBucket,
+    bool cullFrustum) {
+    if (!geometry) {
+        return false;
+    }
+
+    unsigned int noInstances = 0;
+    if (cullFrustum) {
+        // walk the octree with this frame's view before any instance is written
+        cullVisible();
+        noInstances = visibleInstances.noVisible();
+    }
+    else {
+        for (Model* model : models) {
+            noInstances += model->currentNumInstances;
+        }
+    }
+    if (!noInstances) {
+        return true;
+    }
+
+    // instance matrices of all models in one slice each, indexed by firstInstance of the draws
+    VulkanRingBuffer::Slice modelSlice = frameRing.allocate(noInstances * sizeof(glm::mat4));
+    VulkanRingBuffer::Slice normalSlice = frameRing.allocate(noInstances * sizeof(glm::mat3));
+    if (!modelSlice.mapped || !normalSlice.mapped) {
+        return false;
+    }
+
+    VulkanUploadManager& uploads = vulkanDevice.getUploadManager();
+    drawBatch.clear();
+    unsigned int firstInstance = 0;
+    for (unsigned int i = 0, noModels = models.size(); i < noModels; i++) {
+        // the geometry is still uploading
+        if (!uploads.isReady(models[i]->geometryTicket)) {
+            continue;
+        }
+
+        if (cullFrustum) {
+            // a model with no visible list had no instances in view
+            const std::vector<uint32_t>* visible = visibleInstances.get(i);
+            if (visible) {
+                firstInstance += models[i]->batchDraws(drawBatch, (glm::mat4*)modelSlice.mapped, (glm::mat3*)normalSlice.mapped,
+                    firstInstance, nullptr, 0, visible);
+            }
+        }
+        else {
+            firstInstance += models[i]->batchDraws(drawBatch, (glm::mat4*)modelSlice.mapped, (glm::mat3*)normalSlice.mapped, firstInstance);
+        }
+    }
+    drawBatch.build();
+
+    geometry->bind(commandBuffer, modelSlice.buffer, modelSlice.offset, normalSlice.buffer, normalSlice.offset);
+    geometry->draw(commandBuffer, drawBatch, frameRing, bindBucket);
+
+    return true;
+}
+
+// batch all models and record their culling on the GPU (before the render pass)
+bool Scene::cullBatched(VkCommandBuffer commandBuffer, VulkanCullPass& cullPass, int frameIndex) {
+    if (!geometry || !vulkanDevice.drawIndirectFirstInstance || models.size() > cullPass.getMaxGroups()) {
+        return false;
+    }
+
+    unsigned int noInstances = 0;
+    for (Model* model : models) {
+        noInstances += model->currentNumInstances;
+    }
+    if (noInstances > cullPass.getMaxInstances()) {
+        return false;
+    }
+
+    // each model is a group, its instances are compacted to the front of its range
+    VulkanCullPass::FrameData frameData = cullPass.getFrameData(frameIndex);
+    VulkanUploadManager& uploads = vulkanDevice.getUploadManager();
+    drawBatch.clear();
+    unsigned int firstInstance = 0;
+    for (unsigned int i = 0, noModels = models.size(); i < noModels; i++) {
+        frameData.groups[i] = { firstInstance, 0 };
+        // the geometry is still uploading (an empty group)
+        if (!uploads.isReady(models[i]->geometryTicket)) {
+            continue;
+        }
+        firstInstance += models[i]->batchDraws(drawBatch, frameData.models, frameData.normalModels, firstInstance, frameData.instances, i);
+    }
+    drawBatch.build();
+
+    const std::vector<IndirectCommand>& commands = drawBatch.getCommands();
+    const std::vector<uint32_t>& groups = drawBatch.getTags();
+    if (commands.size() > cullPass.getMaxDraws()) {
+        return false;
+    }
+    for (unsigned int i = 0, noCommands = commands.size(); i < noCommands; i++) {
+        frameData.draws[i] = { commands[i], groups[i] };
+    }
+
+    cullPass.record(commandBuffer, frameIndex, projection * view, noInstances, commands.size());
+    return true;
+}
+
+// draw the visible instances of the last cullBatched (in the render pass)
+void Scene::drawCulled(VkCommandBuffer commandBuffer, VulkanCullPass& cullPass, int frameIndex, const std::function<void(uint64_t)>& bindBucket) {
+    VkBuffer output = cullPass.getOutputBuffer(frameIndex);
+    geometry->bind(commandBuffer, output, cullPass.getModelsOffset(), output, cullPass.getNormalModelsOffset());
+    geometry->drawIndirect(commandBuffer, drawBatch, output, cullPass.getCommandsOffset(), bindBucket);
+}
+
+// render the models one by one, recorded in parallel into secondary command buffers (one per bucket of models)
+void Scene::renderParallel(VkCommandBuffer commandBuffer, VulkanCommandRecorder& recorder, const VulkanCommandRecorder::Target& target,
+    ShaderPipline& pipeline, VkDescriptorSet globalDescriptorSet, float dt, int frameIndex, VulkanRingBuffer* frameRing) {
+    // buckets of consecutive models, so no model is recorded by two threads
+    unsigned int noModels = models.size();
+    unsigned int noBuckets = std::min(noModels, jobs->noThreads() * SCENE_RECORD_BUCKETS_PER_THREAD);
+    if (!noBuckets) {
+        return;
+    }
+    unsigned int perBucket = (noModels + noBuckets - 1) / noBuckets;
+    noBuckets = (noModels + perBucket - 1) / perBucket;
+
+    recorder.record(commandBuffer, target, noBuckets, [&](VkCommandBuffer secondary, unsigned int bucket) {
+        // nothing is inherited from the primary buffer but the render pass
+        pipeline.bind(secondary, globalDescriptorSet);
+
+        for (unsigned int i = bucket * perBucket, end = std::min(i + perBucket, noModels); i < end; i++) {
+            models[i]->render(pipeline, dt, secondary, frameIndex, frameRing);
+        }
+    });
+}
+
+// overlay with the recording time of each thread in the last renderParallel
+void Scene::renderRecordStats(const VulkanCommandRecorder& recorder, std::string font, Shader shader, float x, float y, float lineHeight) {
+    std::string text = recorder.getStatsText();
+    for (size_t begin = 0, end; begin < text.size(); begin = end + 1, y -= lineHeight) {
+        end = text.find('\n', begin);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+
+        renderText(font, shader, text.substr(begin, end - begin), x, y, glm::vec2(1.0f), glm::vec3(1.0f));
     }
 }
 
@@ -471,13 +621,17 @@ void Scene::renderText(std::string font, Shader shader, std::string text, float
 // called after main loop
 void Scene::cleanup() {
     // clean up instances
-    instances.cleanup();
+    instances.clear();
 
     // clean all models
-    avl_postorderTraverse(models, [](avl* node) -> void {
-        ((Model*)node->val)->cleanup();
-    });
-    avl_free(models);
+    for (Model* model : models) {
+        model->cleanup();
+    }
+    models.clear();
+    modelIndices.clear();
+
+    // release the shared buffers before the device
+    geometry.reset();
 
     // cleanup fonts
     avl_postorderTraverse(fonts, [](avl* node) -> void {
@@ -488,6 +642,9 @@ void Scene::cleanup() {
     // destroy octree
     octree->destroy();
 
+    // the job system goes with the scene
+    VulkanPipeline::getShaderCache().jobs = nullptr;
+
     // quit SDL
     //glfwTerminate();
     SDL_DestroyWindow(window);
@@ -544,29 +701,26 @@ void Scene::createGlobalBuffers() {
 }
 */
 
-// register model into model trie
+// register model into model map
 void Scene::registerModel(Model* model) {
-    /*
-    globalVertices.insert(globalVertices.end(), model->combinedVertices.begin(), model->combinedVertices.end());
-    globalIndices.insert(globalIndices.end(), model->combinedIndices.begin(), model->combinedIndices.end());
-    globalIndirectCommands.insert(globalIndirectCommands.end(), model->indirectCommands.begin(), model->indirectCommands.end());
-    */
-    models = avl_insert(models, (void*)model->id.c_str(), model);
+    modelIndices.insert(model->id, models.size());
+    models.push_back(model);
 }
 
 // generate instance of specified model with physical parameters
 RigidBody* Scene::generateInstance(std::string modelId, glm::vec3 size, float mass, glm::vec3 pos, glm::vec3 rot) {
     // generate new rigid body
-    void* val = avl_get(models, (void*)modelId.c_str());
-    if (val) {
-        Model* model = (Model*)val;
+    unsigned int* idx = modelIndices.get(modelId);
+    if (idx) {
+        Model* model = models[*idx];
         RigidBody* rb = model->generateInstance(size, mass, pos, rot);
         if (rb) {
-            // successfully generated, set new and unique id for instance
-            std::string id = generateId();
-            rb->instanceId = id;
-            // insert into trie
-            instances.insert(rb->instanceId, rb);
+            // successfully generated, register to get a new and unique id for instance
+            rb->instanceId = instances.insert(rb, *idx);
+            // moving instances are integrated by the physics world
+            if (States::isActive(&model->switches, DYNAMIC)) {
+                physics.addBody(rb);
+            }
             // insert into pending queue
             octree->addToPending(rb, model);
             return rb;
@@ -578,38 +732,45 @@ RigidBody* Scene::generateInstance(std::string modelId, glm::vec3 size, float ma
 // initialize model instances
 void Scene::initInstances() {
     // initialize all instances for each model
-    avl_inorderTraverse(models, [](avl* node) -> void {
-        ((Model*)node->val)->initInstances();
-    });
+    for (Model* model : models) {
+        model->initInstances();
+    }
 }
 
-// load model data
-void Scene::loadModels() {
+// load model data (onProgress is called while each model loads, e.g. to render a loading frame)
+void Scene::loadModels(const ModelImportCallback& onProgress) {
+    if (!geometry) {
+        geometry = std::make_unique<VulkanGeometryBuffer>(vulkanDevice, sizeof(Vertex), SCENE_MAX_VERTICES, SCENE_MAX_INDICES);
+    }
+
     // initialize each model
-    avl_inorderTraverse(models, [](avl* node) -> void {
-        ((Model*)node->val)->init();
-    });
+    for (Model* model : models) {
+        // meshes and textures of the model import on the job system
+        model->jobs = jobs.get();
+        model->onProgress = onProgress;
+        model->init();
+        model->onProgress = nullptr;
+
+        // copy the meshes into the shared buffers (models that do not fit are only drawn with render)
+        if (!model->addToGeometry(*geometry)) {
+            std::cout << "Geometry buffers full, " << model->id << " is not batched" << std::endl;
+        }
+    }
 }
 
-// delete instance
-void Scene::removeInstance(std::string instanceId) {
-    RigidBody* instance = instances[instanceId];
-    // get instance's model
-    std::string targetModel = instance->modelId;
-    Model* model = (Model*)avl_get(models, (void*)targetModel.c_str());
-
-    // delete instance from model
-    model->removeInstance(instanceId);
-
-    // remove from tree
-    instances[instanceId] = NULL;
-    instances.erase(instanceId);
-    delete(instance);
+// delete instance (instances marked for deletion are deleted with it)
+void Scene::removeInstance(InstanceId instanceId) {
+    markForDeletion(instanceId);
+    clearDeadInstances();
 }
 
 // mark instance for deletion
-void Scene::markForDeletion(std::string instanceId) {
-    RigidBody* instance = instances[instanceId];
+void Scene::markForDeletion(InstanceId instanceId) {
+    RigidBody* instance = getInstance(instanceId);
+    if (!instance || States::isActive(&instance->state, INSTANCE_DEAD)) {
+        // removed or already marked
+        return;
+    }
 
     // activate kill switch
     States::activate(&instance->state, INSTANCE_DEAD);
@@ -619,25 +780,37 @@ void Scene::markForDeletion(std::string instanceId) {
 
 // clear all instances marked for deletion
 void Scene::clearDeadInstances() {
-    for (RigidBody* rb : instancesToDelete) {
-        removeInstance(rb->instanceId);
+    if (instancesToDelete.empty()) {
+        return;
+    }
+
+    // stop integrating and take out of the octree before they are freed (no step may have run this frame)
+    physics.removeDead(instancesToDelete);
+
+    for (RigidBody* instance : instancesToDelete) {
+        InstanceId instanceId = instance->instanceId;
+
+        // delete instance from model
+        models[INSTANCE_ID_MODEL(instanceId)]->removeInstance(instance);
+
+        // remove from registry
+        instances.erase(instanceId);
+        delete(instance);
     }
     instancesToDelete.clear();
 }
 
-// generate next instance id
-std::string Scene::generateId() {
-    for (int i = currentId.length() - 1; i >= 0; i--) {
-        if ((int)currentId[i] != (int)'z') {
-            // increment then break
-            currentId[i] = (char)(((int)currentId[i]) + 1);
-            break;
-        }
-        else {
-            currentId[i] = 'a';
-        }
-    }
-    return currentId;
+// get instance (nullptr if it was removed)
+RigidBody* Scene::getInstance(InstanceId instanceId) {
+    RigidBody** val = instances.get(instanceId);
+    return val ? *val : nullptr;
+}
+
+// readable name of an instance for debugging ("<model id>#<slot>")
+std::string Scene::getInstanceName(InstanceId instanceId) {
+    unsigned int modelIdx = INSTANCE_ID_MODEL(instanceId);
+    std::string modelName = modelIdx < models.size() ? models[modelIdx]->id : "?";
+    return modelName + "#" + std::to_string(SlotMap<RigidBody*>::slotOf(instanceId));
 }
 
 
@@ -774,7 +947,7 @@ void Scene::updateSparseBuffer() {
         sparseMemoryBind.resourceOffset = modelOffsets[i].offset;
         sparseMemoryBind.size = modelOffsets[i].size;
         sparseMemoryBind.memory = globalVertexBuffer->getMemory();  // Assuming global buffer memory
-        sparseMemoryBind.memoryOffset = modelOffsets[i].offset;
+        sparseMemoryBind.memoryOffset = globalVertexBuffer->getMemoryOffset() + modelOffsets[i].offset;
 
         VkSparseBufferMemoryBindInfo sparseBufferBindInfo = {};
         sparseBufferBindInfo.buffer = globalVertexBuffer->getBuffer();
@@ -10,6 +10,7 @@
 
 #include <vector>
 #include <map>
+#include <functional>
 #include <memory>
 
 #include <glm/glm.hpp>
@@ -32,11 +33,16 @@
 
 #include "graphics/memory/framememory.hpp"
 #include "graphics/memory/uniformmemory.hpp"
+#include "graphics/memory/drawbatcher.hpp"
 
 #include "graphics/models/box.hpp"
 
 //#include "graphics/objects/model.h"
 #include "graphics/model.hpp"
+#include "graphics/vulkan_geometry_buffer.hpp"
+#include "graphics/vulkan_ring_buffer.hpp"
+#include "graphics/vulkan_cull_pass.hpp"
+#include "graphics/vulkan_command_recorder.hpp"
 
 #include "graphics/rendering/light.hpp"
 #include "graphics/rendering/shader.hpp"
@@ -49,7 +55,18 @@
 #include "algorithms/states.hpp"
 #include "algorithms/avl.hpp"
 #include "algorithms/octree.hpp"
-#include "algorithms/trie.hpp"
+#include "algorithms/slotmap.hpp"
+#include "algorithms/stringmap.hpp"
+#include "algorithms/jobsystem.hpp"
+
+#include "physics/physicsworld.hpp"
+
+// size of the shared geometry buffers
+#define SCENE_MAX_VERTICES (1 << 20)
+#define SCENE_MAX_INDICES (1 << 22)
+
+// secondary command buffers per recording thread in renderParallel (spare buckets even out uneven models)
+#define SCENE_RECORD_BUCKETS_PER_THREAD 2
 
 // forward declarations
 namespace Octree {
@@ -65,29 +82,31 @@ class Model;
 
 class Scene {
 public:
-    // tries to store models/instances
-    avl* models;
-    trie::Trie<RigidBody*> instances;
-    /*
-    std::vector<Vertex> globalVertices;
-    std::vector<uint32_t> globalIndices;
-	std::vector<std::unique_ptr<VkDrawIndexedIndirectCommand>> globalIndirectCommands;
-
-    std::unique_ptr<VulkanBuffer> globalVertexBuffer;
-	std::unique_ptr<VulkanBuffer> globalIndexBuffer;
-	uint32_t vertexCount;
-  	bool hasIndexBuffer = false;
-	uint32_t indexCount;
-
-    // to be called after constructor
-    void createGlobalBuffers();
-    */
+    // models in order of registration (index is in the ids of their instances) and their indices by id
+    std::vector<Model*> models;
+    StringMap<unsigned int> modelIndices;
+    // instances by id (RigidBody::instanceId is the handle in the registry)
+    SlotMap<RigidBody*> instances;
+
+    // vertices/indices of all models (created in loadModels)
+    std::unique_ptr<VulkanGeometryBuffer> geometry;
+    // draws of the current frame grouped by bucket
+    DrawBatcher drawBatch;
+    // instances in the view frustum (by model index) and counts of the last traversal, filled by cullVisible
+    VisibleInstances visibleInstances;
+    FrustumCullStats frustumStats = {};
 
     // list of instances that should be deleted
     std::vector<RigidBody*> instancesToDelete;
 
-    // pointer to root node in octree
-    std::unique_ptr<Octree::node> octree;
+    // pointer to octree
+    std::unique_ptr<SceneOctree> octree;
+
+    // worker threads for the octree update
+    std::unique_ptr<JobSystem> jobs;
+
+    // fixed step simulation of the dynamic instances (runs the octree)
+    PhysicsWorld physics;
 
     // map for logged variables
     //Jsoncpp::json variableLog;
@@ -143,8 +162,8 @@ public:
     // update inputs each frame
     void updateInput();
 
-    // update screen after frame
-    void newFrame(Box &box);
+    // update screen after frame (advances physics by the frame time)
+    void newFrame(Box &box, float dt);
 
     // set uniform shader varaibles (lighting, etc)
     void renderShader(Shader shader, bool applyLighting = true);
@@ -161,6 +180,31 @@ public:
     // render specified model's instances
     void renderInstances(std::string modelId, Shader shader, float dt);
 
+    // find the instances in the view frustum by walking the octree (CPU culling for renderBatched)
+    // - call after the instances of the frame were added and removed, with the view and projection of the frame
+    void cullVisible();
+
+    // draw all models from the shared geometry buffers (bindBucket binds the pipeline for each bucket)
+    // - with cullFrustum, cullVisible runs first and only the instances it found are written and drawn
+    // false if the frame ring is full, the models then have to be rendered one by one
+    bool renderBatched(VkCommandBuffer commandBuffer, VulkanRingBuffer& frameRing, const std::function<void(uint64_t)>& bindBucket,
+        bool cullFrustum = false);
+
+    // batch all models and record their culling on the GPU (before the render pass)
+    // false if the pass cannot take them or the device has no drawIndirectFirstInstance, renderBatched is used then
+    bool cullBatched(VkCommandBuffer commandBuffer, VulkanCullPass& cullPass, int frameIndex);
+
+    // draw the visible instances of the last cullBatched (in the render pass)
+    void drawCulled(VkCommandBuffer commandBuffer, VulkanCullPass& cullPass, int frameIndex, const std::function<void(uint64_t)>& bindBucket);
+
+    // render the models one by one, recorded in parallel into secondary command buffers (one per bucket of models)
+    // - the render pass has to be begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+    void renderParallel(VkCommandBuffer commandBuffer, VulkanCommandRecorder& recorder, const VulkanCommandRecorder::Target& target,
+        ShaderPipline& pipeline, VkDescriptorSet globalDescriptorSet, float dt, int frameIndex, VulkanRingBuffer* frameRing = nullptr);
+
+    // overlay with the recording time of each thread in the last renderParallel
+    void renderRecordStats(const VulkanCommandRecorder& recorder, std::string font, Shader shader, float x, float y, float lineHeight);
+
     // render text
     void renderText(std::string font, Shader shader, std::string text, float x, float y, glm::vec2 scale, glm::vec3 color);
 
@@ -195,7 +239,7 @@ public:
         Model/instance methods
     */
 
-    // register model into model trie
+    // register model into model map
     void registerModel(Model* model);
 
     // generate instance of specified model with physical parameters
@@ -209,22 +253,22 @@ public:
     void initInstances();
 
     // load model data
-    void loadModels();
+    void loadModels(const ModelImportCallback& onProgress = nullptr);
 
-    // delete instance
-    void removeInstance(std::string instanceId);
+    // delete instance (instances marked for deletion are deleted with it)
+    void removeInstance(InstanceId instanceId);
 
     // mark instance for deletion
-    void markForDeletion(std::string instanceId);
+    void markForDeletion(InstanceId instanceId);
 
     // clear all instances marked for deletion
     void clearDeadInstances();
 
-    // current instance id
-    std::string currentId;
+    // get instance (nullptr if it was removed)
+    RigidBody* getInstance(InstanceId instanceId);
 
-    // generate next instance id
-    std::string generateId();
+    // readable name of an instance for debugging ("<model id>#<slot>")
+    std::string getInstanceName(InstanceId instanceId);
 
     /*
         lights